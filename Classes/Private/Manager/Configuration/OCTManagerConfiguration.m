@@ -30,6 +30,7 @@ static NSString *const kDefaultBaseDirectory = @"me.dvor.objcTox";
 
     configuration.importToxSaveFromPath = nil;
     configuration.useFauxOfflineMessaging = YES;
+    configuration.toxSaveMaxLatency = 2.0;
 
     return configuration;
 }
@@ -44,6 +45,7 @@ static NSString *const kDefaultBaseDirectory = @"me.dvor.objcTox";
     configuration.options = [self.options copy];
     configuration.importToxSaveFromPath = [self.importToxSaveFromPath copy];
     configuration.useFauxOfflineMessaging = self.useFauxOfflineMessaging;
+    configuration.toxSaveMaxLatency = self.toxSaveMaxLatency;
 
     return configuration;
 }
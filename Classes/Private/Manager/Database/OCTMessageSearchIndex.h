@@ -0,0 +1,67 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Foundation/Foundation.h>
+
+@class RLMRealm;
+@class OCTMessageAbstract;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Inverted index of text messages stored in OCTMessageSearchEntry and OCTMessageSearchToken objects.
+ * Index is updated in the same write transaction as messages by OCTRealmManager.
+ */
+@interface OCTMessageSearchIndex : NSObject
+
+/**
+ * Splits string into words using Unicode word boundaries (dictionary based for languages without spaces),
+ * words are folded to be case, diacritic and width insensitive.
+ *
+ * @return Unique tokens in order of their first appearance.
+ */
++ (NSArray<NSString *> *)tokensFromString:(NSString *)string;
+
+/**
+ * Adds entries for text messages. Should be called inside of write transaction.
+ *
+ * @param messages Managed messages, ones without messageText are skipped.
+ * @param realm Realm messages belong to.
+ */
++ (void)addMessages:(id<NSFastEnumeration>)messages inRealm:(RLMRealm *)realm;
+
+/**
+ * Removes entries of messages. Should be called inside of write transaction before messages are deleted.
+ */
++ (void)removeMessages:(id<NSFastEnumeration>)messages inRealm:(RLMRealm *)realm;
+
+/**
+ * Removes entries of all messages in chat. Should be called inside of write transaction.
+ */
++ (void)removeMessagesInChat:(NSString *)chatUniqueIdentifier inRealm:(RLMRealm *)realm;
+
+/**
+ * Checks whether message has entries in index.
+ */
++ (BOOL)isMessageIndexed:(OCTMessageAbstract *)message inRealm:(RLMRealm *)realm;
+
+/**
+ * Builds predicate for OCTMessageAbstract matching messages that contain all words of query.
+ * Each word matches tokens starting with it. Messages are matched through their links to index entries,
+ * so the predicate doesn't depend on number of matching messages.
+ *
+ * @param query Text to search.
+ * @param chatUniqueIdentifier Chat to search in, nil to search in all chats.
+ * @param realm Realm to search in.
+ *
+ * @return Predicate for OCTMessageAbstract, matching nothing if query contains no words or some word
+ * has no tokens in index.
+ */
++ (NSPredicate *)messagePredicateMatchingQuery:(NSString *)query
+                         chatUniqueIdentifier:(nullable NSString *)chatUniqueIdentifier
+                                      inRealm:(RLMRealm *)realm;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,145 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Realm/Realm.h>
+
+#import "OCTMessageSearchIndex.h"
+#import "OCTMessageSearchEntry.h"
+#import "OCTMessageSearchToken.h"
+#import "OCTMessageAbstract.h"
+#import "OCTMessageText.h"
+
+static const NSUInteger kMaxTokenLength = 64;
+
+/**
+ * Name of OCTMessageAbstract property linking message to its entries.
+ */
+static NSString *const kSearchEntriesProperty = @"searchEntries";
+
+@implementation OCTMessageSearchIndex
+
+#pragma mark -  Public
+
++ (NSArray<NSString *> *)tokensFromString:(NSString *)string
+{
+    NSParameterAssert(string);
+
+    if (! string.length) {
+        return @[];
+    }
+
+    NSMutableOrderedSet<NSString *> *tokens = [NSMutableOrderedSet new];
+
+    CFStringTokenizerRef tokenizer = CFStringTokenizerCreate(
+        kCFAllocatorDefault,
+        (__bridge CFStringRef)string,
+        CFRangeMake(0, string.length),
+        kCFStringTokenizerUnitWord,
+        NULL);
+
+    NSCharacterSet *alphanumerics = [NSCharacterSet alphanumericCharacterSet];
+
+    while (CFStringTokenizerAdvanceToNextToken(tokenizer) != kCFStringTokenizerTokenNone) {
+        CFRange range = CFStringTokenizerGetCurrentTokenRange(tokenizer);
+        NSString *token = [string substringWithRange:NSMakeRange(range.location, range.length)];
+
+        if ([token rangeOfCharacterFromSet:alphanumerics].location == NSNotFound) {
+            continue;
+        }
+
+        token = [token stringByFoldingWithOptions:NSCaseInsensitiveSearch | NSDiacriticInsensitiveSearch | NSWidthInsensitiveSearch
+                                           locale:nil];
+
+        if (token.length > kMaxTokenLength) {
+            token = [token substringToIndex:[token rangeOfComposedCharacterSequenceAtIndex:kMaxTokenLength].location];
+        }
+
+        [tokens addObject:token];
+    }
+
+    CFRelease(tokenizer);
+
+    return [tokens array];
+}
+
++ (void)addMessages:(id<NSFastEnumeration>)messages inRealm:(RLMRealm *)realm
+{
+    for (OCTMessageAbstract *message in messages) {
+        NSString *text = message.messageText.text;
+
+        if (! text) {
+            continue;
+        }
+
+        for (NSString *token in [self tokensFromString:text]) {
+            OCTMessageSearchEntry *entry = [OCTMessageSearchEntry new];
+            entry.token = token;
+            entry.message = message;
+            entry.chatUniqueIdentifier = message.chatUniqueIdentifier;
+            [realm addObject:entry];
+
+            if (! [OCTMessageSearchToken objectInRealm:realm forPrimaryKey:token]) {
+                OCTMessageSearchToken *searchToken = [OCTMessageSearchToken new];
+                searchToken.token = token;
+                [realm addObject:searchToken];
+            }
+        }
+    }
+}
+
++ (void)removeMessages:(id<NSFastEnumeration>)messages inRealm:(RLMRealm *)realm
+{
+    // Tokens are kept, ones without entries simply match nothing.
+    for (OCTMessageAbstract *message in messages) {
+        if (! message.messageText) {
+            continue;
+        }
+
+        [realm deleteObjects:message[kSearchEntriesProperty]];
+    }
+}
+
++ (void)removeMessagesInChat:(NSString *)chatUniqueIdentifier inRealm:(RLMRealm *)realm
+{
+    [realm deleteObjects:[OCTMessageSearchEntry objectsInRealm:realm
+                                                         where:@"chatUniqueIdentifier == %@", chatUniqueIdentifier]];
+}
+
++ (BOOL)isMessageIndexed:(OCTMessageAbstract *)message inRealm:(RLMRealm *)realm
+{
+    RLMLinkingObjects *entries = message[kSearchEntriesProperty];
+    return entries.count > 0;
+}
+
++ (NSPredicate *)messagePredicateMatchingQuery:(NSString *)query
+                         chatUniqueIdentifier:(NSString *)chatUniqueIdentifier
+                                      inRealm:(RLMRealm *)realm
+{
+    NSParameterAssert(query);
+
+    NSArray<NSString *> *words = [self tokensFromString:query];
+
+    if (! words.count) {
+        return [NSPredicate predicateWithValue:NO];
+    }
+
+    NSMutableArray<NSPredicate *> *predicates = [NSMutableArray new];
+
+    if (chatUniqueIdentifier) {
+        [predicates addObject:[NSPredicate predicateWithFormat:@"chatUniqueIdentifier == %@", chatUniqueIdentifier]];
+    }
+
+    for (NSString *word in words) {
+        // Distinct tokens are far fewer than entries, word which is not a prefix of any of them matches nothing.
+        if (! [OCTMessageSearchToken objectsInRealm:realm where:@"token BEGINSWITH %@", word].count) {
+            return [NSPredicate predicateWithValue:NO];
+        }
+
+        [predicates addObject:[NSPredicate predicateWithFormat:@"ANY %K.token BEGINSWITH %@", kSearchEntriesProperty, word]];
+    }
+
+    return [NSCompoundPredicate andPredicateWithSubpredicates:predicates];
+}
+
+@end
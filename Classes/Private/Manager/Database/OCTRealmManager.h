@@ -7,6 +7,7 @@
 #import "OCTToxConstants.h"
 #import "OCTManagerConstants.h"
 
+@class OCTTox;
 @class OCTObject;
 @class OCTFriend;
 @class OCTChat;
@@ -14,6 +15,7 @@
 @class OCTMessageAbstract;
 @class OCTSettingsStorageObject;
 @class RLMResults;
+@class RLMRealm;
 
 @interface OCTRealmManager : NSObject
 
@@ -45,8 +47,67 @@
 
 - (NSURL *)realmFileURL;
 
+/**
+ * Realm instances are confined to the thread they were created on. Tox delegate methods may be delivered
+ * on a queue other than main (see OCTToxOptions.delegateQueue), in that case per-thread instance is used.
+ *
+ * Queue is not a thread: blocks of the same queue may run on different threads. Objects fetched off
+ * the thread manager was created on are valid only inside of block they were fetched in. Keep their
+ * uniqueIdentifier and fetch them by primary key in the next block.
+ *
+ * @return Main instance on the thread manager was created on, per-thread instance on other threads.
+ * Per-thread instance is at the version it was opened at, write transaction advances it to the latest one.
+ * It must not be passed to other threads.
+ */
+- (RLMRealm *)currentRealm;
+
+/**
+ * Number of write transactions committed by manager. Used for diagnostics and benchmarks.
+ */
+@property (assign, nonatomic, readonly) NSUInteger writeTransactionsCount;
+
+/**
+ * All writes made by manager inside of block on current thread are committed in single write transaction.
+ * Calls can be nested, nested calls are part of outer transaction.
+ *
+ * Manager queue and Realm write lock are held while block runs, block must not wait for other threads
+ * (e.g. call methods of OCTTox that are not served from its caches). If block throws, transaction is
+ * cancelled and exception is rethrown.
+ *
+ * @param block Block to perform, it is called synchronously.
+ */
+- (void)performBatchUpdates:(void (^)(void))block;
+
+/**
+ * Maximum time async writes are collected for before being committed. With 0 (default value) they are
+ * committed as soon as writer queue of manager picks them up.
+ */
+@property (assign, atomic) NSTimeInterval asyncWritesInterval;
+
+/**
+ * Enqueues write and returns immediately, on any thread. Pending writes are owned by writer queue of manager
+ * and are committed there in single write transaction after asyncWritesInterval, or earlier together with
+ * synchronous write or flushAsyncWrites call on any thread, whichever comes first.
+ *
+ * @param block Block making changes using methods of manager. It may be called on writer queue or on thread
+ * of synchronous write, so it must not capture realm objects. Fetch them by primary key inside of block.
+ * @param completion Called after changes are committed, on the same thread as block. Can be nil.
+ */
+- (void)performAsyncWrite:(void (^)(void))block completion:(void (^)(void))completion;
+
+/**
+ * Commits all pending async writes on current thread and refreshes realm of current thread, so it sees
+ * writes already committed on writer queue. Must not be called inside of performBatchUpdates:.
+ */
+- (void)flushAsyncWrites;
+
 #pragma mark -  Basic methods
 
+/**
+ * Read methods don't go through manager queue, they use Realm instance of calling thread (see currentRealm).
+ * Readers on different threads don't wait for each other or for commits of writer. Returned objects belong
+ * to calling thread and must not be passed to other threads.
+ */
 - (id)objectWithUniqueIdentifier:(NSString *)uniqueIdentifier class:(Class)class;
 
 - (RLMResults *)objectsWithClass:(Class)class predicate:(NSPredicate *)predicate;
@@ -58,6 +119,9 @@
  * All realm objects should be updated ONLY using following two methods.
  *
  * Specified object will be passed in block.
+ *
+ * Write methods are synchronous. Outside of performBatchUpdates: they commit pending async writes
+ * in the same transaction.
  */
 - (void)updateObject:(OCTObject *)object withBlock:(void (^)(id theObject))updateBlock;
 
@@ -68,6 +132,17 @@
 #pragma mark -  Other methods
 
 - (OCTFriend *)friendWithPublicKey:(NSString *)publicKey;
+
+/**
+ * Resolves friend through friends cache of OCTTox: uniqueIdentifier of OCTFriend is stored there as client
+ * identifier, so after first lookup friend is fetched by primary key without querying by public key.
+ *
+ * On cache miss public key is requested from tox, so this method should be called before performBatchUpdates:,
+ * not inside of it.
+ *
+ * @return Friend or nil if there is no such friend in tox or in database.
+ */
+- (OCTFriend *)friendWithFriendNumber:(OCTToxFriendNumber)friendNumber tox:(OCTTox *)tox;
 - (OCTChat *)getOrCreateChatWithFriend:(OCTFriend *)friend;
 - (OCTCall *)createCallWithChat:(OCTChat *)chat status:(OCTCallStatus)status;
 
@@ -79,9 +154,25 @@
  */
 - (OCTCall *)getCurrentCallForChat:(OCTChat *)chat;
 
+/**
+ * Removes messages and updates messageCount, unreadCount and lastMessage of their chats in the same
+ * write transaction. New lastMessage is looked up only if it was removed.
+ */
 - (void)removeMessages:(NSArray<OCTMessageAbstract *> *)messages;
 - (void)removeAllMessagesInChat:(OCTChat *)chat removeChat:(BOOL)removeChat;
 
+/**
+ * Counts incoming messages in chat that have date later than lastReadDateInterval. Only these messages are
+ * visited, so it is cheap for chats that are read.
+ */
+- (NSInteger)unreadCountInChat:(OCTChat *)chat lastReadDateInterval:(NSTimeInterval)lastReadDateInterval;
+
+/**
+ * Recomputes messageCount, unreadCount and lastMessage of all chats from their messages. These are updated
+ * together with messages, use it to repair them. Visits every message.
+ */
+- (void)recomputeChatAggregates;
+
 /**
  * Converts all the OCTCalls to OCTMessageCalls.
  * Only use this when first starting the app or during termination.
@@ -100,9 +191,38 @@
                                         fileName:(NSString *)fileName
                                         filePath:(NSString *)filePath
                                          fileUTI:(NSString *)fileUTI
+                                          fileId:(NSData *)fileId
                                             chat:(OCTChat *)chat
                                           sender:(OCTFriend *)sender;
 
 - (OCTMessageAbstract *)addMessageCall:(OCTCall *)call;
 
+/**
+ * Adds messages and updates lastMessage, lastActivityDateInterval, messageCount and unreadCount of their chats
+ * in single write transaction.
+ * Use it for bursts of incoming messages.
+ *
+ * @param messages Unmanaged messages with chatUniqueIdentifier set.
+ */
+- (void)addMessages:(NSArray<OCTMessageAbstract *> *)messages;
+
+/**
+ * Searches text messages using search index. Index is updated together with messages.
+ *
+ * @param query Text to search, each word matches words starting with it.
+ * @param chatUniqueIdentifier Chat to search in, nil to search in all chats.
+ *
+ * @return Messages containing all words of query sorted by date descending. Messages are matched through
+ * links to their index entries, results are updated as messages are added or removed.
+ */
+- (RLMResults *)searchMessagesWithQuery:(NSString *)query chatUniqueIdentifier:(NSString *)chatUniqueIdentifier;
+
+/**
+ * Indexes messages added before search index was introduced on background queue. Does nothing
+ * if it was already done.
+ *
+ * @param completionBlock Called on main queue when index is complete. Can be nil.
+ */
+- (void)rebuildSearchIndexIfNeededWithCompletionBlock:(void (^)(void))completionBlock;
+
 @end
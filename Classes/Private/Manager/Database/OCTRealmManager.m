@@ -14,16 +14,51 @@
 #import "OCTMessageFile.h"
 #import "OCTMessageCall.h"
 #import "OCTSettingsStorageObject.h"
+#import "OCTMessageSearchIndex.h"
+#import "OCTMessageSearchEntry.h"
+#import "OCTTox.h"
 #import "OCTLogging.h"
 
-static const uint64_t kCurrentSchemeVersion = 7;
+static const uint64_t kCurrentSchemeVersion = 14;
 static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrimaryKey";
+static const NSUInteger kSearchIndexRebuildBatchSize = 1000;
+
+// Marks manager queue, so nested calls made while it is held run right away instead of deadlocking.
+static const void *kQueueSpecificKey = &kQueueSpecificKey;
+
+/**
+ * When lastMessage of chat is removed, new one is searched among messages in this window before removed one.
+ * Window grows until message is found.
+ */
+static const NSTimeInterval kLastMessageInitialWindow = 60 * 60;
+static const NSUInteger kLastMessageWindowGrowthFactor = 8;
 
 @interface OCTRealmManager ()
 
 @property (strong, nonatomic) dispatch_queue_t queue;
 @property (strong, nonatomic) RLMRealm *realm;
 
+// Configuration of realm, used to open instances on other threads without touching realm itself.
+@property (strong, nonatomic) RLMRealmConfiguration *configuration;
+
+// Thread realm was created on. On any other thread per-thread realm instance is used.
+@property (strong, nonatomic) NSThread *realmThread;
+
+// Async writes are committed on this queue, whichever thread realm was created on.
+@property (strong, nonatomic) dispatch_queue_t writerQueue;
+
+@property (assign, nonatomic, readwrite) NSUInteger writeTransactionsCount;
+
+// Async writes and their completions (NSNull if none), guarded by @synchronized(pendingWrites).
+@property (strong, nonatomic) NSMutableArray<dispatch_block_t> *pendingWrites;
+@property (strong, nonatomic) NSMutableArray *pendingCompletions;
+@property (assign, nonatomic) BOOL flushScheduled;
+// Incremented on every flush, so delayed flush that was already done early is skipped.
+@property (assign, nonatomic) NSUInteger flushGeneration;
+// Held while pending writes are taken and committed, so flush returns only after writes taken by
+// concurrent flush are committed as well.
+@property (strong, nonatomic) NSObject *flushLock;
+
 @end
 
 @implementation OCTRealmManager
@@ -77,6 +112,12 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
     OCTLogInfo(@"init with fileURL %@", fileURL);
 
     _queue = dispatch_queue_create("OCTRealmManager queue", NULL);
+    dispatch_queue_set_specific(_queue, kQueueSpecificKey, (__bridge void *)self, NULL);
+    _realmThread = [NSThread currentThread];
+    _writerQueue = dispatch_queue_create("me.dvor.objcTox.OCTRealmManagerWriterQueue", NULL);
+    _pendingWrites = [NSMutableArray new];
+    _pendingCompletions = [NSMutableArray new];
+    _flushLock = [NSObject new];
 
     __weak OCTRealmManager *weakSelf = self;
     dispatch_sync(_queue, ^{
@@ -84,6 +125,7 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
 
         // TODO handle error
         self->_realm = [OCTRealmManager createRealmWithFileURL:fileURL encryptionKey:encryptionKey error:nil];
+        self->_configuration = self->_realm.configuration;
         [strongSelf createSettingsStorage];
     });
 
@@ -99,6 +141,76 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
     return self.realm.configuration.fileURL;
 }
 
+- (RLMRealm *)currentRealm
+{
+    if ([NSThread currentThread] == self.realmThread) {
+        return self.realm;
+    }
+
+    // Instance is cached by Realm while it is referenced. Opened inside of delegate block, it is released
+    // with block's autorelease pool, so next block opens it again at the latest version without refresh.
+    NSError *error;
+    RLMRealm *realm = [RLMRealm realmWithConfiguration:self.configuration error:&error];
+
+    if (! realm) {
+        OCTLogError(@"cannot open realm on thread %@, error %@", [NSThread currentThread], error);
+        [NSException raise:NSInternalInconsistencyException format:@"Cannot open realm on thread: %@", error];
+    }
+
+    return realm;
+}
+
+- (OCTSettingsStorageObject *)settingsStorage
+{
+    if ([NSThread currentThread] == self.realmThread) {
+        return _settingsStorage;
+    }
+
+    return [OCTSettingsStorageObject objectInRealm:[self currentRealm] forPrimaryKey:kSettingsStorageObjectPrimaryKey];
+}
+
+- (void)performBatchUpdates:(void (^)(void))block
+{
+    NSParameterAssert(block);
+
+    RLMRealm *realm = [self currentRealm];
+
+    [self performWriteInRealm:realm block:block];
+}
+
+- (void)performAsyncWrite:(void (^)(void))block completion:(void (^)(void))completion
+{
+    NSParameterAssert(block);
+
+    BOOL needsScheduling;
+    NSUInteger generation;
+
+    @synchronized(self.pendingWrites) {
+        [self.pendingWrites addObject:[block copy]];
+        [self.pendingCompletions addObject:completion ? [completion copy] : [NSNull null]];
+
+        needsScheduling = ! self.flushScheduled;
+        self.flushScheduled = YES;
+        generation = self.flushGeneration;
+    }
+
+    if (needsScheduling) {
+        [self scheduleFlushOfGeneration:generation];
+    }
+}
+
+- (void)flushAsyncWrites
+{
+    [self commitPendingWritesWithWrite:nil];
+
+    // Writes could have been committed on writer queue, current thread should see them.
+    RLMRealm *realm = [self currentRealm];
+
+    if (! realm.inWriteTransaction) {
+        [realm refresh];
+    }
+}
+
 #pragma mark -  Basic methods
 
 - (id)objectWithUniqueIdentifier:(NSString *)uniqueIdentifier class:(Class)class
@@ -106,26 +218,14 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
     NSParameterAssert(uniqueIdentifier);
     NSParameterAssert(class);
 
-    __block OCTObject *object = nil;
-
-    dispatch_sync(self.queue, ^{
-        object = [class objectInRealm:self.realm forPrimaryKey:uniqueIdentifier];
-    });
-
-    return object;
+    return [class objectInRealm:[self currentRealm] forPrimaryKey:uniqueIdentifier];
 }
 
 - (RLMResults *)objectsWithClass:(Class)class predicate:(NSPredicate *)predicate
 {
     NSParameterAssert(class);
 
-    __block RLMResults *results;
-
-    dispatch_sync(self.queue, ^{
-        results = [class objectsInRealm:self.realm withPredicate:predicate];
-    });
-
-    return results;
+    return [class objectsInRealm:[self currentRealm] withPredicate:predicate];
 }
 
 - (void)updateObject:(OCTObject *)object withBlock:(void (^)(id theObject))updateBlock
@@ -135,13 +235,9 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
 
     OCTLogInfo(@"updateObject %@", object);
 
-    dispatch_sync(self.queue, ^{
-        [self.realm beginWriteTransaction];
-
+    [self performSyncWrite:^(RLMRealm *realm) {
         updateBlock(object);
-
-        [self.realm commitWriteTransaction];
-    });
+    }];
 }
 
 - (void)updateObjectsWithClass:(Class)class
@@ -153,15 +249,13 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
 
     OCTLogInfo(@"updating objects of class %@ with predicate %@", NSStringFromClass(class), predicate);
 
-    dispatch_sync(self.queue, ^{
-        RLMResults *results = [class objectsInRealm:self.realm withPredicate:predicate];
+    [self performSyncWrite:^(RLMRealm *realm) {
+        RLMResults *results = [class objectsInRealm:realm withPredicate:predicate];
 
-        [self.realm beginWriteTransaction];
         for (id object in results) {
             updateBlock(object);
         }
-        [self.realm commitWriteTransaction];
-    });
+    }];
 }
 
 - (void)addObject:(OCTObject *)object
@@ -170,13 +264,9 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
 
     OCTLogInfo(@"add object %@", object);
 
-    dispatch_sync(self.queue, ^{
-        [self.realm beginWriteTransaction];
-
-        [self.realm addObject:object];
-
-        [self.realm commitWriteTransaction];
-    });
+    [self performSyncWrite:^(RLMRealm *realm) {
+        [realm addObject:object];
+    }];
 }
 
 - (void)deleteObject:(OCTObject *)object
@@ -185,13 +275,9 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
 
     OCTLogInfo(@"delete object %@", object);
 
-    dispatch_sync(self.queue, ^{
-        [self.realm beginWriteTransaction];
-
-        [self.realm deleteObject:object];
-
-        [self.realm commitWriteTransaction];
-    });
+    [self performSyncWrite:^(RLMRealm *realm) {
+        [realm deleteObject:object];
+    }];
 }
 
 #pragma mark -  Other methods
@@ -232,11 +318,33 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
 - (OCTFriend *)friendWithPublicKey:(NSString *)publicKey
 {
     NSAssert(publicKey, @"Public key should be non-empty.");
-    __block OCTFriend *friend;
 
-    dispatch_sync(self.queue, ^{
-        friend = [[OCTFriend objectsInRealm:self.realm where:@"publicKey == %@", publicKey] firstObject];
-    });
+    return [[OCTFriend objectsInRealm:[self currentRealm] where:@"publicKey == %@", publicKey] firstObject];
+}
+
+- (OCTFriend *)friendWithFriendNumber:(OCTToxFriendNumber)friendNumber tox:(OCTTox *)tox
+{
+    NSString *uniqueIdentifier = [tox clientIdentifierForFriendNumber:friendNumber];
+
+    if (uniqueIdentifier) {
+        OCTFriend *friend = [self objectWithUniqueIdentifier:uniqueIdentifier class:[OCTFriend class]];
+
+        if (friend) {
+            return friend;
+        }
+    }
+
+    NSString *publicKey = [tox publicKeyFromFriendNumber:friendNumber error:nil];
+
+    if (! publicKey) {
+        return nil;
+    }
+
+    OCTFriend *friend = [self friendWithPublicKey:publicKey];
+
+    if (friend) {
+        [tox setClientIdentifier:friend.uniqueIdentifier forFriendNumber:friendNumber];
+    }
 
     return friend;
 }
@@ -245,10 +353,12 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
 {
     __block OCTChat *chat = nil;
 
-    dispatch_sync(self.queue, ^{
+    [self performOnQueue:^{
+        RLMRealm *realm = [self currentRealm];
+
         // TODO add this (friends.@count == 1) condition. Currentry Realm doesn't support collection queries
         // See https://github.com/realm/realm-cocoa/issues/1490
-        chat = [[OCTChat objectsInRealm:self.realm where:@"ANY friends == %@", friend] firstObject];
+        chat = [[OCTChat objectsInRealm:realm where:@"ANY friends == %@", friend] firstObject];
 
         if (chat) {
             return;
@@ -259,13 +369,13 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
         chat = [OCTChat new];
         chat.lastActivityDateInterval = [[NSDate date] timeIntervalSince1970];
 
-        [self.realm beginWriteTransaction];
+        BOOL startedTransaction = [self beginWriteTransactionInRealm:realm];
 
-        [self.realm addObject:chat];
+        [realm addObject:chat];
         [chat.friends addObject:friend];
 
-        [self.realm commitWriteTransaction];
-    });
+        [self commitWriteTransactionInRealm:realm started:startedTransaction];
+    }];
 
     return chat;
 }
@@ -274,9 +384,11 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
 {
     __block OCTCall *call = nil;
 
-    dispatch_sync(self.queue, ^{
+    [self performOnQueue:^{
+        RLMRealm *realm = [self currentRealm];
+
 
-        call = [[OCTCall objectsInRealm:self.realm where:@"chat == %@", chat] firstObject];
+        call = [[OCTCall objectsInRealm:realm where:@"chat == %@", chat] firstObject];
 
         if (call) {
             return;
@@ -288,24 +400,17 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
         call.status = status;
         call.chat = chat;
 
-        [self.realm beginWriteTransaction];
-        [self.realm addObject:call];
-        [self.realm commitWriteTransaction];
-    });
+        BOOL startedTransaction = [self beginWriteTransactionInRealm:realm];
+        [realm addObject:call];
+        [self commitWriteTransactionInRealm:realm started:startedTransaction];
+    }];
 
     return call;
 }
 
 - (OCTCall *)getCurrentCallForChat:(OCTChat *)chat
 {
-    __block OCTCall *call = nil;
-
-    dispatch_sync(self.queue, ^{
-
-        call = [[OCTCall objectsInRealm:self.realm where:@"chat == %@", chat] firstObject];
-    });
-
-    return call;
+    return [[OCTCall objectsInRealm:[self currentRealm] where:@"chat == %@", chat] firstObject];
 }
 
 - (void)removeMessages:(NSArray<OCTMessageAbstract *> *)messages
@@ -314,26 +419,59 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
 
     OCTLogInfo(@"removing messages %lu", (unsigned long)messages.count);
 
-    dispatch_sync(self.queue, ^{
-        [self.realm beginWriteTransaction];
+    [self performOnQueue:^{
+        RLMRealm *realm = [self currentRealm];
+
+        BOOL startedTransaction = [self beginWriteTransactionInRealm:realm];
+
+        NSMutableDictionary<NSString *, OCTChat *> *chats = [NSMutableDictionary new];
+        NSCountedSet<NSString *> *removedCounts = [NSCountedSet new];
+        NSCountedSet<NSString *> *removedUnreadCounts = [NSCountedSet new];
+        // Date of removed lastMessage for chats that need new one.
+        NSMutableDictionary<NSString *, NSNumber *> *removedLastMessageDates = [NSMutableDictionary new];
 
-        NSMutableSet *changedChats = [NSMutableSet new];
         for (OCTMessageAbstract *message in messages) {
-            [changedChats addObject:message.chatUniqueIdentifier];
+            NSString *chatUniqueIdentifier = message.chatUniqueIdentifier;
+            OCTChat *chat = chats[chatUniqueIdentifier];
+
+            if (! chat) {
+                chat = [OCTChat objectInRealm:realm forPrimaryKey:chatUniqueIdentifier];
+
+                if (! chat) {
+                    continue;
+                }
+                chats[chatUniqueIdentifier] = chat;
+            }
+
+            [removedCounts addObject:chatUniqueIdentifier];
+
+            if (! message.isOutgoing && (message.dateInterval > chat.lastReadDateInterval)) {
+                [removedUnreadCounts addObject:chatUniqueIdentifier];
+            }
+
+            if ([chat.lastMessage.uniqueIdentifier isEqualToString:message.uniqueIdentifier]) {
+                removedLastMessageDates[chatUniqueIdentifier] = @(message.dateInterval);
+            }
         }
 
+        [OCTMessageSearchIndex removeMessages:messages inRealm:realm];
         [self removeMessagesWithSubmessages:messages];
 
-        for (NSString *chatUniqueIdentifier in changedChats) {
-            RLMResults *messages = [OCTMessageAbstract objectsInRealm:self.realm where:@"chatUniqueIdentifier == %@", chatUniqueIdentifier];
-            messages = [messages sortedResultsUsingKeyPath:@"dateInterval" ascending:YES];
+        [chats enumerateKeysAndObjectsUsingBlock:^(NSString *chatUniqueIdentifier, OCTChat *chat, BOOL *stop) {
+            chat.messageCount = MAX(chat.messageCount - (NSInteger)[removedCounts countForObject:chatUniqueIdentifier], 0);
+            chat.unreadCount = MAX(chat.unreadCount - (NSInteger)[removedUnreadCounts countForObject:chatUniqueIdentifier], 0);
 
-            OCTChat *chat = [OCTChat objectInRealm:self.realm forPrimaryKey:chatUniqueIdentifier];
-            chat.lastMessage = messages.lastObject;
-        }
+            NSNumber *removedLastMessageDate = removedLastMessageDates[chatUniqueIdentifier];
 
-        [self.realm commitWriteTransaction];
-    });
+            if (removedLastMessageDate) {
+                chat.lastMessage = [self lastMessageInChat:chatUniqueIdentifier
+                                        nearDateInterval:removedLastMessageDate.doubleValue
+                                                   realm:realm];
+            }
+        }];
+
+        [self commitWriteTransactionInRealm:realm started:startedTransaction];
+    }];
 }
 
 - (void)removeAllMessagesInChat:(OCTChat *)chat removeChat:(BOOL)removeChat
@@ -342,23 +480,57 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
 
     OCTLogInfo(@"removing chat with all messages %@", chat);
 
-    dispatch_sync(self.queue, ^{
-        RLMResults *messages = [OCTMessageAbstract objectsInRealm:self.realm where:@"chatUniqueIdentifier == %@", chat.uniqueIdentifier];
+    [self performOnQueue:^{
+        RLMRealm *realm = [self currentRealm];
 
-        [self.realm beginWriteTransaction];
+        RLMResults *messages = [OCTMessageAbstract objectsInRealm:realm where:@"chatUniqueIdentifier == %@", chat.uniqueIdentifier];
+
+        BOOL startedTransaction = [self beginWriteTransactionInRealm:realm];
 
+        [OCTMessageSearchIndex removeMessagesInChat:chat.uniqueIdentifier inRealm:realm];
         [self removeMessagesWithSubmessages:messages];
         if (removeChat) {
-            [self.realm deleteObject:chat];
+            [realm deleteObject:chat];
+        }
+        else {
+            chat.messageCount = 0;
+            chat.unreadCount = 0;
         }
 
-        [self.realm commitWriteTransaction];
-    });
+        [self commitWriteTransactionInRealm:realm started:startedTransaction];
+    }];
+}
+
+- (NSInteger)unreadCountInChat:(OCTChat *)chat lastReadDateInterval:(NSTimeInterval)lastReadDateInterval
+{
+    NSParameterAssert(chat);
+
+    return [OCTMessageAbstract objectsInRealm:[self currentRealm]
+                                        where:@"chatUniqueIdentifier == %@ AND dateInterval > %@ AND senderUniqueIdentifier != nil",
+            chat.uniqueIdentifier, @(lastReadDateInterval)].count;
+}
+
+- (void)recomputeChatAggregates
+{
+    OCTLogInfo(@"recomputing chat aggregates");
+
+    [self performSyncWrite:^(RLMRealm *realm) {
+        for (OCTChat *chat in [OCTChat allObjectsInRealm:realm]) {
+            RLMResults *messages = [OCTMessageAbstract objectsInRealm:realm
+                                                                where:@"chatUniqueIdentifier == %@", chat.uniqueIdentifier];
+
+            chat.messageCount = messages.count;
+            chat.unreadCount = [messages objectsWhere:@"dateInterval > %@ AND senderUniqueIdentifier != nil",
+                                @(chat.lastReadDateInterval)].count;
+            chat.lastMessage = [[messages sortedResultsUsingKeyPath:@"dateInterval" ascending:YES] lastObject];
+        }
+    }];
 }
 
 - (void)convertAllCallsToMessages
 {
-    RLMResults *calls = [OCTCall allObjectsInRealm:self.realm];
+    RLMRealm *realm = [self currentRealm];
+    RLMResults *calls = [OCTCall allObjectsInRealm:realm];
 
     OCTLogInfo(@"removing %lu calls", (unsigned long)calls.count);
 
@@ -366,9 +538,9 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
         [self addMessageCall:call];
     }
 
-    [self.realm beginWriteTransaction];
-    [self.realm deleteObjects:calls];
-    [self.realm commitWriteTransaction];
+    BOOL startedTransaction = [self beginWriteTransactionInRealm:realm];
+    [realm deleteObjects:calls];
+    [self commitWriteTransactionInRealm:realm started:startedTransaction];
 }
 
 - (OCTMessageAbstract *)addMessageWithText:(NSString *)text
@@ -396,6 +568,7 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
                                         fileName:(NSString *)fileName
                                         filePath:(NSString *)filePath
                                          fileUTI:(NSString *)fileUTI
+                                          fileId:(NSData *)fileId
                                             chat:(OCTChat *)chat
                                           sender:(OCTFriend *)sender
 {
@@ -408,6 +581,7 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
     messageFile.fileName = fileName;
     [messageFile internalSetFilePath:filePath];
     messageFile.fileUTI = fileUTI;
+    messageFile.internalFileId = fileId;
 
     return [self addMessageAbstractWithChat:chat sender:sender messageText:nil messageFile:messageFile messageCall:nil];
 }
@@ -434,8 +608,316 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
     return [self addMessageAbstractWithChat:call.chat sender:call.caller messageText:nil messageFile:nil messageCall:messageCall];
 }
 
+- (void)addMessages:(NSArray<OCTMessageAbstract *> *)messages
+{
+    NSParameterAssert(messages);
+
+    if (! messages.count) {
+        return;
+    }
+
+    OCTLogInfo(@"adding %lu messages", (unsigned long)messages.count);
+
+    [self performSyncWrite:^(RLMRealm *realm) {
+        [realm addObjects:messages];
+        [OCTMessageSearchIndex addMessages:messages inRealm:realm];
+
+        NSMutableDictionary<NSString *, OCTChat *> *chats = [NSMutableDictionary new];
+
+        for (OCTMessageAbstract *message in messages) {
+            OCTChat *chat = chats[message.chatUniqueIdentifier];
+
+            if (! chat) {
+                chat = [OCTChat objectInRealm:realm forPrimaryKey:message.chatUniqueIdentifier];
+
+                if (! chat) {
+                    continue;
+                }
+                chats[message.chatUniqueIdentifier] = chat;
+            }
+
+            chat.messageCount++;
+
+            if (! message.isOutgoing && (message.dateInterval > chat.lastReadDateInterval)) {
+                chat.unreadCount++;
+            }
+
+            if (! chat.lastMessage || (chat.lastMessage.dateInterval <= message.dateInterval)) {
+                chat.lastMessage = message;
+                chat.lastActivityDateInterval = message.dateInterval;
+            }
+        }
+    }];
+}
+
+- (RLMResults *)searchMessagesWithQuery:(NSString *)query chatUniqueIdentifier:(NSString *)chatUniqueIdentifier
+{
+    NSParameterAssert(query);
+
+    RLMRealm *realm = [self currentRealm];
+
+    NSPredicate *predicate = [OCTMessageSearchIndex messagePredicateMatchingQuery:query
+                                                             chatUniqueIdentifier:chatUniqueIdentifier
+                                                                          inRealm:realm];
+
+    RLMResults *results = [OCTMessageAbstract objectsInRealm:realm withPredicate:predicate];
+
+    return [results sortedResultsUsingKeyPath:@"dateInterval" ascending:NO];
+}
+
+- (void)rebuildSearchIndexIfNeededWithCompletionBlock:(void (^)(void))completionBlock
+{
+    if (self.settingsStorage.messageSearchIndexBuilt) {
+        if (completionBlock) {
+            dispatch_async(dispatch_get_main_queue(), completionBlock);
+        }
+        return;
+    }
+
+    OCTLogInfo(@"rebuilding message search index");
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+        [self rebuildSearchIndex];
+
+        OCTLogInfo(@"message search index rebuilt");
+
+        if (completionBlock) {
+            dispatch_async(dispatch_get_main_queue(), completionBlock);
+        }
+    });
+}
+
 #pragma mark -  Private
 
+/**
+ * Indexes text messages that are not indexed yet, in short transactions so writes made by other threads are
+ * not blocked for long. Each transaction goes through manager queue like any other write. Messages are taken
+ * in batches by date: order of objects in Realm isn't stable when other threads delete objects.
+ */
+- (void)rebuildSearchIndex
+{
+    @autoreleasepool {
+        RLMRealm *realm = [self currentRealm];
+        RLMResults *messages = [OCTMessageAbstract objectsInRealm:realm where:@"messageText != nil"];
+
+        NSNumber *min = [messages minOfProperty:@"dateInterval"];
+        NSNumber *max = [messages maxOfProperty:@"dateInterval"];
+
+        if (min && max) {
+            NSUInteger batchesCount = messages.count / kSearchIndexRebuildBatchSize + 1;
+            NSTimeInterval window = MAX((max.doubleValue - min.doubleValue) / batchesCount, 1.0);
+
+            for (NSTimeInterval from = min.doubleValue; from <= max.doubleValue; from += window) {
+                @autoreleasepool {
+                    [self performWriteInRealm:realm block:^{
+                        RLMResults *batch = [messages objectsWhere:@"dateInterval >= %@ AND dateInterval < %@", @(from), @(from + window)];
+
+                        for (OCTMessageAbstract *message in batch) {
+                            if (! [OCTMessageSearchIndex isMessageIndexed:message inRealm:realm]) {
+                                [OCTMessageSearchIndex addMessages:@[message] inRealm:realm];
+                            }
+                        }
+                    }];
+                }
+            }
+        }
+
+        [self performWriteInRealm:realm block:^{
+            OCTSettingsStorageObject *settingsStorage = [OCTSettingsStorageObject objectInRealm:realm
+                                                                                  forPrimaryKey:kSettingsStorageObjectPrimaryKey];
+            settingsStorage.messageSearchIndexBuilt = YES;
+        }];
+    }
+}
+
+/**
+ * Finds the latest message in chat. Messages newer than dateInterval are expected to be few, so search starts
+ * with small window before it and widens it until window has messages or covers whole history.
+ */
+- (OCTMessageAbstract *)lastMessageInChat:(NSString *)chatUniqueIdentifier
+                         nearDateInterval:(NSTimeInterval)dateInterval
+                                    realm:(RLMRealm *)realm
+{
+    RLMResults *messages = [OCTMessageAbstract objectsInRealm:realm where:@"chatUniqueIdentifier == %@", chatUniqueIdentifier];
+    RLMResults *candidates;
+
+    for (NSTimeInterval window = kLastMessageInitialWindow;; window *= kLastMessageWindowGrowthFactor) {
+        NSTimeInterval from = dateInterval - window;
+
+        if (from <= 0) {
+            candidates = messages;
+            break;
+        }
+
+        candidates = [messages objectsWhere:@"dateInterval >= %@", @(from)];
+
+        if (candidates.count) {
+            break;
+        }
+    }
+
+    return [[candidates sortedResultsUsingKeyPath:@"dateInterval" ascending:YES] lastObject];
+}
+
+/**
+ * Write is committed together with pending async writes, so it sees them. Inside of transaction
+ * it joins it instead.
+ */
+- (void)performSyncWrite:(void (^)(RLMRealm *realm))block
+{
+    RLMRealm *realm = [self currentRealm];
+
+    if (realm.inWriteTransaction) {
+        [self performWriteInRealm:realm block:^{
+            block(realm);
+        }];
+        return;
+    }
+
+    // Block may use objects of current thread, so it isn't put to pending writes other threads may take.
+    [self commitPendingWritesWithWrite:^{
+        block(realm);
+    }];
+}
+
+- (void)scheduleFlushOfGeneration:(NSUInteger)generation
+{
+    dispatch_time_t time = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.asyncWritesInterval * NSEC_PER_SEC));
+
+    // Manager is retained until pending writes are committed.
+    dispatch_after(time, self.writerQueue, ^{
+        @synchronized(self.pendingWrites) {
+            if (generation != self.flushGeneration) {
+                // Writes were already flushed by synchronous write.
+                return;
+            }
+        }
+
+        // Per-thread realm is released with the pool, next flush opens it at the latest version.
+        @autoreleasepool {
+            [self commitPendingWritesWithWrite:nil];
+        }
+    });
+}
+
+/**
+ * Commits pending writes in single transaction on current thread and calls their completions.
+ * Must not be called inside of transaction, flush lock would be taken after Realm write lock.
+ *
+ * @param write Write committed after pending ones in the same transaction. Can be nil.
+ */
+- (void)commitPendingWritesWithWrite:(dispatch_block_t)write
+{
+    @synchronized(self.flushLock) {
+        NSArray<dispatch_block_t> *writes;
+        NSArray *completions;
+
+        @synchronized(self.pendingWrites) {
+            writes = [self.pendingWrites copy];
+            completions = [self.pendingCompletions copy];
+
+            [self.pendingWrites removeAllObjects];
+            [self.pendingCompletions removeAllObjects];
+
+            self.flushScheduled = NO;
+            self.flushGeneration++;
+        }
+
+        if (! writes.count && ! write) {
+            return;
+        }
+
+        [self performBatchUpdates:^{
+            for (dispatch_block_t pendingWrite in writes) {
+                pendingWrite();
+            }
+
+            if (write) {
+                write();
+            }
+        }];
+
+        for (id completion in completions) {
+            if (completion != [NSNull null]) {
+                ((dispatch_block_t)completion)();
+            }
+        }
+    }
+}
+
+/**
+ * Runs block on manager queue. Called while queue is already held by current thread (e.g. write method
+ * called inside of performBatchUpdates:), runs block right away.
+ */
+- (void)performOnQueue:(dispatch_block_t)block
+{
+    if (dispatch_get_specific(kQueueSpecificKey) == (__bridge void *)self) {
+        block();
+        return;
+    }
+
+    dispatch_sync(self.queue, block);
+}
+
+/**
+ * Begins, runs and commits write transaction as one unit on manager queue, so writer holding Realm write
+ * lock never waits for the queue. Joins transaction already in progress.
+ *
+ * If block throws, transaction started here is cancelled and exception is rethrown. It is caught inside
+ * of queue block, exceptions must not unwind through dispatch_sync.
+ */
+- (void)performWriteInRealm:(RLMRealm *)realm block:(dispatch_block_t)block
+{
+    __block NSException *blockException = nil;
+
+    [self performOnQueue:^{
+        BOOL startedTransaction = [self beginWriteTransactionInRealm:realm];
+
+        @try {
+            block();
+        }
+        @catch (NSException *exception) {
+            blockException = exception;
+        }
+
+        if (! blockException) {
+            [self commitWriteTransactionInRealm:realm started:startedTransaction];
+        }
+        else if (startedTransaction) {
+            [realm cancelWriteTransaction];
+        }
+    }];
+
+    if (blockException) {
+        @throw blockException;
+    }
+}
+
+/**
+ * Begins write transaction unless it is already in progress (e.g. inside of performBatchUpdates:).
+ *
+ * @return YES if transaction was started and should be committed by caller, NO otherwise.
+ */
+- (BOOL)beginWriteTransactionInRealm:(RLMRealm *)realm
+{
+    if (realm.inWriteTransaction) {
+        return NO;
+    }
+
+    [realm beginWriteTransaction];
+    return YES;
+}
+
+- (void)commitWriteTransactionInRealm:(RLMRealm *)realm started:(BOOL)started
+{
+    if (! started) {
+        return;
+    }
+
+    [realm commitWriteTransaction];
+    self.writeTransactionsCount++;
+}
+
 + (RLMMigrationBlock)realmMigrationBlock
 {
     return ^(RLMMigration *migration, uint64_t oldSchemaVersion) {
@@ -468,6 +950,40 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
                if (oldSchemaVersion < 7) {
                    [self doMigrationVersion7:migration];
                }
+
+               if (oldSchemaVersion < 8) {
+                   // Indexes on OCTFriend.publicKey, OCTFriend.connectionStatus,
+                   // OCTMessageAbstract.chatUniqueIdentifier and OCTMessageFile.internalFilePath.
+                   // Realm builds them on its own.
+               }
+
+               if (oldSchemaVersion < 9) {
+                   // OCTMessageSearchEntry and OCTMessageSearchToken: message search index.
+                   // OCTSettingsStorageObject: adding messageSearchIndexBuilt property, index is rebuilt in background.
+               }
+
+               if (oldSchemaVersion < 10) {
+                   // OCTChat: adding messageCount and unreadCount properties.
+                   [self doMigrationVersion10:migration];
+               }
+
+               if (oldSchemaVersion < 11) {
+                   // OCTMessageOutboxEntry: outgoing messages not passed to toxcore yet.
+               }
+
+               if (oldSchemaVersion < 12) {
+                   // OCTFriend: isConnected, connectionStatus and isTyping moved to OCTPresenceStore.
+                   // Realm drops their columns on its own.
+               }
+
+               if (oldSchemaVersion < 13) {
+                   // OCTMessageFile: internalFileId and internalTempFileName, added by Realm on its own.
+               }
+
+               if (oldSchemaVersion < 14) {
+                   // OCTMessageSearchEntry: messageUniqueIdentifier replaced with link to message.
+                   [self doMigrationVersion14:migration];
+               }
     };
 }
 
@@ -529,6 +1045,52 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
     }];
 }
 
++ (void)doMigrationVersion10:(RLMMigration *)migration
+{
+    NSMutableDictionary<NSString *, NSNumber *> *lastReadDateIntervals = [NSMutableDictionary new];
+
+    [migration enumerateObjects:OCTChat.className block:^(RLMObject *oldObject, RLMObject *newObject) {
+        lastReadDateIntervals[newObject[@"uniqueIdentifier"]] = newObject[@"lastReadDateInterval"];
+    }];
+
+    NSCountedSet<NSString *> *messageCounts = [NSCountedSet new];
+    NSCountedSet<NSString *> *unreadCounts = [NSCountedSet new];
+
+    [migration enumerateObjects:OCTMessageAbstract.className block:^(RLMObject *oldObject, RLMObject *newObject) {
+        NSString *chatUniqueIdentifier = newObject[@"chatUniqueIdentifier"];
+
+        if (! chatUniqueIdentifier) {
+            return;
+        }
+
+        [messageCounts addObject:chatUniqueIdentifier];
+
+        BOOL isIncoming = (newObject[@"senderUniqueIdentifier"] != nil);
+        double lastReadDateInterval = [lastReadDateIntervals[chatUniqueIdentifier] doubleValue];
+
+        if (isIncoming && ([newObject[@"dateInterval"] doubleValue] > lastReadDateInterval)) {
+            [unreadCounts addObject:chatUniqueIdentifier];
+        }
+    }];
+
+    [migration enumerateObjects:OCTChat.className block:^(RLMObject *oldObject, RLMObject *newObject) {
+        NSString *chatUniqueIdentifier = newObject[@"uniqueIdentifier"];
+
+        newObject[@"messageCount"] = @([messageCounts countForObject:chatUniqueIdentifier]);
+        newObject[@"unreadCount"] = @([unreadCounts countForObject:chatUniqueIdentifier]);
+    }];
+}
+
++ (void)doMigrationVersion14:(RLMMigration *)migration
+{
+    // Entries are dropped and rebuilt in background, same as for databases created before search index.
+    [migration deleteDataForClassName:OCTMessageSearchEntry.className];
+
+    [migration enumerateObjects:OCTSettingsStorageObject.className block:^(RLMObject *oldObject, RLMObject *newObject) {
+        newObject[@"messageSearchIndexBuilt"] = @NO;
+    }];
+}
+
 /**
  * Only one of messageText, messageFile or messageCall can be non-nil.
  */
@@ -553,12 +1115,7 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
     messageAbstract.messageFile = messageFile;
     messageAbstract.messageCall = messageCall;
 
-    [self addObject:messageAbstract];
-
-    [self updateObject:chat withBlock:^(OCTChat *theChat) {
-        theChat.lastMessage = messageAbstract;
-        theChat.lastActivityDateInterval = messageAbstract.dateInterval;
-    }];
+    [self addMessages:@[messageAbstract]];
 
     return messageAbstract;
 }
@@ -566,19 +1123,21 @@ static NSString *kSettingsStorageObjectPrimaryKey = @"kSettingsStorageObjectPrim
 // Delete an NSArray, RLMArray, or RLMResults of messages from this Realm.
 - (void)removeMessagesWithSubmessages:(id)messages
 {
+    RLMRealm *realm = [self currentRealm];
+
     for (OCTMessageAbstract *message in messages) {
         if (message.messageText) {
-            [self.realm deleteObject:message.messageText];
+            [realm deleteObject:message.messageText];
         }
         if (message.messageFile) {
-            [self.realm deleteObject:message.messageFile];
+            [realm deleteObject:message.messageFile];
         }
         if (message.messageCall) {
-            [self.realm deleteObject:message.messageCall];
+            [realm deleteObject:message.messageCall];
         }
     }
 
-    [self.realm deleteObjects:messages];
+    [realm deleteObjects:messages];
 }
 
 @end
@@ -27,6 +27,12 @@
  */
 - (void)updateBytesDone:(OCTToxFileSize)bytesDone;
 
+/**
+ * Call this method from operationStarted if part of file was transferred earlier. Progress starts
+ * from these bytes, they are not counted in speed and eta.
+ */
+- (void)resumeFromBytesDone:(OCTToxFileSize)bytesDone;
+
 /**
  * Call this method in case if operation was finished.
  */
@@ -37,25 +37,16 @@ typedef void (^OCTFileBaseOperationFailureBlock)(OCTFileBaseOperation *__nonnull
 @interface OCTFileBaseOperation : NSOperation
 
 /**
- * Identifier of operation, unique for all active file operations.
+ * Progress properties. They are updated on the thread transfer runs on (tox iterate queue for chunks),
+ * and can be read from any thread.
  */
-@property (strong, nonatomic, readonly, nonnull) NSString *operationId;
-
-/**
- * Progress properties.
- */
-@property (assign, nonatomic, readonly) OCTToxFileSize bytesDone;
-@property (assign, nonatomic, readonly) float progress;
-@property (assign, nonatomic, readonly) OCTToxFileSize bytesPerSecond;
-@property (assign, nonatomic, readonly) CFTimeInterval eta;
+@property (assign, atomic, readonly) OCTToxFileSize bytesDone;
+@property (assign, atomic, readonly) float progress;
+@property (assign, atomic, readonly) OCTToxFileSize bytesPerSecond;
+@property (assign, atomic, readonly) CFTimeInterval eta;
 
 @property (strong, nonatomic, readonly, nullable) NSDictionary *userInfo;
 
-/**
- * Creates operation id from file and friend number.
- */
-+ (nonnull NSString *)operationIdFromFileNumber:(OCTToxFileNumber)fileNumber friendNumber:(OCTToxFriendNumber)friendNumber;
-
 /**
  * Create operation.
  *
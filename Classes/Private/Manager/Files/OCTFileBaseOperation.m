@@ -30,16 +30,18 @@ static const CFTimeInterval kMinUpdateEtaInterval = 1.0;
 @property (assign, nonatomic, readonly) OCTToxFileNumber fileNumber;
 @property (assign, nonatomic, readonly) OCTToxFileSize fileSize;
 
-@property (assign, nonatomic, readwrite) OCTToxFileSize bytesDone;
-@property (assign, nonatomic, readwrite) float progress;
-@property (assign, nonatomic, readwrite) OCTToxFileSize bytesPerSecond;
-@property (assign, nonatomic, readwrite) CFTimeInterval eta;
+@property (assign, atomic, readwrite) OCTToxFileSize bytesDone;
+@property (assign, atomic, readwrite) float progress;
+@property (assign, atomic, readwrite) OCTToxFileSize bytesPerSecond;
+@property (assign, atomic, readwrite) CFTimeInterval eta;
 
 @property (copy, nonatomic) OCTFileBaseOperationProgressBlock progressBlock;
 @property (copy, nonatomic) OCTFileBaseOperationProgressBlock etaUpdateBlock;
 @property (copy, nonatomic) OCTFileBaseOperationSuccessBlock successBlock;
 @property (copy, nonatomic) OCTFileBaseOperationFailureBlock failureBlock;
 
+// Progress bookkeeping, guarded by @synchronized(self). Chunks update it on tox iterate queue
+// while operation is started and cancelled on other threads.
 @property (assign, nonatomic) CFTimeInterval lastUpdateProgressTime;
 @property (assign, nonatomic) OCTToxFileSize lastUpdateBytesDone;
 @property (assign, nonatomic) CFTimeInterval lastUpdateEtaProgressTime;
@@ -51,13 +53,6 @@ static const CFTimeInterval kMinUpdateEtaInterval = 1.0;
 
 @implementation OCTFileBaseOperation
 
-#pragma mark -  Class methods
-
-+ (NSString *)operationIdFromFileNumber:(OCTToxFileNumber)fileNumber friendNumber:(OCTToxFriendNumber)friendNumber
-{
-    return [NSString stringWithFormat:@"%d-%d", fileNumber, friendNumber];
-}
-
 #pragma mark -  Lifecycle
 
 - (nullable instancetype)initWithTox:(nonnull OCTTox *)tox
@@ -79,8 +74,6 @@ static const CFTimeInterval kMinUpdateEtaInterval = 1.0;
         return nil;
     }
 
-    _operationId = [[self class] operationIdFromFileNumber:fileNumber friendNumber:friendNumber];
-
     _tox = tox;
 
     _friendNumber = friendNumber;
@@ -134,15 +127,41 @@ static const CFTimeInterval kMinUpdateEtaInterval = 1.0;
 
 - (void)updateBytesDone:(OCTToxFileSize)bytesDone
 {
-    self.bytesDone = bytesDone;
+    BOOL progressUpdated;
+    BOOL etaUpdated;
+
+    @synchronized(self) {
+        self.bytesDone = bytesDone;
+
+        progressUpdated = [self updateProgressIfNeeded:bytesDone];
+        etaUpdated = [self updateEtaIfNeeded:bytesDone];
+    }
+
+    // Blocks are called outside of lock, they read progress properties.
+    if (progressUpdated) {
+        [self callBlockOnMainThread:self.progressBlock];
+    }
+
+    if (etaUpdated) {
+        [self callBlockOnMainThread:self.etaUpdateBlock];
+    }
+}
+
+- (void)resumeFromBytesDone:(OCTToxFileSize)bytesDone
+{
+    @synchronized(self) {
+        self.bytesDone = bytesDone;
+        self.lastUpdateBytesDone = bytesDone;
+        self.lastUpdateEtaBytesDone = bytesDone;
+        self.progress = (float)bytesDone / self.fileSize;
+    }
 
-    [self updateProgressIfNeeded:bytesDone];
-    [self updateEtaIfNeeded:bytesDone];
+    OCTLogInfo(@"resuming from %lld bytes", bytesDone);
 }
 
 - (void)operationStarted
 {
-    OCTLogInfo(@"start loading file with identifier %@", self.operationId);
+    OCTLogInfo(@"start loading file with fileNumber %d friendNumber %d", self.fileNumber, self.friendNumber);
 }
 
 - (void)operationWasCanceled
@@ -191,11 +210,13 @@ static const CFTimeInterval kMinUpdateEtaInterval = 1.0;
 
     self.executing = YES;
 
-    self.lastUpdateProgressTime = CACurrentMediaTime();
-    self.lastUpdateBytesDone = 0;
-    self.lastUpdateEtaProgressTime = CACurrentMediaTime();
-    self.lastUpdateEtaBytesDone = 0;
-    self.last10EtaObjects = [NSMutableArray new];
+    @synchronized(self) {
+        self.lastUpdateProgressTime = CACurrentMediaTime();
+        self.lastUpdateBytesDone = 0;
+        self.lastUpdateEtaProgressTime = CACurrentMediaTime();
+        self.lastUpdateEtaBytesDone = 0;
+        self.last10EtaObjects = [NSMutableArray new];
+    }
 
     [self operationStarted];
 }
@@ -217,14 +238,17 @@ static const CFTimeInterval kMinUpdateEtaInterval = 1.0;
 
 #pragma mark -  Private
 
-- (void)updateProgressIfNeeded:(OCTToxFileSize)bytesDone
+/**
+ * @return YES if progress was updated and progressBlock should be called.
+ */
+- (BOOL)updateProgressIfNeeded:(OCTToxFileSize)bytesDone
 {
     CFTimeInterval time = CACurrentMediaTime();
 
     CFTimeInterval deltaTime = time - self.lastUpdateProgressTime;
 
     if (deltaTime <= kMinUpdateProgressInterval) {
-        return;
+        return NO;
     }
 
     self.lastUpdateProgressTime = time;
@@ -234,19 +258,20 @@ static const CFTimeInterval kMinUpdateEtaInterval = 1.0;
 
     OCTLogInfo(@"progress %.2f, bytes per second %lld, eta %.0f seconds", self.progress, self.bytesPerSecond, self.eta);
 
-    if (self.progressBlock) {
-        self.progressBlock(self);
-    }
+    return YES;
 }
 
-- (void)updateEtaIfNeeded:(OCTToxFileSize)bytesDone
+/**
+ * @return YES if eta was updated and etaUpdateBlock should be called.
+ */
+- (BOOL)updateEtaIfNeeded:(OCTToxFileSize)bytesDone
 {
     CFTimeInterval time = CACurrentMediaTime();
 
     CFTimeInterval deltaTime = time - self.lastUpdateEtaProgressTime;
 
     if (deltaTime <= kMinUpdateEtaInterval) {
-        return;
+        return NO;
     }
 
     OCTToxFileSize deltaBytes = bytesDone - self.lastUpdateEtaBytesDone;
@@ -278,9 +303,27 @@ static const CFTimeInterval kMinUpdateEtaInterval = 1.0;
         self.eta = totalDeltaTime * bytesLeft / totalDeltaBytes;
     }
 
-    if (self.etaUpdateBlock) {
-        self.etaUpdateBlock(self);
+    return YES;
+}
+
+/**
+ * Chunks may be delivered on a queue other than main (see OCTToxOptions.delegateQueue),
+ * progress blocks are documented to be called on main thread.
+ */
+- (void)callBlockOnMainThread:(OCTFileBaseOperationProgressBlock)block
+{
+    if (! block) {
+        return;
+    }
+
+    if ([NSThread isMainThread]) {
+        block(self);
+        return;
     }
+
+    dispatch_async(dispatch_get_main_queue(), ^{
+        block(self);
+    });
 }
 
 @end
@@ -27,6 +27,12 @@
     return YES;
 }
 
+- (BOOL)writeBytes:(nonnull const void *)bytes length:(NSUInteger)length
+{
+    [self.tempData appendBytes:bytes length:length];
+    return YES;
+}
+
 - (BOOL)finishWriting
 {
     self.resultData = [self.tempData copy];
@@ -10,12 +10,24 @@
 /**
  * File operation for downloading file.
  *
- * When started will automatically send resume control to friend.
+ * When started will automatically send resume control to friend, unless startsPaused is set.
  */
 @interface OCTFileDownloadOperation : OCTFileBaseOperation
 
 @property (strong, nonatomic, readonly, nonnull) id<OCTFileOutputProtocol> output;
 
+/**
+ * Transfer paused by user is prepared on start, but resume control is sent only once user resumes it.
+ * Should be set before operation is started.
+ */
+@property (assign, nonatomic) BOOL startsPaused;
+
+/**
+ * Pauses or resumes transfer on user request. Output that can't keep up with transfer pauses it as well,
+ * transfer is resumed only once neither user nor output keeps it paused.
+ */
+- (void)pauseByUser:(BOOL)pause;
+
 /**
  * Create operation.
  *
@@ -42,4 +54,14 @@
  */
 - (void)receiveChunk:(nullable NSData *)chunk position:(OCTToxFileSize)position;
 
+/**
+ * Same as receiveChunk:position:, but without NSData wrapper.
+ * Operation registers itself as OCTTox chunk sink when started, so it normally receives chunks with this method.
+ *
+ * @param bytes Bytes of chunk, valid only during the call.
+ * @param length Length of chunk, 0 means that file transfer is finished.
+ * @param position Position in file to append chunk.
+ */
+- (void)receiveBytes:(nullable const uint8_t *)bytes length:(size_t)length position:(OCTToxFileSize)position;
+
 @end
@@ -4,12 +4,26 @@
 
 #import "OCTFileDownloadOperation.h"
 #import "OCTFileBaseOperation+Private.h"
+#import "OCTTox.h"
 #import "OCTFileOutputProtocol.h"
 #import "OCTLogging.h"
 #import "NSError+OCTFile.h"
 
 @interface OCTFileDownloadOperation ()
 
+// Set under @synchronized(self). Operation may be finished from tox queue, delegate queue, output queue
+// or cancelled from any thread.
+@property (assign, atomic) BOOL finishing;
+
+// Pause and resume controls are sent on this queue, so pause requested by user and pause because
+// of slow disk don't override each other.
+@property (strong, nonatomic, readonly) dispatch_queue_t controlQueue;
+
+// Accessed on controlQueue only.
+@property (assign, nonatomic) BOOL pausedByUser;
+@property (assign, nonatomic) BOOL throttled;
+@property (assign, nonatomic) BOOL transferStarted;
+
 @end
 
 @implementation OCTFileDownloadOperation
@@ -44,40 +58,97 @@
     }
 
     _output = fileOutput;
+    _controlQueue = dispatch_queue_create("me.dvor.objcTox.OCTFileDownloadOperationControlQueue", DISPATCH_QUEUE_SERIAL);
 
     return self;
 }
 
 #pragma mark -  Public
 
-- (void)receiveChunk:(NSData *)chunk position:(OCTToxFileSize)position
+- (BOOL)startsPaused
 {
-    if (! chunk) {
-        if ([self.output finishWriting]) {
-            [self finishWithSuccess];
+    __block BOOL startsPaused;
+
+    dispatch_sync(self.controlQueue, ^{
+        startsPaused = self.pausedByUser;
+    });
+
+    return startsPaused;
+}
+
+- (void)setStartsPaused:(BOOL)startsPaused
+{
+    dispatch_sync(self.controlQueue, ^{
+        self.pausedByUser = startsPaused;
+    });
+}
+
+- (void)pauseByUser:(BOOL)pause
+{
+    dispatch_sync(self.controlQueue, ^{
+        if (self.pausedByUser == pause) {
+            return;
+        }
+
+        self.pausedByUser = pause;
+
+        // Before first resume transfer isn't running yet, operation decides on start.
+        if (self.transferStarted && ! self.throttled) {
+            [self sendControl:pause ? OCTToxFileControlPause : OCTToxFileControlResume];
         }
-        else {
-            [self finishWithError:[NSError acceptFileErrorCannotWriteToFile]];
+    });
+}
+
+- (void)receiveChunk:(NSData *)chunk position:(OCTToxFileSize)position
+{
+    [self receiveBytes:chunk.bytes length:chunk.length position:position];
+}
+
+- (void)receiveBytes:(const uint8_t *)bytes length:(size_t)length position:(OCTToxFileSize)position
+{
+    if (self.finishing) {
+        return;
+    }
+
+    if (! length) {
+        if (! [self beginFinishing]) {
+            return;
         }
+
+        // Final chunk comes on delegate queue, which may be main. Waiting for data to reach the disk elsewhere.
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            if ([self.output finishWriting]) {
+                [self finishWithSuccess];
+            }
+            else {
+                // Sink is removed by tox after final chunk.
+                [super finishWithError:[NSError acceptFileErrorCannotWriteToFile]];
+            }
+        });
         return;
     }
 
     if (self.bytesDone != position) {
         OCTLogWarn(@"bytesDone doesn't match position");
-        [self.tox fileSendControlForFileNumber:self.fileNumber
-                                  friendNumber:self.friendNumber
-                                       control:OCTToxFileControlCancel
-                                         error:nil];
-        [self finishWithError:[NSError acceptFileErrorInternalError]];
+        [self cancelTransferWithError:[NSError acceptFileErrorInternalError]];
         return;
     }
 
-    if (! [self.output writeData:chunk]) {
-        [self finishWithError:[NSError acceptFileErrorCannotWriteToFile]];
+    BOOL written;
+
+    if ([self.output respondsToSelector:@selector(writeBytes:length:)]) {
+        written = [self.output writeBytes:bytes length:length];
+    }
+    else {
+        written = [self.output writeData:[NSData dataWithBytesNoCopy:(void *)bytes length:length freeWhenDone:NO]];
+    }
+
+    if (! written) {
+        [self cancelTransferAfterWriteFailure];
         return;
     }
 
-    [self updateBytesDone:self.bytesDone + chunk.length];
+    [self updateBytesDone:self.bytesDone + length];
 }
 
 #pragma mark -  Override
@@ -86,17 +157,76 @@
 {
     [super operationStarted];
 
+    __weak OCTFileDownloadOperation *weakSelf = self;
+
+    if ([self.output respondsToSelector:@selector(setWriteFailureBlock:)]) {
+        self.output.writeFailureBlock = ^{
+            [weakSelf cancelTransferAfterWriteFailure];
+        };
+    }
+
+    if ([self.output respondsToSelector:@selector(setWriteThrottleBlock:)]) {
+        self.output.writeThrottleBlock = ^(BOOL throttled) {
+            [weakSelf throttle:throttled];
+        };
+    }
+
     if (! [self.output prepareToWrite]) {
         [self finishWithError:[NSError acceptFileErrorCannotWriteToFile]];
+        return;
     }
 
+    OCTToxFileSize resumePosition = 0;
+
+    if ([self.output respondsToSelector:@selector(resumePosition)]) {
+        resumePosition = self.output.resumePosition;
+    }
+
+    // Chunks are written right on the tox iterate queue, bypassing delegate.
+    [self.tox setFileReceiveChunkSink:^(const uint8_t *bytes, size_t length, OCTToxFileSize position) {
+        [weakSelf receiveBytes:bytes length:length position:position];
+    } forFileNumber:self.fileNumber friendNumber:self.friendNumber];
+
     NSError *error;
-    if (! [self.tox fileSendControlForFileNumber:self.fileNumber
-                                    friendNumber:self.friendNumber
-                                         control:OCTToxFileControlResume
-                                           error:&error]) {
-        OCTLogWarn(@"cannot send control %@", error);
-        [self finishWithError:[NSError acceptFileErrorFromToxFileControl:error.code]];
+
+    // Seek is allowed only before transfer is resumed for the first time.
+    if (resumePosition > 0) {
+        if (! [self.tox fileSeekForFileNumber:self.fileNumber
+                                 friendNumber:self.friendNumber
+                                     position:resumePosition
+                                        error:&error]) {
+            OCTLogWarn(@"cannot seek to %lld %@", resumePosition, error);
+            // Dropping partial file, next offer of this file starts from scratch.
+            [self.output cancel];
+            [self cancelTransferWithError:[NSError acceptFileErrorInternalError]];
+            return;
+        }
+
+        [self resumeFromBytesDone:resumePosition];
+    }
+
+    __block BOOL resumed = YES;
+    __block NSError *resumeError;
+
+    dispatch_sync(self.controlQueue, ^{
+        // Transfer paused by user is resumed by pauseByUser:.
+        self.transferStarted = YES;
+
+        if (self.pausedByUser) {
+            return;
+        }
+
+        NSError *controlError;
+        resumed = [self.tox fileSendControlForFileNumber:self.fileNumber
+                                            friendNumber:self.friendNumber
+                                                 control:OCTToxFileControlResume
+                                                   error:&controlError];
+        resumeError = controlError;
+    });
+
+    if (! resumed) {
+        OCTLogWarn(@"cannot send control %@", resumeError);
+        [self finishWithError:[NSError acceptFileErrorFromToxFileControl:resumeError.code]];
         return;
     }
 }
@@ -105,7 +235,103 @@
 {
     [super operationWasCanceled];
 
+    // Final chunk or write failure reported after cancel is ignored.
+    [self beginFinishing];
+    [self removeChunkSink];
+    [self.output cancel];
+}
+
+- (void)finishWithError:(nonnull NSError *)error
+{
+    if (! [self beginFinishing]) {
+        return;
+    }
+
+    [self removeChunkSink];
+
+    [super finishWithError:error];
+}
+
+#pragma mark -  Private
+
+/**
+ * @return NO if operation is already being finished.
+ */
+- (BOOL)beginFinishing
+{
+    @synchronized(self) {
+        if (self.finishing) {
+            return NO;
+        }
+
+        self.finishing = YES;
+        return YES;
+    }
+}
+
+- (void)cancelTransferWithError:(NSError *)error
+{
+    if (self.finishing) {
+        return;
+    }
+
+    [self.tox fileSendControlForFileNumber:self.fileNumber
+                              friendNumber:self.friendNumber
+                                   control:OCTToxFileControlCancel
+                                     error:nil];
+    [self finishWithError:error];
+}
+
+/**
+ * Partial file is dropped after failed write, next offer of this file starts from scratch.
+ */
+- (void)cancelTransferAfterWriteFailure
+{
+    if (self.finishing) {
+        return;
+    }
+
     [self.output cancel];
+    [self cancelTransferWithError:[NSError acceptFileErrorCannotWriteToFile]];
+}
+
+/**
+ * Called by output from writing thread, control is sent asynchronously so tox thread is never blocked.
+ */
+- (void)throttle:(BOOL)throttled
+{
+    dispatch_async(self.controlQueue, ^{
+        self.throttled = throttled;
+
+        // Transfer paused by user stays paused.
+        if (! self.pausedByUser) {
+            [self sendControl:throttled ? OCTToxFileControlPause : OCTToxFileControlResume];
+        }
+    });
+}
+
+/**
+ * Called on controlQueue.
+ */
+- (void)sendControl:(OCTToxFileControl)control
+{
+    if (self.finishing) {
+        return;
+    }
+
+    NSError *error;
+
+    if (! [self.tox fileSendControlForFileNumber:self.fileNumber
+                                    friendNumber:self.friendNumber
+                                         control:control
+                                           error:&error]) {
+        OCTLogWarn(@"cannot send control %ld %@", (long)control, error);
+    }
+}
+
+- (void)removeChunkSink
+{
+    [self.tox setFileReceiveChunkSink:nil forFileNumber:self.fileNumber friendNumber:self.friendNumber];
 }
 
 @end
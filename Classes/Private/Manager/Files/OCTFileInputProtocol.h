@@ -24,4 +24,12 @@
  */
 - (nonnull NSData *)bytesWithPosition:(OCTToxFileSize)position length:(size_t)length;
 
+@optional
+
+/**
+ * Called once operation is finished or cancelled, input may release resources here.
+ * Data returned earlier may still be in use by caller and should stay valid.
+ */
+- (void)finishReading;
+
 @end
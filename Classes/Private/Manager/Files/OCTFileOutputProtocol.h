@@ -3,6 +3,7 @@
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #import <Foundation/Foundation.h>
+#import "OCTToxConstants.h"
 
 @protocol OCTFileOutputProtocol <NSObject>
 
@@ -22,8 +23,43 @@
  */
 - (BOOL)writeData:(nonnull NSData *)data;
 
+@optional
+
+/**
+ * Write bytes to output. If implemented, it is used instead of writeData: for received file chunks
+ * to avoid wrapping every chunk into NSData. Bytes are valid only during the call.
+ *
+ * @param bytes Bytes to write.
+ * @param length Number of bytes to write.
+ *
+ * @return YES on success, NO on failure.
+ */
+- (BOOL)writeBytes:(nonnull const void *)bytes length:(NSUInteger)length;
+
+/**
+ * Output writing data in background reports failed write with this block, so transfer can be stopped
+ * before next chunk arrives. Block is called once, on arbitrary queue. Should be set before prepareToWrite.
+ */
+@property (copy, nonatomic, nullable) void (^writeFailureBlock)(void);
+
+/**
+ * Output writing data in background reports with this block that it runs short of memory for data
+ * not written yet (YES), and that it caught up (NO). Transfer should be paused meanwhile, output
+ * fails only if chunks keep coming. Calls are balanced and come in order, on arbitrary queue.
+ * Block should return quickly. Should be set before prepareToWrite.
+ */
+@property (copy, nonatomic, nullable) void (^writeThrottleBlock)(BOOL throttled);
+
+/**
+ * Number of bytes of previous run of transfer known to be on disk, valid after prepareToWrite.
+ * Writing continues from this position.
+ */
+@property (assign, nonatomic, readonly) OCTToxFileSize resumePosition;
+
+@required
+
 /**
- * This method is called after last writeData: method.
+ * This method is called after last writeData: method. Waits for all data to reach the disk.
  *
  * @return YES on success, NO on failure.
  */
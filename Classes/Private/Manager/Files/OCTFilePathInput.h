@@ -5,8 +5,34 @@
 #import <Foundation/Foundation.h>
 #import "OCTFileInputProtocol.h"
 
+/**
+ * Default value of maxMappingSize.
+ */
+extern const OCTToxFileSize kOCTFilePathInputDefaultMaxMappingSize;
+
+/**
+ * Default value of windowSize.
+ */
+extern const size_t kOCTFilePathInputDefaultWindowSize;
+
+/**
+ * Reads file through memory mapping. Returned data points into mapping without copying,
+ * mapping stays alive while any returned data is alive.
+ *
+ * Files up to maxMappingSize are mapped whole, larger ones through sliding window of windowSize bytes.
+ * Mapping is advised for sequential access, so kernel reads ahead of chunks requested by toxcore.
+ * File size is checked every 1MB of read chunks and before mapping new window, once file is found
+ * truncated its chunks are read with pread instead of mapping. File truncated between checks is not detected,
+ * reading its mapped pages past the end raises SIGBUS.
+ */
 @interface OCTFilePathInput : NSObject <OCTFileInputProtocol>
 
+/**
+ * Should be set before prepareToRead.
+ */
+@property (assign, nonatomic) OCTToxFileSize maxMappingSize;
+@property (assign, nonatomic) size_t windowSize;
+
 - (nullable instancetype)initWithFilePath:(nonnull NSString *)filePath;
 
 - (nullable instancetype)init NS_UNAVAILABLE;
@@ -5,10 +5,87 @@
 #import "OCTFilePathInput.h"
 #import "OCTLogging.h"
 
+#import <fcntl.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+#if __LP64__
+const OCTToxFileSize kOCTFilePathInputDefaultMaxMappingSize = 1024 * 1024 * 1024;
+#else
+const OCTToxFileSize kOCTFilePathInputDefaultMaxMappingSize = 64 * 1024 * 1024;
+#endif
+
+const size_t kOCTFilePathInputDefaultWindowSize = 16 * 1024 * 1024;
+
+// File size is checked again after this many bytes are read (~750 chunks) and whenever new window is mapped.
+static const OCTToxFileSize kSizeCheckInterval = 1024 * 1024;
+
+/**
+ * Mapped region of file, unmapped on dealloc. Data returned by input retains region it points into.
+ */
+@interface OCTFileMapping : NSObject
+
+@property (assign, nonatomic, readonly) uint8_t *bytes;
+@property (assign, nonatomic, readonly) OCTToxFileSize offset;
+@property (assign, nonatomic, readonly) size_t length;
+
+@end
+
+@implementation OCTFileMapping
+
+- (instancetype)initWithFileDescriptor:(int)fd offset:(OCTToxFileSize)offset length:(size_t)length
+{
+    self = [super init];
+
+    if (! self) {
+        return nil;
+    }
+
+    void *bytes = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, (off_t)offset);
+
+    if (bytes == MAP_FAILED) {
+        OCTLogWarn(@"cannot map file, offset %lld length %zu, errno %d", offset, length, errno);
+        return nil;
+    }
+
+    madvise(bytes, length, MADV_SEQUENTIAL);
+
+    _bytes = bytes;
+    _offset = offset;
+    _length = length;
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_bytes) {
+        munmap(_bytes, _length);
+    }
+}
+
+- (BOOL)containsPosition:(OCTToxFileSize)position length:(size_t)length
+{
+    return (position >= self.offset) && (position + length <= self.offset + self.length);
+}
+
+@end
+
 @interface OCTFilePathInput ()
 
 @property (strong, nonatomic, readonly) NSString *filePath;
-@property (strong, nonatomic) NSFileHandle *handle;
+
+// Guarded by @synchronized(self), chunk requests and cancellation come from different threads.
+@property (assign, nonatomic) int fd;
+@property (assign, nonatomic) OCTToxFileSize fileSize;
+@property (strong, nonatomic) OCTFileMapping *mapping;
+
+// Reading past this position checks file size first.
+@property (assign, nonatomic) OCTToxFileSize nextSizeCheckPosition;
+
+// File shrank after it was opened, mapping isn't used anymore.
+@property (assign, nonatomic) BOOL truncated;
 
 @end
 
@@ -25,37 +102,167 @@
     }
 
     _filePath = filePath;
+    _fd = -1;
+    _maxMappingSize = kOCTFilePathInputDefaultMaxMappingSize;
+    _windowSize = kOCTFilePathInputDefaultWindowSize;
 
     return self;
 }
 
+- (void)dealloc
+{
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
+
 #pragma mark -  OCTFileInputProtocol
 
 - (BOOL)prepareToRead
 {
-    self.handle = [NSFileHandle fileHandleForReadingAtPath:self.filePath];
+    @synchronized(self) {
+        // Preparing again reopens file, previous descriptor isn't leaked.
+        [self closeFile];
 
-    if (! self.handle) {
-        return NO;
-    }
+        int fd = open(self.filePath.fileSystemRepresentation, O_RDONLY);
+
+        if (fd < 0) {
+            OCTLogWarn(@"cannot open file %@, errno %d", self.filePath, errno);
+            return NO;
+        }
 
-    return YES;
+        struct stat info;
+
+        if (fstat(fd, &info) != 0) {
+            OCTLogWarn(@"cannot stat file %@, errno %d", self.filePath, errno);
+            close(fd);
+            return NO;
+        }
+
+        self.fd = fd;
+        self.fileSize = info.st_size;
+        self.nextSizeCheckPosition = kSizeCheckInterval;
+        self.truncated = NO;
+
+        if ((self.fileSize > 0) && (self.fileSize <= self.maxMappingSize)) {
+            self.mapping = [[OCTFileMapping alloc] initWithFileDescriptor:fd offset:0 length:(size_t)self.fileSize];
+
+            if (! self.mapping) {
+                [self closeFile];
+                return NO;
+            }
+        }
+
+        return YES;
+    }
 }
 
 - (NSData *)bytesWithPosition:(OCTToxFileSize)position length:(size_t)length
 {
-    @try {
-        if (self.handle.offsetInFile != position) {
-            [self.handle seekToFileOffset:position];
+    @synchronized(self) {
+        if ((self.fd < 0) || (position > self.fileSize)) {
+            return nil;
+        }
+
+        length = (size_t)MIN((OCTToxFileSize)length, self.fileSize - position);
+
+        if (length == 0) {
+            return [NSData data];
+        }
+
+        if (self.truncated) {
+            return [self readBytesWithPosition:position length:length];
+        }
+
+        BOOL needsWindow = ! [self.mapping containsPosition:position length:length];
+
+        // Touching mapped pages past end of file raises SIGBUS, file may be truncated while it is uploaded.
+        // Size is checked at coarse interval only, stat per chunk costs more than reading it from mapping.
+        // File truncated between checks still crashes the app, as well as if it is truncated while toxcore
+        // copies chunk returned before. That is accepted: SIGBUS can't be handled safely in library code,
+        // and it happens only to file modified while it is sent.
+        if (needsWindow || (position + length > self.nextSizeCheckPosition)) {
+            struct stat info;
+
+            if ((fstat(self.fd, &info) != 0) || ((OCTToxFileSize)info.st_size < self.fileSize)) {
+                OCTLogWarn(@"file %@ was truncated, reading without mapping", self.filePath);
+                self.truncated = YES;
+                self.mapping = nil;
+
+                return [self readBytesWithPosition:position length:length];
+            }
+
+            self.nextSizeCheckPosition = position + length + kSizeCheckInterval;
+        }
+
+        if (needsWindow) {
+            self.mapping = [self windowMappingWithPosition:position length:length];
+        }
+
+        OCTFileMapping *mapping = self.mapping;
+
+        if (! mapping) {
+            return nil;
         }
 
-        return [self.handle readDataOfLength:length];
+        return [[NSData alloc] initWithBytesNoCopy:mapping.bytes + (position - mapping.offset)
+                                            length:length
+                                       deallocator:^(void *bytes, NSUInteger dataLength) {
+            // Keeping mapping alive while data is used.
+            (void)mapping;
+        }];
+    }
+}
+
+- (void)finishReading
+{
+    @synchronized(self) {
+        [self closeFile];
+    }
+}
+
+#pragma mark -  Private
+
+/**
+ * Should be called under @synchronized(self).
+ */
+- (void)closeFile
+{
+    self.mapping = nil;
+
+    if (self.fd >= 0) {
+        close(self.fd);
+        self.fd = -1;
     }
-    @catch (NSException *ex) {
-        OCTLogWarn(@"catched exception %@", ex);
+}
+
+/**
+ * Copies bytes with pread, returns nil if file has less than requested.
+ */
+- (NSData *)readBytesWithPosition:(OCTToxFileSize)position length:(size_t)length
+{
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    ssize_t result = pread(self.fd, data.mutableBytes, length, (off_t)position);
+
+    if (result != (ssize_t)length) {
+        OCTLogWarn(@"cannot read file %@, position %lld length %zu, read %zd, errno %d",
+                   self.filePath, position, length, result, errno);
+        return nil;
     }
 
-    return nil;
+    return data;
+}
+
+- (OCTFileMapping *)windowMappingWithPosition:(OCTToxFileSize)position length:(size_t)length
+{
+    OCTToxFileSize pageSize = (OCTToxFileSize)getpagesize();
+    OCTToxFileSize offset = position - (position % pageSize);
+
+    OCTToxFileSize windowLength = MAX((OCTToxFileSize)self.windowSize, position + length - offset);
+    windowLength = MIN(windowLength, self.fileSize - offset);
+
+    // Previous window is unmapped once all data pointing into it is released.
+    return [[OCTFileMapping alloc] initWithFileDescriptor:self.fd offset:offset length:(size_t)windowLength];
 }
 
 @end
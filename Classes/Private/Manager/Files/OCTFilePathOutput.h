@@ -5,14 +5,36 @@
 #import <Foundation/Foundation.h>
 #import "OCTFileOutputProtocol.h"
 
+/**
+ * Default value of syncInterval.
+ */
+extern const OCTToxFileSize kOCTFilePathOutputDefaultSyncInterval;
+
 @interface OCTFilePathOutput : NSObject <OCTFileOutputProtocol>
 
+@property (copy, nonatomic, readonly, nonnull) NSString *tempFilePath;
 @property (copy, nonatomic, readonly, nonnull) NSString *resultFilePath;
 
+/**
+ * Written data is synchronized to disk every syncInterval bytes, resumed download continues from last
+ * synchronized position. Should be set before prepareToWrite.
+ */
+@property (assign, nonatomic) OCTToxFileSize syncInterval;
+
 - (nullable instancetype)initWithTempFolder:(nonnull NSString *)tempFolder
                                resultFolder:(nonnull NSString *)resultFolder
                                    fileName:(nonnull NSString *)fileName;
 
+/**
+ * Continues writing to partially downloaded temp file from the last position synchronized to disk,
+ * data after it is discarded.
+ *
+ * @param tempFilePath Existing temp file.
+ * @param resultFilePath Path file is moved to when finished.
+ */
+- (nullable instancetype)initWithTempFilePath:(nonnull NSString *)tempFilePath
+                               resultFilePath:(nonnull NSString *)resultFilePath;
+
 - (nullable instancetype)init NS_UNAVAILABLE;
 + (nullable instancetype)new NS_UNAVAILABLE;
 
@@ -2,25 +2,89 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+#import <fcntl.h>
+#import <unistd.h>
+#import <errno.h>
+#import <sys/stat.h>
+#import <sys/xattr.h>
+
 #import "OCTFilePathOutput.h"
 #import "OCTLogging.h"
 #import "OCTFileTools.h"
 
+const OCTToxFileSize kOCTFilePathOutputDefaultSyncInterval = 16 * 1024 * 1024;
+
+// Extended attribute of temp file with number of bytes synchronized to disk, resume starts there.
+static const char *kSyncedLengthAttributeName = "me.dvor.objcTox.syncedLength";
+
+// Chunks are small (~1.3KB), collecting them to write to disk in bigger blocks.
+static const NSUInteger kWriteBufferSize = 512 * 1024;
+
+// Full buffers are written on I/O queue while next one is filled, this many of them are kept for reuse.
+static const NSUInteger kWriteBuffersCount = 3;
+
+// Disk falling behind gets extra buffers up to this limit, capping memory of data in flight at 4MB.
+static const NSUInteger kMaxWriteBuffersCount = 8;
+
+// Once only this many buffers are left transfer is paused, they take chunks friend sent before pause
+// reached it. Write fails only if even they are used up.
+static const NSUInteger kPauseFreeBuffersCount = 2;
+
+// Paused transfer is resumed once this many buffers are free again.
+static const NSUInteger kResumeFreeBuffersCount = kMaxWriteBuffersCount / 2;
+
 @interface OCTFilePathOutput ()
 
-@property (copy, nonatomic, readonly, nonnull) NSString *tempFilePath;
+@property (assign, nonatomic, readonly) BOOL resuming;
+@property (assign, nonatomic, readwrite) OCTToxFileSize resumePosition;
 
-@property (strong, nonatomic) NSFileHandle *handle;
+@property (strong, nonatomic, readonly) dispatch_queue_t ioQueue;
+
+// Accessed on ioQueue only, so descriptor is never closed while write submitted before is pending.
+@property (assign, nonatomic) int fileDescriptor;
+@property (assign, nonatomic) OCTToxFileSize unsyncedLength;
+
+// Whether writes are accepted, set by prepareToWrite and cleared on finish or cancel.
+@property (assign, atomic) BOOL open;
+@property (assign, atomic) BOOL writeFailed;
+
+// Accessed by writing thread only.
+@property (strong, nonatomic) NSMutableData *buffer;
+@property (assign, nonatomic) NSUInteger bufferLength;
+@property (assign, nonatomic) off_t bufferOffset;
+
+// Guarded by @synchronized(freeBuffers). Buffers not used by writer or I/O queue are kept for reuse,
+// count includes buffers not allocated yet.
+@property (strong, nonatomic, readonly) NSMutableArray<NSMutableData *> *freeBuffers;
+@property (assign, nonatomic) NSUInteger freeBuffersCount;
+@property (assign, nonatomic) BOOL throttled;
 
 @end
 
 @implementation OCTFilePathOutput
+@synthesize writeFailureBlock = _writeFailureBlock;
+@synthesize writeThrottleBlock = _writeThrottleBlock;
 
 #pragma mark -  Lifecycle
 
 - (nullable instancetype)initWithTempFolder:(nonnull NSString *)tempFolder
                                resultFolder:(nonnull NSString *)resultFolder
                                    fileName:(nonnull NSString *)fileName
+{
+    return [self initWithTempFilePath:[OCTFileTools createNewFilePathInDirectory:tempFolder fileName:fileName]
+                       resultFilePath:[OCTFileTools createNewFilePathInDirectory:resultFolder fileName:fileName]
+                             resuming:NO];
+}
+
+- (nullable instancetype)initWithTempFilePath:(nonnull NSString *)tempFilePath
+                               resultFilePath:(nonnull NSString *)resultFilePath
+{
+    return [self initWithTempFilePath:tempFilePath resultFilePath:resultFilePath resuming:YES];
+}
+
+- (nullable instancetype)initWithTempFilePath:(nonnull NSString *)tempFilePath
+                               resultFilePath:(nonnull NSString *)resultFilePath
+                                     resuming:(BOOL)resuming
 {
     self = [super init];
 
@@ -28,11 +92,20 @@
         return nil;
     }
 
-    _tempFilePath = [OCTFileTools createNewFilePathInDirectory:tempFolder fileName:fileName];
-    _resultFilePath = [OCTFileTools createNewFilePathInDirectory:resultFolder fileName:fileName];
+    _tempFilePath = [tempFilePath copy];
+    _resultFilePath = [resultFilePath copy];
+    _resuming = resuming;
+
+    _ioQueue = dispatch_queue_create("me.dvor.objcTox.OCTFilePathOutput", DISPATCH_QUEUE_SERIAL);
+    _fileDescriptor = -1;
+    _syncInterval = kOCTFilePathOutputDefaultSyncInterval;
+    _freeBuffers = [NSMutableArray new];
+    _freeBuffersCount = kMaxWriteBuffersCount;
 
     // Create dummy file to reserve fileName.
-    [[NSFileManager defaultManager] createFileAtPath:_resultFilePath contents:[NSData data] attributes:nil];
+    if (! resuming || ! [[NSFileManager defaultManager] fileExistsAtPath:_resultFilePath]) {
+        [[NSFileManager defaultManager] createFileAtPath:_resultFilePath contents:[NSData data] attributes:nil];
+    }
 
     OCTLogInfo(@"temp path %@", _tempFilePath);
     OCTLogInfo(@"result path %@", _resultFilePath);
@@ -40,43 +113,131 @@
     return self;
 }
 
+- (void)dealloc
+{
+    if (_fileDescriptor >= 0) {
+        close(_fileDescriptor);
+    }
+}
+
 #pragma mark -  OCTFileOutputProtocol
 
 - (BOOL)prepareToWrite
 {
-    if (! [[NSFileManager defaultManager] createFileAtPath:self.tempFilePath contents:nil attributes:nil]) {
+    int flags = O_WRONLY | O_CREAT | (self.resuming ? 0 : O_TRUNC);
+    int fileDescriptor = open(self.tempFilePath.fileSystemRepresentation, flags, 0644);
+
+    if (fileDescriptor < 0) {
+        OCTLogWarn(@"cannot open file %@, errno %d", self.tempFilePath, errno);
         return NO;
     }
 
-    self.handle = [NSFileHandle fileHandleForWritingAtPath:self.tempFilePath];
+    OCTToxFileSize position = 0;
 
-    if (! self.handle) {
-        return NO;
+    if (self.resuming) {
+        position = [self synchronizedLengthOfFileDescriptor:fileDescriptor];
+
+        // Data past synchronized length may not have reached the disk before relaunch, it is downloaded again.
+        if (ftruncate(fileDescriptor, (off_t)position) != 0) {
+            OCTLogWarn(@"cannot truncate file %@, errno %d", self.tempFilePath, errno);
+            close(fileDescriptor);
+            return NO;
+        }
+    }
+
+    // Descriptor of cancelled previous run is closed before it is replaced.
+    dispatch_sync(self.ioQueue, ^{
+        if (self.fileDescriptor >= 0) {
+            close(self.fileDescriptor);
+        }
+
+        self.fileDescriptor = fileDescriptor;
+        self.unsyncedLength = 0;
+    });
+
+    @synchronized(self.freeBuffers) {
+        self.throttled = NO;
     }
 
+    self.open = YES;
+    self.writeFailed = NO;
+    self.bufferLength = 0;
+    self.bufferOffset = (off_t)position;
+    self.resumePosition = position;
+
     return YES;
 }
 
 - (BOOL)writeData:(nonnull NSData *)data
 {
-    @try {
-        [self.handle writeData:data];
-        return YES;
+    return [self writeBytes:data.bytes length:data.length];
+}
+
+- (BOOL)writeBytes:(nonnull const void *)bytes length:(NSUInteger)length
+{
+    if (! self.open || self.writeFailed) {
+        return NO;
     }
-    @catch (NSException *ex) {
-        OCTLogWarn(@"catched exception %@", ex);
+
+    while (length > 0) {
+        if (! self.buffer) {
+            self.buffer = [self takeFreeBuffer];
+            self.bufferLength = 0;
+
+            if (! self.buffer) {
+                OCTLogWarn(@"all %lu write buffers are in flight, disk is too slow", (unsigned long)kMaxWriteBuffersCount);
+                [self failWriting];
+                return NO;
+            }
+        }
+
+        NSUInteger copyLength = MIN(length, kWriteBufferSize - self.bufferLength);
+
+        memcpy((uint8_t *)self.buffer.mutableBytes + self.bufferLength, bytes, copyLength);
+        self.bufferLength += copyLength;
+        bytes = (const uint8_t *)bytes + copyLength;
+        length -= copyLength;
+
+        if (self.bufferLength == kWriteBufferSize) {
+            [self submitBuffer];
+        }
     }
 
-    return NO;
+    return YES;
 }
 
 - (BOOL)finishWriting
 {
-    @try {
-        [self.handle synchronizeFile];
+    if (! self.open) {
+        return NO;
     }
-    @catch (NSException *ex) {
-        OCTLogWarn(@"catched exception %@", ex);
+
+    if (self.bufferLength) {
+        [self submitBuffer];
+    }
+
+    self.open = NO;
+
+    __block BOOL synchronized = NO;
+
+    dispatch_sync(self.ioQueue, ^{
+        if (self.fileDescriptor < 0) {
+            return;
+        }
+
+        synchronized = (fsync(self.fileDescriptor) == 0);
+
+        if (! synchronized) {
+            OCTLogWarn(@"cannot synchronize file, errno %d", errno);
+        }
+
+        // File is complete, it isn't resumed anymore.
+        fremovexattr(self.fileDescriptor, kSyncedLengthAttributeName, 0);
+        close(self.fileDescriptor);
+        self.fileDescriptor = -1;
+    });
+
+    if (self.writeFailed || ! synchronized) {
         return NO;
     }
 
@@ -92,9 +253,200 @@
 
 - (void)cancel
 {
-    self.handle = nil;
+    self.open = NO;
+
+    NSString *tempFilePath = self.tempFilePath;
+
+    // Writes already submitted go first, ones submitted later find descriptor closed.
+    dispatch_async(self.ioQueue, ^{
+        if (self.fileDescriptor >= 0) {
+            close(self.fileDescriptor);
+            self.fileDescriptor = -1;
+        }
+
+        [[NSFileManager defaultManager] removeItemAtPath:tempFilePath error:nil];
+    });
+}
+
+#pragma mark -  Private
+
+/**
+ * Throttle block is called under the lock, so pause and resume are reported in order they happen.
+ *
+ * @return nil if all buffers are being written.
+ */
+- (NSMutableData *)takeFreeBuffer
+{
+    @synchronized(self.freeBuffers) {
+        if (! self.freeBuffersCount) {
+            return nil;
+        }
+
+        self.freeBuffersCount--;
+
+        if (! self.throttled && (self.freeBuffersCount <= kPauseFreeBuffersCount)) {
+            OCTLogInfo(@"disk is behind, pausing transfer");
+            [self setThrottledUnderLock:YES];
+        }
+
+        NSMutableData *buffer = [self.freeBuffers lastObject];
 
-    [[NSFileManager defaultManager] removeItemAtPath:self.tempFilePath error:nil];
+        if (buffer) {
+            [self.freeBuffers removeLastObject];
+            return buffer;
+        }
+    }
+
+    return [NSMutableData dataWithLength:kWriteBufferSize];
+}
+
+- (void)returnFreeBuffer:(NSMutableData *)buffer
+{
+    @synchronized(self.freeBuffers) {
+        // Extra buffers allocated while disk was behind are released.
+        if (self.freeBuffers.count < kWriteBuffersCount) {
+            [self.freeBuffers addObject:buffer];
+        }
+
+        self.freeBuffersCount++;
+
+        if (self.throttled && (self.freeBuffersCount >= kResumeFreeBuffersCount)) {
+            OCTLogInfo(@"disk caught up, resuming transfer");
+            [self setThrottledUnderLock:NO];
+        }
+    }
+}
+
+- (void)setThrottledUnderLock:(BOOL)throttled
+{
+    self.throttled = throttled;
+
+    void (^writeThrottleBlock)(BOOL) = self.writeThrottleBlock;
+
+    // Nothing is written after failure or cancel, transfer is being stopped anyway.
+    if (writeThrottleBlock && self.open && ! self.writeFailed) {
+        writeThrottleBlock(throttled);
+    }
+}
+
+/**
+ * Marks output as failed and reports it with writeFailureBlock, only first failure is reported.
+ */
+- (void)failWriting
+{
+    @synchronized(self) {
+        if (self.writeFailed) {
+            return;
+        }
+
+        self.writeFailed = YES;
+    }
+
+    void (^writeFailureBlock)(void) = self.writeFailureBlock;
+
+    if (writeFailureBlock) {
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), writeFailureBlock);
+    }
+}
+
+- (void)submitBuffer
+{
+    NSMutableData *buffer = self.buffer;
+    NSUInteger length = self.bufferLength;
+    off_t offset = self.bufferOffset;
+
+    self.buffer = nil;
+    self.bufferLength = 0;
+    self.bufferOffset += length;
+
+    dispatch_async(self.ioQueue, ^{
+        BOOL failed = NO;
+
+        // Descriptor is closed if output was cancelled after buffer was submitted.
+        if (! self.writeFailed && (self.fileDescriptor >= 0)) {
+            failed = ! [self writeToFileDescriptor:self.fileDescriptor bytes:buffer.bytes length:length offset:offset];
+
+            self.unsyncedLength += length;
+
+            if (! failed && (self.unsyncedLength >= self.syncInterval)) {
+                failed = ! [self synchronizeWithLength:offset + length];
+            }
+        }
+
+        if (failed) {
+            [self failWriting];
+        }
+
+        [self returnFreeBuffer:buffer];
+    });
+}
+
+/**
+ * Called on ioQueue. Waits for data to reach the disk, then stores its length for resume.
+ */
+- (BOOL)synchronizeWithLength:(off_t)length
+{
+    if (fsync(self.fileDescriptor) != 0) {
+        OCTLogWarn(@"cannot synchronize file, errno %d", errno);
+        return NO;
+    }
+
+    self.unsyncedLength = 0;
+
+    // Attribute reaches the disk with next synchronization, until then resume starts from previous length.
+    uint64_t value = (uint64_t)length;
+
+    if (fsetxattr(self.fileDescriptor, kSyncedLengthAttributeName, &value, sizeof(value), 0, 0) != 0) {
+        OCTLogWarn(@"cannot store synchronized length, errno %d", errno);
+    }
+
+    return YES;
+}
+
+/**
+ * @return 0 if file has no synchronized length stored.
+ */
+- (OCTToxFileSize)synchronizedLengthOfFileDescriptor:(int)fileDescriptor
+{
+    uint64_t value = 0;
+    ssize_t size = fgetxattr(fileDescriptor, kSyncedLengthAttributeName, &value, sizeof(value), 0, 0);
+
+    if (size != sizeof(value)) {
+        return 0;
+    }
+
+    struct stat fileStat;
+
+    if (fstat(fileDescriptor, &fileStat) != 0) {
+        return 0;
+    }
+
+    return MIN((OCTToxFileSize)value, (OCTToxFileSize)fileStat.st_size);
+}
+
+- (BOOL)writeToFileDescriptor:(int)fileDescriptor
+                        bytes:(const uint8_t *)bytes
+                       length:(NSUInteger)length
+                       offset:(off_t)offset
+{
+    while (length > 0) {
+        ssize_t written = pwrite(fileDescriptor, bytes, length, offset);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            OCTLogWarn(@"cannot write to file, errno %d", errno);
+            return NO;
+        }
+
+        bytes += written;
+        length -= written;
+        offset += written;
+    }
+
+    return YES;
 }
 
 @end
@@ -0,0 +1,39 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Foundation/Foundation.h>
+
+#import "OCTToxConstants.h"
+
+@class OCTFileBaseOperation;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Active file operations keyed by packed (friendNumber, fileNumber) pair. Lookups are done for every chunk
+ * of every transfer, so they are O(1) and don't allocate.
+ *
+ * Registry holds operation until it is finished or cancelled. All methods are thread-safe.
+ */
+@interface OCTFileTransferRegistry : NSObject
+
+/**
+ * Number of registered operations.
+ */
+@property (assign, nonatomic, readonly) NSUInteger count;
+
+/**
+ * Registers operation, it is unregistered automatically once finished. Operation previously registered
+ * for the same friend and file number is replaced.
+ *
+ * Uses completionBlock of operation, it should not be set by anyone else.
+ */
+- (void)registerOperation:(OCTFileBaseOperation *)operation;
+
+- (nullable OCTFileBaseOperation *)operationWithFileNumber:(OCTToxFileNumber)fileNumber
+                                              friendNumber:(OCTToxFriendNumber)friendNumber;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,92 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import "OCTFileTransferRegistry.h"
+#import "OCTFileBaseOperation+Private.h"
+
+/**
+ * NSNumber of 64 bit value is a tagged pointer, key creation doesn't allocate.
+ */
+static NSNumber *transferKey(OCTToxFriendNumber friendNumber, OCTToxFileNumber fileNumber)
+{
+    return @(((uint64_t)friendNumber << 32) | (uint32_t)fileNumber);
+}
+
+@interface OCTFileTransferRegistry ()
+
+// Guarded by @synchronized(self).
+@property (strong, nonatomic, readonly) NSMutableDictionary<NSNumber *, OCTFileBaseOperation *> *operations;
+
+@end
+
+@implementation OCTFileTransferRegistry
+
+#pragma mark -  Lifecycle
+
+- (instancetype)init
+{
+    self = [super init];
+
+    if (! self) {
+        return nil;
+    }
+
+    _operations = [NSMutableDictionary new];
+
+    return self;
+}
+
+#pragma mark -  Properties
+
+- (NSUInteger)count
+{
+    @synchronized(self) {
+        return self.operations.count;
+    }
+}
+
+#pragma mark -  Public
+
+- (void)registerOperation:(OCTFileBaseOperation *)operation
+{
+    NSParameterAssert(operation);
+    NSAssert(! operation.completionBlock, @"completionBlock of operation is used by registry");
+
+    NSNumber *key = transferKey(operation.friendNumber, operation.fileNumber);
+
+    @synchronized(self) {
+        self.operations[key] = operation;
+    }
+
+    __weak OCTFileTransferRegistry *weakSelf = self;
+    __weak OCTFileBaseOperation *weakOperation = operation;
+
+    operation.completionBlock = ^{
+        [weakSelf unregisterOperation:weakOperation forKey:key];
+    };
+}
+
+- (OCTFileBaseOperation *)operationWithFileNumber:(OCTToxFileNumber)fileNumber
+                                     friendNumber:(OCTToxFriendNumber)friendNumber
+{
+    NSNumber *key = transferKey(friendNumber, fileNumber);
+
+    @synchronized(self) {
+        return self.operations[key];
+    }
+}
+
+#pragma mark -  Private
+
+- (void)unregisterOperation:(OCTFileBaseOperation *)operation forKey:(NSNumber *)key
+{
+    @synchronized(self) {
+        // File number may be already reused by toxcore for new transfer.
+        if (operation && (self.operations[key] == operation)) {
+            [self.operations removeObjectForKey:key];
+        }
+    }
+}
+
+@end
@@ -10,6 +10,12 @@
 
 @property (strong, nonatomic, readonly, nonnull) id<OCTFileInputProtocol> input;
 
+/**
+ * Number of chunks which toxcore didn't accept because its send queue was full. Such chunks are parked
+ * together with chunks requested after them and sent again after following tox iterations.
+ */
+@property (assign, atomic, readonly) NSUInteger parkedChunksCount;
+
 /**
  * Create operation.
  *
@@ -29,7 +35,7 @@
                         failureBlock:(nullable OCTFileBaseOperationFailureBlock)failureBlock;
 
 /**
- * Call this method to request next chunk.
+ * Call this method to request next chunk. Can be called from any thread.
  *
  * @param position The file or stream position from which to continue reading.
  * @param length The number of bytes requested for the current chunk.
@@ -8,13 +8,47 @@
 #import "OCTLogging.h"
 #import "NSError+OCTFile.h"
 
+static const NSUInteger kInitialPendingChunksCapacity = 16;
+
+typedef struct {
+    OCTToxFileSize position;
+    size_t length;
+    BOOL parked;
+} OCTFileChunkRequest;
+
+typedef NS_ENUM(NSInteger, OCTFileChunkSendResult) {
+    OCTFileChunkSendResultSent,
+    OCTFileChunkSendResultParked,
+    OCTFileChunkSendResultFinished,
+};
+
 @interface OCTFileUploadOperation ()
 
+@property (assign, atomic, readwrite) NSUInteger parkedChunksCount;
+
+@property (strong, atomic) id iterationObserverToken;
+
+// Serial queue progress and completion are reported on, chunks are sent from tox iteration observer.
+@property (strong, nonatomic, readonly) dispatch_queue_t queue;
+
 @end
 
-@implementation OCTFileUploadOperation
+@implementation OCTFileUploadOperation {
+    // Ring buffer of requested chunks, guarded by @synchronized(self). toxcore accepts chunks only
+    // in order they were requested, so chunks requested after parked one wait behind it.
+    OCTFileChunkRequest *_pendingChunks;
+    NSUInteger _pendingCapacity;
+    NSUInteger _pendingHead;
+    NSUInteger _pendingCount;
 
-#pragma mark -  Public
+    // YES while some thread is passing pending chunks to toxcore.
+    BOOL _sending;
+
+    // YES once last chunk was sent or transfer failed, finish is queued on operation queue.
+    BOOL _stopped;
+}
+
+#pragma mark -  Lifecycle
 
 - (nullable instancetype)initWithTox:(nonnull OCTTox *)tox
                            fileInput:(nonnull id<OCTFileInputProtocol>)fileInput
@@ -44,65 +78,204 @@
     }
 
     _input = fileInput;
+    _queue = dispatch_queue_create("me.dvor.objcTox.OCTFileUploadOperation", DISPATCH_QUEUE_SERIAL);
 
     return self;
 }
 
+- (void)dealloc
+{
+    free(_pendingChunks);
+}
+
 #pragma mark -  Public
 
 - (void)chunkRequestWithPosition:(OCTToxFileSize)position length:(size_t)length
 {
-    if (length == 0) {
-        [self finishWithSuccess];
-        return;
+    @synchronized(self) {
+        [self appendPendingChunkWithPosition:position length:length];
     }
 
-    NSData *data = [self.input bytesWithPosition:position length:length];
+    [self sendPendingChunks];
+}
 
-    if (! data) {
-        [self finishWithError:[NSError sendFileErrorCannotReadFile]];
+#pragma mark -  Override
+
+- (void)operationStarted
+{
+    [super operationStarted];
+
+    if (! [self.input prepareToRead]) {
+        [self finishWithReadError];
         return;
     }
 
-    NSError *error;
+    __weak OCTFileUploadOperation *weakSelf = self;
+    self.iterationObserverToken = [self.tox addIterationObserver:^{
+        [weakSelf sendPendingChunks];
+    }];
+}
+
+- (void)operationWasCanceled
+{
+    [super operationWasCanceled];
+
+    [self stopTransfer];
+}
+
+#pragma mark -  Private
 
-    BOOL result;
-    do {
-        result = [self.tox fileSendChunkForFileNumber:self.fileNumber
-                                         friendNumber:self.friendNumber
-                                             position:position
-                                                 data:data
-                                                error:&error];
+- (void)appendPendingChunkWithPosition:(OCTToxFileSize)position length:(size_t)length
+{
+    if (_pendingCount == _pendingCapacity) {
+        NSUInteger capacity = MAX(_pendingCapacity * 2, kInitialPendingChunksCapacity);
+        OCTFileChunkRequest *chunks = malloc(capacity * sizeof(OCTFileChunkRequest));
 
-        if (! result) {
-            [NSThread sleepForTimeInterval:0.01];
+        for (NSUInteger i = 0; i < _pendingCount; i++) {
+            chunks[i] = _pendingChunks[(_pendingHead + i) % _pendingCapacity];
         }
+
+        free(_pendingChunks);
+        _pendingChunks = chunks;
+        _pendingCapacity = capacity;
+        _pendingHead = 0;
     }
-    while (! result && error.code == OCTToxErrorFileSendChunkSendq);
 
-    if (! result) {
-        OCTLogWarn(@"upload error %@", error);
+    OCTFileChunkRequest request = { .position = position, .length = length, .parked = NO };
+    _pendingChunks[(_pendingHead + _pendingCount) % _pendingCapacity] = request;
+    _pendingCount++;
+}
 
-        [self.tox fileSendControlForFileNumber:self.fileNumber
-                                  friendNumber:self.friendNumber
-                                       control:OCTToxFileControlCancel
-                                         error:nil];
+/**
+ * Called after chunk request and after every tox iteration. Lock isn't held while calling tox, tox calls
+ * made from other threads wait for iteration observers to finish.
+ */
+- (void)sendPendingChunks
+{
+    while (YES) {
+        OCTFileChunkRequest request;
 
-        [self finishWithError:[NSError acceptFileErrorFromToxFileSendChunkError:error.code]];
-        return;
+        @synchronized(self) {
+            if (_sending || _stopped || (_pendingCount == 0) || self.isFinished) {
+                return;
+            }
+
+            _sending = YES;
+            request = _pendingChunks[_pendingHead];
+        }
+
+        OCTFileChunkSendResult result = [self sendChunk:request];
+
+        @synchronized(self) {
+            _sending = NO;
+
+            switch (result) {
+                case OCTFileChunkSendResultSent:
+                    _pendingHead = (_pendingHead + 1) % _pendingCapacity;
+                    _pendingCount--;
+                    break;
+                case OCTFileChunkSendResultParked:
+                    if (! _pendingChunks[_pendingHead].parked) {
+                        _pendingChunks[_pendingHead].parked = YES;
+                        self.parkedChunksCount++;
+                    }
+                    return;
+                case OCTFileChunkSendResultFinished:
+                    _pendingCount = 0;
+                    _stopped = YES;
+                    return;
+            }
+        }
+    }
+}
+
+- (OCTFileChunkSendResult)sendChunk:(OCTFileChunkRequest)request
+{
+    if (request.length == 0) {
+        [self stopTransfer];
+        [self finishOnQueueWithError:nil];
+        return OCTFileChunkSendResultFinished;
+    }
+
+    NSData *data = [self.input bytesWithPosition:request.position length:request.length];
+
+    if (! data) {
+        [self finishWithReadError];
+        return OCTFileChunkSendResultFinished;
+    }
+
+    OCTToxErrorFileSendChunk code = OCTToxErrorFileSendChunkUnknown;
+    BOOL result = [self.tox fileSendChunkForFileNumber:self.fileNumber
+                                          friendNumber:self.friendNumber
+                                              position:request.position
+                                                  data:data
+                                             errorCode:&code];
+
+    if (result) {
+        OCTToxFileSize bytesDone = request.position + request.length;
+
+        dispatch_async(self.queue, ^{
+            [self updateBytesDone:bytesDone];
+        });
+        return OCTFileChunkSendResultSent;
+    }
+
+    if (code == OCTToxErrorFileSendChunkSendq) {
+        return OCTFileChunkSendResultParked;
     }
 
-    [self updateBytesDone:position + length];
+    OCTLogWarn(@"upload error %ld", (long)code);
+
+    [self.tox fileSendControlForFileNumber:self.fileNumber
+                              friendNumber:self.friendNumber
+                                   control:OCTToxFileControlCancel
+                                     error:nil];
+
+    [self stopTransfer];
+    [self finishOnQueueWithError:[NSError acceptFileErrorFromToxFileSendChunkError:code]];
+
+    return OCTFileChunkSendResultFinished;
 }
 
-#pragma mark -  Override
+- (void)finishWithReadError
+{
+    [self stopTransfer];
+    [self finishOnQueueWithError:[NSError sendFileErrorCannotReadFile]];
+}
 
-- (void)operationStarted
+/**
+ * Finishes on operation queue after progress updates queued before.
+ *
+ * @param error nil on success.
+ */
+- (void)finishOnQueueWithError:(NSError *)error
 {
-    [super operationStarted];
+    dispatch_async(self.queue, ^{
+        // Operation may have been cancelled meanwhile.
+        if (self.isFinished) {
+            return;
+        }
 
-    if (! [self.input prepareToRead]) {
-        [self finishWithError:[NSError sendFileErrorCannotReadFile]];
+        if (error) {
+            [self finishWithError:error];
+        }
+        else {
+            [self finishWithSuccess];
+        }
+    });
+}
+
+- (void)stopTransfer
+{
+    [self.tox removeIterationObserver:self.iterationObserverToken];
+    self.iterationObserverToken = nil;
+
+    if ([self.input respondsToSelector:@selector(finishReading)]) {
+        [self.input finishReading];
+    }
+
+    if (self.parkedChunksCount) {
+        OCTLogInfo(@"%lu chunks were parked on full send queue", (unsigned long)self.parkedChunksCount);
     }
 }
 
@@ -0,0 +1,24 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import "OCTMessageCursor.h"
+
+@class OCTRealmManager;
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface OCTMessageCursor (Private)
+
+/**
+ * @param realmManager Manager to read messages with.
+ * @param chatUniqueIdentifier Chat to page through.
+ * @param pageSize Maximum number of messages in page, should be greater than 0.
+ */
+- (instancetype)initWithRealmManager:(OCTRealmManager *)realmManager
+                chatUniqueIdentifier:(NSString *)chatUniqueIdentifier
+                            pageSize:(NSUInteger)pageSize;
+
+@end
+
+NS_ASSUME_NONNULL_END
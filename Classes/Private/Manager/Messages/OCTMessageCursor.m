@@ -0,0 +1,326 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Realm/Realm.h>
+
+#import "OCTMessageCursor+Private.h"
+#import "OCTRealmManager.h"
+#import "OCTMessageAbstract.h"
+#import "OCTMessageText.h"
+#import "OCTMessageFile.h"
+#import "OCTMessageCall.h"
+
+static const NSTimeInterval kInitialWindow = 24 * 60 * 60;
+static const NSUInteger kWindowGrowFactor = 8;
+
+/**
+ * Position in history, messages are ordered by dateInterval and then by uniqueIdentifier.
+ */
+@interface OCTMessageCursorKey : NSObject
+
+@property (assign, nonatomic, readonly) NSTimeInterval dateInterval;
+@property (copy, nonatomic, readonly) NSString *uniqueIdentifier;
+
+@end
+
+@implementation OCTMessageCursorKey
+
+- (instancetype)initWithDateInterval:(NSTimeInterval)dateInterval uniqueIdentifier:(NSString *)uniqueIdentifier
+{
+    self = [super init];
+
+    if (! self) {
+        return nil;
+    }
+
+    _dateInterval = dateInterval;
+    _uniqueIdentifier = [uniqueIdentifier copy];
+
+    return self;
+}
+
++ (instancetype)keyWithMessage:(OCTMessageAbstract *)message
+{
+    return [[self alloc] initWithDateInterval:message.dateInterval uniqueIdentifier:message.uniqueIdentifier];
+}
+
++ (NSComparisonResult)compareDateInterval:(NSTimeInterval)dateInterval1
+                         uniqueIdentifier:(NSString *)uniqueIdentifier1
+                         withDateInterval:(NSTimeInterval)dateInterval2
+                         uniqueIdentifier:(NSString *)uniqueIdentifier2
+{
+    if (dateInterval1 < dateInterval2) {
+        return NSOrderedAscending;
+    }
+
+    if (dateInterval1 > dateInterval2) {
+        return NSOrderedDescending;
+    }
+
+    return [uniqueIdentifier1 compare:uniqueIdentifier2 options:NSLiteralSearch];
+}
+
+- (NSComparisonResult)compareWithMessage:(OCTMessageAbstract *)message
+{
+    return [OCTMessageCursorKey compareDateInterval:self.dateInterval
+                                   uniqueIdentifier:self.uniqueIdentifier
+                                   withDateInterval:message.dateInterval
+                                   uniqueIdentifier:message.uniqueIdentifier];
+}
+
+- (BOOL)isEqual:(id)object
+{
+    if (! [object isKindOfClass:[OCTMessageCursorKey class]]) {
+        return NO;
+    }
+
+    OCTMessageCursorKey *key = object;
+
+    return (self.dateInterval == key.dateInterval) && [self.uniqueIdentifier isEqualToString:key.uniqueIdentifier];
+}
+
+- (NSUInteger)hash
+{
+    return [self.uniqueIdentifier hash];
+}
+
+@end
+
+@interface OCTMessageCursor ()
+
+@property (strong, nonatomic, readonly) OCTRealmManager *realmManager;
+@property (strong, nonatomic, readonly) dispatch_queue_t queue;
+
+@property (assign, atomic, readwrite) BOOL hasOlderMessages;
+
+/**
+ * Following properties should be accessed on queue only.
+ */
+@property (strong, nonatomic) OCTMessageCursorKey *oldestKey;
+@property (strong, nonatomic) OCTMessageCursorKey *newestKey;
+
+@property (strong, nonatomic) NSArray<OCTMessageAbstract *> *prefetchedOlderMessages;
+@property (strong, nonatomic) OCTMessageCursorKey *prefetchedOlderKey;
+@property (strong, nonatomic) NSArray<OCTMessageAbstract *> *prefetchedNewerMessages;
+@property (strong, nonatomic) OCTMessageCursorKey *prefetchedNewerKey;
+
+/**
+ * Time window the last page was found in, next fetch starts with it.
+ */
+@property (assign, nonatomic) NSTimeInterval window;
+
+@end
+
+@implementation OCTMessageCursor
+
+#pragma mark -  Lifecycle
+
+- (instancetype)initWithRealmManager:(OCTRealmManager *)realmManager
+                chatUniqueIdentifier:(NSString *)chatUniqueIdentifier
+                            pageSize:(NSUInteger)pageSize
+{
+    NSParameterAssert(realmManager);
+    NSParameterAssert(chatUniqueIdentifier);
+    NSParameterAssert(pageSize > 0);
+
+    self = [super init];
+
+    if (! self) {
+        return nil;
+    }
+
+    _realmManager = realmManager;
+    _chatUniqueIdentifier = [chatUniqueIdentifier copy];
+    _pageSize = pageSize;
+    _queue = dispatch_queue_create("me.dvor.objcTox.OCTMessageCursor", DISPATCH_QUEUE_SERIAL);
+    _hasOlderMessages = YES;
+    _window = kInitialWindow;
+
+    // Empty identifier precedes any other one, so messages added at the same moment are treated as newer.
+    OCTMessageCursorKey *key = [[OCTMessageCursorKey alloc] initWithDateInterval:[[NSDate date] timeIntervalSince1970]
+                                                                uniqueIdentifier:@""];
+    _oldestKey = key;
+    _newestKey = key;
+
+    return self;
+}
+
+#pragma mark -  Public
+
+- (NSArray<OCTMessageAbstract *> *)olderMessages
+{
+    __block NSArray<OCTMessageAbstract *> *messages;
+
+    dispatch_sync(self.queue, ^{
+        if (self.prefetchedOlderMessages && [self.prefetchedOlderKey isEqual:self.oldestKey]) {
+            messages = self.prefetchedOlderMessages;
+        }
+        else {
+            messages = [self fetchMessagesOlder:YES thanKey:self.oldestKey];
+        }
+
+        self.prefetchedOlderMessages = nil;
+        self.prefetchedOlderKey = nil;
+
+        if (messages.count) {
+            self.oldestKey = [OCTMessageCursorKey keyWithMessage:messages.firstObject];
+        }
+        self.hasOlderMessages = (messages.count == self.pageSize);
+    });
+
+    if (self.hasOlderMessages) {
+        [self prefetchOlder:YES];
+    }
+
+    return messages;
+}
+
+- (NSArray<OCTMessageAbstract *> *)newerMessages
+{
+    __block NSArray<OCTMessageAbstract *> *messages;
+
+    dispatch_sync(self.queue, ^{
+        // New messages could be added after short page was prefetched.
+        if ((self.prefetchedNewerMessages.count == self.pageSize) && [self.prefetchedNewerKey isEqual:self.newestKey]) {
+            messages = self.prefetchedNewerMessages;
+        }
+        else {
+            messages = [self fetchMessagesOlder:NO thanKey:self.newestKey];
+        }
+
+        self.prefetchedNewerMessages = nil;
+        self.prefetchedNewerKey = nil;
+
+        if (messages.count) {
+            self.newestKey = [OCTMessageCursorKey keyWithMessage:messages.lastObject];
+        }
+    });
+
+    if (messages.count == self.pageSize) {
+        [self prefetchOlder:NO];
+    }
+
+    return messages;
+}
+
+#pragma mark -  Private
+
+- (void)prefetchOlder:(BOOL)older
+{
+    __weak OCTMessageCursor *weakSelf = self;
+
+    dispatch_async(self.queue, ^{
+        OCTMessageCursor *strongSelf = weakSelf;
+
+        if (! strongSelf) {
+            return;
+        }
+
+        OCTMessageCursorKey *key = older ? strongSelf.oldestKey : strongSelf.newestKey;
+        NSArray *messages = [strongSelf fetchMessagesOlder:older thanKey:key];
+
+        if (older) {
+            strongSelf.prefetchedOlderMessages = messages;
+            strongSelf.prefetchedOlderKey = key;
+        }
+        else {
+            strongSelf.prefetchedNewerMessages = messages;
+            strongSelf.prefetchedNewerKey = key;
+        }
+    });
+}
+
+/**
+ * Should be called on queue.
+ *
+ * dateInterval is a double and can't be indexed by Realm, so sorting all messages of the chat would make
+ * every page as expensive as the whole history. Instead only messages in a time window next to the key
+ * are sorted, window grows until page is filled or history is over.
+ *
+ * @return Up to pageSize unmanaged messages sorted by date ascending.
+ */
+- (NSArray<OCTMessageAbstract *> *)fetchMessagesOlder:(BOOL)older thanKey:(OCTMessageCursorKey *)key
+{
+    NSMutableArray<OCTMessageAbstract *> *result = [NSMutableArray new];
+
+    @autoreleasepool {
+        RLMRealm *realm = [self.realmManager currentRealm];
+        RLMResults *messages = [OCTMessageAbstract objectsInRealm:realm
+                                                            where:@"chatUniqueIdentifier == %@", self.chatUniqueIdentifier];
+
+        NSNumber *bound = older ? [messages minOfProperty:@"dateInterval"] : [messages maxOfProperty:@"dateInterval"];
+
+        if (! bound) {
+            return @[];
+        }
+
+        NSTimeInterval window = self.window;
+        NSMutableArray<OCTMessageAbstract *> *page = [NSMutableArray new];
+
+        while (YES) {
+            NSTimeInterval from = older ? (key.dateInterval - window) : key.dateInterval;
+            NSTimeInterval to = older ? key.dateInterval : (key.dateInterval + window);
+            BOOL isLastWindow = older ? (from <= bound.doubleValue) : (to >= bound.doubleValue);
+
+            RLMResults *candidates = [messages objectsWhere:@"dateInterval >= %@ AND dateInterval <= %@", @(from), @(to)];
+            candidates = [candidates sortedResultsUsingKeyPath:@"dateInterval" ascending:! older];
+
+            [page removeAllObjects];
+
+            for (OCTMessageAbstract *message in candidates) {
+                NSComparisonResult order = [key compareWithMessage:message];
+
+                if (older ? (order != NSOrderedDescending) : (order != NSOrderedAscending)) {
+                    continue;
+                }
+
+                // Realm sorts by date only, taking all messages with the same date as the last one
+                // and sorting them by uniqueIdentifier below.
+                if ((page.count >= self.pageSize) && (message.dateInterval != page.lastObject.dateInterval)) {
+                    break;
+                }
+
+                [page addObject:message];
+            }
+
+            if ((page.count >= self.pageSize) || isLastWindow) {
+                break;
+            }
+
+            window *= kWindowGrowFactor;
+        }
+
+        self.window = window;
+
+        [page sortUsingComparator:^NSComparisonResult (OCTMessageAbstract *message1, OCTMessageAbstract *message2) {
+            return [OCTMessageCursorKey compareDateInterval:message1.dateInterval
+                                           uniqueIdentifier:message1.uniqueIdentifier
+                                           withDateInterval:message2.dateInterval
+                                           uniqueIdentifier:message2.uniqueIdentifier];
+        }];
+
+        NSUInteger count = MIN(page.count, self.pageSize);
+        NSRange range = older ? NSMakeRange(page.count - count, count) : NSMakeRange(0, count);
+
+        for (OCTMessageAbstract *message in [page subarrayWithRange:range]) {
+            [result addObject:[self snapshotOfMessage:message]];
+        }
+    }
+
+    return [result copy];
+}
+
+- (OCTMessageAbstract *)snapshotOfMessage:(OCTMessageAbstract *)message
+{
+    OCTMessageAbstract *snapshot = [[OCTMessageAbstract alloc] initWithValue:message];
+
+    // Linked objects should be copied too, otherwise snapshot would reference managed ones.
+    snapshot.messageText = message.messageText ? [[OCTMessageText alloc] initWithValue:message.messageText] : nil;
+    snapshot.messageFile = message.messageFile ? [[OCTMessageFile alloc] initWithValue:message.messageFile] : nil;
+    snapshot.messageCall = message.messageCall ? [[OCTMessageCall alloc] initWithValue:message.messageCall] : nil;
+
+    return snapshot;
+}
+
+@end
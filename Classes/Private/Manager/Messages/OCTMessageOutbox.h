@@ -0,0 +1,97 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Foundation/Foundation.h>
+
+#import "OCTToxConstants.h"
+
+@class OCTTox;
+@class OCTRealmManager;
+@class OCTChat;
+@class OCTFriend;
+@class OCTMessageAbstract;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Called on the queue iterating Tox once toxcore accepted message.
+ */
+typedef void (^OCTMessageOutboxSentBlock)(NSString *messageUniqueIdentifier,
+                                          OCTToxFriendNumber friendNumber,
+                                          OCTToxMessageId messageId);
+
+/**
+ * Called on the queue iterating Tox once message was dropped because toxcore refused it for reason
+ * other than full send queue or friend not being connected.
+ */
+typedef void (^OCTMessageOutboxFailedBlock)(NSString *messageUniqueIdentifier,
+                                            OCTToxFriendNumber friendNumber,
+                                            NSError *error);
+
+extern const NSUInteger kOCTMessageOutboxDefaultSendBudget;
+
+/**
+ * Per friend queues of outgoing text messages. Queues are drained after every iteration of Tox, new messages
+ * of friend go before undelivered ones being resent, friends are served in round robin
+ * continuing after friend served last.
+ *
+ * When toxcore send queue is full friend is backed off for a growing interval, when friend is offline
+ * its queue is paused until resumeFriendNumber: is called.
+ *
+ * New messages are persisted together with OCTMessageOutboxEntry, queue survives restart. Entry is removed
+ * after toxcore accepted message, message may be sent twice if app is terminated in between.
+ */
+@interface OCTMessageOutbox : NSObject
+
+/**
+ * Maximum number of messages passed to toxcore after single iteration, for all friends together.
+ * Default value is kOCTMessageOutboxDefaultSendBudget.
+ */
+@property (assign, atomic) NSUInteger sendBudget;
+
+@property (copy, atomic, nullable) OCTMessageOutboxSentBlock sentBlock;
+@property (copy, atomic, nullable) OCTMessageOutboxFailedBlock failedBlock;
+
+- (instancetype)initWithTox:(OCTTox *)tox realmManager:(OCTRealmManager *)realmManager;
+
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+/**
+ * Adds outgoing text message with outbox entry in single write transaction and queues it.
+ *
+ * @return Added message, its messageId is updated once message is sent.
+ */
+- (OCTMessageAbstract *)addMessageWithText:(NSString *)text
+                                      type:(OCTToxMessageType)type
+                                      chat:(OCTChat *)chat
+                                    friend:(OCTFriend *)friend;
+
+/**
+ * Queues undelivered text messages after new ones. Backlog isn't persisted, it is queued again on reconnect.
+ *
+ * @param messages Messages to send, ones already in outbox are skipped.
+ */
+- (void)enqueueBacklogMessages:(id<NSFastEnumeration>)messages friendNumber:(OCTToxFriendNumber)friendNumber;
+
+/**
+ * Queues messages of entries left from previous launch. Entries of removed or delivered messages are deleted.
+ */
+- (void)restore;
+
+/**
+ * Messages of friend stop being sent once toxcore reports friend as not connected. Call this on reconnect.
+ */
+- (void)resumeFriendNumber:(OCTToxFriendNumber)friendNumber;
+
+- (NSUInteger)queuedMessagesCountForFriendNumber:(OCTToxFriendNumber)friendNumber;
+
+/**
+ * Passes queued messages to toxcore, at most sendBudget of them. Called automatically on the queue iterating Tox.
+ */
+- (void)drain;
+
+@end
+
+NS_ASSUME_NONNULL_END
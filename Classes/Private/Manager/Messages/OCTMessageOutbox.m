@@ -0,0 +1,438 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Realm/Realm.h>
+
+#import "OCTMessageOutbox.h"
+#import "OCTMessageOutboxEntry.h"
+#import "OCTTox.h"
+#import "OCTRealmManager.h"
+#import "OCTFriend.h"
+#import "OCTChat.h"
+#import "OCTMessageAbstract.h"
+#import "OCTMessageText.h"
+#import "OCTLogging.h"
+
+const NSUInteger kOCTMessageOutboxDefaultSendBudget = 16;
+
+static const NSTimeInterval kSendqInitialBackoff = 0.05;
+static const NSTimeInterval kSendqMaxBackoff = 2.0;
+
+@interface OCTMessageOutboxItem : NSObject
+
+@property (copy, nonatomic) NSString *messageUniqueIdentifier;
+@property (copy, nonatomic) NSString *text;
+@property (assign, nonatomic) OCTToxMessageType type;
+
+/**
+ * Whether item has OCTMessageOutboxEntry. Backlog items don't.
+ */
+@property (assign, nonatomic) BOOL persisted;
+
+@end
+
+@implementation OCTMessageOutboxItem
+@end
+
+@interface OCTMessageOutboxFriendQueue : NSObject
+
+@property (strong, nonatomic) NSMutableArray<OCTMessageOutboxItem *> *freshItems;
+@property (strong, nonatomic) NSMutableArray<OCTMessageOutboxItem *> *backlogItems;
+
+@property (assign, nonatomic) BOOL paused;
+@property (assign, nonatomic) NSTimeInterval backoffInterval;
+@property (assign, nonatomic) CFAbsoluteTime backoffUntil;
+
+@end
+
+@implementation OCTMessageOutboxFriendQueue
+
+- (instancetype)init
+{
+    self = [super init];
+
+    if (! self) {
+        return nil;
+    }
+
+    _freshItems = [NSMutableArray new];
+    _backlogItems = [NSMutableArray new];
+
+    return self;
+}
+
+- (OCTMessageOutboxItem *)nextItem
+{
+    return self.freshItems.firstObject ?: self.backlogItems.firstObject;
+}
+
+- (NSUInteger)count
+{
+    return self.freshItems.count + self.backlogItems.count;
+}
+
+@end
+
+@interface OCTMessageOutbox ()
+
+@property (weak, nonatomic, readonly) OCTTox *tox;
+@property (weak, nonatomic, readonly) OCTRealmManager *realmManager;
+@property (strong, nonatomic, readonly) id iterationObserverToken;
+
+// Guarded by @synchronized(queues). Queues without items are removed, so idle drain does nothing.
+@property (strong, nonatomic, readonly) NSMutableDictionary<NSNumber *, OCTMessageOutboxFriendQueue *> *queues;
+@property (strong, nonatomic, readonly) NSMutableSet<NSString *> *queuedIdentifiers;
+
+// Friend served last, next drain starts after it. Guarded by @synchronized(queues).
+@property (strong, nonatomic) NSNumber *lastServedFriendNumber;
+
+@end
+
+@implementation OCTMessageOutbox
+
+#pragma mark -  Lifecycle
+
+- (instancetype)initWithTox:(OCTTox *)tox realmManager:(OCTRealmManager *)realmManager
+{
+    NSParameterAssert(tox);
+    NSParameterAssert(realmManager);
+
+    self = [super init];
+
+    if (! self) {
+        return nil;
+    }
+
+    _tox = tox;
+    _realmManager = realmManager;
+    _sendBudget = kOCTMessageOutboxDefaultSendBudget;
+    _queues = [NSMutableDictionary new];
+    _queuedIdentifiers = [NSMutableSet new];
+
+    __weak OCTMessageOutbox *weakSelf = self;
+    _iterationObserverToken = [tox addIterationObserver:^{
+        [weakSelf drain];
+    }];
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_tox removeIterationObserver:_iterationObserverToken];
+}
+
+#pragma mark -  Public
+
+- (OCTMessageAbstract *)addMessageWithText:(NSString *)text
+                                      type:(OCTToxMessageType)type
+                                      chat:(OCTChat *)chat
+                                    friend:(OCTFriend *)friend
+{
+    NSParameterAssert(text);
+    NSParameterAssert(chat);
+    NSParameterAssert(friend);
+
+    OCTRealmManager *realmManager = self.realmManager;
+    __block OCTMessageAbstract *message;
+
+    [realmManager performBatchUpdates:^{
+        message = [realmManager addMessageWithText:text type:type chat:chat sender:nil messageId:0];
+
+        OCTMessageOutboxEntry *entry = [OCTMessageOutboxEntry new];
+        entry.messageUniqueIdentifier = message.uniqueIdentifier;
+        entry.friendUniqueIdentifier = friend.uniqueIdentifier;
+        entry.dateInterval = message.dateInterval;
+
+        // Batch is in write transaction already.
+        [[realmManager currentRealm] addObject:entry];
+    }];
+
+    OCTMessageOutboxItem *item = [OCTMessageOutboxItem new];
+    item.messageUniqueIdentifier = message.uniqueIdentifier;
+    item.text = text;
+    item.type = type;
+    item.persisted = YES;
+
+    [self enqueueItem:item friendNumber:friend.friendNumber backlog:NO];
+
+    return message;
+}
+
+- (void)enqueueBacklogMessages:(id<NSFastEnumeration>)messages friendNumber:(OCTToxFriendNumber)friendNumber
+{
+    for (OCTMessageAbstract *message in messages) {
+        if (! message.messageText) {
+            continue;
+        }
+
+        OCTMessageOutboxItem *item = [OCTMessageOutboxItem new];
+        item.messageUniqueIdentifier = message.uniqueIdentifier;
+        item.text = message.messageText.text;
+        item.type = message.messageText.type;
+
+        [self enqueueItem:item friendNumber:friendNumber backlog:YES];
+    }
+}
+
+- (void)restore
+{
+    OCTRealmManager *realmManager = self.realmManager;
+
+    RLMResults *entries = [OCTMessageOutboxEntry allObjectsInRealm:[realmManager currentRealm]];
+    entries = [entries sortedResultsUsingKeyPath:@"dateInterval" ascending:YES];
+
+    NSMutableArray<OCTMessageOutboxEntry *> *staleEntries = [NSMutableArray new];
+
+    for (OCTMessageOutboxEntry *entry in entries) {
+        OCTMessageAbstract *message = [realmManager objectWithUniqueIdentifier:entry.messageUniqueIdentifier
+                                                                         class:[OCTMessageAbstract class]];
+        OCTFriend *friend = [realmManager objectWithUniqueIdentifier:entry.friendUniqueIdentifier
+                                                               class:[OCTFriend class]];
+
+        if (! message.messageText || message.messageText.isDelivered || ! friend) {
+            [staleEntries addObject:entry];
+            continue;
+        }
+
+        OCTMessageOutboxItem *item = [OCTMessageOutboxItem new];
+        item.messageUniqueIdentifier = message.uniqueIdentifier;
+        item.text = message.messageText.text;
+        item.type = message.messageText.type;
+        item.persisted = YES;
+
+        [self enqueueItem:item friendNumber:friend.friendNumber backlog:NO];
+    }
+
+    if (! staleEntries.count) {
+        return;
+    }
+
+    OCTLogInfo(@"removing %lu stale outbox entries", (unsigned long)staleEntries.count);
+
+    [realmManager performBatchUpdates:^{
+        [[realmManager currentRealm] deleteObjects:staleEntries];
+    }];
+}
+
+- (void)resumeFriendNumber:(OCTToxFriendNumber)friendNumber
+{
+    @synchronized(self.queues) {
+        OCTMessageOutboxFriendQueue *queue = self.queues[@(friendNumber)];
+        queue.paused = NO;
+        queue.backoffInterval = 0;
+        queue.backoffUntil = 0;
+    }
+}
+
+- (NSUInteger)queuedMessagesCountForFriendNumber:(OCTToxFriendNumber)friendNumber
+{
+    @synchronized(self.queues) {
+        return [self.queues[@(friendNumber)] count];
+    }
+}
+
+- (void)drain
+{
+    NSArray<NSNumber *> *friendNumbers;
+
+    @synchronized(self.queues) {
+        if (! self.queues.count) {
+            return;
+        }
+
+        friendNumbers = [self friendNumbersStartingAfter:self.lastServedFriendNumber];
+    }
+
+    NSUInteger budget = self.sendBudget;
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    BOOL progress = YES;
+
+    // One message of every friend per pass, busy friend cannot take whole budget.
+    while (budget && progress) {
+        progress = NO;
+
+        for (NSNumber *friendNumber in friendNumbers) {
+            if (! budget) {
+                break;
+            }
+
+            OCTMessageOutboxItem *item;
+
+            @synchronized(self.queues) {
+                OCTMessageOutboxFriendQueue *queue = self.queues[friendNumber];
+
+                if (! queue.paused && (queue.backoffUntil <= now)) {
+                    item = [queue nextItem];
+                }
+
+                if (item) {
+                    self.lastServedFriendNumber = friendNumber;
+                }
+            }
+
+            if (! item) {
+                continue;
+            }
+
+            budget--;
+
+            if ([self sendItem:item friendNumber:friendNumber.unsignedIntValue now:now]) {
+                progress = YES;
+            }
+        }
+    }
+}
+
+#pragma mark -  Private
+
+/**
+ * Friends with queues in ascending order rotated to start after given friend. Call under @synchronized(queues).
+ */
+- (NSArray<NSNumber *> *)friendNumbersStartingAfter:(NSNumber *)lastFriendNumber
+{
+    NSArray<NSNumber *> *friendNumbers = [[self.queues allKeys] sortedArrayUsingSelector:@selector(compare:)];
+
+    if (! lastFriendNumber) {
+        return friendNumbers;
+    }
+
+    NSUInteger index = [friendNumbers indexOfObjectPassingTest:^BOOL (NSNumber *friendNumber, NSUInteger idx, BOOL *stop) {
+        return [friendNumber compare:lastFriendNumber] == NSOrderedDescending;
+    }];
+
+    if ((index == NSNotFound) || (index == 0)) {
+        return friendNumbers;
+    }
+
+    NSRange head = NSMakeRange(0, index);
+    NSRange tail = NSMakeRange(index, friendNumbers.count - index);
+
+    return [[friendNumbers subarrayWithRange:tail] arrayByAddingObjectsFromArray:[friendNumbers subarrayWithRange:head]];
+}
+
+- (void)enqueueItem:(OCTMessageOutboxItem *)item friendNumber:(OCTToxFriendNumber)friendNumber backlog:(BOOL)backlog
+{
+    @synchronized(self.queues) {
+        if ([self.queuedIdentifiers containsObject:item.messageUniqueIdentifier]) {
+            return;
+        }
+
+        OCTMessageOutboxFriendQueue *queue = self.queues[@(friendNumber)];
+
+        if (! queue) {
+            queue = [OCTMessageOutboxFriendQueue new];
+            self.queues[@(friendNumber)] = queue;
+        }
+
+        NSMutableArray *items = backlog ? queue.backlogItems : queue.freshItems;
+        [items addObject:item];
+        [self.queuedIdentifiers addObject:item.messageUniqueIdentifier];
+    }
+}
+
+- (void)removeItem:(OCTMessageOutboxItem *)item friendNumber:(OCTToxFriendNumber)friendNumber
+{
+    @synchronized(self.queues) {
+        OCTMessageOutboxFriendQueue *queue = self.queues[@(friendNumber)];
+
+        [queue.freshItems removeObjectIdenticalTo:item];
+        [queue.backlogItems removeObjectIdenticalTo:item];
+        queue.backoffInterval = 0;
+
+        if (! [queue count]) {
+            [self.queues removeObjectForKey:@(friendNumber)];
+        }
+
+        [self.queuedIdentifiers removeObject:item.messageUniqueIdentifier];
+    }
+}
+
+/**
+ * @return YES if item left the queue.
+ */
+- (BOOL)sendItem:(OCTMessageOutboxItem *)item friendNumber:(OCTToxFriendNumber)friendNumber now:(CFAbsoluteTime)now
+{
+    NSError *error;
+    OCTToxMessageId messageId = [self.tox sendMessageWithFriendNumber:friendNumber
+                                                                 type:item.type
+                                                              message:item.text
+                                                                error:&error];
+
+    if (! error) {
+        [self removeItem:item friendNumber:friendNumber];
+
+        OCTMessageOutboxSentBlock sentBlock = self.sentBlock;
+        if (sentBlock) {
+            sentBlock(item.messageUniqueIdentifier, friendNumber, messageId);
+        }
+
+        [self finishItem:item messageId:@(messageId)];
+        return YES;
+    }
+
+    @synchronized(self.queues) {
+        OCTMessageOutboxFriendQueue *queue = self.queues[@(friendNumber)];
+
+        if (error.code == OCTToxErrorFriendSendMessageSendq) {
+            queue.backoffInterval = queue.backoffInterval ? MIN(queue.backoffInterval * 2, kSendqMaxBackoff) : kSendqInitialBackoff;
+            queue.backoffUntil = now + queue.backoffInterval;
+            return NO;
+        }
+
+        if (error.code == OCTToxErrorFriendSendMessageFriendNotConnected) {
+            queue.paused = YES;
+            return NO;
+        }
+    }
+
+    OCTLogWarn(@"cannot send message to friend %u, dropping it, error %@", friendNumber, error);
+
+    [self removeItem:item friendNumber:friendNumber];
+
+    OCTMessageOutboxFailedBlock failedBlock = self.failedBlock;
+    if (failedBlock) {
+        failedBlock(item.messageUniqueIdentifier, friendNumber, error);
+    }
+
+    [self finishItem:item messageId:nil];
+
+    return YES;
+}
+
+/**
+ * Stores messageId of sent message and removes outbox entry.
+ *
+ * @param messageId nil if message was dropped.
+ */
+- (void)finishItem:(OCTMessageOutboxItem *)item messageId:(NSNumber *)messageId
+{
+    if (! messageId && ! item.persisted) {
+        return;
+    }
+
+    OCTRealmManager *realmManager = self.realmManager;
+    NSString *identifier = item.messageUniqueIdentifier;
+    BOOL persisted = item.persisted;
+
+    // Called on the queue iterating Tox, writes are committed on writer queue of realm manager instead of blocking it.
+    [realmManager performAsyncWrite:^{
+        RLMRealm *realm = [realmManager currentRealm];
+
+        if (messageId) {
+            OCTMessageAbstract *message = [OCTMessageAbstract objectInRealm:realm forPrimaryKey:identifier];
+            message.messageText.messageId = messageId.intValue;
+        }
+
+        if (persisted) {
+            OCTMessageOutboxEntry *entry = [OCTMessageOutboxEntry objectInRealm:realm forPrimaryKey:identifier];
+
+            if (entry) {
+                [realm deleteObject:entry];
+            }
+        }
+    } completion:nil];
+}
+
+@end
@@ -9,6 +9,8 @@
 #import "OCTTox.h"
 #import "OCTToxEncryptSave.h"
 #import "OCTToxEncryptSaveConstants.h"
+#import "OCTToxPassKey.h"
+#import "OCTLogging.h"
 
 typedef NS_ENUM(NSInteger, OCTDecryptionErrorFileType) {
     OCTDecryptionErrorFileTypeDatabaseKey,
@@ -27,49 +29,48 @@ static const NSUInteger kEncryptedKeyLength = 64;
     [self validateConfiguration:configuration];
 
     dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
-    dispatch_group_t group = dispatch_group_create();
-
-    // Decrypting Realm.
-    __block NSData *realmEncryptionKey = nil;
-    __block NSError *decryptRealmError = nil;
-
-    dispatch_group_async(group, queue, ^{
-        realmEncryptionKey = [self realmEncryptionKeyWithConfiguration:configuration
-                                                              password:encryptPassword
-                                                                 error:&decryptRealmError];
-    });
 
+    dispatch_async(queue, ^{
+        NSData *realmEncryptionKey = nil;
+        NSError *decryptRealmError = nil;
+
+        NSError *decryptToxError = nil;
+        OCTToxEncryptSave *encryptSave = nil;
+        NSData *toxSave = nil;
+
+        if ([self importToxSaveIfNeeded:configuration error:&decryptToxError]) {
+            NSData *savedData = [self getSavedDataFromPath:configuration.fileStorage.pathForToxSaveFile];
+            NSData *encryptedKey = [self getSavedDataFromPath:configuration.fileStorage.pathForDatabaseEncryptionKey];
+
+            // Key derivation is the slowest part of launch. Tox save and database key are encrypted
+            // with the same key, so usually it is derived only once.
+            OCTToxPassKey *toxPassKey;
+            OCTToxPassKey *databasePassKey;
+            [self derivePassKeysWithPassword:encryptPassword
+                                   savedData:savedData
+                                encryptedKey:encryptedKey
+                                  toxPassKey:&toxPassKey
+                             databasePassKey:&databasePassKey];
+
+            if (toxPassKey) {
+                encryptSave = [[OCTToxEncryptSave alloc] initWithPassKey:toxPassKey];
+                toxSave = [self decryptSavedData:savedData encryptSave:encryptSave error:&decryptToxError];
+            }
+            else {
+                [self fillError:&decryptToxError withInitErrorCode:OCTManagerInitErrorPassphraseFailed];
+            }
 
-    // Decrypting Tox save.
-    __block NSError *decryptToxError = nil;
-    __block OCTToxEncryptSave *encryptSave = nil;
-    __block NSData *toxSave = nil;
-
-    dispatch_group_async(group, queue, ^{
-        if (! [self importToxSaveIfNeeded:configuration error:&decryptToxError]) {
-            return;
-        }
-
-        NSData *savedData = [self getSavedDataFromPath:configuration.fileStorage.pathForToxSaveFile];
-
-        encryptSave = [self toxEncryptSaveWithToxPassword:encryptPassword savedData:savedData error:&decryptToxError];
-
-        if (! encryptSave) {
-            return;
-        }
-
-        savedData = [self decryptSavedData:savedData encryptSave:encryptSave error:&decryptToxError];
-
-        if (! savedData) {
-            return;
+            if (databasePassKey) {
+                realmEncryptionKey = [self realmEncryptionKeyWithConfiguration:configuration
+                                                                       passKey:databasePassKey
+                                                                    toxPassKey:toxPassKey
+                                                                         error:&decryptRealmError];
+            }
+            else {
+                [self fillError:&decryptRealmError withInitErrorCode:OCTManagerInitErrorPassphraseFailed];
+            }
         }
 
-        toxSave = savedData;
-    });
-
-    dispatch_async(queue, ^{
-        dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
-
         dispatch_async(dispatch_get_main_queue(), ^{
             NSError *error = decryptRealmError ?: decryptToxError;
 
@@ -116,8 +117,47 @@ static const NSUInteger kEncryptedKeyLength = 64;
     NSParameterAssert(configuration.options);
 }
 
++ (void)derivePassKeysWithPassword:(NSString *)password
+                        savedData:(NSData *)savedData
+                     encryptedKey:(NSData *)encryptedKey
+                       toxPassKey:(OCTToxPassKey **)toxPassKey
+                  databasePassKey:(OCTToxPassKey **)databasePassKey
+{
+    NSData *toxSalt = savedData ? [OCTToxPassKey saltOfEncryptedData:savedData] : nil;
+    NSData *databaseSalt = encryptedKey ? [OCTToxPassKey saltOfEncryptedData:encryptedKey] : nil;
+
+    // Files that are not encrypted yet will be encrypted with key of the other one.
+    NSData *salt = toxSalt ?: databaseSalt;
+
+    if (! databaseSalt || [databaseSalt isEqualToData:salt]) {
+        *toxPassKey = [OCTToxPassKey passKeyWithPassphrase:password salt:salt error:nil];
+        *databasePassKey = *toxPassKey;
+        return;
+    }
+
+    // Files were encrypted with different salts by older version, deriving both keys in parallel.
+    __block OCTToxPassKey *toxResult;
+    __block OCTToxPassKey *databaseResult;
+
+    dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    dispatch_group_t group = dispatch_group_create();
+
+    dispatch_group_async(group, queue, ^{
+        toxResult = [OCTToxPassKey passKeyWithPassphrase:password salt:toxSalt error:nil];
+    });
+    dispatch_group_async(group, queue, ^{
+        databaseResult = [OCTToxPassKey passKeyWithPassphrase:password salt:databaseSalt error:nil];
+    });
+
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+
+    *toxPassKey = toxResult;
+    *databasePassKey = databaseResult;
+}
+
 + (NSData *)realmEncryptionKeyWithConfiguration:(OCTManagerConfiguration *)configuration
-                                       password:(NSString *)databasePassword
+                                        passKey:(OCTToxPassKey *)passKey
+                                     toxPassKey:(OCTToxPassKey *)toxPassKey
                                           error:(NSError **)error
 {
     NSString *databasePath = configuration.fileStorage.pathForDatabase;
@@ -128,7 +168,7 @@ static const NSUInteger kEncryptedKeyLength = 64;
 
     if (! databaseExists && ! encryptedKeyExists) {
         // First run, create key and database.
-        if (! [self createEncryptedKeyAtPath:encryptedKeyPath withPassword:databasePassword]) {
+        if (! [self createEncryptedKeyAtPath:encryptedKeyPath withPassKey:passKey]) {
             [self fillError:error withInitErrorCode:OCTManagerInitErrorDatabaseKeyCannotCreateKey];
             return nil;
         }
@@ -140,7 +180,7 @@ static const NSUInteger kEncryptedKeyLength = 64;
 
         BOOL result = [self migrateToEncryptedDatabase:databasePath
                                      encryptionKeyPath:encryptedKeyPath
-                                          withPassword:databasePassword
+                                           withPassKey:passKey
                                                  error:&migrationError];
 
         if (! result) {
@@ -163,26 +203,54 @@ static const NSUInteger kEncryptedKeyLength = 64;
     }
 
     NSError *decryptError;
-    NSData *key = [OCTToxEncryptSave decryptData:encryptedKey withPassphrase:databasePassword error:&decryptError];
+    NSData *key = [passKey decryptData:encryptedKey error:&decryptError];
 
     if (! key) {
         [self fillError:error withDecryptionError:decryptError.code fileType:OCTDecryptionErrorFileTypeDatabaseKey];
         return nil;
     }
 
+    if (toxPassKey && (toxPassKey != passKey)) {
+        // Switching key file to the same key as tox save, so next launch derives key only once.
+        // On failure old key file is left untouched, it is still valid for current passphrase.
+        NSError *reencryptError;
+        if (! [self reencryptKey:key atPath:encryptedKeyPath withPassKey:toxPassKey error:&reencryptError]) {
+            OCTLogWarn(@"cannot re-encrypt database key, keeping old key file %@", reencryptError);
+        }
+    }
+
     return key;
 }
 
-+ (BOOL)createEncryptedKeyAtPath:(NSString *)path withPassword:(NSString *)password
++ (BOOL)createEncryptedKeyAtPath:(NSString *)path withPassKey:(OCTToxPassKey *)passKey
 {
     NSMutableData *key = [NSMutableData dataWithLength:kEncryptedKeyLength];
     SecRandomCopyBytes(kSecRandomDefault, key.length, (uint8_t *)key.mutableBytes);
 
-    NSData *encryptedKey = [OCTToxEncryptSave encryptData:key withPassphrase:password error:nil];
+    NSData *encryptedKey = [passKey encryptData:key error:nil];
 
     return [encryptedKey writeToFile:path options:NSDataWritingAtomic error:nil];
 }
 
++ (BOOL)reencryptKey:(NSData *)key atPath:(NSString *)path withPassKey:(OCTToxPassKey *)passKey error:(NSError **)error
+{
+    NSData *encryptedKey = [passKey encryptData:key error:error];
+
+    if (! encryptedKey) {
+        return NO;
+    }
+
+    // Losing database key means losing database, making sure new file can be read back before replacing old one.
+    NSData *decryptedKey = [passKey decryptData:encryptedKey error:error];
+
+    if (! [decryptedKey isEqualToData:key]) {
+        return NO;
+    }
+
+    // Atomic write keeps old file if anything goes wrong.
+    return [encryptedKey writeToFile:path options:NSDataWritingAtomic error:error];
+}
+
 + (BOOL)fillError:(NSError **)error withDecryptionError:(OCTToxEncryptSaveDecryptionError)code fileType:(OCTDecryptionErrorFileType)fileType
 {
     if (! error) {
@@ -295,12 +363,12 @@ static const NSUInteger kEncryptedKeyLength = 64;
 
 + (BOOL)migrateToEncryptedDatabase:(NSString *)databasePath
                  encryptionKeyPath:(NSString *)encryptionKeyPath
-                      withPassword:(NSString *)password
+                       withPassKey:(OCTToxPassKey *)passKey
                              error:(NSError **)error
 {
     NSParameterAssert(databasePath);
     NSParameterAssert(encryptionKeyPath);
-    NSParameterAssert(password);
+    NSParameterAssert(passKey);
 
     if ([[NSFileManager defaultManager] fileExistsAtPath:encryptionKeyPath]) {
         if (error) {
@@ -314,7 +382,7 @@ static const NSUInteger kEncryptedKeyLength = 64;
 
     NSString *tempKeyPath = [encryptionKeyPath stringByAppendingPathExtension:@"tmp"];
 
-    if (! [self createEncryptedKeyAtPath:tempKeyPath withPassword:password]) {
+    if (! [self createEncryptedKeyAtPath:tempKeyPath withPassKey:passKey]) {
         if (error) {
             *error = [NSError errorWithDomain:kOCTManagerErrorDomain code:101 userInfo:@{
                           NSLocalizedDescriptionKey : @"Cannot migrate unencrypted database to encrypted",
@@ -336,7 +404,7 @@ static const NSUInteger kEncryptedKeyLength = 64;
         return NO;
     }
 
-    NSData *key = [OCTToxEncryptSave decryptData:encryptedKey withPassphrase:password error:error];
+    NSData *key = [passKey decryptData:encryptedKey error:error];
 
     if (! key) {
         return NO;
@@ -372,28 +440,6 @@ static const NSUInteger kEncryptedKeyLength = 64;
     return result;
 }
 
-+ (OCTToxEncryptSave *)toxEncryptSaveWithToxPassword:(NSString *)toxPassword
-                                           savedData:(NSData *)savedData
-                                               error:(NSError **)error
-{
-    OCTToxEncryptSave *encryptSave;
-
-    if (savedData && [OCTToxEncryptSave isDataEncrypted:savedData]) {
-        encryptSave = [[OCTToxEncryptSave alloc] initWithPassphrase:toxPassword toxData:savedData error:nil];
-    }
-    else {
-        // Save data wasn't encrypted. Passing nil as toxData parameter to encrypt it next time.
-        encryptSave = [[OCTToxEncryptSave alloc] initWithPassphrase:toxPassword toxData:nil error:nil];
-    }
-
-    if (! encryptSave) {
-        [self fillError:error withInitErrorCode:OCTManagerInitErrorPassphraseFailed];
-        return nil;
-    }
-
-    return encryptSave;
-}
-
 + (NSData *)decryptSavedData:(NSData *)data encryptSave:(OCTToxEncryptSave *)encryptSave error:(NSError **)error
 {
     NSParameterAssert(encryptSave);
@@ -6,7 +6,9 @@
 
 #import "OCTManagerImpl.h"
 #import "OCTTox.h"
+#import "OCTToxEventBatch.h"
 #import "OCTToxEncryptSave.h"
+#import "OCTToxPassKey.h"
 #import "OCTManagerConfiguration.h"
 #import "OCTManagerFactory.h"
 #import "OCTSubmanagerBootstrapImpl.h"
@@ -17,17 +19,24 @@
 #import "OCTSubmanagerObjectsImpl.h"
 #import "OCTSubmanagerUserImpl.h"
 #import "OCTRealmManager.h"
+#import "OCTPresenceStore.h"
+#import "OCTToxSaveScheduler.h"
+#import "OCTLogging.h"
+
+static inline id OCTSelectorKey(SEL selector)
+{
+    return (__bridge id)(void *)selector;
+}
 
 @interface OCTManagerImpl () <OCTToxDelegate, OCTSubmanagerDataSource>
 
 @property (copy, nonatomic, readonly) OCTManagerConfiguration *currentConfiguration;
 
 @property (strong, nonatomic, readonly) OCTTox *tox;
-@property (strong, nonatomic, readonly) NSObject *toxSaveFileLock;
-
-@property (strong, nonatomic, nonnull) OCTToxEncryptSave *encryptSave;
+@property (strong, nonatomic, readonly) OCTToxSaveScheduler *saveScheduler;
 
 @property (strong, nonatomic, readonly) OCTRealmManager *realmManager;
+@property (strong, nonatomic, readwrite) OCTPresenceStore *presence;
 @property (strong, atomic) NSNotificationCenter *notificationCenter;
 
 @property (strong, nonatomic, readwrite) OCTSubmanagerBootstrapImpl *bootstrap;
@@ -38,6 +47,12 @@
 @property (strong, nonatomic, readwrite) OCTSubmanagerObjectsImpl *objects;
 @property (strong, nonatomic, readwrite) OCTSubmanagerUserImpl *user;
 
+/**
+ * OCTToxDelegate selector -> ordered array of submanagers implementing it. Table is immutable once built,
+ * it is replaced as a whole whenever submanagers change.
+ */
+@property (strong, atomic) NSMapTable<id, NSArray *> *toxDelegateTable;
+
 @end
 
 @implementation OCTManagerImpl
@@ -58,25 +73,37 @@
     _currentConfiguration = [configuration copy];
 
     _tox = tox;
-    _tox.delegate = self;
-    _toxSaveFileLock = [NSObject new];
-
-    _encryptSave = toxEncryptSave;
+    _saveScheduler = [[OCTToxSaveScheduler alloc] initWithTox:tox
+                                                  encryptSave:toxEncryptSave
+                                                         path:configuration.fileStorage.pathForToxSaveFile
+                                                   maxLatency:configuration.toxSaveMaxLatency];
 
     _realmManager = realmManager;
     _notificationCenter = [[NSNotificationCenter alloc] init];
+    _presence = [OCTPresenceStore new];
+
+    [_realmManager rebuildSearchIndexIfNeededWithCompletionBlock:nil];
 
     [_tox start];
-    [self saveTox];
+    [self flushToxSave];
 
     [self createSubmanagers];
 
+    // Tox caches delegate capabilities on assignment, so delegate is set once forwarding table is ready.
+    _tox.delegate = self;
+
     return self;
 }
 
 - (void)dealloc
 {
     [self killSubmanagers];
+
+    NSError *error;
+    if (! [self.saveScheduler flushAndReturnError:&error]) {
+        OCTLogError(@"cannot save tox on dealloc %@", error);
+    }
+
     [self.tox stop];
 }
 
@@ -89,23 +116,34 @@
 
 - (NSString *)exportToxSaveFileAndReturnError:(NSError **)error
 {
-    @synchronized(self.toxSaveFileLock) {
-        NSString *savedDataPath = self.currentConfiguration.fileStorage.pathForToxSaveFile;
+    // Exported file should contain latest changes.
+    [self flushToxSave];
+
+    __block NSString *result = nil;
+    __block NSError *copyError = nil;
+
+    [self.saveScheduler accessSaveFile:^(NSString *savedDataPath) {
         NSString *tempPath = self.currentConfiguration.fileStorage.pathForTemporaryFilesDirectory;
         tempPath = [tempPath stringByAppendingPathComponent:[savedDataPath lastPathComponent]];
 
         NSFileManager *fileManager = [NSFileManager defaultManager];
 
         if ([fileManager fileExistsAtPath:tempPath]) {
-            [fileManager removeItemAtPath:tempPath error:error];
+            [fileManager removeItemAtPath:tempPath error:&copyError];
         }
 
-        if (! [fileManager copyItemAtPath:savedDataPath toPath:tempPath error:error]) {
-            return nil;
+        if (! [fileManager copyItemAtPath:savedDataPath toPath:tempPath error:&copyError]) {
+            return;
         }
 
-        return tempPath;
+        result = tempPath;
+    }];
+
+    if (! result && error) {
+        *error = copyError;
     }
+
+    return result;
 }
 
 - (BOOL)changeEncryptPassword:(nonnull NSString *)newPassword oldPassword:(nonnull NSString *)oldPassword
@@ -115,12 +153,13 @@
         return NO;
     }
 
-    if (! [self changeDatabasePassword:newPassword oldPassword:oldPassword]) {
+    if (! [self changeDatabasePasswordToPassKey:encryptSave.passKey oldPassword:oldPassword]) {
         return NO;
     }
 
-    self.encryptSave = encryptSave;
-    [self saveTox];
+    // New encryption forces write even if tox data didn't change.
+    self.saveScheduler.encryptSave = encryptSave;
+    [self flushToxSave];
 
     return YES;
 }
@@ -146,7 +185,7 @@
 
 - (void)managerSaveTox
 {
-    return [self saveTox];
+    [self.saveScheduler setNeedsSave];
 }
 
 - (OCTRealmManager *)managerGetRealmManager
@@ -154,6 +193,11 @@
     return self.realmManager;
 }
 
+- (OCTPresenceStore *)managerGetPresenceStore
+{
+    return self.presence;
+}
+
 - (id<OCTFileStorageProtocol>)managerGetFileStorage
 {
     return self.currentConfiguration.fileStorage;
@@ -169,6 +213,26 @@
     return self.currentConfiguration.useFauxOfflineMessaging;
 }
 
+#pragma mark -  OCTToxDelegate
+
+- (void)tox:(OCTTox *)tox receivedEventBatch:(OCTToxEventBatch *)batch
+{
+    // Friend lookup may call tox, so friends are resolved before write lock is taken.
+    // Lookups made by submanagers inside of batch use tox cache and database only.
+    [batch.friendNumbers enumerateIndexesUsingBlock:^(NSUInteger friendNumber, BOOL *stop) {
+        [self.realmManager friendWithFriendNumber:(OCTToxFriendNumber)friendNumber tox:tox];
+    }];
+
+    // Events are forwarded to submanagers, all database changes they make are committed at once.
+    [self.realmManager performBatchUpdates:^{
+        [batch deliverToDelegate:self callingTox:NO];
+    }];
+
+    // File transfers and friend connection changes call tox back and wait for its thread,
+    // which may wait for write lock in turn. They commit their own changes.
+    [batch deliverToDelegate:self callingTox:YES];
+}
+
 #pragma mark -  Private
 
 - (NSData *)getSavedDataFromPath:(NSString *)path
@@ -186,11 +250,14 @@
         return NO;
     }
 
-    if ([OCTToxEncryptSave isDataEncrypted:savedData]) {
-        return [OCTToxEncryptSave decryptData:savedData withPassphrase:password error:nil] != nil;
+    if (! [OCTToxEncryptSave isDataEncrypted:savedData]) {
+        return NO;
     }
 
-    return NO;
+    // Key for the right password is usually alive and already verified, so neither derivation nor decryption is needed.
+    OCTToxPassKey *passKey = [OCTToxPassKey passKeyWithPassphrase:password forEncryptedData:savedData error:nil];
+
+    return [passKey verifyEncryptedData:savedData];
 }
 
 - (void)createSubmanagers
@@ -206,17 +273,21 @@
     calls.dataSource = self;
     _calls = calls;
     [_calls setupAndReturnError:nil];
+
+    [self rebuildToxDelegateTable];
 }
 
 - (void)killSubmanagers
 {
-    self.bootstrap = nil;
-    self.calls = nil;
-    self.chats = nil;
-    self.files = nil;
-    self.friends = nil;
-    self.objects = nil;
-    self.user = nil;
+    _bootstrap = nil;
+    _calls = nil;
+    _chats = nil;
+    _files = nil;
+    _friends = nil;
+    _objects = nil;
+    _user = nil;
+
+    self.toxDelegateTable = nil;
 }
 
 - (id)createSubmanagerWithClass:(Class)class
@@ -231,11 +302,92 @@
     return submanager;
 }
 
-- (BOOL)respondsToSelector:(SEL)aSelector
+- (void)setBootstrap:(OCTSubmanagerBootstrapImpl *)bootstrap
+{
+    _bootstrap = bootstrap;
+    [self rebuildToxDelegateTable];
+}
+
+- (void)setChats:(OCTSubmanagerChatsImpl *)chats
+{
+    _chats = chats;
+    [self rebuildToxDelegateTable];
+}
+
+- (void)setFiles:(OCTSubmanagerFilesImpl *)files
+{
+    _files = files;
+    [self rebuildToxDelegateTable];
+}
+
+- (void)setFriends:(OCTSubmanagerFriendsImpl *)friends
+{
+    _friends = friends;
+    [self rebuildToxDelegateTable];
+}
+
+- (void)setObjects:(OCTSubmanagerObjectsImpl *)objects
+{
+    _objects = objects;
+    [self rebuildToxDelegateTable];
+}
+
+- (void)setUser:(OCTSubmanagerUserImpl *)user
 {
-    id submanager = [self forwardingTargetForSelector:aSelector];
+    _user = user;
+    [self rebuildToxDelegateTable];
+}
+
+- (void)rebuildToxDelegateTable
+{
+    id candidates[] = { _bootstrap, _chats, _files, _friends, _objects, _user };
+    NSMutableOrderedSet *submanagers = [NSMutableOrderedSet new];
+
+    for (NSUInteger i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+        if (candidates[i]) {
+            [submanagers addObject:candidates[i]];
+        }
+    }
+
+    NSMapTable *table = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality
+                                              valueOptions:NSPointerFunctionsStrongMemory];
+
+    unsigned int count = 0;
+    struct objc_method_description *descriptions = protocol_copyMethodDescriptionList(@protocol(OCTToxDelegate), NO, YES, &count);
+
+    for (unsigned int i = 0; i < count; i++) {
+        SEL selector = descriptions[i].name;
+        NSMutableArray *targets = [NSMutableArray new];
+
+        for (id submanager in submanagers) {
+            if ([submanager respondsToSelector:selector]) {
+                [targets addObject:submanager];
+            }
+        }
+
+        if (targets.count) {
+            [table setObject:[targets copy] forKey:OCTSelectorKey(selector)];
+        }
+    }
+
+    free(descriptions);
+
+    self.toxDelegateTable = table;
 
-    if (submanager) {
+    // Refreshing capabilities cached by tox. Delegate is nil while manager is being initialized or deallocated.
+    if (_tox.delegate == self) {
+        _tox.delegate = self;
+    }
+}
+
+- (NSArray *)toxDelegateTargetsForSelector:(SEL)aSelector
+{
+    return [self.toxDelegateTable objectForKey:OCTSelectorKey(aSelector)];
+}
+
+- (BOOL)respondsToSelector:(SEL)aSelector
+{
+    if ([self toxDelegateTargetsForSelector:aSelector]) {
         return YES;
     }
 
@@ -244,57 +396,53 @@
 
 - (id)forwardingTargetForSelector:(SEL)aSelector
 {
-    struct objc_method_description description = protocol_getMethodDescription(@protocol(OCTToxDelegate), aSelector, NO, YES);
+    NSArray *targets = [self toxDelegateTargetsForSelector:aSelector];
 
-    if (description.name == NULL) {
-        // We forward methods only from OCTToxDelegate protocol.
-        return nil;
-    }
-
-    NSArray *submanagers = @[
-        self.bootstrap,
-        self.chats,
-        self.files,
-        self.friends,
-        self.objects,
-        self.user,
-    ];
-
-    for (id delegate in submanagers) {
-        if ([delegate respondsToSelector:aSelector]) {
-            return delegate;
-        }
+    // Selectors implemented by several submanagers go through forwardInvocation: and are multicasted.
+    if (targets.count == 1) {
+        return targets.firstObject;
     }
 
     return nil;
 }
 
-- (void)saveTox
+- (NSMethodSignature *)methodSignatureForSelector:(SEL)aSelector
 {
-    @synchronized(self.toxSaveFileLock) {
-        void (^throwException)(NSError *) = ^(NSError *error) {
-            NSDictionary *userInfo = nil;
+    NSArray *targets = [self toxDelegateTargetsForSelector:aSelector];
 
-            if (error) {
-                userInfo = @{ @"NSError" : error };
-            }
+    if (targets.count) {
+        return [targets.firstObject methodSignatureForSelector:aSelector];
+    }
 
-            @throw [NSException exceptionWithName:@"saveToxException" reason:error.debugDescription userInfo:userInfo];
-        };
+    return [super methodSignatureForSelector:aSelector];
+}
 
-        NSData *data = [self.tox save];
+- (void)forwardInvocation:(NSInvocation *)anInvocation
+{
+    NSArray *targets = [self toxDelegateTargetsForSelector:anInvocation.selector];
 
-        NSError *error;
+    if (! targets.count) {
+        [super forwardInvocation:anInvocation];
+        return;
+    }
 
-        data = [self.encryptSave encryptData:data error:&error];
+    for (id target in targets) {
+        [anInvocation invokeWithTarget:target];
+    }
+}
 
-        if (! data) {
-            throwException(error);
-        }
+- (void)flushToxSave
+{
+    NSError *error;
 
-        if (! [data writeToFile:self.currentConfiguration.fileStorage.pathForToxSaveFile options:NSDataWritingAtomic error:&error]) {
-            throwException(error);
+    if (! [self.saveScheduler flushAndReturnError:&error]) {
+        NSDictionary *userInfo = nil;
+
+        if (error) {
+            userInfo = @{ @"NSError" : error };
         }
+
+        @throw [NSException exceptionWithName:@"saveToxException" reason:error.debugDescription userInfo:userInfo];
     }
 }
 
@@ -307,19 +455,14 @@
         return nil;
     }
 
-    __block OCTToxEncryptSave *newEncryptSave;
-
-    @synchronized(self.toxSaveFileLock) {
-        // Passing nil as tox data as we are setting new password.
-        newEncryptSave = [[OCTToxEncryptSave alloc] initWithPassphrase:newPassword toxData:nil error:nil];
-    }
-
-    return newEncryptSave;
+    // Passing nil as tox data as we are setting new password.
+    return [[OCTToxEncryptSave alloc] initWithPassphrase:newPassword toxData:nil error:nil];
 }
 
-- (BOOL)changeDatabasePassword:(NSString *)newPassword oldPassword:(NSString *)oldPassword
+// Database key is encrypted with the same key as tox save.
+- (BOOL)changeDatabasePasswordToPassKey:(OCTToxPassKey *)newPassKey oldPassword:(NSString *)oldPassword
 {
-    NSParameterAssert(newPassword);
+    NSParameterAssert(newPassKey);
     NSParameterAssert(oldPassword);
 
     NSString *encryptedKeyPath = self.currentConfiguration.fileStorage.pathForDatabaseEncryptionKey;
@@ -329,13 +472,14 @@
         return NO;
     }
 
-    NSData *key = [OCTToxEncryptSave decryptData:encryptedKey withPassphrase:oldPassword error:nil];
+    OCTToxPassKey *oldPassKey = [OCTToxPassKey passKeyWithPassphrase:oldPassword forEncryptedData:encryptedKey error:nil];
+    NSData *key = [oldPassKey decryptData:encryptedKey error:nil];
 
     if (! key) {
         return NO;
     }
 
-    NSData *newEncryptedKey = [OCTToxEncryptSave encryptData:key withPassphrase:newPassword error:nil];
+    NSData *newEncryptedKey = [newPassKey encryptData:key error:nil];
 
     if (! newEncryptedKey) {
         return NO;
@@ -0,0 +1,36 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import "OCTPresenceStore.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Store is keyed by friend number, it is updated by submanagers from tox callbacks.
+ */
+@interface OCTPresenceStore (Private)
+
+/**
+ * Friend going offline stops typing as well.
+ */
+- (void)setConnectionStatus:(OCTToxConnectionStatus)connectionStatus forFriendNumber:(OCTToxFriendNumber)friendNumber;
+
+- (void)setIsTyping:(BOOL)isTyping forFriendNumber:(OCTToxFriendNumber)friendNumber;
+
+/**
+ * Should be called when friend is removed, friend number may be reused for new friend.
+ */
+- (void)removeFriendNumber:(OCTToxFriendNumber)friendNumber;
+
+- (OCTToxConnectionStatus)connectionStatusForFriendNumber:(OCTToxFriendNumber)friendNumber;
+
+- (BOOL)isFriendNumberConnected:(OCTToxFriendNumber)friendNumber;
+
+- (BOOL)isFriendNumberTyping:(OCTToxFriendNumber)friendNumber;
+
+- (NSArray<NSNumber *> *)connectedFriendNumbers;
+
+@end
+
+NS_ASSUME_NONNULL_END
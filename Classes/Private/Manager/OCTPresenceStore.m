@@ -0,0 +1,209 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import "OCTPresenceStore+Private.h"
+#import "OCTFriend.h"
+
+@interface OCTFriendPresence ()
+
+@property (assign, nonatomic, readwrite) OCTToxConnectionStatus connectionStatus;
+@property (assign, nonatomic, readwrite) BOOL isTyping;
+
+@end
+
+@implementation OCTFriendPresence
+
++ (NSSet<NSString *> *)keyPathsForValuesAffectingIsConnected
+{
+    return [NSSet setWithObject:NSStringFromSelector(@selector(connectionStatus))];
+}
+
+- (BOOL)isConnected
+{
+    return (self.connectionStatus != OCTToxConnectionStatusNone);
+}
+
+@end
+
+@interface OCTPresenceStore ()
+
+// Guarded by @synchronized(self). Offline friends have no status stored.
+@property (strong, nonatomic, readonly) NSMutableDictionary<NSNumber *, NSNumber *> *connectionStatuses;
+@property (strong, nonatomic, readonly) NSMutableSet<NSNumber *> *typingFriendNumbers;
+
+// Accessed on main thread only.
+@property (strong, nonatomic, readonly) NSMutableDictionary<NSNumber *, OCTFriendPresence *> *presences;
+
+@end
+
+@implementation OCTPresenceStore
+
+#pragma mark -  Lifecycle
+
+- (instancetype)init
+{
+    self = [super init];
+
+    if (! self) {
+        return nil;
+    }
+
+    _connectionStatuses = [NSMutableDictionary new];
+    _typingFriendNumbers = [NSMutableSet new];
+    _presences = [NSMutableDictionary new];
+
+    return self;
+}
+
+#pragma mark -  Public
+
+- (OCTToxConnectionStatus)connectionStatusOfFriend:(OCTFriend *)friend
+{
+    NSParameterAssert(friend);
+
+    return [self connectionStatusForFriendNumber:friend.friendNumber];
+}
+
+- (BOOL)isFriendConnected:(OCTFriend *)friend
+{
+    NSParameterAssert(friend);
+
+    return [self isFriendNumberConnected:friend.friendNumber];
+}
+
+- (BOOL)isFriendTyping:(OCTFriend *)friend
+{
+    NSParameterAssert(friend);
+
+    return [self isFriendNumberTyping:friend.friendNumber];
+}
+
+- (OCTFriendPresence *)presenceOfFriend:(OCTFriend *)friend
+{
+    NSParameterAssert(friend);
+    NSAssert([NSThread isMainThread], @"Presence should be requested on main thread");
+
+    NSNumber *key = @(friend.friendNumber);
+    OCTFriendPresence *presence = self.presences[key];
+
+    if (! presence) {
+        presence = [OCTFriendPresence new];
+        presence.connectionStatus = [self connectionStatusForFriendNumber:friend.friendNumber];
+        presence.isTyping = [self isFriendNumberTyping:friend.friendNumber];
+
+        self.presences[key] = presence;
+    }
+
+    return presence;
+}
+
+#pragma mark -  Private category
+
+- (void)setConnectionStatus:(OCTToxConnectionStatus)connectionStatus forFriendNumber:(OCTToxFriendNumber)friendNumber
+{
+    @synchronized(self) {
+        if (connectionStatus == OCTToxConnectionStatusNone) {
+            [self.connectionStatuses removeObjectForKey:@(friendNumber)];
+            [self.typingFriendNumbers removeObject:@(friendNumber)];
+        }
+        else {
+            self.connectionStatuses[@(friendNumber)] = @(connectionStatus);
+        }
+    }
+
+    [self updatePresenceOfFriendNumber:friendNumber];
+}
+
+- (void)setIsTyping:(BOOL)isTyping forFriendNumber:(OCTToxFriendNumber)friendNumber
+{
+    @synchronized(self) {
+        if (isTyping) {
+            [self.typingFriendNumbers addObject:@(friendNumber)];
+        }
+        else {
+            [self.typingFriendNumbers removeObject:@(friendNumber)];
+        }
+    }
+
+    [self updatePresenceOfFriendNumber:friendNumber];
+}
+
+- (void)removeFriendNumber:(OCTToxFriendNumber)friendNumber
+{
+    [self setConnectionStatus:OCTToxConnectionStatusNone forFriendNumber:friendNumber];
+
+    // Observers get offline update first, friend number reused later gets new presence object.
+    dispatch_block_t remove = ^{
+        [self.presences removeObjectForKey:@(friendNumber)];
+    };
+
+    if ([NSThread isMainThread]) {
+        remove();
+    }
+    else {
+        dispatch_async(dispatch_get_main_queue(), remove);
+    }
+}
+
+- (OCTToxConnectionStatus)connectionStatusForFriendNumber:(OCTToxFriendNumber)friendNumber
+{
+    @synchronized(self) {
+        NSNumber *status = self.connectionStatuses[@(friendNumber)];
+
+        return status ? (OCTToxConnectionStatus)status.integerValue : OCTToxConnectionStatusNone;
+    }
+}
+
+- (BOOL)isFriendNumberConnected:(OCTToxFriendNumber)friendNumber
+{
+    return ([self connectionStatusForFriendNumber:friendNumber] != OCTToxConnectionStatusNone);
+}
+
+- (BOOL)isFriendNumberTyping:(OCTToxFriendNumber)friendNumber
+{
+    @synchronized(self) {
+        return [self.typingFriendNumbers containsObject:@(friendNumber)];
+    }
+}
+
+- (NSArray<NSNumber *> *)connectedFriendNumbers
+{
+    @synchronized(self) {
+        return [self.connectionStatuses allKeys];
+    }
+}
+
+#pragma mark -  Private
+
+- (void)updatePresenceOfFriendNumber:(OCTToxFriendNumber)friendNumber
+{
+    dispatch_block_t update = ^{
+        OCTFriendPresence *presence = self.presences[@(friendNumber)];
+
+        if (! presence) {
+            return;
+        }
+
+        // Reading latest state, updates coming from other thread may be coalesced.
+        OCTToxConnectionStatus connectionStatus = [self connectionStatusForFriendNumber:friendNumber];
+        BOOL isTyping = [self isFriendNumberTyping:friendNumber];
+
+        if (presence.connectionStatus != connectionStatus) {
+            presence.connectionStatus = connectionStatus;
+        }
+
+        if (presence.isTyping != isTyping) {
+            presence.isTyping = isTyping;
+        }
+    };
+
+    if ([NSThread isMainThread]) {
+        update();
+    }
+    else {
+        dispatch_async(dispatch_get_main_queue(), update);
+    }
+}
+
+@end
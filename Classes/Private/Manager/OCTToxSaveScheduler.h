@@ -0,0 +1,83 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class OCTTox;
+@class OCTToxEncryptSave;
+
+/**
+ * Writes encrypted tox save file off the calling thread.
+ *
+ * Save requests only mark state as dirty, all requests made within maxLatency are coalesced into single write
+ * performed on background queue. Write is skipped if tox data didn't change since last one.
+ * Pending save is flushed when application goes to background and when scheduler is deallocated.
+ */
+@interface OCTToxSaveScheduler : NSObject
+
+/**
+ * Encryption used for save file. Setting new one forces next save to be written even if tox data didn't change.
+ */
+@property (strong, atomic) OCTToxEncryptSave *encryptSave;
+
+/**
+ * Maximum time between save request and write.
+ */
+@property (assign, nonatomic, readonly) NSTimeInterval maxLatency;
+
+/**
+ * Number of setNeedsSave and flush calls.
+ */
+@property (assign, nonatomic, readonly) NSUInteger savesRequestedCount;
+
+/**
+ * Number of times save file was actually written.
+ */
+@property (assign, nonatomic, readonly) NSUInteger savesPerformedCount;
+
+/**
+ * Number of saves skipped because tox data didn't change.
+ */
+@property (assign, nonatomic, readonly) NSUInteger savesSkippedCount;
+
+/**
+ * @param tox Tox to save.
+ * @param encryptSave Encryption to use.
+ * @param path Path to save file.
+ * @param maxLatency Maximum time between save request and write.
+ */
+- (instancetype)initWithTox:(OCTTox *)tox
+                encryptSave:(OCTToxEncryptSave *)encryptSave
+                       path:(NSString *)path
+                 maxLatency:(NSTimeInterval)maxLatency NS_DESIGNATED_INITIALIZER;
+
+/**
+ * Marks tox state as changed. Returns immediately, can be called from any thread.
+ */
+- (void)setNeedsSave;
+
+/**
+ * Saves tox state right away and waits for write to finish.
+ *
+ * @param error If an error occurs, this pointer is set to an actual error object.
+ *
+ * @return YES on success (including skipped write), NO on failure.
+ */
+- (BOOL)flushAndReturnError:(NSError **)error;
+
+/**
+ * Executes block while no write is in progress.
+ *
+ * @param block Block to execute, is called synchronously.
+ */
+- (void)accessSaveFile:(void (^)(NSString *path))block;
+
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,250 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <CommonCrypto/CommonDigest.h>
+#import <stdatomic.h>
+
+#import "TargetConditionals.h"
+
+#import "OCTToxSaveScheduler.h"
+#import "OCTTox.h"
+#import "OCTToxEncryptSave.h"
+#import "OCTLogging.h"
+
+// Values of UIApplicationDidEnterBackgroundNotification and NSApplicationWillTerminateNotification,
+// spelled out to avoid linking UIKit/AppKit.
+#if TARGET_OS_IPHONE
+static NSString *const kFlushNotificationName = @"UIApplicationDidEnterBackgroundNotification";
+#else
+static NSString *const kFlushNotificationName = @"NSApplicationWillTerminateNotification";
+#endif
+
+@interface OCTToxSaveScheduler () {
+    atomic_bool _dirty;
+    // Snapshots are numbered in the order they were started, older snapshot never overwrites newer one.
+    atomic_uint_fast64_t _snapshotNumber;
+
+    atomic_uint_fast64_t _savesRequestedCount;
+    atomic_uint_fast64_t _savesPerformedCount;
+    atomic_uint_fast64_t _savesSkippedCount;
+}
+
+@property (strong, nonatomic, readonly) OCTTox *tox;
+@property (copy, nonatomic, readonly) NSString *path;
+@property (strong, nonatomic, readonly) dispatch_queue_t queue;
+
+// Accessed on queue only.
+@property (assign, nonatomic) uint64_t writtenSnapshotNumber;
+@property (strong, nonatomic) NSData *writtenHash;
+@property (strong, nonatomic) OCTToxEncryptSave *writtenEncryptSave;
+
+@end
+
+@implementation OCTToxSaveScheduler
+
+#pragma mark -  Lifecycle
+
+- (instancetype)initWithTox:(OCTTox *)tox
+                encryptSave:(OCTToxEncryptSave *)encryptSave
+                       path:(NSString *)path
+                 maxLatency:(NSTimeInterval)maxLatency
+{
+    NSParameterAssert(tox);
+    NSParameterAssert(encryptSave);
+    NSParameterAssert(path);
+
+    self = [super init];
+
+    if (! self) {
+        return nil;
+    }
+
+    _tox = tox;
+    _encryptSave = encryptSave;
+    _path = [path copy];
+    _maxLatency = maxLatency;
+    _queue = dispatch_queue_create("me.dvor.objcTox.OCTToxSaveScheduler", DISPATCH_QUEUE_SERIAL);
+
+    atomic_init(&_dirty, false);
+    atomic_init(&_snapshotNumber, 0);
+    atomic_init(&_savesRequestedCount, 0);
+    atomic_init(&_savesPerformedCount, 0);
+    atomic_init(&_savesSkippedCount, 0);
+
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(applicationWillStopNotification:)
+                                                 name:kFlushNotificationName
+                                               object:nil];
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+
+    // Last reference may be released on our own queue, writing directly.
+    if (atomic_exchange(&_dirty, false)) {
+        NSError *error;
+        uint64_t number;
+        NSData *data = [self takeSnapshotWithNumber:&number];
+
+        if (! [self writeSnapshot:data number:number error:&error]) {
+            OCTLogError(@"cannot save tox on dealloc %@", error);
+        }
+    }
+}
+
+#pragma mark -  Properties
+
+- (NSUInteger)savesRequestedCount
+{
+    return (NSUInteger)atomic_load_explicit(&_savesRequestedCount, memory_order_relaxed);
+}
+
+- (NSUInteger)savesPerformedCount
+{
+    return (NSUInteger)atomic_load_explicit(&_savesPerformedCount, memory_order_relaxed);
+}
+
+- (NSUInteger)savesSkippedCount
+{
+    return (NSUInteger)atomic_load_explicit(&_savesSkippedCount, memory_order_relaxed);
+}
+
+#pragma mark -  Public
+
+- (void)setNeedsSave
+{
+    atomic_fetch_add_explicit(&_savesRequestedCount, 1, memory_order_relaxed);
+
+    if (atomic_exchange(&_dirty, true)) {
+        // Save is already scheduled.
+        return;
+    }
+
+    __weak OCTToxSaveScheduler *weakSelf = self;
+    dispatch_time_t time = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.maxLatency * NSEC_PER_SEC));
+
+    dispatch_after(time, self.queue, ^{
+        [weakSelf saveIfNeeded];
+    });
+}
+
+- (BOOL)flushAndReturnError:(NSError **)error
+{
+    atomic_fetch_add_explicit(&_savesRequestedCount, 1, memory_order_relaxed);
+    atomic_store(&_dirty, false);
+
+    // Snapshot is taken on calling thread, tox may be iterated on it.
+    uint64_t number;
+    NSData *data = [self takeSnapshotWithNumber:&number];
+
+    __block BOOL result;
+    __block NSError *writeError;
+
+    dispatch_sync(self.queue, ^{
+        result = [self writeSnapshot:data number:number error:&writeError];
+    });
+
+    if (! result && error) {
+        *error = writeError;
+    }
+
+    return result;
+}
+
+- (void)accessSaveFile:(void (^)(NSString *path))block
+{
+    NSParameterAssert(block);
+
+    dispatch_sync(self.queue, ^{
+        block(self.path);
+    });
+}
+
+#pragma mark -  Notifications
+
+- (void)applicationWillStopNotification:(NSNotification *)notification
+{
+    if (! atomic_load(&_dirty)) {
+        return;
+    }
+
+    NSError *error;
+    if (! [self flushAndReturnError:&error]) {
+        OCTLogError(@"cannot flush tox save %@", error);
+    }
+}
+
+#pragma mark -  Private
+
+- (void)saveIfNeeded
+{
+    // Flush may have already saved everything.
+    if (! atomic_exchange(&_dirty, false)) {
+        return;
+    }
+
+    NSError *error;
+    uint64_t number;
+    NSData *data = [self takeSnapshotWithNumber:&number];
+
+    if (! [self writeSnapshot:data number:number error:&error]) {
+        OCTLogError(@"cannot save tox %@", error);
+    }
+}
+
+- (NSData *)takeSnapshotWithNumber:(uint64_t *)number
+{
+    *number = atomic_fetch_add(&_snapshotNumber, 1) + 1;
+
+    return [self.tox save];
+}
+
+// Called on queue, or in dealloc when nothing else can access it.
+- (BOOL)writeSnapshot:(NSData *)data number:(uint64_t)number error:(NSError **)error
+{
+    if (number < self.writtenSnapshotNumber) {
+        // Newer snapshot is already written.
+        atomic_fetch_add_explicit(&_savesSkippedCount, 1, memory_order_relaxed);
+        return YES;
+    }
+
+    NSData *hash = [self hashOfData:data];
+    OCTToxEncryptSave *encryptSave = self.encryptSave;
+
+    if ([hash isEqualToData:self.writtenHash] && (encryptSave == self.writtenEncryptSave)) {
+        self.writtenSnapshotNumber = number;
+        atomic_fetch_add_explicit(&_savesSkippedCount, 1, memory_order_relaxed);
+        return YES;
+    }
+
+    NSData *encrypted = [encryptSave encryptData:data error:error];
+
+    if (! encrypted) {
+        return NO;
+    }
+
+    if (! [encrypted writeToFile:self.path options:NSDataWritingAtomic error:error]) {
+        return NO;
+    }
+
+    self.writtenSnapshotNumber = number;
+    self.writtenHash = hash;
+    self.writtenEncryptSave = encryptSave;
+    atomic_fetch_add_explicit(&_savesPerformedCount, 1, memory_order_relaxed);
+
+    return YES;
+}
+
+- (NSData *)hashOfData:(NSData *)data
+{
+    NSMutableData *hash = [NSMutableData dataWithLength:CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256(data.bytes, (CC_LONG)data.length, hash.mutableBytes);
+
+    return hash;
+}
+
+@end
@@ -22,6 +22,13 @@
     return [properties copy];
 }
 
++ (NSArray *)indexedProperties
+{
+    return @[
+        NSStringFromSelector(@selector(publicKey)),
+    ];
+}
+
 #pragma mark -  Public
 
 - (NSDate *)lastSeenOnline
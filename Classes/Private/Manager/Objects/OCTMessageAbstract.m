@@ -6,13 +6,34 @@
 #import "OCTMessageText.h"
 #import "OCTMessageFile.h"
 #import "OCTMessageCall.h"
+#import "OCTMessageSearchEntry.h"
 
 @interface OCTMessageAbstract ()
 
+/**
+ * Search index entries of message, see OCTMessageSearchIndex.
+ */
+@property (readonly) RLMLinkingObjects *searchEntries;
+
 @end
 
 @implementation OCTMessageAbstract
 
+#pragma mark -  Class methods
+
++ (NSArray *)indexedProperties
+{
+    return @[NSStringFromSelector(@selector(chatUniqueIdentifier))];
+}
+
++ (NSDictionary *)linkingObjectsProperties
+{
+    return @{
+        NSStringFromSelector(@selector(searchEntries)) : [RLMPropertyDescriptor descriptorWithClass:[OCTMessageSearchEntry class]
+                                                                                       propertyName:@"message"],
+    };
+}
+
 #pragma mark -  Public
 
 - (NSDate *)date
@@ -10,6 +10,13 @@
 
 @implementation OCTMessageFile
 
+#pragma mark -  Class methods
+
++ (NSArray *)indexedProperties
+{
+    return @[NSStringFromSelector(@selector(internalFilePath))];
+}
+
 #pragma mark -  Public
 
 - (nullable NSString *)filePath
@@ -0,0 +1,22 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Realm/Realm.h>
+
+/**
+ * Outgoing text message that wasn't passed to toxcore yet, see OCTMessageOutbox. Entry is added in the same
+ * write transaction as message and removed once toxcore accepts message.
+ */
+@interface OCTMessageOutboxEntry : RLMObject
+
+@property NSString *messageUniqueIdentifier;
+
+@property NSString *friendUniqueIdentifier;
+
+/**
+ * Entries are restored in order they were added.
+ */
+@property NSTimeInterval dateInterval;
+
+@end
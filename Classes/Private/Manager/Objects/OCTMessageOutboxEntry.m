@@ -0,0 +1,24 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import "OCTMessageOutboxEntry.h"
+
+@implementation OCTMessageOutboxEntry
+
+#pragma mark -  Class methods
+
++ (NSString *)primaryKey
+{
+    return NSStringFromSelector(@selector(messageUniqueIdentifier));
+}
+
++ (NSArray *)requiredProperties
+{
+    return @[
+        NSStringFromSelector(@selector(messageUniqueIdentifier)),
+        NSStringFromSelector(@selector(friendUniqueIdentifier)),
+    ];
+}
+
+@end
@@ -0,0 +1,27 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Realm/Realm.h>
+
+@class OCTMessageAbstract;
+
+/**
+ * Entry of message search index: text of message contains token.
+ */
+@interface OCTMessageSearchEntry : RLMObject
+
+/**
+ * Normalized word, see OCTMessageSearchIndex.
+ */
+@property NSString *token;
+
+/**
+ * Message containing token. Messages link back to their entries with "searchEntries" property,
+ * so search is run as a query on messages.
+ */
+@property OCTMessageAbstract *message;
+
+@property NSString *chatUniqueIdentifier;
+
+@end
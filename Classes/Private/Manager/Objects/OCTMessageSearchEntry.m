@@ -0,0 +1,28 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import "OCTMessageSearchEntry.h"
+#import "OCTMessageAbstract.h"
+
+@implementation OCTMessageSearchEntry
+
+#pragma mark -  Class methods
+
++ (NSArray *)requiredProperties
+{
+    return @[
+        NSStringFromSelector(@selector(token)),
+        NSStringFromSelector(@selector(chatUniqueIdentifier)),
+    ];
+}
+
++ (NSArray *)indexedProperties
+{
+    return @[
+        NSStringFromSelector(@selector(token)),
+        NSStringFromSelector(@selector(chatUniqueIdentifier)),
+    ];
+}
+
+@end
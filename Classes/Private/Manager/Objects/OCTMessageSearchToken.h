@@ -0,0 +1,15 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Realm/Realm.h>
+
+/**
+ * Distinct token of message search index. Prefix queries are resolved against these objects,
+ * which are far fewer than index entries.
+ */
+@interface OCTMessageSearchToken : RLMObject
+
+@property NSString *token;
+
+@end
@@ -8,6 +8,11 @@
 
 @property BOOL bootstrapDidConnect;
 
+/**
+ * Set once messages added before search index was introduced are indexed.
+ */
+@property BOOL messageSearchIndexBuilt;
+
 /**
  * UIImage with avatar of user.
  */
@@ -11,6 +11,7 @@
     NSMutableDictionary *dict = [NSMutableDictionary dictionaryWithDictionary:[super defaultPropertyValues]];
 
     dict[@"bootstrapDidConnect"] = @NO;
+    dict[@"messageSearchIndexBuilt"] = @NO;
     return [dict copy];
 }
 
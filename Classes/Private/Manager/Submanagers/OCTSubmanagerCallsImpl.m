@@ -288,8 +288,7 @@ const OCTToxAVVideoBitRate kDefaultVideoBitRate = 2500;
 {
     OCTRealmManager *realmManager = [self.dataSource managerGetRealmManager];
 
-    NSString *publicKey = [[self.dataSource managerGetTox] publicKeyFromFriendNumber:friendNumber error:nil];
-    OCTFriend *friend = [realmManager friendWithPublicKey:publicKey];
+    OCTFriend *friend = [realmManager friendWithFriendNumber:friendNumber tox:[self.dataSource managerGetTox]];
     OCTChat *chat = [realmManager getOrCreateChatWithFriend:friend];
 
     return [realmManager getCurrentCallForChat:chat];
@@ -447,16 +446,26 @@ const OCTToxAVVideoBitRate kDefaultVideoBitRate = 2500;
         [self.videoEngine stopSendingVideo];
         [self.timer stopTimer];
     }
+
+    // Audio/video frames need strict iteration cadence, otherwise wakeups may be coalesced.
+    [self.dataSource managerGetTox].runLoop.profile = start ? OCTToxRunLoopProfileLowLatency : OCTToxRunLoopProfileLowPower;
 }
 
 #pragma mark OCTToxAV delegate methods
 
 - (void)toxAV:(OCTToxAV *)toxAV receiveCallAudioEnabled:(BOOL)audio videoEnabled:(BOOL)video friendNumber:(OCTToxFriendNumber)friendNumber
 {
+    // Call objects are passed to delegate and engines are driven from main thread.
+    if (! [NSThread isMainThread]) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self toxAV:toxAV receiveCallAudioEnabled:audio videoEnabled:video friendNumber:friendNumber];
+        });
+        return;
+    }
+
     OCTRealmManager *realmManager = [self.dataSource managerGetRealmManager];
 
-    NSString *publicKey = [[self.dataSource managerGetTox] publicKeyFromFriendNumber:friendNumber error:nil];
-    OCTFriend *friend = [realmManager friendWithPublicKey:publicKey];
+    OCTFriend *friend = [realmManager friendWithFriendNumber:friendNumber tox:[self.dataSource managerGetTox]];
     OCTCall *call = [self createCallWithFriend:friend status:OCTCallStatusRinging];
 
     [realmManager updateObject:call withBlock:^(OCTCall *callToUpdate) {
@@ -475,6 +484,13 @@ const OCTToxAVVideoBitRate kDefaultVideoBitRate = 2500;
 
 - (void)toxAV:(OCTToxAV *)toxAV callStateChanged:(OCTToxAVCallState)state friendNumber:(OCTToxFriendNumber)friendNumber
 {
+    if (! [NSThread isMainThread]) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self toxAV:toxAV callStateChanged:state friendNumber:friendNumber];
+        });
+        return;
+    }
+
     OCTCall *call = [self getCurrentCallForFriendNumber:friendNumber];
 
     if ((state & OCTToxAVFriendCallStateFinished) || (state & OCTToxAVFriendCallStateError)) {
@@ -9,16 +9,28 @@
 #import "OCTMessageText.h"
 #import "OCTChat.h"
 #import "OCTLogging.h"
-#import "OCTSendMessageOperation.h"
+#import "OCTMessageOutbox.h"
+#import "OCTPresenceStore+Private.h"
+#import "OCTMessageCursor+Private.h"
+
+static NSNumber *pendingReceiptKey(OCTToxFriendNumber friendNumber, OCTToxMessageId messageId)
+{
+    return @(((uint64_t)friendNumber << 32) | messageId);
+}
 
 @interface OCTSubmanagerChatsImpl ()
 
-@property (strong, nonatomic, readonly) NSOperationQueue *sendMessageQueue;
+@property (strong, nonatomic) OCTMessageOutbox *outbox;
+
+// Messages sent during this session waiting for read receipt, (friendNumber, messageId) key to uniqueIdentifier
+// of OCTMessageAbstract. Guarded by @synchronized(pendingReceipts), receipts may come on delegate queue.
+@property (strong, nonatomic, readonly) NSMutableDictionary<NSNumber *, NSString *> *pendingReceipts;
 
 @end
 
 @implementation OCTSubmanagerChatsImpl
 @synthesize dataSource = _dataSource;
+@synthesize delegate = _delegate;
 
 - (instancetype)init
 {
@@ -28,8 +40,7 @@
         return nil;
     }
 
-    _sendMessageQueue = [NSOperationQueue new];
-    _sendMessageQueue.maxConcurrentOperationCount = 1;
+    _pendingReceipts = [NSMutableDictionary new];
 
     return self;
 }
@@ -45,6 +56,28 @@
                                                      selector:@selector(friendConnectionStatusChangeNotification:)
                                                          name:kOCTFriendConnectionStatusChangeNotification
                                                        object:nil];
+    [self.dataSource.managerGetNotificationCenter addObserver:self
+                                                     selector:@selector(friendWasRemovedNotification:)
+                                                         name:kOCTFriendWasRemovedNotification
+                                                       object:nil];
+
+    self.outbox = [[OCTMessageOutbox alloc] initWithTox:[self.dataSource managerGetTox]
+                                           realmManager:[self.dataSource managerGetRealmManager]];
+
+    __weak OCTSubmanagerChatsImpl *weakSelf = self;
+    self.outbox.sentBlock = ^(NSString *messageUniqueIdentifier, OCTToxFriendNumber friendNumber, OCTToxMessageId messageId) {
+        [weakSelf addPendingReceiptForMessage:messageUniqueIdentifier friendNumber:friendNumber messageId:messageId];
+    };
+    self.outbox.failedBlock = ^(NSString *messageUniqueIdentifier, OCTToxFriendNumber friendNumber, NSError *error) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            OCTSubmanagerChatsImpl *strongSelf = weakSelf;
+            [strongSelf.delegate submanagerChats:strongSelf
+                failedToSendMessageWithUniqueIdentifier:messageUniqueIdentifier
+                                                  error:error];
+        });
+    };
+
+    [self.outbox restore];
 }
 
 #pragma mark -  Public
@@ -66,6 +99,21 @@
     [self.dataSource.managerGetNotificationCenter postNotificationName:kOCTScheduleFileTransferCleanupNotification object:nil];
 }
 
+- (OCTMessageCursor *)messageCursorForChat:(OCTChat *)chat pageSize:(NSUInteger)pageSize
+{
+    NSParameterAssert(chat);
+
+    return [[OCTMessageCursor alloc] initWithRealmManager:[self.dataSource managerGetRealmManager]
+                                     chatUniqueIdentifier:chat.uniqueIdentifier
+                                                 pageSize:pageSize];
+}
+
+- (RLMResults *)searchMessagesWithQuery:(NSString *)query inChat:(OCTChat *)chat
+{
+    return [[self.dataSource managerGetRealmManager] searchMessagesWithQuery:query
+                                                        chatUniqueIdentifier:chat.uniqueIdentifier];
+}
+
 - (void)sendMessageToChat:(OCTChat *)chat
                      text:(NSString *)text
                      type:(OCTToxMessageType)type
@@ -76,41 +124,35 @@
     NSParameterAssert(text);
 
     OCTFriend *friend = [chat.friends firstObject];
+    BOOL isConnected = [[self.dataSource managerGetPresenceStore] isFriendNumberConnected:friend.friendNumber];
 
-    __weak OCTSubmanagerChatsImpl *weakSelf = self;
-    OCTSendMessageOperationSuccessBlock successBlock = ^(OCTToxMessageId messageId) {
-        __strong OCTSubmanagerChatsImpl *strongSelf = weakSelf;
-
-        OCTRealmManager *realmManager = [strongSelf.dataSource managerGetRealmManager];
-        OCTMessageAbstract *message = [realmManager addMessageWithText:text type:type chat:chat sender:nil messageId:messageId];
-
-        if (userSuccessBlock) {
-            userSuccessBlock(message);
+    if (! isConnected && ! [self.dataSource managerUseFauxOfflineMessaging]) {
+        if (userFailureBlock) {
+            NSDictionary *userInfo = @{
+                NSLocalizedDescriptionKey : @"Cannot send message",
+                NSLocalizedFailureReasonErrorKey : @"Friend is not connected",
+            };
+
+            userFailureBlock([NSError errorWithDomain:kOCTToxErrorDomain
+                                                 code:OCTToxErrorFriendSendMessageFriendNotConnected
+                                             userInfo:userInfo]);
         }
-    };
-
-    OCTSendMessageOperationFailureBlock failureBlock = ^(NSError *error) {
-        __strong OCTSubmanagerChatsImpl *strongSelf = weakSelf;
+        return;
+    }
 
-        if ((error.code == OCTToxErrorFriendSendMessageFriendNotConnected) &&
-            [strongSelf.dataSource managerUseFauxOfflineMessaging]) {
+    // Message is stored right away, outbox sends it after next tox iteration.
+    OCTMessageAbstract *message = [self.outbox addMessageWithText:text type:type chat:chat friend:friend];
 
-            successBlock(-1);
-            return;
-        }
+    if (userSuccessBlock) {
+        userSuccessBlock(message);
+    }
+}
 
-        if (userFailureBlock) {
-            userFailureBlock(error);
-        }
-    };
+- (NSUInteger)numberOfQueuedMessagesForFriend:(OCTFriend *)friend
+{
+    NSParameterAssert(friend);
 
-    OCTSendMessageOperation *operation = [[OCTSendMessageOperation alloc] initWithTox:[self.dataSource managerGetTox]
-                                                                         friendNumber:friend.friendNumber
-                                                                          messageType:type
-                                                                              message:text
-                                                                         successBlock:successBlock
-                                                                         failureBlock:failureBlock];
-    [self.sendMessageQueue addOperation:operation];
+    return [self.outbox queuedMessagesCountForFriendNumber:friend.friendNumber];
 }
 
 - (BOOL)setIsTyping:(BOOL)isTyping inChat:(OCTChat *)chat error:(NSError **)error
@@ -134,11 +176,19 @@
         return;
     }
 
-    if (friend.isConnected) {
+    if ([[self.dataSource managerGetPresenceStore] isFriendNumberConnected:friend.friendNumber]) {
         [self resendUndeliveredMessagesToFriend:friend];
     }
 }
 
+- (void)friendWasRemovedNotification:(NSNotification *)notification
+{
+    NSNumber *friendNumber = notification.object;
+
+    // Friend number may be reused by next added friend, whose receipts must not be matched with these messages.
+    [self removePendingReceiptsForFriendNumber:friendNumber.unsignedIntValue];
+}
+
 #pragma mark -  Private
 
 - (void)resendUndeliveredMessagesToFriend:(OCTFriend *)friend
@@ -154,53 +204,64 @@
 
     RLMResults *results = [realmManager objectsWithClass:[OCTMessageAbstract class] predicate:predicate];
 
-    for (OCTMessageAbstract *message in results) {
-        OCTLogInfo(@"Resending message to friend %@", friend);
+    OCTLogInfo(@"Resending %lu messages to friend %@", (unsigned long)results.count, friend);
 
-        __weak OCTSubmanagerChatsImpl *weakSelf = self;
-        OCTSendMessageOperationSuccessBlock successBlock = ^(OCTToxMessageId messageId) {
-            __strong OCTSubmanagerChatsImpl *strongSelf = weakSelf;
+    // Receipts for messages sent before friend went offline won't come, messages get new ids on resend.
+    [self removePendingReceiptsForFriendNumber:friend.friendNumber];
 
-            OCTRealmManager *realmManager = [strongSelf.dataSource managerGetRealmManager];
-
-            [realmManager updateObject:message withBlock:^(OCTMessageAbstract *theMessage) {
-                theMessage.messageText.messageId = messageId;
-            }];
-        };
+    [self.outbox resumeFriendNumber:friend.friendNumber];
+    [self.outbox enqueueBacklogMessages:results friendNumber:friend.friendNumber];
+}
 
-        OCTSendMessageOperationFailureBlock failureBlock = ^(NSError *error) {
-            OCTLogWarn(@"Cannot resend message to friend %@, error %@", friend, error);
-        };
+- (void)addPendingReceiptForMessage:(NSString *)messageIdentifier
+                       friendNumber:(OCTToxFriendNumber)friendNumber
+                          messageId:(OCTToxMessageId)messageId
+{
+    if (! messageIdentifier) {
+        return;
+    }
 
-        OCTSendMessageOperation *operation = [[OCTSendMessageOperation alloc] initWithTox:[self.dataSource managerGetTox]
-                                                                             friendNumber:friend.friendNumber
-                                                                              messageType:message.messageText.type
-                                                                                  message:message.messageText.text
-                                                                             successBlock:successBlock
-                                                                             failureBlock:failureBlock];
-        [self.sendMessageQueue addOperation:operation];
+    @synchronized(self.pendingReceipts) {
+        self.pendingReceipts[pendingReceiptKey(friendNumber, messageId)] = messageIdentifier;
     }
 }
 
-#pragma mark -  OCTToxDelegate
+- (NSString *)takePendingReceiptWithFriendNumber:(OCTToxFriendNumber)friendNumber messageId:(OCTToxMessageId)messageId
+{
+    NSNumber *key = pendingReceiptKey(friendNumber, messageId);
 
-- (void)tox:(OCTTox *)tox friendMessage:(NSString *)message type:(OCTToxMessageType)type friendNumber:(OCTToxFriendNumber)friendNumber
+    @synchronized(self.pendingReceipts) {
+        NSString *messageIdentifier = self.pendingReceipts[key];
+        [self.pendingReceipts removeObjectForKey:key];
+
+        return messageIdentifier;
+    }
+}
+
+- (void)removePendingReceiptsForFriendNumber:(OCTToxFriendNumber)friendNumber
 {
-    OCTRealmManager *realmManager = [self.dataSource managerGetRealmManager];
+    @synchronized(self.pendingReceipts) {
+        NSMutableArray<NSNumber *> *keys = [NSMutableArray new];
 
-    NSString *publicKey = [[self.dataSource managerGetTox] publicKeyFromFriendNumber:friendNumber error:nil];
-    OCTFriend *friend = [realmManager friendWithPublicKey:publicKey];
-    OCTChat *chat = [realmManager getOrCreateChatWithFriend:friend];
+        for (NSNumber *key in self.pendingReceipts) {
+            if ((key.unsignedLongLongValue >> 32) == friendNumber) {
+                [keys addObject:key];
+            }
+        }
 
-    [realmManager addMessageWithText:message type:type chat:chat sender:friend messageId:0];
+        [self.pendingReceipts removeObjectsForKeys:keys];
+    }
 }
 
-- (void)tox:(OCTTox *)tox messageDelivered:(OCTToxMessageId)messageId friendNumber:(OCTToxFriendNumber)friendNumber
+/**
+ * Looks up message by messageId in database. Used for messages that weren't sent by this manager during
+ * current session, e.g. added by client directly.
+ */
+- (OCTMessageAbstract *)latestMessageWithMessageId:(OCTToxMessageId)messageId friendNumber:(OCTToxFriendNumber)friendNumber
 {
     OCTRealmManager *realmManager = [self.dataSource managerGetRealmManager];
 
-    NSString *publicKey = [[self.dataSource managerGetTox] publicKeyFromFriendNumber:friendNumber error:nil];
-    OCTFriend *friend = [realmManager friendWithPublicKey:publicKey];
+    OCTFriend *friend = [realmManager friendWithFriendNumber:friendNumber tox:[self.dataSource managerGetTox]];
     OCTChat *chat = [realmManager getOrCreateChatWithFriend:friend];
 
     NSPredicate *predicate = [NSPredicate predicateWithFormat:@"chatUniqueIdentifier == %@ AND messageText.messageId == %d",
@@ -210,12 +271,50 @@
     RLMResults *results = [realmManager objectsWithClass:[OCTMessageAbstract class] predicate:predicate];
     results = [results sortedResultsUsingKeyPath:@"dateInterval" ascending:NO];
 
-    OCTMessageAbstract *message = [results firstObject];
+    return [results firstObject];
+}
+
+#pragma mark -  OCTToxDelegate
+
+- (void)tox:(OCTTox *)tox friendMessage:(NSString *)message type:(OCTToxMessageType)type friendNumber:(OCTToxFriendNumber)friendNumber
+{
+    OCTRealmManager *realmManager = [self.dataSource managerGetRealmManager];
+
+    // Friend lookup may call tox, it must not be done while write lock is held. Inside of event batch
+    // friend is resolved by OCTManagerImpl before transaction, so this lookup hits tox friends cache.
+    OCTFriend *friend = [realmManager friendWithFriendNumber:friendNumber tox:tox];
+
+    // Creating chat, adding message and updating chat activity in single transaction.
+    [realmManager performBatchUpdates:^{
+        if (friend.isInvalidated) {
+            return;
+        }
+
+        OCTChat *chat = [realmManager getOrCreateChatWithFriend:friend];
+
+        [realmManager addMessageWithText:message type:type chat:chat sender:friend messageId:0];
+    }];
+}
+
+- (void)tox:(OCTTox *)tox messageDelivered:(OCTToxMessageId)messageId friendNumber:(OCTToxFriendNumber)friendNumber
+{
+    OCTRealmManager *realmManager = [self.dataSource managerGetRealmManager];
+    OCTMessageAbstract *message;
+
+    NSString *messageIdentifier = [self takePendingReceiptWithFriendNumber:friendNumber messageId:messageId];
+
+    if (messageIdentifier) {
+        message = [realmManager objectWithUniqueIdentifier:messageIdentifier class:[OCTMessageAbstract class]];
+    }
+    else {
+        message = [self latestMessageWithMessageId:messageId friendNumber:friendNumber];
+    }
 
     if (! message) {
         return;
     }
 
+    // Receipts of single tox iteration are delivered inside of OCTRealmManager batch, they are committed together.
     [realmManager updateObject:message withBlock:^(OCTMessageAbstract *theMessage) {
         theMessage.messageText.isDelivered = YES;
     }];
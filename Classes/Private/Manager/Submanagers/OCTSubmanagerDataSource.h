@@ -6,6 +6,7 @@
 
 @class OCTTox;
 @class OCTRealmManager;
+@class OCTPresenceStore;
 @protocol OCTFileStorageProtocol;
 
 /**
@@ -16,6 +17,14 @@
  */
 static NSString *const kOCTFriendConnectionStatusChangeNotification = @"kOCTFriendConnectionStatusChangeNotification";
 
+/**
+ * Notification is send when friend was removed. Friend number may be given to other friend later.
+ *
+ * - object NSNumber with friend number of removed friend.
+ * - userInfo nil
+ */
+static NSString *const kOCTFriendWasRemovedNotification = @"kOCTFriendWasRemovedNotification";
+
 /**
  * Notification is send on user avatar update.
  *
@@ -37,8 +46,12 @@ static NSString *const kOCTScheduleFileTransferCleanupNotification = @"kOCTSched
 
 - (OCTTox *)managerGetTox;
 - (BOOL)managerIsToxConnected;
+/**
+ * Schedules tox save, returns immediately. Saves requested in short time are coalesced.
+ */
 - (void)managerSaveTox;
 - (OCTRealmManager *)managerGetRealmManager;
+- (OCTPresenceStore *)managerGetPresenceStore;
 - (id<OCTFileStorageProtocol>)managerGetFileStorage;
 - (NSNotificationCenter *)managerGetNotificationCenter;
 - (BOOL)managerUseFauxOfflineMessaging;
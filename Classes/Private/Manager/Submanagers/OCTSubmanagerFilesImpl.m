@@ -9,6 +9,7 @@
 #import "OCTFileDownloadOperation.h"
 #import "OCTFileUploadOperation.h"
 #import "OCTRealmManager.h"
+#import "OCTPresenceStore+Private.h"
 #import "OCTLogging.h"
 #import "OCTMessageAbstract.h"
 #import "OCTMessageFile.h"
@@ -20,6 +21,7 @@
 #import "OCTFileDataInput.h"
 #import "OCTFileDataOutput.h"
 #import "OCTFileTools.h"
+#import "OCTFileTransferRegistry.h"
 #import "OCTSettingsStorageObject.h"
 #import "NSError+OCTFile.h"
 
@@ -35,6 +37,7 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
 @interface OCTSubmanagerFilesImpl ()
 
 @property (strong, nonatomic, readonly) NSOperationQueue *queue;
+@property (strong, nonatomic, readonly) OCTFileTransferRegistry *transfers;
 
 @property (strong, nonatomic, readonly) NSObject *filesCleanupLock;
 @property (assign, nonatomic) BOOL filesCleanupInProgress;
@@ -55,6 +58,7 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
     }
 
     _queue = [NSOperationQueue new];
+    _transfers = [OCTFileTransferRegistry new];
     _filesCleanupLock = [NSObject new];
 
     return self;
@@ -95,11 +99,23 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
 
     NSFileManager *fileManager = [NSFileManager defaultManager];
 
+    // Downloads interrupted by relaunch keep their temp files, they are resumed when friend offers file again.
+    NSPredicate *resumablePredicate = [NSPredicate predicateWithFormat:@"fileType == %d AND internalTempFileName != nil",
+                                       OCTMessageFileTypeCanceled];
+    RLMResults *resumableFiles = [realmManager objectsWithClass:[OCTMessageFile class] predicate:resumablePredicate];
+    NSSet *resumableFileNames = [NSSet setWithArray:[resumableFiles valueForKey:@"internalTempFileName"]];
+
     NSString *downloads = [self downloadsTempDirectory];
-    OCTLogInfo(@"clearing downloads temp directory %@\ncontents %@",
+    OCTLogInfo(@"clearing downloads temp directory %@\ncontents %@\nkeeping %@",
                downloads,
-               [fileManager contentsOfDirectoryAtPath:downloads error:nil]);
-    [fileManager removeItemAtPath:downloads error:nil];
+               [fileManager contentsOfDirectoryAtPath:downloads error:nil],
+               resumableFileNames);
+
+    for (NSString *fileName in [fileManager contentsOfDirectoryAtPath:downloads error:nil]) {
+        if (! [resumableFileNames containsObject:fileName]) {
+            [fileManager removeItemAtPath:[downloads stringByAppendingPathComponent:fileName] error:nil];
+        }
+    }
 
     [self scheduleFilesCleanup];
 }
@@ -181,6 +197,11 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
         return;
     }
 
+    // Random file id is generated by tox, it is reused on retry so friend can resume download.
+    NSData *fileId = [[self.dataSource managerGetTox] fileGetFileIdForFileNumber:fileNumber
+                                                                    friendNumber:friend.friendNumber
+                                                                           error:nil];
+
     OCTRealmManager *realmManager = [self.dataSource managerGetRealmManager];
     OCTMessageAbstract *message = [realmManager addMessageWithFileNumber:fileNumber
                                                                 fileType:OCTMessageFileTypeWaitingConfirmation
@@ -188,6 +209,7 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
                                                                 fileName:fileName
                                                                 filePath:filePath
                                                                  fileUTI:[self fileUTIFromFileName:fileName]
+                                                                  fileId:fileId
                                                                     chat:chat
                                                                   sender:nil];
 
@@ -206,7 +228,7 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
                                                                        failureBlock:[self   fileFailureBlockWithMessage:message
                                                                                                        userFailureBlock:failureBlock]];
 
-    [self.queue addOperation:operation];
+    [self startOperation:operation];
 }
 
 - (void)acceptFileTransfer:(OCTMessageAbstract *)message
@@ -258,11 +280,12 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
                                             failureBlock:[self   fileFailureBlockWithMessage:message
                                                                             userFailureBlock:failureBlock]];
 
-    [self.queue addOperation:operation];
+    [self startOperation:operation];
 
     [self updateMessageFile:message withBlock:^(OCTMessageFile *file) {
         file.fileType = OCTMessageFileTypeLoading;
         [file internalSetFilePath:output.resultFilePath];
+        file.internalTempFileName = [output.tempFilePath lastPathComponent];
     }];
 }
 
@@ -283,8 +306,8 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
                                                         control:OCTToxFileControlCancel
                                                           error:nil];
 
-    OCTFileBaseOperation *operation = [self operationWithFileNumber:message.messageFile.internalFileNumber
-                                                       friendNumber:friend.friendNumber];
+    OCTFileBaseOperation *operation = [self.transfers operationWithFileNumber:message.messageFile.internalFileNumber
+                                                                 friendNumber:friend.friendNumber];
     [operation cancel];
 
     [self updateMessageFile:message withBlock:^(OCTMessageFile *file) {
@@ -322,12 +345,13 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
 
     OCTToxFileSize fileSize = [attributes[NSFileSize] longLongValue];
     OCTFriend *friend = [self friendForMessage:message];
+    NSData *fileId = message.messageFile.internalFileId;
     NSError *error;
 
     OCTToxFileNumber fileNumber = [[self.dataSource managerGetTox] fileSendWithFriendNumber:friend.friendNumber
                                                                                        kind:OCTToxFileKindData
                                                                                    fileSize:fileSize
-                                                                                     fileId:nil
+                                                                                     fileId:fileId
                                                                                    fileName:fileName
                                                                                       error:&error];
 
@@ -339,10 +363,18 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
         return;
     }
 
+    if (! fileId) {
+        // Message was sent before file ids were stored.
+        fileId = [[self.dataSource managerGetTox] fileGetFileIdForFileNumber:fileNumber
+                                                                friendNumber:friend.friendNumber
+                                                                       error:nil];
+    }
+
     [self updateMessageFile:message withBlock:^(OCTMessageFile *messageFile) {
         messageFile.internalFileNumber = fileNumber;
         messageFile.fileType = OCTMessageFileTypeWaitingConfirmation;
         messageFile.fileSize = fileSize;
+        messageFile.internalFileId = fileId;
     }];
 
     NSDictionary *userInfo = [self fileOperationUserInfoWithMessage:message];
@@ -360,7 +392,7 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
                                                                        failureBlock:[self   fileFailureBlockWithMessage:message
                                                                                                        userFailureBlock:failureBlock]];
 
-    [self.queue addOperation:operation];
+    [self startOperation:operation];
 }
 
 - (BOOL)pauseFileTransfer:(BOOL)pause message:(nonnull OCTMessageAbstract *)message error:(NSError **)error
@@ -404,10 +436,19 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
 
     OCTFriend *friend = [self friendForMessage:message];
 
-    [self.dataSource.managerGetTox fileSendControlForFileNumber:message.messageFile.internalFileNumber
-                                                   friendNumber:friend.friendNumber
-                                                        control:control
-                                                          error:nil];
+    OCTFileBaseOperation *operation = [self.transfers operationWithFileNumber:message.messageFile.internalFileNumber
+                                                                 friendNumber:friend.friendNumber];
+
+    // Download may be paused by its output as well, operation keeps track of both.
+    if ([operation isKindOfClass:[OCTFileDownloadOperation class]]) {
+        [(OCTFileDownloadOperation *)operation pauseByUser:pause];
+    }
+    else {
+        [self.dataSource.managerGetTox fileSendControlForFileNumber:message.messageFile.internalFileNumber
+                                                       friendNumber:friend.friendNumber
+                                                            control:control
+                                                              error:nil];
+    }
 
     [self updateMessageFile:message withBlock:^(OCTMessageFile *file) {
         file.fileType = type;
@@ -430,8 +471,8 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
 
     OCTFriend *friend = [self friendForMessage:message];
 
-    OCTFileBaseOperation *operation = [self operationWithFileNumber:message.messageFile.internalFileNumber
-                                                       friendNumber:friend.friendNumber];
+    OCTFileBaseOperation *operation = [self.transfers operationWithFileNumber:message.messageFile.internalFileNumber
+                                                                 friendNumber:friend.friendNumber];
 
     if (! operation) {
         return YES;
@@ -464,8 +505,8 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
 
     OCTFriend *friend = [self friendForMessage:message];
 
-    OCTFileBaseOperation *operation = [self operationWithFileNumber:message.messageFile.internalFileNumber
-                                                       friendNumber:friend.friendNumber];
+    OCTFileBaseOperation *operation = [self.transfers operationWithFileNumber:message.messageFile.internalFileNumber
+                                                                 friendNumber:friend.friendNumber];
 
     if (! operation) {
         return YES;
@@ -488,7 +529,7 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
     friendNumber:(OCTToxFriendNumber)friendNumber
       fileNumber:(OCTToxFileNumber)fileNumber
 {
-    OCTFileBaseOperation *operation = [self operationWithFileNumber:fileNumber friendNumber:friendNumber];
+    OCTFileBaseOperation *operation = [self.transfers operationWithFileNumber:fileNumber friendNumber:friendNumber];
 
     NSString *identifier = operation.userInfo[kMessageIdentifierKey];
     OCTMessageAbstract *message;
@@ -529,7 +570,7 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
         position:(OCTToxFileSize)position
           length:(size_t)length
 {
-    OCTFileBaseOperation *operation = [self operationWithFileNumber:fileNumber friendNumber:friendNumber];
+    OCTFileBaseOperation *operation = [self.transfers operationWithFileNumber:fileNumber friendNumber:friendNumber];
 
     if ([operation isKindOfClass:[OCTFileUploadOperation class]]) {
         [(OCTFileUploadOperation *)operation chunkRequestWithPosition:position length:length];
@@ -569,7 +610,7 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
     friendNumber:(OCTToxFriendNumber)friendNumber
         position:(OCTToxFileSize)position
 {
-    OCTFileBaseOperation *operation = [self operationWithFileNumber:fileNumber friendNumber:friendNumber];
+    OCTFileBaseOperation *operation = [self.transfers operationWithFileNumber:fileNumber friendNumber:friendNumber];
 
     if ([operation isKindOfClass:[OCTFileDownloadOperation class]]) {
         [(OCTFileDownloadOperation *)operation receiveChunk:chunk position:position];
@@ -596,11 +637,15 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
 
 - (void)userAvatarWasUpdatedNotification
 {
-    NSPredicate *predicate = [NSPredicate predicateWithFormat:@"connectionStatus != %d", OCTToxConnectionStatusNone];
-    RLMResults *onlineFriends = [self.dataSource.managerGetRealmManager objectsWithClass:[OCTFriend class] predicate:predicate];
+    OCTRealmManager *realmManager = [self.dataSource managerGetRealmManager];
+    OCTTox *tox = [self.dataSource managerGetTox];
+
+    for (NSNumber *friendNumber in [[self.dataSource managerGetPresenceStore] connectedFriendNumbers]) {
+        OCTFriend *friend = [realmManager friendWithFriendNumber:friendNumber.unsignedIntValue tox:tox];
 
-    for (OCTFriend *friend in onlineFriends) {
-        [self sendAvatarToFriend:friend];
+        if (friend) {
+            [self sendAvatarToFriend:friend];
+        }
     }
 }
 
@@ -696,17 +741,10 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
     });
 }
 
-- (OCTFileBaseOperation *)operationWithFileNumber:(OCTToxFileNumber)fileNumber friendNumber:(OCTToxFriendNumber)friendNumber
+- (void)startOperation:(OCTFileBaseOperation *)operation
 {
-    NSString *operationId = [OCTFileBaseOperation operationIdFromFileNumber:fileNumber friendNumber:friendNumber];
-
-    for (OCTFileBaseOperation *operation in [self.queue operations]) {
-        if ([operation.operationId isEqualToString:operationId]) {
-            return operation;
-        }
-    }
-
-    return nil;
+    [self.transfers registerOperation:operation];
+    [self.queue addOperation:operation];
 }
 
 - (void)createDirectoryIfNeeded:(NSString *)path
@@ -779,11 +817,13 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
 
     OCTRealmManager *realmManager = [self.dataSource managerGetRealmManager];
 
-    [realmManager updateObject:message.messageFile withBlock:block];
+    [realmManager performBatchUpdates:^{
+        [realmManager updateObject:message.messageFile withBlock:block];
 
-    // Workaround to force Realm to update OCTMessageAbstract when OCTMessageFile was updated.
-    [realmManager updateObject:message withBlock:^(OCTMessageAbstract *message) {
-        message.dateInterval = message.dateInterval;
+        // Workaround to force Realm to update OCTMessageAbstract when OCTMessageFile was updated.
+        [realmManager updateObject:message withBlock:^(OCTMessageAbstract *message) {
+            message.dateInterval = message.dateInterval;
+        }];
     }];
 }
 
@@ -894,7 +934,7 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
                                                                        successBlock:nil
                                                                        failureBlock:nil];
 
-    [self.queue addOperation:operation];
+    [self startOperation:operation];
 }
 
 - (void)dataFileReceiveForFileNumber:(OCTToxFileNumber)fileNumber
@@ -910,18 +950,140 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
     }
 
     OCTRealmManager *realmManager = [self.dataSource managerGetRealmManager];
-    NSString *publicKey = [[self.dataSource managerGetTox] publicKeyFromFriendNumber:friendNumber error:nil];
-    OCTFriend *friend = [realmManager friendWithPublicKey:publicKey];
-    OCTChat *chat = [realmManager getOrCreateChatWithFriend:friend];
+    NSData *fileId = [self.dataSource.managerGetTox fileGetFileIdForFileNumber:fileNumber friendNumber:friendNumber error:nil];
+
+    OCTMessageAbstract *interrupted = [self interruptedDownloadWithFileId:fileId fileSize:fileSize friendNumber:friendNumber];
+
+    if (interrupted) {
+        [self resumeDownload:interrupted fileNumber:fileNumber friendNumber:friendNumber];
+        return;
+    }
+
+    // Friend lookup may call tox, it must not be done while write lock is held.
+    OCTFriend *friend = [realmManager friendWithFriendNumber:friendNumber tox:[self.dataSource managerGetTox]];
+
+    [realmManager performBatchUpdates:^{
+        if (friend.isInvalidated) {
+            return;
+        }
+
+        OCTChat *chat = [realmManager getOrCreateChatWithFriend:friend];
+
+        [realmManager addMessageWithFileNumber:fileNumber
+                                      fileType:OCTMessageFileTypeWaitingConfirmation
+                                      fileSize:fileSize
+                                      fileName:fileName
+                                      filePath:nil
+                                       fileUTI:[self fileUTIFromFileName:fileName]
+                                        fileId:fileId
+                                          chat:chat
+                                        sender:friend];
+    }];
+}
+
+/**
+ * Download of same file from same friend, which was accepted and interrupted by relaunch.
+ * Partial temp file should still exist.
+ */
+- (OCTMessageAbstract *)interruptedDownloadWithFileId:(NSData *)fileId
+                                             fileSize:(OCTToxFileSize)fileSize
+                                         friendNumber:(OCTToxFriendNumber)friendNumber
+{
+    if (! fileId) {
+        return nil;
+    }
+
+    OCTRealmManager *realmManager = [self.dataSource managerGetRealmManager];
+    OCTFriend *friend = [realmManager friendWithFriendNumber:friendNumber tox:[self.dataSource managerGetTox]];
+
+    NSPredicate *predicate = [NSPredicate predicateWithFormat:
+                              @"senderUniqueIdentifier == %@ AND messageFile.internalFileId == %@ AND messageFile.fileSize == %lld "
+                              @"AND messageFile.fileType == %d AND messageFile.internalTempFileName != nil "
+                              @"AND messageFile.internalFilePath != nil",
+                              friend.uniqueIdentifier, fileId, fileSize, OCTMessageFileTypeCanceled];
+
+    RLMResults *results = [[realmManager objectsWithClass:[OCTMessageAbstract class] predicate:predicate]
+                           sortedResultsUsingKeyPath:@"dateInterval" ascending:NO];
+    OCTMessageAbstract *message = [results firstObject];
+
+    if (! message) {
+        return nil;
+    }
 
-    [realmManager addMessageWithFileNumber:fileNumber
-                                  fileType:OCTMessageFileTypeWaitingConfirmation
-                                  fileSize:fileSize
-                                  fileName:fileName
-                                  filePath:nil
-                                   fileUTI:[self fileUTIFromFileName:fileName]
-                                      chat:chat
-                                    sender:friend];
+    NSString *tempFilePath = [[self downloadsTempDirectory] stringByAppendingPathComponent:message.messageFile.internalTempFileName];
+
+    if (! [[NSFileManager defaultManager] fileExistsAtPath:tempFilePath]) {
+        return nil;
+    }
+
+    return message;
+}
+
+/**
+ * File was accepted by user before relaunch, so download continues without asking again.
+ * Download paused by user stays paused.
+ */
+- (void)resumeDownload:(OCTMessageAbstract *)message
+            fileNumber:(OCTToxFileNumber)fileNumber
+          friendNumber:(OCTToxFriendNumber)friendNumber
+{
+    OCTLogInfo(@"resuming download %@", message);
+
+    // Message is found on delegate queue, operation blocks use it on main thread.
+    NSString *identifier = message.uniqueIdentifier;
+
+    dispatch_async(dispatch_get_main_queue(), ^{
+        OCTMessageAbstract *theMessage = [self.dataSource.managerGetRealmManager objectWithUniqueIdentifier:identifier
+                                                                                                      class:[OCTMessageAbstract class]];
+
+        if (theMessage.messageFile.fileType != OCTMessageFileTypeCanceled) {
+            OCTLogWarn(@"message of resumed download was removed or resumed already, cancelling it");
+            [self.dataSource.managerGetTox fileSendControlForFileNumber:fileNumber
+                                                           friendNumber:friendNumber
+                                                                control:OCTToxFileControlCancel
+                                                                  error:nil];
+            return;
+        }
+
+        [self startResumedDownload:theMessage fileNumber:fileNumber friendNumber:friendNumber];
+    });
+}
+
+- (void)startResumedDownload:(OCTMessageAbstract *)message
+                  fileNumber:(OCTToxFileNumber)fileNumber
+                friendNumber:(OCTToxFriendNumber)friendNumber
+{
+    NSString *tempFilePath = [[self downloadsTempDirectory] stringByAppendingPathComponent:message.messageFile.internalTempFileName];
+    OCTFilePathOutput *output = [[OCTFilePathOutput alloc] initWithTempFilePath:tempFilePath
+                                                                 resultFilePath:[message.messageFile filePath]];
+
+    // Friend pause belonged to previous transfer.
+    OCTMessageFilePausedBy pausedBy = message.messageFile.pausedBy & OCTMessageFilePausedByUser;
+
+    // File number should be updated before operation starts, transfer is looked up by it.
+    [self updateMessageFile:message withBlock:^(OCTMessageFile *file) {
+        file.internalFileNumber = fileNumber;
+        file.fileType = (pausedBy == OCTMessageFilePausedByNone) ? OCTMessageFileTypeLoading : OCTMessageFileTypePaused;
+        file.pausedBy = pausedBy;
+    }];
+
+    NSDictionary *userInfo = [self fileOperationUserInfoWithMessage:message];
+
+    OCTFileDownloadOperation *operation = [[OCTFileDownloadOperation alloc]
+                                           initWithTox:self.dataSource.managerGetTox
+                                              fileOutput:output
+                                            friendNumber:friendNumber
+                                              fileNumber:fileNumber
+                                                fileSize:message.messageFile.fileSize
+                                                userInfo:userInfo
+                                           progressBlock:[self fileProgressBlockWithMessage:message]
+                                          etaUpdateBlock:[self fileEtaUpdateBlockWithMessage:message]
+                                            successBlock:[self fileSuccessBlockWithMessage:message]
+                                            failureBlock:[self   fileFailureBlockWithMessage:message
+                                                                            userFailureBlock:nil]];
+    operation.startsPaused = (pausedBy != OCTMessageFilePausedByNone);
+
+    [self startOperation:operation];
 }
 
 - (void)avatarFileReceiveForFileNumber:(OCTToxFileNumber)fileNumber
@@ -934,8 +1096,7 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
         [self.dataSource.managerGetTox fileSendControlForFileNumber:fileNumber friendNumber:friendNumber control:OCTToxFileControlCancel error:nil];
     };
 
-    NSString *publicKey = [[self.dataSource managerGetTox] publicKeyFromFriendNumber:friendNumber error:nil];
-    OCTFriend *friend = [[self.dataSource managerGetRealmManager] friendWithPublicKey:publicKey];
+    OCTFriend *friend = [[self.dataSource managerGetRealmManager] friendWithFriendNumber:friendNumber tox:[self.dataSource managerGetTox]];
 
     if (fileSize == 0) {
         if (friend.avatarData) {
@@ -979,15 +1140,14 @@ static NSString *const kMessageIdentifierKey = @"kMessageIdentifierKey";
                                                                            successBlock:^(OCTFileBaseOperation *__nonnull operation) {
         __strong OCTSubmanagerFilesImpl *strongSelf = weakSelf;
 
-        NSString *publicKey = [[strongSelf.dataSource managerGetTox] publicKeyFromFriendNumber:friendNumber error:nil];
-        OCTFriend *friend = [[strongSelf.dataSource managerGetRealmManager] friendWithPublicKey:publicKey];
+        OCTFriend *friend = [[strongSelf.dataSource managerGetRealmManager] friendWithFriendNumber:friendNumber tox:[strongSelf.dataSource managerGetTox]];
 
         [[strongSelf.dataSource managerGetRealmManager] updateObject:friend withBlock:^(OCTFriend *theFriend) {
             theFriend.avatarData = output.resultData;
         }];
     } failureBlock:nil];
 
-    [self.queue addOperation:operation];
+    [self startOperation:operation];
 }
 
 - (OCTFriend *)friendForMessage:(OCTMessageAbstract *)message
@@ -7,6 +7,7 @@
 #import "OCTFriend.h"
 #import "OCTFriendRequest.h"
 #import "OCTRealmManager.h"
+#import "OCTPresenceStore+Private.h"
 
 @implementation OCTSubmanagerFriendsImpl
 @synthesize dataSource = _dataSource;
@@ -62,15 +63,19 @@
     NSParameterAssert(friend);
 
     OCTTox *tox = [self.dataSource managerGetTox];
+    OCTToxFriendNumber friendNumber = friend.friendNumber;
 
-    if (! [tox deleteFriendWithFriendNumber:friend.friendNumber error:error]) {
+    if (! [tox deleteFriendWithFriendNumber:friendNumber error:error]) {
         return NO;
     }
 
     [self.dataSource managerSaveTox];
 
+    [[self.dataSource managerGetPresenceStore] removeFriendNumber:friendNumber];
     [[self.dataSource managerGetRealmManager] deleteObject:friend];
 
+    [[self.dataSource managerGetNotificationCenter] postNotificationName:kOCTFriendWasRemovedNotification object:@(friendNumber)];
+
     return YES;
 }
 
@@ -78,56 +83,7 @@
 
 - (void)configure
 {
-    OCTRealmManager *realmManager = [self.dataSource managerGetRealmManager];
-    OCTTox *tox = [self.dataSource managerGetTox];
-
-    [realmManager updateObjectsWithClass:[OCTFriend class] predicate:nil updateBlock:^(OCTFriend *friend) {
-        // Tox may change friendNumber after relaunch, resetting them.
-        friend.friendNumber = kOCTToxFriendNumberFailure;
-    }];
-
-    for (NSNumber *friendNumber in [tox friendsArray]) {
-        OCTToxFriendNumber number = [friendNumber intValue];
-        NSError *error;
-
-        NSString *publicKey = [tox publicKeyFromFriendNumber:number error:&error];
-
-        if (! publicKey) {
-            @throw [NSException exceptionWithName:@"Cannot find publicKey for existing friendNumber, Tox save data is broken"
-                                           reason:error.debugDescription
-                                         userInfo:nil];
-        }
-
-        NSPredicate *predicate = [NSPredicate predicateWithFormat:@"publicKey == %@", publicKey];
-        RLMResults *results = [realmManager objectsWithClass:[OCTFriend class] predicate:predicate];
-
-        if (results.count == 0) {
-            // It seems that friend is in Tox but isn't in Realm. Let's add it.
-            [self createFriendWithFriendNumber:number error:nil];
-            continue;
-        }
-
-        OCTFriend *friend = [results firstObject];
-
-        // Reset some fields for friends.
-        [realmManager updateObject:friend withBlock:^(OCTFriend *theFriend) {
-            theFriend.friendNumber = number;
-            theFriend.status = OCTToxUserStatusNone;
-            theFriend.isConnected = NO;
-            theFriend.connectionStatus = OCTToxConnectionStatusNone;
-            theFriend.isTyping = NO;
-            NSDate *dateOffline = [tox friendGetLastOnlineWithFriendNumber:number error:nil];
-            theFriend.lastSeenOnlineInterval = [dateOffline timeIntervalSince1970];
-        }];
-    }
-
-    // Remove all OCTFriend's which aren't bounded to tox. User cannot interact with them anyway.
-    NSPredicate *predicate = [NSPredicate predicateWithFormat:@"friendNumber == %d", kOCTToxFriendNumberFailure];
-    RLMResults *results = [realmManager objectsWithClass:[OCTFriend class] predicate:predicate];
-
-    for (OCTFriend *friend in results) {
-        [realmManager deleteObject:friend];
-    }
+    [self updateFriendsFromTox];
 }
 
 #pragma mark -  OCTToxDelegate
@@ -163,8 +119,7 @@
 
     OCTRealmManager *realmManager = [self.dataSource managerGetRealmManager];
 
-    NSString *publicKey = [[self.dataSource managerGetTox] publicKeyFromFriendNumber:friendNumber error:nil];
-    OCTFriend *friend = [realmManager friendWithPublicKey:publicKey];
+    OCTFriend *friend = [realmManager friendWithFriendNumber:friendNumber tox:[self.dataSource managerGetTox]];
 
     [realmManager updateObject:friend withBlock:^(OCTFriend *theFriend) {
         theFriend.name = name;
@@ -180,8 +135,7 @@
     [self.dataSource managerSaveTox];
 
     OCTRealmManager *realmManager = [self.dataSource managerGetRealmManager];
-    NSString *publicKey = [[self.dataSource managerGetTox] publicKeyFromFriendNumber:friendNumber error:nil];
-    OCTFriend *friend = [realmManager friendWithPublicKey:publicKey];
+    OCTFriend *friend = [realmManager friendWithFriendNumber:friendNumber tox:[self.dataSource managerGetTox]];
 
     [realmManager updateObject:friend withBlock:^(OCTFriend *theFriend) {
         theFriend.statusMessage = statusMessage;
@@ -193,8 +147,7 @@
     [self.dataSource managerSaveTox];
 
     OCTRealmManager *realmManager = [self.dataSource managerGetRealmManager];
-    NSString *publicKey = [[self.dataSource managerGetTox] publicKeyFromFriendNumber:friendNumber error:nil];
-    OCTFriend *friend = [realmManager friendWithPublicKey:publicKey];
+    OCTFriend *friend = [realmManager friendWithFriendNumber:friendNumber tox:[self.dataSource managerGetTox]];
 
     [realmManager updateObject:friend withBlock:^(OCTFriend *theFriend) {
         theFriend.status = status;
@@ -203,13 +156,7 @@
 
 - (void)tox:(OCTTox *)tox friendIsTypingUpdate:(BOOL)isTyping friendNumber:(OCTToxFriendNumber)friendNumber
 {
-    OCTRealmManager *realmManager = [self.dataSource managerGetRealmManager];
-    NSString *publicKey = [[self.dataSource managerGetTox] publicKeyFromFriendNumber:friendNumber error:nil];
-    OCTFriend *friend = [realmManager friendWithPublicKey:publicKey];
-
-    [realmManager updateObject:friend withBlock:^(OCTFriend *theFriend) {
-        theFriend.isTyping = isTyping;
-    }];
+    [[self.dataSource managerGetPresenceStore] setIsTyping:isTyping forFriendNumber:friendNumber];
 }
 
 - (void)tox:(OCTTox *)tox friendConnectionStatusChanged:(OCTToxConnectionStatus)status friendNumber:(OCTToxFriendNumber)friendNumber
@@ -217,26 +164,123 @@
     [self.dataSource managerSaveTox];
 
     OCTRealmManager *realmManager = [self.dataSource managerGetRealmManager];
-    NSString *publicKey = [[self.dataSource managerGetTox] publicKeyFromFriendNumber:friendNumber error:nil];
-    OCTFriend *friend = [realmManager friendWithPublicKey:publicKey];
+    OCTFriend *friend = [realmManager friendWithFriendNumber:friendNumber tox:[self.dataSource managerGetTox]];
 
-    [realmManager updateObject:friend withBlock:^(OCTFriend *theFriend) {
-        theFriend.isConnected = (status != OCTToxConnectionStatusNone);
-        theFriend.connectionStatus = status;
+    [[self.dataSource managerGetPresenceStore] setConnectionStatus:status forFriendNumber:friendNumber];
 
-        if (! theFriend.isConnected) {
-            NSDate *dateOffline = [tox friendGetLastOnlineWithFriendNumber:friendNumber error:nil];
-            NSTimeInterval timeSince = [dateOffline timeIntervalSince1970];
-            theFriend.lastSeenOnlineInterval = timeSince;
-        }
-    }];
+    // Only last seen date outlives the session, database is written when friend goes offline.
+    if (status == OCTToxConnectionStatusNone) {
+        // Tox isn't called from update block, it may be executed on database queue.
+        NSDate *dateOffline = [tox friendGetLastOnlineWithFriendNumber:friendNumber error:nil];
+
+        [realmManager updateObject:friend withBlock:^(OCTFriend *theFriend) {
+            theFriend.lastSeenOnlineInterval = [dateOffline timeIntervalSince1970];
+        }];
+    }
 
     [[self.dataSource managerGetNotificationCenter] postNotificationName:kOCTFriendConnectionStatusChangeNotification object:friend];
 }
 
 #pragma mark -  Private
 
+- (void)updateFriendsFromTox
+{
+    OCTRealmManager *realmManager = [self.dataSource managerGetRealmManager];
+    OCTTox *tox = [self.dataSource managerGetTox];
+
+    // Tox is queried before opening batch, toxcore isn't called while write transaction is open.
+    NSMutableDictionary<NSNumber *, NSString *> *clientIdentifiers = [NSMutableDictionary new];
+    NSMutableDictionary<NSNumber *, NSNumber *> *lastSeenIntervals = [NSMutableDictionary new];
+    NSMutableArray<OCTFriend *> *newFriends = [NSMutableArray new];
+
+    for (NSNumber *friendNumber in [tox friendsArray]) {
+        OCTToxFriendNumber number = [friendNumber intValue];
+        NSError *error;
+
+        NSString *publicKey = [tox publicKeyFromFriendNumber:number error:&error];
+
+        if (! publicKey) {
+            @throw [NSException exceptionWithName:@"Cannot find publicKey for existing friendNumber, Tox save data is broken"
+                                           reason:error.debugDescription
+                                         userInfo:nil];
+        }
+
+        OCTFriend *friend = [realmManager friendWithPublicKey:publicKey];
+
+        if (! friend) {
+            // It seems that friend is in Tox but isn't in Realm. Let's add it.
+            friend = [self friendFromToxWithFriendNumber:number error:nil];
+
+            if (friend) {
+                [newFriends addObject:friend];
+                clientIdentifiers[friendNumber] = friend.uniqueIdentifier;
+            }
+            continue;
+        }
+
+        NSDate *dateOffline = [tox friendGetLastOnlineWithFriendNumber:number error:nil];
+
+        clientIdentifiers[friendNumber] = friend.uniqueIdentifier;
+        lastSeenIntervals[friendNumber] = @([dateOffline timeIntervalSince1970]);
+    }
+
+    // All friends are updated in single transaction.
+    [realmManager performBatchUpdates:^{
+        [realmManager updateObjectsWithClass:[OCTFriend class] predicate:nil updateBlock:^(OCTFriend *friend) {
+            // Tox may change friendNumber after relaunch, resetting them.
+            friend.friendNumber = kOCTToxFriendNumberFailure;
+        }];
+
+        for (NSNumber *friendNumber in lastSeenIntervals) {
+            OCTFriend *friend = [realmManager objectWithUniqueIdentifier:clientIdentifiers[friendNumber]
+                                                                   class:[OCTFriend class]];
+
+            // Reset some fields for friends. Connection and typing state isn't stored, nothing to reset there.
+            [realmManager updateObject:friend withBlock:^(OCTFriend *theFriend) {
+                theFriend.friendNumber = friendNumber.unsignedIntValue;
+                theFriend.status = OCTToxUserStatusNone;
+                theFriend.lastSeenOnlineInterval = lastSeenIntervals[friendNumber].doubleValue;
+            }];
+        }
+
+        for (OCTFriend *friend in newFriends) {
+            [realmManager addObject:friend];
+        }
+
+        // Remove all OCTFriend's which aren't bounded to tox. User cannot interact with them anyway.
+        NSPredicate *predicate = [NSPredicate predicateWithFormat:@"friendNumber == %d", kOCTToxFriendNumberFailure];
+        RLMResults *results = [realmManager objectsWithClass:[OCTFriend class] predicate:predicate];
+
+        for (OCTFriend *friend in results) {
+            [realmManager deleteObject:friend];
+        }
+    }];
+
+    for (NSNumber *friendNumber in clientIdentifiers) {
+        [tox setClientIdentifier:clientIdentifiers[friendNumber] forFriendNumber:friendNumber.unsignedIntValue];
+    }
+}
+
 - (BOOL)createFriendWithFriendNumber:(OCTToxFriendNumber)friendNumber error:(NSError **)userError
+{
+    OCTFriend *friend = [self friendFromToxWithFriendNumber:friendNumber error:userError];
+
+    if (! friend) {
+        return NO;
+    }
+
+    NSString *uniqueIdentifier = friend.uniqueIdentifier;
+
+    [[self.dataSource managerGetRealmManager] addObject:friend];
+    [[self.dataSource managerGetTox] setClientIdentifier:uniqueIdentifier forFriendNumber:friendNumber];
+
+    return YES;
+}
+
+/**
+ * Creates unmanaged friend with data queried from tox and updates presence store with its connection and typing.
+ */
+- (OCTFriend *)friendFromToxWithFriendNumber:(OCTToxFriendNumber)friendNumber error:(NSError **)userError
 {
     OCTTox *tox = [self.dataSource managerGetTox];
     NSError *error;
@@ -247,46 +291,47 @@
 
     friend.publicKey = [tox publicKeyFromFriendNumber:friendNumber error:&error];
     if ([self checkForError:error andAssignTo:userError]) {
-        return NO;
+        return nil;
     }
 
     friend.name = [tox friendNameWithFriendNumber:friendNumber error:&error];
     if ([self checkForError:error andAssignTo:userError]) {
-        return NO;
+        return nil;
     }
 
     friend.statusMessage = [tox friendStatusMessageWithFriendNumber:friendNumber error:&error];
     if ([self checkForError:error andAssignTo:userError]) {
-        return NO;
+        return nil;
     }
 
     friend.status = [tox friendStatusWithFriendNumber:friendNumber error:&error];
     if ([self checkForError:error andAssignTo:userError]) {
-        return NO;
+        return nil;
     }
 
-    friend.connectionStatus = [tox friendConnectionStatusWithFriendNumber:friendNumber error:&error];
+    OCTToxConnectionStatus connectionStatus = [tox friendConnectionStatusWithFriendNumber:friendNumber error:&error];
     if ([self checkForError:error andAssignTo:userError]) {
-        return NO;
+        return nil;
     }
 
     NSDate *lastSeenOnline = [tox friendGetLastOnlineWithFriendNumber:friendNumber error:&error];
     friend.lastSeenOnlineInterval = [lastSeenOnline timeIntervalSince1970];
     if ([self checkForError:error andAssignTo:userError]) {
-        return NO;
+        return nil;
     }
 
-    friend.isTyping = [tox isFriendTypingWithFriendNumber:friendNumber error:&error];
+    BOOL isTyping = [tox isFriendTypingWithFriendNumber:friendNumber error:&error];
     if ([self checkForError:error andAssignTo:userError]) {
-        return NO;
+        return nil;
     }
 
-    friend.isConnected = (friend.connectionStatus != OCTToxConnectionStatusNone);
     friend.nickname = friend.name.length ? friend.name : friend.publicKey;
 
-    [[self.dataSource managerGetRealmManager] addObject:friend];
+    OCTPresenceStore *presence = [self.dataSource managerGetPresenceStore];
+    [presence setConnectionStatus:connectionStatus forFriendNumber:friendNumber];
+    [presence setIsTyping:isTyping forFriendNumber:friendNumber];
 
-    return YES;
+    return friend;
 }
 
 - (BOOL)checkForError:(NSError *)toCheck andAssignTo:(NSError **)toAssign
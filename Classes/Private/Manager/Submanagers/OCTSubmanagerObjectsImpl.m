@@ -79,6 +79,7 @@
 
     [manager updateObject:chat withBlock:^(OCTChat *theChat) {
         theChat.lastReadDateInterval = lastReadDateInterval;
+        theChat.unreadCount = [manager unreadCountInChat:theChat lastReadDateInterval:lastReadDateInterval];
     }];
 }
 
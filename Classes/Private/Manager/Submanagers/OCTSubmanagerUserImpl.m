@@ -121,7 +121,14 @@
         [self.dataSource managerSaveTox];
     }
 
-    [self.delegate submanagerUser:self connectionStatusUpdate:connectionStatus];
+    if ([NSThread isMainThread]) {
+        [self.delegate submanagerUser:self connectionStatusUpdate:connectionStatus];
+        return;
+    }
+
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [self.delegate submanagerUser:self connectionStatusUpdate:connectionStatus];
+    });
 }
 
 @end
@@ -0,0 +1,31 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Encodes bytes into uppercase hex string using lookup table.
+ *
+ * @param bytes Bytes to encode.
+ * @param length Number of bytes.
+ *
+ * @return Hex string of 2 * length characters.
+ */
+NSString *OCTHexStringFromBytes(const uint8_t *bytes, NSUInteger length);
+
+/**
+ * Decodes hex string (both upper and lower case) into bytes using lookup table.
+ *
+ * @param string Hex string, should have exactly 2 * length characters.
+ * @param bytes Buffer to write result to.
+ * @param length Size of buffer.
+ *
+ * @return YES on success, NO if string has wrong length or contains non-hex characters.
+ * Content of bytes is undefined in latter case.
+ */
+BOOL OCTBytesFromHexString(NSString *string, uint8_t *bytes, NSUInteger length);
+
+NS_ASSUME_NONNULL_END
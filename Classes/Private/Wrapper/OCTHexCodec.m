@@ -0,0 +1,103 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import "OCTHexCodec.h"
+
+// Enough for addresses and keys, longer strings are converted in heap buffer.
+static const NSUInteger kStackBufferSize = 256;
+
+static const char kHexDigits[] = "0123456789ABCDEF";
+
+// Value of hex digit for every ASCII character, 0xFF for non-hex ones.
+static const uint8_t kHexValues[256] = {
+    ['0'] = 0x0, ['1'] = 0x1, ['2'] = 0x2, ['3'] = 0x3, ['4'] = 0x4,
+    ['5'] = 0x5, ['6'] = 0x6, ['7'] = 0x7, ['8'] = 0x8, ['9'] = 0x9,
+    ['A'] = 0xA, ['B'] = 0xB, ['C'] = 0xC, ['D'] = 0xD, ['E'] = 0xE, ['F'] = 0xF,
+    ['a'] = 0xA, ['b'] = 0xB, ['c'] = 0xC, ['d'] = 0xD, ['e'] = 0xE, ['f'] = 0xF,
+};
+
+// kHexValues has 0 for both '0' and non-hex characters, this table tells them apart.
+static const uint8_t kHexValid[256] = {
+    ['0'] = 1, ['1'] = 1, ['2'] = 1, ['3'] = 1, ['4'] = 1,
+    ['5'] = 1, ['6'] = 1, ['7'] = 1, ['8'] = 1, ['9'] = 1,
+    ['A'] = 1, ['B'] = 1, ['C'] = 1, ['D'] = 1, ['E'] = 1, ['F'] = 1,
+    ['a'] = 1, ['b'] = 1, ['c'] = 1, ['d'] = 1, ['e'] = 1, ['f'] = 1,
+};
+
+NSString *OCTHexStringFromBytes(const uint8_t *bytes, NSUInteger length)
+{
+    NSCParameterAssert(bytes || length == 0);
+
+    const NSUInteger hexLength = 2 * length;
+
+    char stackBuffer[kStackBufferSize];
+    char *buffer = (hexLength <= kStackBufferSize) ? stackBuffer : malloc(hexLength);
+
+    for (NSUInteger idx = 0; idx < length; idx++) {
+        buffer[2 * idx] = kHexDigits[bytes[idx] >> 4];
+        buffer[2 * idx + 1] = kHexDigits[bytes[idx] & 0x0F];
+    }
+
+    NSString *string = [[NSString alloc] initWithBytes:buffer length:hexLength encoding:NSASCIIStringEncoding];
+
+    if (buffer != stackBuffer) {
+        free(buffer);
+    }
+
+    return string;
+}
+
+static BOOL OCTDecodeHexCharacters(const char *hex, uint8_t *bytes, NSUInteger length)
+{
+    uint8_t valid = 1;
+
+    for (NSUInteger idx = 0; idx < length; idx++) {
+        const uint8_t high = (uint8_t)hex[2 * idx];
+        const uint8_t low = (uint8_t)hex[2 * idx + 1];
+
+        // No branches inside of loop, validity is checked once at the end.
+        valid &= kHexValid[high] & kHexValid[low];
+        bytes[idx] = (uint8_t)(kHexValues[high] << 4) | kHexValues[low];
+    }
+
+    return valid == 1;
+}
+
+BOOL OCTBytesFromHexString(NSString *string, uint8_t *bytes, NSUInteger length)
+{
+    NSCParameterAssert(string);
+    NSCParameterAssert(bytes || length == 0);
+
+    const NSUInteger hexLength = 2 * length;
+
+    if (string.length != hexLength) {
+        return NO;
+    }
+
+    const char *hex = CFStringGetCStringPtr((__bridge CFStringRef)string, kCFStringEncodingASCII);
+
+    if (hex) {
+        return OCTDecodeHexCharacters(hex, bytes, length);
+    }
+
+    char stackBuffer[kStackBufferSize];
+    char *buffer = (hexLength <= kStackBufferSize) ? stackBuffer : malloc(hexLength);
+
+    NSUInteger usedLength = 0;
+    BOOL result = [string getBytes:buffer
+                         maxLength:hexLength
+                        usedLength:&usedLength
+                          encoding:NSASCIIStringEncoding
+                           options:0
+                             range:NSMakeRange(0, hexLength)
+                    remainingRange:NULL];
+
+    result = result && (usedLength == hexLength) && OCTDecodeHexCharacters(buffer, bytes, length);
+
+    if (buffer != stackBuffer) {
+        free(buffer);
+    }
+
+    return result;
+}
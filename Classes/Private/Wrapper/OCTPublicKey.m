@@ -0,0 +1,106 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <toxcore/tox.h>
+
+#import "OCTPublicKey.h"
+#import "OCTHexCodec.h"
+
+const NSUInteger kOCTPublicKeySize = TOX_PUBLIC_KEY_SIZE;
+
+@implementation OCTPublicKey
+{
+    uint8_t _bytes[TOX_PUBLIC_KEY_SIZE];
+}
+
+#pragma mark -  Lifecycle
+
+- (instancetype)initWithBytes:(const uint8_t *)bytes
+{
+    NSParameterAssert(bytes);
+
+    self = [super init];
+
+    if (! self) {
+        return nil;
+    }
+
+    memcpy(_bytes, bytes, TOX_PUBLIC_KEY_SIZE);
+
+    return self;
+}
+
+- (instancetype)initWithHexString:(NSString *)hexString
+{
+    NSParameterAssert(hexString);
+
+    uint8_t bytes[TOX_PUBLIC_KEY_SIZE];
+
+    if (! OCTBytesFromHexString(hexString, bytes, TOX_PUBLIC_KEY_SIZE)) {
+        return nil;
+    }
+
+    return [self initWithBytes:bytes];
+}
+
+#pragma mark -  Properties
+
+- (const uint8_t *)bytes
+{
+    return _bytes;
+}
+
+- (NSString *)hexString
+{
+    return OCTHexStringFromBytes(_bytes, TOX_PUBLIC_KEY_SIZE);
+}
+
+#pragma mark -  Public
+
+- (BOOL)isEqualToPublicKey:(OCTPublicKey *)publicKey
+{
+    if (! publicKey) {
+        return NO;
+    }
+
+    return memcmp(_bytes, publicKey->_bytes, TOX_PUBLIC_KEY_SIZE) == 0;
+}
+
+#pragma mark -  NSObject
+
+- (BOOL)isEqual:(id)object
+{
+    if (self == object) {
+        return YES;
+    }
+
+    if (! [object isKindOfClass:[OCTPublicKey class]]) {
+        return NO;
+    }
+
+    return [self isEqualToPublicKey:object];
+}
+
+- (NSUInteger)hash
+{
+    // Public keys are uniformly distributed, so any part of key is good enough hash.
+    NSUInteger hash;
+    memcpy(&hash, _bytes, sizeof(hash));
+
+    return hash;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"OCTPublicKey %@", self.hexString];
+}
+
+#pragma mark -  NSCopying
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    return self;
+}
+
+@end
@@ -3,12 +3,17 @@
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #import "OCTTox.h"
+#import "OCTToxEventBatch+Private.h"
 #import <toxcore/tox.h>
 
+@class OCTToxExecutor;
+
 /**
  * Tox functions
  */
 extern void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
+extern bool (*_tox_file_get_file_id)(const Tox *tox, uint32_t friend_number, uint32_t file_number, uint8_t *file_id,
+                                     TOX_ERR_FILE_GET *error);
 
 /**
  * Callbacks
@@ -32,6 +37,57 @@ tox_file_recv_chunk_cb fileReceiveChunkCallback;
 
 @property (assign, nonatomic) Tox *tox;
 
+/**
+ * All toxcore calls go through executor, so they are serialized with tox_iterate.
+ */
+@property (strong, nonatomic, readonly) OCTToxExecutor *executor;
+
+/**
+ * Called by OCTToxRunLoop on iterate queue. Executes pending executor commands before tox_iterate.
+ */
+- (void)iterate;
+
+/**
+ * @return Time in milliseconds before next iterate call.
+ */
+- (uint32_t)iterationInterval;
+
+/**
+ * Calls block on delegate queue. With OCTToxDelegateQueueIterate block is called synchronously.
+ */
+- (void)dispatchToDelegate:(dispatch_block_t)block;
+
+/**
+ * Delivers event to delegate. Inside of event batch event is postponed till the end of batch.
+ */
+- (void)deliverEvent:(OCTToxEventBlock)event;
+
+/**
+ * Same as deliverEvent:, for event related to friend.
+ *
+ * @param friendNumber Friend event is related to, kOCTToxFriendNumberFailure if none.
+ * @param callsTox YES if event handler is expected to call tox back, see OCTToxEventBatch.
+ */
+- (void)deliverEvent:(OCTToxEventBlock)event friendNumber:(OCTToxFriendNumber)friendNumber callsTox:(BOOL)callsTox;
+
+/**
+ * Events delivered between these calls are passed to delegate as single OCTToxEventBatch,
+ * if delegate implements tox:receivedEventBatch: method. Called around every tox_iterate.
+ */
+- (void)beginEventBatch;
+- (void)endEventBatch;
+
+/**
+ * Passes chunk to registered sink, if any.
+ *
+ * @return YES if sink was found, NO otherwise.
+ */
+- (BOOL)passChunkToSinkWithFileNumber:(OCTToxFileNumber)fileNumber
+                         friendNumber:(OCTToxFriendNumber)friendNumber
+                                bytes:(const uint8_t *)bytes
+                               length:(size_t)length
+                             position:(OCTToxFileSize)position;
+
 - (OCTToxUserStatus)userStatusFromCUserStatus:(TOX_USER_STATUS)cStatus;
 - (OCTToxConnectionStatus)userConnectionStatusFromCUserStatus:(TOX_CONNECTION)cStatus;
 - (OCTToxMessageType)messageTypeFromCMessageType:(TOX_MESSAGE_TYPE)cType;
@@ -4,16 +4,64 @@
 
 #import "OCTTox+Private.h"
 #import "OCTToxOptions+Private.h"
+#import "OCTToxEventBatch+Private.h"
+#import "OCTToxRunLoop+Private.h"
+#import "OCTToxExecutor.h"
+#import "OCTHexCodec.h"
 #import "OCTLogging.h"
 
 void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
+bool (*_tox_file_get_file_id)(const Tox *tox, uint32_t friend_number, uint32_t file_number, uint8_t *file_id,
+                              TOX_ERR_FILE_GET *error);
+
+static const NSUInteger kPendingEventsCapacity = 64;
+
+/**
+ * Cached data of single friend.
+ */
+@interface OCTToxFriendEntry : NSObject
+
+@property (strong, nonatomic) OCTPublicKey *publicKey;
+@property (copy, nonatomic) NSString *publicKeyString;
+@property (copy, nonatomic) NSString *clientIdentifier;
+
+@end
+
+@implementation OCTToxFriendEntry
+@end
 
 @interface OCTTox ()
 
 @property (assign, nonatomic) Tox *tox;
 
-@property (strong, nonatomic) dispatch_source_t timer;
-@property (assign, nonatomic) uint64_t previousIterate;
+@property (strong, nonatomic) dispatch_queue_t iterateQueue;
+@property (strong, nonatomic, readwrite) OCTToxRunLoop *runLoop;
+@property (strong, nonatomic, readwrite) OCTToxExecutor *executor;
+@property (assign, nonatomic) BOOL running;
+
+@property (assign, nonatomic) OCTToxDelegateQueue delegateQueueType;
+@property (strong, nonatomic) dispatch_queue_t delegateQueue;
+@property (assign, atomic) OCTToxDelegateCapabilities delegateCapabilities;
+
+// Events are collected here during iteration when delegate receives them in batch.
+@property (strong, nonatomic) NSMutableArray<OCTToxEventBlock> *pendingEvents;
+@property (strong, nonatomic) NSMutableIndexSet *pendingToxEventIndexes;
+@property (strong, nonatomic) NSMutableIndexSet *pendingFriendNumbers;
+@property (assign, nonatomic) BOOL batchingEvents;
+
+// Keys are packed (friendNumber, fileNumber) pairs. Accessed on iterate queue only.
+@property (strong, nonatomic) NSMutableDictionary<NSNumber *, OCTToxFileReceiveChunkSink> *fileReceiveChunkSinks;
+
+// File ids of incoming transfers captured when they are offered, keyed as fileReceiveChunkSinks.
+// Guarded by @synchronized(receivedFileIds).
+@property (strong, nonatomic) NSMutableDictionary<NSNumber *, NSData *> *receivedFileIds;
+
+// Accessed on iterate queue only.
+@property (strong, nonatomic) NSMutableArray<OCTToxIterationObserver> *iterationObservers;
+
+// Indexed by friend number, holes are filled with NSNull. Both containers are guarded by @synchronized(friendEntries).
+@property (strong, nonatomic) NSMutableArray *friendEntries;
+@property (strong, nonatomic) NSMutableDictionary<OCTPublicKey *, NSNumber *> *friendNumbersByPublicKey;
 
 @end
 
@@ -73,8 +121,22 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
         return nil;
     }
 
+    _iterateQueue = dispatch_queue_create("me.dvor.objcTox.OCTToxQueue", NULL);
+    _runLoop = [[OCTToxRunLoop alloc] initWithQueue:_iterateQueue];
+    _executor = [[OCTToxExecutor alloc] initWithQueue:_iterateQueue];
+    _pendingEvents = [NSMutableArray arrayWithCapacity:kPendingEventsCapacity];
+    _pendingToxEventIndexes = [NSMutableIndexSet new];
+    _pendingFriendNumbers = [NSMutableIndexSet new];
+    _fileReceiveChunkSinks = [NSMutableDictionary new];
+    _receivedFileIds = [NSMutableDictionary new];
+    _iterationObservers = [NSMutableArray new];
+    _friendEntries = [NSMutableArray new];
+    _friendNumbersByPublicKey = [NSMutableDictionary new];
+    [self setupDelegateQueueWithType:options.delegateQueue];
+
     [self setupCFunctions];
     [self setupCallbacks];
+    [self fillFriendsCache];
 
     return self;
 }
@@ -84,7 +146,11 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
     [self stop];
 
     if (self.tox) {
-        tox_kill(self.tox);
+        // Iteration may still be in progress, killing tox in line with other commands.
+        Tox *tox = self.tox;
+        [self.executor performSync:^{
+            tox_kill(tox);
+        }];
     }
 
     OCTLogVerbose(@"dealloc called, tox killed");
@@ -94,13 +160,16 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
 {
     OCTLogVerbose(@"saving...");
 
-    size_t size = tox_get_savedata_size(self.tox);
-    uint8_t *cData = malloc(size);
+    __block NSData *data;
+
+    [self.executor performSync:^{
+        size_t size = tox_get_savedata_size(self.tox);
+        uint8_t *cData = malloc(size);
 
-    tox_get_savedata(self.tox, cData);
+        tox_get_savedata(self.tox, cData);
 
-    NSData *data = [NSData dataWithBytes:cData length:size];
-    free(cData);
+        data = [NSData dataWithBytesNoCopy:cData length:size freeWhenDone:YES];
+    }];
 
     OCTLogInfo(@"saved to data with length %lu", (unsigned long)data.length);
 
@@ -112,29 +181,13 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
     OCTLogVerbose(@"start method called");
 
     @synchronized(self) {
-        if (self.timer) {
+        if (self.running) {
             OCTLogWarn(@"already started");
             return;
         }
 
-        dispatch_queue_t queue = dispatch_queue_create("me.dvor.objcTox.OCTToxQueue", NULL);
-        self.timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queue);
-
-        [self updateTimerIntervalIfNeeded];
-
-        __weak OCTTox *weakSelf = self;
-        dispatch_source_set_event_handler(self.timer, ^{
-            OCTTox *strongSelf = weakSelf;
-            if (! strongSelf) {
-                return;
-            }
-
-            tox_iterate(strongSelf.tox, (__bridge void *)self);
-
-            [strongSelf updateTimerIntervalIfNeeded];
-        });
-
-        dispatch_resume(self.timer);
+        self.running = YES;
+        [self.runLoop startIteratingTox:self];
     }
 
     OCTLogInfo(@"started");
@@ -145,83 +198,128 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
     OCTLogVerbose(@"stop method called");
 
     @synchronized(self) {
-        if (! self.timer) {
+        if (! self.running) {
             OCTLogWarn(@"tox isn't running, nothing to stop");
             return;
         }
 
-        dispatch_source_cancel(self.timer);
-        self.timer = nil;
+        self.running = NO;
+        [self.runLoop stopIteratingTox];
     }
 
     OCTLogInfo(@"stopped");
 }
 
+- (void)iterate
+{
+    [self.executor drain];
+
+    [self beginEventBatch];
+    tox_iterate(self.tox, (__bridge void *)self);
+    [self endEventBatch];
+
+    if (self.iterationObservers.count) {
+        // Observers may remove themselves while being called.
+        for (OCTToxIterationObserver observer in [self.iterationObservers copy]) {
+            observer();
+        }
+    }
+}
+
+- (uint32_t)iterationInterval
+{
+    return tox_iteration_interval(self.tox);
+}
+
 #pragma mark -  Properties
 
+- (void)setDelegate:(id<OCTToxDelegate>)delegate
+{
+    _delegate = delegate;
+    self.delegateCapabilities = OCTToxDelegateCapabilitiesOfDelegate(delegate);
+}
+
 - (OCTToxConnectionStatus)connectionStatus
 {
-    return [self userConnectionStatusFromCUserStatus:tox_self_get_connection_status(self.tox)];
+    __block TOX_CONNECTION cStatus;
+
+    [self.executor performSync:^{
+        cStatus = tox_self_get_connection_status(self.tox);
+    }];
+
+    return [self userConnectionStatusFromCUserStatus:cStatus];
 }
 
 - (NSString *)userAddress
 {
     OCTLogVerbose(@"get userAddress");
 
-    const NSUInteger length = TOX_ADDRESS_SIZE;
-    uint8_t *cAddress = malloc(length);
-
-    tox_self_get_address(self.tox, cAddress);
-
-    if (! cAddress) {
-        return nil;
-    }
+    uint8_t cAddress[TOX_ADDRESS_SIZE];
+    [self getCUserAddress:cAddress];
 
-    NSString *address = [OCTTox binToHexString:cAddress length:length];
+    return OCTHexStringFromBytes(cAddress, TOX_ADDRESS_SIZE);
+}
 
-    free(cAddress);
+- (OCTToxAddress *)userAddressValue
+{
+    uint8_t cAddress[TOX_ADDRESS_SIZE];
+    [self getCUserAddress:cAddress];
 
-    return address;
+    return [[OCTToxAddress alloc] initWithBytes:cAddress];
 }
 
 - (NSString *)publicKey
 {
     OCTLogVerbose(@"get publicKey");
 
-    uint8_t *cPublicKey = malloc(TOX_PUBLIC_KEY_SIZE);
+    uint8_t cPublicKey[TOX_PUBLIC_KEY_SIZE];
+    [self getCUserPublicKey:cPublicKey];
 
-    _tox_self_get_public_key(self.tox, cPublicKey);
+    return OCTHexStringFromBytes(cPublicKey, TOX_PUBLIC_KEY_SIZE);
+}
 
-    NSString *publicKey = [OCTTox binToHexString:cPublicKey length:TOX_PUBLIC_KEY_SIZE];
-    free(cPublicKey);
+- (OCTPublicKey *)publicKeyValue
+{
+    uint8_t cPublicKey[TOX_PUBLIC_KEY_SIZE];
+    [self getCUserPublicKey:cPublicKey];
 
-    return publicKey;
+    return [[OCTPublicKey alloc] initWithBytes:cPublicKey];
 }
 
 - (NSString *)secretKey
 {
     OCTLogVerbose(@"get secretKey");
 
-    uint8_t *cSecretKey = malloc(TOX_SECRET_KEY_SIZE);
-
-    tox_self_get_secret_key(self.tox, cSecretKey);
+    uint8_t cSecretKey[TOX_SECRET_KEY_SIZE];
+    uint8_t *cSecretKeyPointer = cSecretKey;
 
-    NSString *secretKey = [OCTTox binToHexString:cSecretKey length:TOX_SECRET_KEY_SIZE];
-    free(cSecretKey);
+    [self.executor performSync:^{
+        tox_self_get_secret_key(self.tox, cSecretKeyPointer);
+    }];
 
-    return secretKey;
+    return OCTHexStringFromBytes(cSecretKey, TOX_SECRET_KEY_SIZE);
 }
 
 - (void)setNospam:(OCTToxNoSpam)nospam
 {
     OCTLogVerbose(@"set nospam");
-    tox_self_set_nospam(self.tox, nospam);
+
+    [self.executor performSync:^{
+        tox_self_set_nospam(self.tox, nospam);
+    }];
 }
 
 - (OCTToxNoSpam)nospam
 {
     OCTLogVerbose(@"get nospam");
-    return tox_self_get_nospam(self.tox);
+
+    __block OCTToxNoSpam nospam;
+
+    [self.executor performSync:^{
+        nospam = tox_self_get_nospam(self.tox);
+    }];
+
+    return nospam;
 }
 
 - (void)setUserStatus:(OCTToxUserStatus)status
@@ -240,14 +338,22 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
             break;
     }
 
-    tox_self_set_status(self.tox, cStatus);
+    [self.executor performSync:^{
+        tox_self_set_status(self.tox, cStatus);
+    }];
 
     OCTLogInfo(@"set user status to %lu", (unsigned long)status);
 }
 
 - (OCTToxUserStatus)userStatus
 {
-    return [self userStatusFromCUserStatus:tox_self_get_status(self.tox)];
+    __block TOX_USER_STATUS cStatus;
+
+    [self.executor performSync:^{
+        cStatus = tox_self_get_status(self.tox);
+    }];
+
+    return [self userStatusFromCUserStatus:cStatus];
 }
 
 #pragma mark -  Methods
@@ -259,18 +365,20 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
 
     OCTLogInfo(@"bootstrap with host %@ port %d publicKey %@", host, port, publicKey);
 
-    const char *cAddress = host.UTF8String;
-    uint8_t *cPublicKey = [OCTTox hexStringToBin:publicKey];
-
-    TOX_ERR_BOOTSTRAP cError;
+    uint8_t cPublicKey[TOX_PUBLIC_KEY_SIZE];
+    BOOL valid = OCTBytesFromHexString(publicKey, cPublicKey, TOX_PUBLIC_KEY_SIZE);
 
-    bool result = tox_bootstrap(self.tox, cAddress, port, cPublicKey, &cError);
+    return [self bootstrapFromHost:host port:port cPublicKey:(valid ? cPublicKey : NULL) error:error];
+}
 
-    [self fillError:error withCErrorBootstrap:cError];
+- (BOOL)bootstrapFromHost:(NSString *)host port:(OCTToxPort)port publicKeyValue:(OCTPublicKey *)publicKey error:(NSError **)error
+{
+    NSParameterAssert(host);
+    NSParameterAssert(publicKey);
 
-    free(cPublicKey);
+    OCTLogInfo(@"bootstrap with host %@ port %d %@", host, port, publicKey);
 
-    return (BOOL)result;
+    return [self bootstrapFromHost:host port:port cPublicKey:publicKey.bytes error:error];
 }
 
 - (BOOL)addTCPRelayWithHost:(NSString *)host port:(OCTToxPort)port publicKey:(NSString *)publicKey error:(NSError **)error
@@ -280,18 +388,20 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
 
     OCTLogInfo(@"add TCP relay with host %@ port %d publicKey %@", host, port, publicKey);
 
-    const char *cAddress = host.UTF8String;
-    uint8_t *cPublicKey = [OCTTox hexStringToBin:publicKey];
-
-    TOX_ERR_BOOTSTRAP cError;
+    uint8_t cPublicKey[TOX_PUBLIC_KEY_SIZE];
+    BOOL valid = OCTBytesFromHexString(publicKey, cPublicKey, TOX_PUBLIC_KEY_SIZE);
 
-    bool result = tox_add_tcp_relay(self.tox, cAddress, port, cPublicKey, &cError);
+    return [self addTCPRelayWithHost:host port:port cPublicKey:(valid ? cPublicKey : NULL) error:error];
+}
 
-    [self fillError:error withCErrorBootstrap:cError];
+- (BOOL)addTCPRelayWithHost:(NSString *)host port:(OCTToxPort)port publicKeyValue:(OCTPublicKey *)publicKey error:(NSError **)error
+{
+    NSParameterAssert(host);
+    NSParameterAssert(publicKey);
 
-    free(cPublicKey);
+    OCTLogInfo(@"add TCP relay with host %@ port %d %@", host, port, publicKey);
 
-    return (BOOL)result;
+    return [self addTCPRelayWithHost:host port:port cPublicKey:publicKey.bytes error:error];
 }
 
 - (OCTToxFriendNumber)addFriendWithAddress:(NSString *)address message:(NSString *)message error:(NSError **)error
@@ -302,19 +412,20 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
 
     OCTLogVerbose(@"add friend with address.length %lu, message.length %lu", (unsigned long)address.length, (unsigned long)message.length);
 
-    uint8_t *cAddress = [OCTTox hexStringToBin:address];
-    const char *cMessage = [message cStringUsingEncoding:NSUTF8StringEncoding];
-    size_t length = [message lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+    uint8_t cAddress[TOX_ADDRESS_SIZE];
+    BOOL valid = OCTBytesFromHexString(address, cAddress, TOX_ADDRESS_SIZE);
 
-    TOX_ERR_FRIEND_ADD cError;
-
-    OCTToxFriendNumber result = tox_friend_add(self.tox, cAddress, (const uint8_t *)cMessage, length, &cError);
+    return [self addFriendWithCAddress:(valid ? cAddress : NULL) message:message error:error];
+}
 
-    free(cAddress);
+- (OCTToxFriendNumber)addFriendWithAddressValue:(OCTToxAddress *)address message:(NSString *)message error:(NSError **)error
+{
+    NSParameterAssert(address);
+    NSParameterAssert(message);
 
-    [self fillError:error withCErrorFriendAdd:cError];
+    OCTLogVerbose(@"add friend with %@, message.length %lu", address, (unsigned long)message.length);
 
-    return result;
+    return [self addFriendWithCAddress:address.bytes message:message error:error];
 }
 
 - (OCTToxFriendNumber)addFriendWithNoRequestWithPublicKey:(NSString *)publicKey error:(NSError **)error
@@ -324,24 +435,34 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
 
     OCTLogVerbose(@"add friend with no request and publicKey.length %lu", (unsigned long)publicKey.length);
 
-    uint8_t *cPublicKey = [OCTTox hexStringToBin:publicKey];
-
-    TOX_ERR_FRIEND_ADD cError;
+    uint8_t cPublicKey[TOX_PUBLIC_KEY_SIZE];
+    BOOL valid = OCTBytesFromHexString(publicKey, cPublicKey, TOX_PUBLIC_KEY_SIZE);
 
-    OCTToxFriendNumber result = tox_friend_add_norequest(self.tox, cPublicKey, &cError);
+    return [self addFriendWithNoRequestWithCPublicKey:(valid ? cPublicKey : NULL) error:error];
+}
 
-    free(cPublicKey);
+- (OCTToxFriendNumber)addFriendWithNoRequestWithPublicKeyValue:(OCTPublicKey *)publicKey error:(NSError **)error
+{
+    NSParameterAssert(publicKey);
 
-    [self fillError:error withCErrorFriendAdd:cError];
+    OCTLogVerbose(@"add friend with no request and %@", publicKey);
 
-    return result;
+    return [self addFriendWithNoRequestWithCPublicKey:publicKey.bytes error:error];
 }
 
 - (BOOL)deleteFriendWithFriendNumber:(OCTToxFriendNumber)friendNumber error:(NSError **)error
 {
-    TOX_ERR_FRIEND_DELETE cError;
+    __block TOX_ERR_FRIEND_DELETE cError;
+    __block bool result;
 
-    bool result = tox_friend_delete(self.tox, friendNumber, &cError);
+    [self.executor performSync:^{
+        result = tox_friend_delete(self.tox, friendNumber, &cError);
+
+        if (result) {
+            [self uncacheFriendNumber:friendNumber];
+            [self forgetReceivedFileIdsOfFriendNumber:friendNumber];
+        }
+    }];
 
     [self fillError:error withCErrorFriendDelete:cError];
 
@@ -355,49 +476,95 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
     NSParameterAssert(publicKey);
     NSAssert(publicKey.length == kOCTToxPublicKeyLength, @"Public key must be kOCTToxPublicKeyLength length");
 
-    OCTLogVerbose(@"get friend number with publicKey.length %lu", (unsigned long)publicKey.length);
+    OCTPublicKey *publicKeyValue = [[OCTPublicKey alloc] initWithHexString:publicKey];
 
-    uint8_t *cPublicKey = [OCTTox hexStringToBin:publicKey];
+    if (publicKeyValue) {
+        return [self friendNumberWithPublicKeyValue:publicKeyValue error:error];
+    }
 
-    TOX_ERR_FRIEND_BY_PUBLIC_KEY cError;
+    OCTLogVerbose(@"get friend number with invalid publicKey %@", publicKey);
 
-    OCTToxFriendNumber result = tox_friend_by_public_key(self.tox, cPublicKey, &cError);
+    return [self friendNumberWithCPublicKey:NULL error:error];
+}
 
-    free(cPublicKey);
+- (OCTToxFriendNumber)friendNumberWithPublicKeyValue:(OCTPublicKey *)publicKey error:(NSError **)error
+{
+    NSParameterAssert(publicKey);
 
-    [self fillError:error withCErrorFriendByPublicKey:cError];
+    NSNumber *friendNumber;
 
-    return result;
+    @synchronized(self.friendEntries) {
+        friendNumber = self.friendNumbersByPublicKey[publicKey];
+    }
+
+    if (friendNumber) {
+        return friendNumber.intValue;
+    }
+
+    OCTLogVerbose(@"get friend number with %@", publicKey);
+
+    return [self friendNumberWithCPublicKey:publicKey.bytes error:error];
 }
 
 - (NSString *)publicKeyFromFriendNumber:(OCTToxFriendNumber)friendNumber error:(NSError **)error
 {
+    OCTToxFriendEntry *entry = [self cachedFriendEntryWithFriendNumber:friendNumber];
+
+    if (entry) {
+        return entry.publicKeyString;
+    }
+
     OCTLogVerbose(@"get public key from friend number %d", friendNumber);
 
-    uint8_t *cPublicKey = malloc(TOX_PUBLIC_KEY_SIZE);
+    uint8_t cPublicKey[TOX_PUBLIC_KEY_SIZE];
 
-    TOX_ERR_FRIEND_GET_PUBLIC_KEY cError;
+    if (! [self getCPublicKey:cPublicKey fromFriendNumber:friendNumber error:error]) {
+        return nil;
+    }
 
-    bool result = tox_friend_get_public_key(self.tox, friendNumber, cPublicKey, &cError);
+    return OCTHexStringFromBytes(cPublicKey, TOX_PUBLIC_KEY_SIZE);
+}
 
-    NSString *publicKey = nil;
+- (OCTPublicKey *)publicKeyValueFromFriendNumber:(OCTToxFriendNumber)friendNumber error:(NSError **)error
+{
+    OCTToxFriendEntry *entry = [self cachedFriendEntryWithFriendNumber:friendNumber];
 
-    if (result) {
-        publicKey = [OCTTox binToHexString:cPublicKey length:TOX_PUBLIC_KEY_SIZE];
+    if (entry) {
+        return entry.publicKey;
     }
 
-    if (cPublicKey) {
-        free(cPublicKey);
+    OCTLogVerbose(@"get public key value from friend number %d", friendNumber);
+
+    uint8_t cPublicKey[TOX_PUBLIC_KEY_SIZE];
+
+    if (! [self getCPublicKey:cPublicKey fromFriendNumber:friendNumber error:error]) {
+        return nil;
     }
 
-    [self fillError:error withCErrorFriendGetPublicKey:cError];
+    return [[OCTPublicKey alloc] initWithBytes:cPublicKey];
+}
 
-    return publicKey;
+- (void)setClientIdentifier:(NSString *)identifier forFriendNumber:(OCTToxFriendNumber)friendNumber
+{
+    @synchronized(self.friendEntries) {
+        [self cachedFriendEntryWithFriendNumber:friendNumber].clientIdentifier = identifier;
+    }
+}
+
+- (NSString *)clientIdentifierForFriendNumber:(OCTToxFriendNumber)friendNumber
+{
+    @synchronized(self.friendEntries) {
+        return [self cachedFriendEntryWithFriendNumber:friendNumber].clientIdentifier;
+    }
 }
 
 - (BOOL)friendExistsWithFriendNumber:(OCTToxFriendNumber)friendNumber
 {
-    bool result = tox_friend_exists(self.tox, friendNumber);
+    __block bool result;
+
+    [self.executor performSync:^{
+        result = tox_friend_exists(self.tox, friendNumber);
+    }];
 
     OCTLogVerbose(@"friend exists with friendNumber %d, result %d", friendNumber, result);
 
@@ -406,9 +573,12 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
 
 - (NSDate *)friendGetLastOnlineWithFriendNumber:(OCTToxFriendNumber)friendNumber error:(NSError **)error
 {
-    TOX_ERR_FRIEND_GET_LAST_ONLINE cError;
+    __block TOX_ERR_FRIEND_GET_LAST_ONLINE cError;
+    __block uint64_t timestamp;
 
-    uint64_t timestamp = tox_friend_get_last_online(self.tox, friendNumber, &cError);
+    [self.executor performSync:^{
+        timestamp = tox_friend_get_last_online(self.tox, friendNumber, &cError);
+    }];
 
     [self fillError:error withCErrorFriendGetLastOnline:cError];
 
@@ -421,9 +591,12 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
 
 - (OCTToxUserStatus)friendStatusWithFriendNumber:(OCTToxFriendNumber)friendNumber error:(NSError **)error
 {
-    TOX_ERR_FRIEND_QUERY cError;
+    __block TOX_ERR_FRIEND_QUERY cError;
+    __block TOX_USER_STATUS cStatus;
 
-    TOX_USER_STATUS cStatus = tox_friend_get_status(self.tox, friendNumber, &cError);
+    [self.executor performSync:^{
+        cStatus = tox_friend_get_status(self.tox, friendNumber, &cError);
+    }];
 
     [self fillError:error withCErrorFriendQuery:cError];
 
@@ -432,9 +605,12 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
 
 - (OCTToxConnectionStatus)friendConnectionStatusWithFriendNumber:(OCTToxFriendNumber)friendNumber error:(NSError **)error
 {
-    TOX_ERR_FRIEND_QUERY cError;
+    __block TOX_ERR_FRIEND_QUERY cError;
+    __block TOX_CONNECTION cStatus;
 
-    TOX_CONNECTION cStatus = tox_friend_get_connection_status(self.tox, friendNumber, &cError);
+    [self.executor performSync:^{
+        cStatus = tox_friend_get_connection_status(self.tox, friendNumber, &cError);
+    }];
 
     [self fillError:error withCErrorFriendQuery:cError];
 
@@ -461,9 +637,12 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
             break;
     }
 
-    TOX_ERR_FRIEND_SEND_MESSAGE cError;
+    __block TOX_ERR_FRIEND_SEND_MESSAGE cError;
+    __block OCTToxMessageId result;
 
-    OCTToxMessageId result = tox_friend_send_message(self.tox, friendNumber, cType, (const uint8_t *)cMessage, length, &cError);
+    [self.executor performSync:^{
+        result = tox_friend_send_message(self.tox, friendNumber, cType, (const uint8_t *)cMessage, length, &cError);
+    }];
 
     [self fillError:error withCErrorFriendSendMessage:cError];
 
@@ -477,9 +656,12 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
     const char *cName = [name cStringUsingEncoding:NSUTF8StringEncoding];
     size_t length = [name lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
 
-    TOX_ERR_SET_INFO cError;
+    __block TOX_ERR_SET_INFO cError;
+    __block bool result;
 
-    bool result = tox_self_set_name(self.tox, (const uint8_t *)cName, length, &cError);
+    [self.executor performSync:^{
+        result = tox_self_set_name(self.tox, (const uint8_t *)cName, length, &cError);
+    }];
 
     [self fillError:error withCErrorSetInfo:cError];
 
@@ -490,49 +672,57 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
 
 - (NSString *)userName
 {
-    size_t length = tox_self_get_name_size(self.tox);
+    __block NSData *data;
 
-    if (! length) {
-        return nil;
-    }
+    [self.executor performSync:^{
+        size_t length = tox_self_get_name_size(self.tox);
 
-    uint8_t *cName = malloc(length);
-    tox_self_get_name(self.tox, cName);
+        if (! length) {
+            return;
+        }
 
-    NSString *name = [[NSString alloc] initWithBytes:cName length:length encoding:NSUTF8StringEncoding];
+        uint8_t *cName = malloc(length);
+        tox_self_get_name(self.tox, cName);
 
-    free(cName);
+        data = [NSData dataWithBytesNoCopy:cName length:length freeWhenDone:YES];
+    }];
 
-    return name;
+    if (! data) {
+        return nil;
+    }
+
+    return [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
 }
 
 - (NSString *)friendNameWithFriendNumber:(OCTToxFriendNumber)friendNumber error:(NSError **)error
 {
-    TOX_ERR_FRIEND_QUERY cError;
-    size_t size = tox_friend_get_name_size(self.tox, friendNumber, &cError);
+    __block TOX_ERR_FRIEND_QUERY cError;
+    __block NSData *data;
 
-    [self fillError:error withCErrorFriendQuery:cError];
+    [self.executor performSync:^{
+        size_t size = tox_friend_get_name_size(self.tox, friendNumber, &cError);
 
-    if (cError != TOX_ERR_FRIEND_QUERY_OK) {
-        return nil;
-    }
+        if (cError != TOX_ERR_FRIEND_QUERY_OK) {
+            return;
+        }
 
-    uint8_t *cName = malloc(size);
-    bool result = tox_friend_get_name(self.tox, friendNumber, cName, &cError);
+        uint8_t *cName = malloc(size);
 
-    NSString *name = nil;
+        if (tox_friend_get_name(self.tox, friendNumber, cName, &cError)) {
+            data = [NSData dataWithBytesNoCopy:cName length:size freeWhenDone:YES];
+        }
+        else {
+            free(cName);
+        }
+    }];
 
-    if (result) {
-        name = [[NSString alloc] initWithBytes:cName length:size encoding:NSUTF8StringEncoding];
-    }
+    [self fillError:error withCErrorFriendQuery:cError];
 
-    if (cName) {
-        free(cName);
+    if (! data) {
+        return nil;
     }
 
-    [self fillError:error withCErrorFriendQuery:cError];
-
-    return name;
+    return [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
 }
 
 - (BOOL)setUserStatusMessage:(NSString *)statusMessage error:(NSError **)error
@@ -542,9 +732,12 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
     const char *cStatusMessage = [statusMessage cStringUsingEncoding:NSUTF8StringEncoding];
     size_t length = [statusMessage lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
 
-    TOX_ERR_SET_INFO cError;
+    __block TOX_ERR_SET_INFO cError;
+    __block bool result;
 
-    bool result = tox_self_set_status_message(self.tox, (const uint8_t *)cStatusMessage, length, &cError);
+    [self.executor performSync:^{
+        result = tox_self_set_status_message(self.tox, (const uint8_t *)cStatusMessage, length, &cError);
+    }];
 
     [self fillError:error withCErrorSetInfo:cError];
 
@@ -555,58 +748,67 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
 
 - (NSString *)userStatusMessage
 {
-    size_t length = tox_self_get_status_message_size(self.tox);
+    __block NSData *data;
 
-    if (! length) {
-        return nil;
-    }
+    [self.executor performSync:^{
+        size_t length = tox_self_get_status_message_size(self.tox);
 
-    uint8_t *cBuffer = malloc(length);
+        if (! length) {
+            return;
+        }
+
+        uint8_t *cBuffer = malloc(length);
+        tox_self_get_status_message(self.tox, cBuffer);
 
-    tox_self_get_status_message(self.tox, cBuffer);
+        data = [NSData dataWithBytesNoCopy:cBuffer length:length freeWhenDone:YES];
+    }];
 
-    NSString *message = [[NSString alloc] initWithBytes:cBuffer length:length encoding:NSUTF8StringEncoding];
-    free(cBuffer);
+    if (! data) {
+        return nil;
+    }
 
-    return message;
+    return [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
 }
 
 - (NSString *)friendStatusMessageWithFriendNumber:(OCTToxFriendNumber)friendNumber error:(NSError **)error
 {
-    TOX_ERR_FRIEND_QUERY cError;
-
-    size_t size = tox_friend_get_status_message_size(self.tox, friendNumber, &cError);
+    __block TOX_ERR_FRIEND_QUERY cError;
+    __block NSData *data;
 
-    [self fillError:error withCErrorFriendQuery:cError];
-
-    if (cError != TOX_ERR_FRIEND_QUERY_OK) {
-        return nil;
-    }
+    [self.executor performSync:^{
+        size_t size = tox_friend_get_status_message_size(self.tox, friendNumber, &cError);
 
-    uint8_t *cBuffer = malloc(size);
+        if (cError != TOX_ERR_FRIEND_QUERY_OK) {
+            return;
+        }
 
-    bool result = tox_friend_get_status_message(self.tox, friendNumber, cBuffer, &cError);
+        uint8_t *cBuffer = malloc(size);
 
-    NSString *message = nil;
+        if (tox_friend_get_status_message(self.tox, friendNumber, cBuffer, &cError)) {
+            data = [NSData dataWithBytesNoCopy:cBuffer length:size freeWhenDone:YES];
+        }
+        else {
+            free(cBuffer);
+        }
+    }];
 
-    if (result) {
-        message = [[NSString alloc] initWithBytes:cBuffer length:size encoding:NSUTF8StringEncoding];
-    }
+    [self fillError:error withCErrorFriendQuery:cError];
 
-    if (cBuffer) {
-        free(cBuffer);
+    if (! data) {
+        return nil;
     }
 
-    [self fillError:error withCErrorFriendQuery:cError];
-
-    return message;
+    return [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
 }
 
 - (BOOL)setUserIsTyping:(BOOL)isTyping forFriendNumber:(OCTToxFriendNumber)friendNumber error:(NSError **)error
 {
-    TOX_ERR_SET_TYPING cError;
+    __block TOX_ERR_SET_TYPING cError;
+    __block bool result;
 
-    bool result = tox_self_set_typing(self.tox, friendNumber, (bool)isTyping, &cError);
+    [self.executor performSync:^{
+        result = tox_self_set_typing(self.tox, friendNumber, (bool)isTyping, &cError);
+    }];
 
     [self fillError:error withCErrorSetTyping:cError];
 
@@ -617,9 +819,12 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
 
 - (BOOL)isFriendTypingWithFriendNumber:(OCTToxFriendNumber)friendNumber error:(NSError **)error
 {
-    TOX_ERR_FRIEND_QUERY cError;
+    __block TOX_ERR_FRIEND_QUERY cError;
+    __block bool isTyping;
 
-    bool isTyping = tox_friend_get_typing(self.tox, friendNumber, &cError);
+    [self.executor performSync:^{
+        isTyping = tox_friend_get_typing(self.tox, friendNumber, &cError);
+    }];
 
     [self fillError:error withCErrorFriendQuery:cError];
 
@@ -628,22 +833,35 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
 
 - (NSUInteger)friendsCount
 {
-    return tox_self_get_friend_list_size(self.tox);
+    __block NSUInteger count;
+
+    [self.executor performSync:^{
+        count = tox_self_get_friend_list_size(self.tox);
+    }];
+
+    return count;
 }
 
 - (NSArray *)friendsArray
 {
-    size_t count = tox_self_get_friend_list_size(self.tox);
+    __block size_t count;
+    __block uint32_t *cList = NULL;
+
+    [self.executor performSync:^{
+        count = tox_self_get_friend_list_size(self.tox);
+
+        if (! count) {
+            return;
+        }
+
+        cList = malloc(count * sizeof(uint32_t));
+        tox_self_get_friend_list(self.tox, cList);
+    }];
 
     if (! count) {
         return @[];
     }
 
-    size_t listSize = count * sizeof(uint32_t);
-    uint32_t *cList = malloc(listSize);
-
-    tox_self_get_friend_list(self.tox, cList);
-
     NSMutableArray *list = [NSMutableArray new];
 
     for (NSUInteger index = 0; index < count; index++) {
@@ -698,9 +916,16 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
             break;
     }
 
-    TOX_ERR_FILE_CONTROL cError;
+    __block TOX_ERR_FILE_CONTROL cError;
+    __block bool result;
 
-    bool result = tox_file_control(self.tox, friendNumber, fileNumber, cControl, &cError);
+    [self.executor performSync:^{
+        result = tox_file_control(self.tox, friendNumber, fileNumber, cControl, &cError);
+    }];
+
+    if (result && (control == OCTToxFileControlCancel)) {
+        [self forgetReceivedFileIdWithFileNumber:fileNumber friendNumber:friendNumber];
+    }
 
     [self fillError:error withCErrorFileControl:cError];
 
@@ -712,9 +937,12 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
                      position:(OCTToxFileSize)position
                         error:(NSError **)error
 {
-    TOX_ERR_FILE_SEEK cError;
+    __block TOX_ERR_FILE_SEEK cError;
+    __block bool result;
 
-    bool result = tox_file_seek(self.tox, friendNumber, fileNumber, position, &cError);
+    [self.executor performSync:^{
+        result = tox_file_seek(self.tox, friendNumber, fileNumber, position, &cError);
+    }];
 
     [self fillError:error withCErrorFileSeek:cError];
 
@@ -725,10 +953,21 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
                           friendNumber:(OCTToxFriendNumber)friendNumber
                                  error:(NSError **)error
 {
+    NSData *receivedFileId = [self receivedFileIdWithFileNumber:fileNumber friendNumber:friendNumber];
+
+    if (receivedFileId) {
+        // Offer of incoming file is being handled, no need to wait for iteration to finish.
+        return receivedFileId;
+    }
+
     uint8_t *cFileId = malloc(kOCTToxFileIdLength);
-    TOX_ERR_FILE_GET cError;
+    __block TOX_ERR_FILE_GET cError;
+    __block bool result;
+
+    [self.executor performSync:^{
+        result = _tox_file_get_file_id(self.tox, friendNumber, fileNumber, cFileId, &cError);
+    }];
 
-    bool result = tox_file_get_file_id(self.tox, friendNumber, fileNumber, cFileId, &cError);
     NSData *fileId;
 
     [self fillError:error withCErrorFileGet:cError];
@@ -751,7 +990,7 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
                                     fileName:(NSString *)fileName
                                        error:(NSError **)error
 {
-    TOX_ERR_FILE_SEND cError;
+    __block TOX_ERR_FILE_SEND cError;
     enum TOX_FILE_KIND cKind;
     const uint8_t *cFileId = NULL;
     const uint8_t *cFileName = NULL;
@@ -773,7 +1012,11 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
         cFileName = (const uint8_t *)[fileName cStringUsingEncoding:NSUTF8StringEncoding];
     }
 
-    OCTToxFileNumber result = tox_file_send(self.tox, friendNumber, cKind, fileSize, cFileId, cFileName, fileName.length, &cError);
+    __block OCTToxFileNumber result;
+
+    [self.executor performSync:^{
+        result = tox_file_send(self.tox, friendNumber, cKind, fileSize, cFileId, cFileName, fileName.length, &cError);
+    }];
 
     [self fillError:error withCErrorFileSend:cError];
 
@@ -786,33 +1029,430 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
                               data:(NSData *)data
                              error:(NSError **)error
 {
-    TOX_ERR_FILE_SEND_CHUNK cError;
+    __block TOX_ERR_FILE_SEND_CHUNK cError;
+    __block bool result;
     const uint8_t *cData = [data bytes];
 
-    bool result = tox_file_send_chunk(self.tox, friendNumber, fileNumber, position, cData, (uint32_t)data.length, &cError);
+    [self.executor performSync:^{
+        result = tox_file_send_chunk(self.tox, friendNumber, fileNumber, position, cData, (uint32_t)data.length, &cError);
+    }];
 
     [self fillError:error withCErrorFileSendChunk:cError];
 
     return (BOOL)result;
 }
 
+- (BOOL)fileSendChunkForFileNumber:(OCTToxFileNumber)fileNumber
+                      friendNumber:(OCTToxFriendNumber)friendNumber
+                          position:(OCTToxFileSize)position
+                              data:(NSData *)data
+                         errorCode:(OCTToxErrorFileSendChunk *)errorCode
+{
+    __block TOX_ERR_FILE_SEND_CHUNK cError;
+    __block bool result;
+    const uint8_t *cData = [data bytes];
+
+    [self.executor performSync:^{
+        result = tox_file_send_chunk(self.tox, friendNumber, fileNumber, position, cData, (uint32_t)data.length, &cError);
+    }];
+
+    if (! result && errorCode) {
+        *errorCode = [self errorCodeFromCErrorFileSendChunk:cError];
+    }
+
+    return (BOOL)result;
+}
+
+- (void)setFileReceiveChunkSink:(OCTToxFileReceiveChunkSink)sink
+                  forFileNumber:(OCTToxFileNumber)fileNumber
+                   friendNumber:(OCTToxFriendNumber)friendNumber
+{
+    NSNumber *key = [self fileTransferKeyWithFileNumber:fileNumber friendNumber:friendNumber];
+    sink = [sink copy];
+
+    // Sinks are used on iterate queue only, so no extra locking is needed.
+    [self.executor performSync:^{
+        self.fileReceiveChunkSinks[key] = sink;
+    }];
+}
+
+- (id)addIterationObserver:(OCTToxIterationObserver)observer
+{
+    NSParameterAssert(observer);
+
+    observer = [observer copy];
+
+    [self.executor performSync:^{
+        [self.iterationObservers addObject:observer];
+    }];
+
+    return observer;
+}
+
+- (void)removeIterationObserver:(id)token
+{
+    if (! token) {
+        return;
+    }
+
+    [self.executor performSync:^{
+        [self.iterationObservers removeObjectIdenticalTo:token];
+    }];
+}
+
 #pragma mark -  Private methods
 
-- (void)updateTimerIntervalIfNeeded
+- (NSNumber *)fileTransferKeyWithFileNumber:(OCTToxFileNumber)fileNumber friendNumber:(OCTToxFriendNumber)friendNumber
+{
+    return @(((uint64_t)friendNumber << 32) | (uint32_t)fileNumber);
+}
+
+- (void)rememberReceivedFileIdWithFileNumber:(OCTToxFileNumber)fileNumber friendNumber:(OCTToxFriendNumber)friendNumber
+{
+    uint8_t cFileId[kOCTToxFileIdLength];
+
+    if (! _tox_file_get_file_id(self.tox, friendNumber, fileNumber, cFileId, NULL)) {
+        return;
+    }
+
+    NSNumber *key = [self fileTransferKeyWithFileNumber:fileNumber friendNumber:friendNumber];
+    NSData *fileId = [NSData dataWithBytes:cFileId length:kOCTToxFileIdLength];
+
+    @synchronized(self.receivedFileIds) {
+        self.receivedFileIds[key] = fileId;
+    }
+}
+
+- (NSData *)receivedFileIdWithFileNumber:(OCTToxFileNumber)fileNumber friendNumber:(OCTToxFriendNumber)friendNumber
+{
+    NSNumber *key = [self fileTransferKeyWithFileNumber:fileNumber friendNumber:friendNumber];
+
+    @synchronized(self.receivedFileIds) {
+        return self.receivedFileIds[key];
+    }
+}
+
+- (void)forgetReceivedFileIdWithFileNumber:(OCTToxFileNumber)fileNumber friendNumber:(OCTToxFriendNumber)friendNumber
+{
+    NSNumber *key = [self fileTransferKeyWithFileNumber:fileNumber friendNumber:friendNumber];
+
+    @synchronized(self.receivedFileIds) {
+        [self.receivedFileIds removeObjectForKey:key];
+    }
+}
+
+- (void)forgetReceivedFileIdsOfFriendNumber:(OCTToxFriendNumber)friendNumber
+{
+    @synchronized(self.receivedFileIds) {
+        NSMutableArray *keys = [NSMutableArray new];
+
+        for (NSNumber *key in self.receivedFileIds) {
+            if ((OCTToxFriendNumber)(key.unsignedLongLongValue >> 32) == friendNumber) {
+                [keys addObject:key];
+            }
+        }
+
+        [self.receivedFileIds removeObjectsForKeys:keys];
+    }
+}
+
+- (BOOL)passChunkToSinkWithFileNumber:(OCTToxFileNumber)fileNumber
+                         friendNumber:(OCTToxFriendNumber)friendNumber
+                                bytes:(const uint8_t *)bytes
+                               length:(size_t)length
+                             position:(OCTToxFileSize)position
+{
+    NSNumber *key = [self fileTransferKeyWithFileNumber:fileNumber friendNumber:friendNumber];
+
+    OCTToxFileReceiveChunkSink sink = self.fileReceiveChunkSinks[key];
+
+    if (! sink) {
+        return NO;
+    }
+
+    if (length == 0) {
+        [self.fileReceiveChunkSinks removeObjectForKey:key];
+
+        // Completion goes after events that came before it, e.g. control of this transfer.
+        [self deliverEvent:^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
+            sink(NULL, 0, position);
+        } friendNumber:friendNumber callsTox:YES];
+        return YES;
+    }
+
+    sink(bytes, length, position);
+
+    return YES;
+}
+
+- (void)dispatchToDelegate:(dispatch_block_t)block
+{
+    // Pool is drained after every block, so per-thread realm instances opened by delegate don't outlive it.
+    if (self.delegateQueueType == OCTToxDelegateQueueIterate) {
+        @autoreleasepool {
+            block();
+        }
+        return;
+    }
+
+    dispatch_async(self.delegateQueue, ^{
+        @autoreleasepool {
+            block();
+        }
+    });
+}
+
+- (void)deliverEvent:(OCTToxEventBlock)event
+{
+    [self deliverEvent:event friendNumber:kOCTToxFriendNumberFailure callsTox:NO];
+}
+
+- (void)deliverEvent:(OCTToxEventBlock)event friendNumber:(OCTToxFriendNumber)friendNumber callsTox:(BOOL)callsTox
+{
+    if (self.batchingEvents) {
+        if (callsTox) {
+            [self.pendingToxEventIndexes addIndex:self.pendingEvents.count];
+        }
+
+        if (friendNumber != kOCTToxFriendNumberFailure) {
+            [self.pendingFriendNumbers addIndex:(NSUInteger)friendNumber];
+        }
+
+        [self.pendingEvents addObject:event];
+        return;
+    }
+
+    [self dispatchToDelegate:^{
+        event(self.delegate, self.delegateCapabilities);
+    }];
+}
+
+- (void)beginEventBatch
+{
+    self.batchingEvents = (self.delegateCapabilities & OCTToxDelegateCapabilityReceivedEventBatch) != 0;
+}
+
+- (void)endEventBatch
+{
+    self.batchingEvents = NO;
+
+    if (! self.pendingEvents.count) {
+        return;
+    }
+
+    OCTToxEventBatch *batch = [[OCTToxEventBatch alloc] initWithEvents:self.pendingEvents
+                                                        toxEventIndexes:self.pendingToxEventIndexes
+                                                          friendNumbers:self.pendingFriendNumbers];
+    // Keeping already allocated storage for next iteration.
+    [self.pendingEvents removeAllObjects];
+    [self.pendingToxEventIndexes removeAllIndexes];
+    [self.pendingFriendNumbers removeAllIndexes];
+
+    [self dispatchToDelegate:^{
+        id<OCTToxDelegate> delegate = self.delegate;
+
+        if (self.delegateCapabilities & OCTToxDelegateCapabilityReceivedEventBatch) {
+            [delegate tox:self receivedEventBatch:batch];
+        }
+        else {
+            [batch deliverToDelegate:delegate];
+        }
+    }];
+}
+
+- (void)setupDelegateQueueWithType:(OCTToxDelegateQueue)type
+{
+    self.delegateQueueType = type;
+
+    switch (type) {
+        case OCTToxDelegateQueueMain:
+            self.delegateQueue = dispatch_get_main_queue();
+            break;
+        case OCTToxDelegateQueueIterate:
+            self.delegateQueue = self.iterateQueue;
+            break;
+        case OCTToxDelegateQueueDedicated:
+            self.delegateQueue = dispatch_queue_create("me.dvor.objcTox.OCTToxDelegateQueue", NULL);
+            break;
+    }
+}
+
+// Invalid hex strings are passed as NULL, so toxcore reports them with *_NULL error code.
+- (BOOL)bootstrapFromHost:(NSString *)host port:(OCTToxPort)port cPublicKey:(const uint8_t *)cPublicKey error:(NSError **)error
+{
+    __block TOX_ERR_BOOTSTRAP cError;
+    __block bool result;
+
+    [self.executor performSync:^{
+        result = tox_bootstrap(self.tox, host.UTF8String, port, cPublicKey, &cError);
+    }];
+
+    [self fillError:error withCErrorBootstrap:cError];
+
+    return (BOOL)result;
+}
+
+- (BOOL)addTCPRelayWithHost:(NSString *)host port:(OCTToxPort)port cPublicKey:(const uint8_t *)cPublicKey error:(NSError **)error
+{
+    __block TOX_ERR_BOOTSTRAP cError;
+    __block bool result;
+
+    [self.executor performSync:^{
+        result = tox_add_tcp_relay(self.tox, host.UTF8String, port, cPublicKey, &cError);
+    }];
+
+    [self fillError:error withCErrorBootstrap:cError];
+
+    return (BOOL)result;
+}
+
+- (OCTToxFriendNumber)addFriendWithCAddress:(const uint8_t *)cAddress message:(NSString *)message error:(NSError **)error
+{
+    const char *cMessage = [message cStringUsingEncoding:NSUTF8StringEncoding];
+    size_t length = [message lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+
+    __block TOX_ERR_FRIEND_ADD cError;
+    __block OCTToxFriendNumber result;
+
+    [self.executor performSync:^{
+        result = tox_friend_add(self.tox, cAddress, (const uint8_t *)cMessage, length, &cError);
+
+        if (cError == TOX_ERR_FRIEND_ADD_OK) {
+            // Address starts with public key.
+            [self cacheFriendNumber:result cPublicKey:cAddress];
+        }
+    }];
+
+    [self fillError:error withCErrorFriendAdd:cError];
+
+    return result;
+}
+
+- (OCTToxFriendNumber)addFriendWithNoRequestWithCPublicKey:(const uint8_t *)cPublicKey error:(NSError **)error
+{
+    __block TOX_ERR_FRIEND_ADD cError;
+    __block OCTToxFriendNumber result;
+
+    [self.executor performSync:^{
+        result = tox_friend_add_norequest(self.tox, cPublicKey, &cError);
+
+        if (cError == TOX_ERR_FRIEND_ADD_OK) {
+            [self cacheFriendNumber:result cPublicKey:cPublicKey];
+        }
+    }];
+
+    [self fillError:error withCErrorFriendAdd:cError];
+
+    return result;
+}
+
+- (OCTToxFriendNumber)friendNumberWithCPublicKey:(const uint8_t *)cPublicKey error:(NSError **)error
+{
+    __block TOX_ERR_FRIEND_BY_PUBLIC_KEY cError;
+    __block OCTToxFriendNumber result;
+
+    [self.executor performSync:^{
+        result = tox_friend_by_public_key(self.tox, cPublicKey, &cError);
+    }];
+
+    [self fillError:error withCErrorFriendByPublicKey:cError];
+
+    return result;
+}
+
+- (BOOL)getCPublicKey:(uint8_t *)cPublicKey fromFriendNumber:(OCTToxFriendNumber)friendNumber error:(NSError **)error
+{
+    __block TOX_ERR_FRIEND_GET_PUBLIC_KEY cError;
+    __block bool result;
+
+    [self.executor performSync:^{
+        result = tox_friend_get_public_key(self.tox, friendNumber, cPublicKey, &cError);
+    }];
+
+    [self fillError:error withCErrorFriendGetPublicKey:cError];
+
+    return (BOOL)result;
+}
+
+- (void)fillFriendsCache
+{
+    // Single command for all friends, calls below are executed right away.
+    [self.executor performSync:^{
+        for (NSNumber *friendNumber in [self friendsArray]) {
+            uint8_t cPublicKey[TOX_PUBLIC_KEY_SIZE];
+
+            if ([self getCPublicKey:cPublicKey fromFriendNumber:friendNumber.intValue error:nil]) {
+                [self cacheFriendNumber:friendNumber.intValue cPublicKey:cPublicKey];
+            }
+        }
+    }];
+}
+
+- (void)getCUserAddress:(uint8_t *)cAddress
 {
-    uint64_t nextIterate = tox_iteration_interval(self.tox) * USEC_PER_SEC;
+    [self.executor performSync:^{
+        tox_self_get_address(self.tox, cAddress);
+    }];
+}
+
+- (void)getCUserPublicKey:(uint8_t *)cPublicKey
+{
+    [self.executor performSync:^{
+        _tox_self_get_public_key(self.tox, cPublicKey);
+    }];
+}
 
-    if (self.previousIterate == nextIterate) {
+- (void)cacheFriendNumber:(OCTToxFriendNumber)friendNumber cPublicKey:(const uint8_t *)cPublicKey
+{
+    if (friendNumber < 0) {
         return;
     }
 
-    self.previousIterate = nextIterate;
-    dispatch_source_set_timer(self.timer, dispatch_walltime(NULL, nextIterate), nextIterate, nextIterate / 5);
+    OCTToxFriendEntry *entry = [OCTToxFriendEntry new];
+    entry.publicKey = [[OCTPublicKey alloc] initWithBytes:cPublicKey];
+    entry.publicKeyString = entry.publicKey.hexString;
+
+    @synchronized(self.friendEntries) {
+        while (self.friendEntries.count <= (NSUInteger)friendNumber) {
+            [self.friendEntries addObject:[NSNull null]];
+        }
+
+        self.friendEntries[friendNumber] = entry;
+        self.friendNumbersByPublicKey[entry.publicKey] = @(friendNumber);
+    }
+}
+
+- (void)uncacheFriendNumber:(OCTToxFriendNumber)friendNumber
+{
+    @synchronized(self.friendEntries) {
+        OCTToxFriendEntry *entry = [self cachedFriendEntryWithFriendNumber:friendNumber];
+
+        if (! entry) {
+            return;
+        }
+
+        [self.friendNumbersByPublicKey removeObjectForKey:entry.publicKey];
+        self.friendEntries[friendNumber] = [NSNull null];
+    }
+}
+
+- (OCTToxFriendEntry *)cachedFriendEntryWithFriendNumber:(OCTToxFriendNumber)friendNumber
+{
+    @synchronized(self.friendEntries) {
+        if ((friendNumber < 0) || ((NSUInteger)friendNumber >= self.friendEntries.count)) {
+            return nil;
+        }
+
+        id entry = self.friendEntries[friendNumber];
+
+        return (entry == [NSNull null]) ? nil : entry;
+    }
 }
 
 - (void)setupCFunctions
 {
     _tox_self_get_public_key = tox_self_get_public_key;
+    _tox_file_get_file_id = tox_file_get_file_id;
 }
 
 - (void)setupCallbacks
@@ -1421,6 +2061,29 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
     return YES;
 }
 
+- (OCTToxErrorFileSendChunk)errorCodeFromCErrorFileSendChunk:(TOX_ERR_FILE_SEND_CHUNK)cError
+{
+    switch (cError) {
+        case TOX_ERR_FILE_SEND_CHUNK_OK:
+        case TOX_ERR_FILE_SEND_CHUNK_NULL:
+            return OCTToxErrorFileSendChunkUnknown;
+        case TOX_ERR_FILE_SEND_CHUNK_FRIEND_NOT_FOUND:
+            return OCTToxErrorFileSendChunkFriendNotFound;
+        case TOX_ERR_FILE_SEND_CHUNK_FRIEND_NOT_CONNECTED:
+            return OCTToxErrorFileSendChunkFriendNotConnected;
+        case TOX_ERR_FILE_SEND_CHUNK_NOT_FOUND:
+            return OCTToxErrorFileSendChunkNotFound;
+        case TOX_ERR_FILE_SEND_CHUNK_NOT_TRANSFERRING:
+            return OCTToxErrorFileSendChunkNotTransferring;
+        case TOX_ERR_FILE_SEND_CHUNK_INVALID_LENGTH:
+            return OCTToxErrorFileSendChunkInvalidLength;
+        case TOX_ERR_FILE_SEND_CHUNK_SENDQ:
+            return OCTToxErrorFileSendChunkSendq;
+        case TOX_ERR_FILE_SEND_CHUNK_WRONG_POSITION:
+            return OCTToxErrorFileSendChunkWrongPosition;
+    }
+}
+
 - (BOOL)fillError:(NSError **)error withCErrorFileSendChunk:(TOX_ERR_FILE_SEND_CHUNK)cError
 {
     if (! error || (cError == TOX_ERR_FILE_SEND_CHUNK_OK)) {
@@ -1493,34 +2156,21 @@ void (*_tox_self_get_public_key)(const Tox *tox, uint8_t *public_key);
 
 + (NSString *)binToHexString:(uint8_t *)bin length:(NSUInteger)length
 {
-    NSMutableString *string = [NSMutableString stringWithCapacity:length];
-
-    for (NSUInteger idx = 0; idx < length; ++idx) {
-        [string appendFormat:@"%02X", bin[idx]];
-    }
-
-    return [string copy];
+    return OCTHexStringFromBytes(bin, length);
 }
 
 // You are responsible for freeing the return value!
 + (uint8_t *)hexStringToBin:(NSString *)string
 {
-    // byte is represented by exactly 2 hex digits, so lenth of binary string
-    // is half of that of the hex one. only hex string with even length
-    // valid. the more proper implementation would be to check if strlen(hex_string)
-    // is odd and return error code if it is. we assume strlen is even. if it's not
-    // then the last byte just won't be written in 'ret'.
+    NSUInteger length = string.length / 2;
+    uint8_t *bin = malloc(length);
 
-    char *hex_string = (char *)string.UTF8String;
-    size_t i, len = strlen(hex_string) / 2;
-    uint8_t *ret = malloc(len);
-    char *pos = hex_string;
-
-    for (i = 0; i < len; ++i, pos += 2) {
-        sscanf(pos, "%2hhx", &ret[i]);
+    if (! OCTBytesFromHexString(string, bin, length)) {
+        free(bin);
+        return NULL;
     }
 
-    return ret;
+    return bin;
 }
 
 @end
@@ -1560,13 +2210,13 @@ void connectionStatusCallback(Tox *cTox, TOX_CONNECTION cStatus, void *userData)
 
     OCTToxConnectionStatus status = [tox userConnectionStatusFromCUserStatus:cStatus];
 
-    dispatch_async(dispatch_get_main_queue(), ^{
+    [tox deliverEvent:^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
         OCTLogCInfo(@"connectionStatusCallback with status %lu", tox, (unsigned long)status);
 
-        if ([tox.delegate respondsToSelector:@selector(tox:connectionStatus:)]) {
-            [tox.delegate tox:tox connectionStatus:status];
+        if (capabilities & OCTToxDelegateCapabilityConnectionStatus) {
+            [delegate tox:tox connectionStatus:status];
         }
-    });
+    }];
 }
 
 void friendNameCallback(Tox *cTox, uint32_t friendNumber, const uint8_t *cName, size_t length, void *userData)
@@ -1575,13 +2225,13 @@ void friendNameCallback(Tox *cTox, uint32_t friendNumber, const uint8_t *cName,
 
     NSString *name = [NSString stringWithCString:(const char *)cName encoding:NSUTF8StringEncoding];
 
-    dispatch_async(dispatch_get_main_queue(), ^{
+    [tox deliverEvent:^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
         OCTLogCInfo(@"nameChangeCallback with name %@, friend number %d", tox, name, friendNumber);
 
-        if ([tox.delegate respondsToSelector:@selector(tox:friendNameUpdate:friendNumber:)]) {
-            [tox.delegate tox:tox friendNameUpdate:name friendNumber:friendNumber];
+        if (capabilities & OCTToxDelegateCapabilityFriendName) {
+            [delegate tox:tox friendNameUpdate:name friendNumber:friendNumber];
         }
-    });
+    } friendNumber:friendNumber callsTox:NO];
 }
 
 void friendStatusMessageCallback(Tox *cTox, uint32_t friendNumber, const uint8_t *cMessage, size_t length, void *userData)
@@ -1590,13 +2240,13 @@ void friendStatusMessageCallback(Tox *cTox, uint32_t friendNumber, const uint8_t
 
     NSString *message = [NSString stringWithCString:(const char *)cMessage encoding:NSUTF8StringEncoding];
 
-    dispatch_async(dispatch_get_main_queue(), ^{
+    [tox deliverEvent:^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
         OCTLogCInfo(@"statusMessageCallback with status message %@, friend number %d", tox, message, friendNumber);
 
-        if ([tox.delegate respondsToSelector:@selector(tox:friendStatusMessageUpdate:friendNumber:)]) {
-            [tox.delegate tox:tox friendStatusMessageUpdate:message friendNumber:friendNumber];
+        if (capabilities & OCTToxDelegateCapabilityFriendStatusMessage) {
+            [delegate tox:tox friendStatusMessageUpdate:message friendNumber:friendNumber];
         }
-    });
+    } friendNumber:friendNumber callsTox:NO];
 }
 
 void friendStatusCallback(Tox *cTox, uint32_t friendNumber, TOX_USER_STATUS cStatus, void *userData)
@@ -1605,13 +2255,13 @@ void friendStatusCallback(Tox *cTox, uint32_t friendNumber, TOX_USER_STATUS cSta
 
     OCTToxUserStatus status = [tox userStatusFromCUserStatus:cStatus];
 
-    dispatch_async(dispatch_get_main_queue(), ^{
+    [tox deliverEvent:^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
         OCTLogCInfo(@"userStatusCallback with status %lu, friend number %d", tox, (unsigned long)status, friendNumber);
 
-        if ([tox.delegate respondsToSelector:@selector(tox:friendStatusUpdate:friendNumber:)]) {
-            [tox.delegate tox:tox friendStatusUpdate:status friendNumber:friendNumber];
+        if (capabilities & OCTToxDelegateCapabilityFriendStatus) {
+            [delegate tox:tox friendStatusUpdate:status friendNumber:friendNumber];
         }
-    });
+    } friendNumber:friendNumber callsTox:NO];
 }
 
 void friendConnectionStatusCallback(Tox *cTox, uint32_t friendNumber, TOX_CONNECTION cStatus, void *userData)
@@ -1622,11 +2272,16 @@ void friendConnectionStatusCallback(Tox *cTox, uint32_t friendNumber, TOX_CONNEC
 
     OCTLogCInfo(@"connectionStatusCallback with status %lu, friendNumber %d", tox, (unsigned long)status, friendNumber);
 
-    dispatch_async(dispatch_get_main_queue(), ^{
-        if ([tox.delegate respondsToSelector:@selector(tox:friendConnectionStatusChanged:friendNumber:)]) {
-            [tox.delegate tox:tox friendConnectionStatusChanged:status friendNumber:friendNumber];
+    if (status == OCTToxConnectionStatusNone) {
+        // Transfers are dropped by tox when friend goes offline.
+        [tox forgetReceivedFileIdsOfFriendNumber:friendNumber];
+    }
+
+    [tox deliverEvent:^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
+        if (capabilities & OCTToxDelegateCapabilityFriendConnectionStatus) {
+            [delegate tox:tox friendConnectionStatusChanged:status friendNumber:friendNumber];
         }
-    });
+    } friendNumber:friendNumber callsTox:YES];
 }
 
 void friendTypingCallback(Tox *cTox, uint32_t friendNumber, bool isTyping, void *userData)
@@ -1635,11 +2290,11 @@ void friendTypingCallback(Tox *cTox, uint32_t friendNumber, bool isTyping, void
 
     OCTLogCInfo(@"typingChangeCallback with isTyping %d, friend number %d", tox, isTyping, friendNumber);
 
-    dispatch_async(dispatch_get_main_queue(), ^{
-        if ([tox.delegate respondsToSelector:@selector(tox:friendIsTypingUpdate:friendNumber:)]) {
-            [tox.delegate tox:tox friendIsTypingUpdate:(BOOL)isTyping friendNumber:friendNumber];
+    [tox deliverEvent:^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
+        if (capabilities & OCTToxDelegateCapabilityFriendIsTyping) {
+            [delegate tox:tox friendIsTypingUpdate:(BOOL)isTyping friendNumber:friendNumber];
         }
-    });
+    } friendNumber:friendNumber callsTox:NO];
 }
 
 void friendReadReceiptCallback(Tox *cTox, uint32_t friendNumber, uint32_t messageId, void *userData)
@@ -1648,27 +2303,27 @@ void friendReadReceiptCallback(Tox *cTox, uint32_t friendNumber, uint32_t messag
 
     OCTLogCInfo(@"readReceiptCallback with message id %d, friendNumber %d", tox, messageId, friendNumber);
 
-    dispatch_async(dispatch_get_main_queue(), ^{
-        if ([tox.delegate respondsToSelector:@selector(tox:messageDelivered:friendNumber:)]) {
-            [tox.delegate tox:tox messageDelivered:messageId friendNumber:friendNumber];
+    [tox deliverEvent:^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
+        if (capabilities & OCTToxDelegateCapabilityMessageDelivered) {
+            [delegate tox:tox messageDelivered:messageId friendNumber:friendNumber];
         }
-    });
+    } friendNumber:friendNumber callsTox:NO];
 }
 
 void friendRequestCallback(Tox *cTox, const uint8_t *cPublicKey, const uint8_t *cMessage, size_t length, void *userData)
 {
     OCTTox *tox = (__bridge OCTTox *)(userData);
 
-    NSString *publicKey = [OCTTox binToHexString:(uint8_t *)cPublicKey length:TOX_PUBLIC_KEY_SIZE];
+    NSString *publicKey = OCTHexStringFromBytes(cPublicKey, TOX_PUBLIC_KEY_SIZE);
     NSString *message = [[NSString alloc] initWithBytes:cMessage length:length encoding:NSUTF8StringEncoding];
 
-    dispatch_async(dispatch_get_main_queue(), ^{
+    [tox deliverEvent:^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
         OCTLogCInfo(@"friendRequestCallback with publicKey %@, message %@", tox, publicKey, message);
 
-        if ([tox.delegate respondsToSelector:@selector(tox:friendRequestWithMessage:publicKey:)]) {
-            [tox.delegate tox:tox friendRequestWithMessage:message publicKey:publicKey];
+        if (capabilities & OCTToxDelegateCapabilityFriendRequest) {
+            [delegate tox:tox friendRequestWithMessage:message publicKey:publicKey];
         }
-    });
+    }];
 }
 
 void friendMessageCallback(
@@ -1684,13 +2339,13 @@ void friendMessageCallback(
     NSString *message = [[NSString alloc] initWithBytes:cMessage length:length encoding:NSUTF8StringEncoding];
     OCTToxMessageType type = [tox messageTypeFromCMessageType:cType];
 
-    dispatch_async(dispatch_get_main_queue(), ^{
+    [tox deliverEvent:^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
         OCTLogCInfo(@"friendMessageCallback with message %@, friend number %d", tox, message, friendNumber);
 
-        if ([tox.delegate respondsToSelector:@selector(tox:friendMessage:type:friendNumber:)]) {
-            [tox.delegate tox:tox friendMessage:message type:type friendNumber:friendNumber];
+        if (capabilities & OCTToxDelegateCapabilityFriendMessage) {
+            [delegate tox:tox friendMessage:message type:type friendNumber:friendNumber];
         }
-    });
+    } friendNumber:friendNumber callsTox:NO];
 }
 
 void fileReceiveControlCallback(Tox *cTox, uint32_t friendNumber, OCTToxFileNumber fileNumber, TOX_FILE_CONTROL cControl, void *userData)
@@ -1699,28 +2354,32 @@ void fileReceiveControlCallback(Tox *cTox, uint32_t friendNumber, OCTToxFileNumb
 
     OCTToxFileControl control = [tox fileControlFromCFileControl:cControl];
 
-    dispatch_async(dispatch_get_main_queue(), ^{
+    if (control == OCTToxFileControlCancel) {
+        [tox forgetReceivedFileIdWithFileNumber:fileNumber friendNumber:friendNumber];
+    }
+
+    [tox deliverEvent:^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
         OCTLogCInfo(@"fileReceiveControlCallback with friendNumber %d fileNumber %d controlType %lu",
                     tox, friendNumber, fileNumber, (unsigned long)control);
 
-        if ([tox.delegate respondsToSelector:@selector(tox:fileReceiveControl:friendNumber:fileNumber:)]) {
-            [tox.delegate tox:tox fileReceiveControl:control friendNumber:friendNumber fileNumber:fileNumber];
+        if (capabilities & OCTToxDelegateCapabilityFileReceiveControl) {
+            [delegate tox:tox fileReceiveControl:control friendNumber:friendNumber fileNumber:fileNumber];
         }
-    });
+    } friendNumber:friendNumber callsTox:YES];
 }
 
 void fileChunkRequestCallback(Tox *cTox, uint32_t friendNumber, OCTToxFileNumber fileNumber, uint64_t position, size_t length, void *userData)
 {
     OCTTox *tox = (__bridge OCTTox *)(userData);
 
-    dispatch_async(dispatch_get_main_queue(), ^{
-        if ([tox.delegate respondsToSelector:@selector(tox:fileChunkRequestForFileNumber:friendNumber:position:length:)]) {
-            [tox.delegate tox:tox fileChunkRequestForFileNumber:fileNumber
+    [tox deliverEvent:^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
+        if (capabilities & OCTToxDelegateCapabilityFileChunkRequest) {
+            [delegate tox:tox fileChunkRequestForFileNumber:fileNumber
                  friendNumber:friendNumber
                      position:position
                        length:length];
         }
-    });
+    } friendNumber:friendNumber callsTox:YES];
 }
 
 void fileReceiveCallback(
@@ -1748,18 +2407,21 @@ void fileReceiveCallback(
 
     NSString *fileName = [[NSString alloc] initWithBytes:cFileName length:fileNameLength encoding:NSUTF8StringEncoding];
 
-    dispatch_async(dispatch_get_main_queue(), ^{
+    // Delegate usually asks for file id right away, it is read here while tox is not busy with iteration.
+    [tox rememberReceivedFileIdWithFileNumber:fileNumber friendNumber:friendNumber];
+
+    [tox deliverEvent:^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
         OCTLogCInfo(@"fileReceiveCallback with friendNumber %d fileNumber %d kind %ld fileSize %llu fileName %@",
                     tox, friendNumber, fileNumber, (long)kind, fileSize, fileName);
 
-        if ([tox.delegate respondsToSelector:@selector(tox:fileReceiveForFileNumber:friendNumber:kind:fileSize:fileName:)]) {
-            [tox.delegate tox:tox fileReceiveForFileNumber:fileNumber
+        if (capabilities & OCTToxDelegateCapabilityFileReceive) {
+            [delegate tox:tox fileReceiveForFileNumber:fileNumber
                  friendNumber:friendNumber
                          kind:kind
                      fileSize:fileSize
                      fileName:fileName];
         }
-    });
+    } friendNumber:friendNumber callsTox:YES];
 }
 
 void fileReceiveChunkCallback(
@@ -1773,15 +2435,23 @@ void fileReceiveChunkCallback(
 {
     OCTTox *tox = (__bridge OCTTox *)(userData);
 
+    if (length == 0) {
+        [tox forgetReceivedFileIdWithFileNumber:fileNumber friendNumber:friendNumber];
+    }
+
+    if ([tox passChunkToSinkWithFileNumber:fileNumber friendNumber:friendNumber bytes:cData length:length position:position]) {
+        return;
+    }
+
     NSData *chunk = nil;
 
     if (length) {
         chunk = [NSData dataWithBytes:cData length:length];
     }
 
-    dispatch_async(dispatch_get_main_queue(), ^{
-        if ([tox.delegate respondsToSelector:@selector(tox:fileReceiveChunk:fileNumber:friendNumber:position:)]) {
-            [tox.delegate tox:tox fileReceiveChunk:chunk fileNumber:fileNumber friendNumber:friendNumber position:position];
+    [tox deliverEvent:^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
+        if (capabilities & OCTToxDelegateCapabilityFileReceiveChunk) {
+            [delegate tox:tox fileReceiveChunk:chunk fileNumber:fileNumber friendNumber:friendNumber position:position];
         }
-    });
+    } friendNumber:friendNumber callsTox:YES];
 }
@@ -38,6 +38,16 @@ toxav_video_receive_frame_cb receiveVideoFrameCallback;
 
 @property (assign, nonatomic) ToxAV *toxAV;
 
+/**
+ * Called by OCTToxRunLoop on iterate queue.
+ */
+- (void)iterate;
+
+/**
+ * @return Time in milliseconds before next iterate call.
+ */
+- (uint32_t)iterationInterval;
+
 - (BOOL)fillError:(NSError **)error withCErrorInit:(TOXAV_ERR_NEW)cError;
 - (BOOL)fillError:(NSError **)error withCErrorCall:(TOXAV_ERR_CALL)cError;
 - (BOOL)fillError:(NSError **)error withCErrorAnswer:(TOXAV_ERR_ANSWER)cError;
@@ -4,6 +4,8 @@
 
 #import "OCTTox+Private.h"
 #import "OCTToxAV+Private.h"
+#import "OCTToxRunLoop+Private.h"
+#import "OCTToxExecutor.h"
 #import "OCTLogging.h"
 
 ToxAV *(*_toxav_new)(Tox *tox, TOXAV_ERR_NEW *error);
@@ -26,9 +28,10 @@ bool (*_toxav_video_send_frame)(ToxAV *toxAV, uint32_t friend_number, uint16_t w
 
 @property (assign, nonatomic) ToxAV *toxAV;
 
-@property (strong, nonatomic) dispatch_source_t timer;
+// ToxAV depends on Tox instance, retaining it. Also used to deliver delegate methods on proper queue.
+@property (strong, nonatomic) OCTTox *tox;
 
-@property (assign, nonatomic) uint64_t previousIterate;
+@property (assign, nonatomic) BOOL running;
 
 @end
 
@@ -47,12 +50,16 @@ bool (*_toxav_video_send_frame)(ToxAV *toxAV, uint32_t friend_number, uint16_t w
 
     [self setupCFunctions];
 
-    TOXAV_ERR_NEW cError;
-    _toxAV = _toxav_new(tox.tox, &cError);
+    _tox = tox;
 
-    [self fillError:error withCErrorInit:cError];
+    __block TOXAV_ERR_NEW cError;
+
+    [tox.executor performSync:^{
+        self.toxAV = _toxav_new(tox.tox, &cError);
+        [self setupCallbacks];
+    }];
 
-    [self setupCallbacks];
+    [self fillError:error withCErrorInit:cError];
 
     return self;
 }
@@ -62,29 +69,13 @@ bool (*_toxav_video_send_frame)(ToxAV *toxAV, uint32_t friend_number, uint16_t w
     OCTLogVerbose(@"start method called");
 
     @synchronized(self) {
-        if (self.timer) {
+        if (self.running) {
             OCTLogWarn(@"already started");
             return;
         }
 
-        dispatch_queue_t queue = dispatch_queue_create("me.dvor.objcTox.OCTToxAVQueue", NULL);
-        self.timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queue);
-
-        [self updateTimerIntervalIfNeeded];
-
-        __weak OCTToxAV *weakSelf = self;
-        dispatch_source_set_event_handler(self.timer, ^{
-            OCTToxAV *strongSelf = weakSelf;
-            if (! strongSelf) {
-                return;
-            }
-
-            _toxav_iterate(strongSelf.toxAV);
-
-            [strongSelf updateTimerIntervalIfNeeded];
-        });
-
-        dispatch_resume(self.timer);
+        self.running = YES;
+        [self.tox.runLoop startIteratingToxAV:self];
     }
     OCTLogInfo(@"started");
 }
@@ -94,22 +85,36 @@ bool (*_toxav_video_send_frame)(ToxAV *toxAV, uint32_t friend_number, uint16_t w
     OCTLogVerbose(@"stop method called");
 
     @synchronized(self) {
-        if (! self.timer) {
+        if (! self.running) {
             OCTLogWarn(@"toxav isn't running, nothing to stop");
             return;
         }
 
-        dispatch_source_cancel(self.timer);
-        self.timer = nil;
+        self.running = NO;
+        [self.tox.runLoop stopIteratingToxAV];
     }
 
     OCTLogInfo(@"stopped");
 }
 
+- (void)iterate
+{
+    _toxav_iterate(self.toxAV);
+}
+
+- (uint32_t)iterationInterval
+{
+    return _toxav_iteration_interval(self.toxAV);
+}
+
 - (void)dealloc
 {
     [self stop];
-    _toxav_kill(self.toxAV);
+
+    ToxAV *toxAV = self.toxAV;
+    [self.tox.executor performSync:^{
+        _toxav_kill(toxAV);
+    }];
     OCTLogVerbose(@"dealloc called, toxav killed");
 }
 
@@ -117,8 +122,12 @@ bool (*_toxav_video_send_frame)(ToxAV *toxAV, uint32_t friend_number, uint16_t w
 
 - (BOOL)callFriendNumber:(OCTToxFriendNumber)friendNumber audioBitRate:(OCTToxAVAudioBitRate)audioBitRate videoBitRate:(OCTToxAVVideoBitRate)videoBitRate error:(NSError **)error
 {
-    TOXAV_ERR_CALL cError;
-    BOOL status = _toxav_call(self.toxAV, friendNumber, audioBitRate, videoBitRate, &cError);
+    __block TOXAV_ERR_CALL cError;
+    __block BOOL status;
+
+    [self.tox.executor performSync:^{
+        status = _toxav_call(self.toxAV, friendNumber, audioBitRate, videoBitRate, &cError);
+    }];
 
     [self fillError:error withCErrorCall:cError];
 
@@ -127,8 +136,12 @@ bool (*_toxav_video_send_frame)(ToxAV *toxAV, uint32_t friend_number, uint16_t w
 
 - (BOOL)answerIncomingCallFromFriend:(OCTToxFriendNumber)friendNumber audioBitRate:(OCTToxAVAudioBitRate)audioBitRate videoBitRate:(OCTToxAVVideoBitRate)videoBitrate error:(NSError **)error
 {
-    TOXAV_ERR_ANSWER cError;
-    BOOL status = _toxav_answer(self.toxAV, friendNumber, audioBitRate, videoBitrate, &cError);
+    __block TOXAV_ERR_ANSWER cError;
+    __block BOOL status;
+
+    [self.tox.executor performSync:^{
+        status = _toxav_answer(self.toxAV, friendNumber, audioBitRate, videoBitrate, &cError);
+    }];
 
     [self fillError:error withCErrorAnswer:cError];
 
@@ -163,9 +176,12 @@ bool (*_toxav_video_send_frame)(ToxAV *toxAV, uint32_t friend_number, uint16_t w
             break;
     }
 
-    TOXAV_ERR_CALL_CONTROL cError;
+    __block TOXAV_ERR_CALL_CONTROL cError;
+    __block BOOL status;
 
-    BOOL status = _toxav_call_control(self.toxAV, friendNumber, cControl, &cError);
+    [self.tox.executor performSync:^{
+        status = _toxav_call_control(self.toxAV, friendNumber, cControl, &cError);
+    }];
 
     [self fillError:error withCErrorControl:cError];
 
@@ -176,9 +192,12 @@ bool (*_toxav_video_send_frame)(ToxAV *toxAV, uint32_t friend_number, uint16_t w
 
 - (BOOL)setAudioBitRate:(OCTToxAVAudioBitRate)bitRate force:(BOOL)force forFriend:(OCTToxFriendNumber)friendNumber error:(NSError **)error
 {
-    TOXAV_ERR_BIT_RATE_SET cError;
+    __block TOXAV_ERR_BIT_RATE_SET cError;
+    __block BOOL status;
 
-    BOOL status = _toxav_audio_set_bit_rate(self.toxAV, friendNumber, bitRate, &cError);
+    [self.tox.executor performSync:^{
+        status = _toxav_audio_set_bit_rate(self.toxAV, friendNumber, bitRate, &cError);
+    }];
 
     [self fillError:error withCErrorSetBitRate:cError];
 
@@ -189,9 +208,12 @@ bool (*_toxav_video_send_frame)(ToxAV *toxAV, uint32_t friend_number, uint16_t w
 
 - (BOOL)setVideoBitRate:(OCTToxAVVideoBitRate)bitRate force:(BOOL)force forFriend:(OCTToxFriendNumber)friendNumber error:(NSError **)error
 {
-    TOXAV_ERR_BIT_RATE_SET cError;
+    __block TOXAV_ERR_BIT_RATE_SET cError;
+    __block BOOL status;
 
-    BOOL status = _toxav_video_set_bit_rate(self.toxAV, friendNumber, bitRate, &cError);
+    [self.tox.executor performSync:^{
+        status = _toxav_video_set_bit_rate(self.toxAV, friendNumber, bitRate, &cError);
+    }];
 
     [self fillError:error withCErrorSetBitRate:cError];
 
@@ -203,6 +225,8 @@ bool (*_toxav_video_send_frame)(ToxAV *toxAV, uint32_t friend_number, uint16_t w
               channels:(OCTToxAVChannels)channels sampleRate:(OCTToxAVSampleRate)sampleRate
               toFriend:(OCTToxFriendNumber)friendNumber error:(NSError **)error
 {
+    // Frames are sent from capture threads directly, toxav guards sending with its own locks
+    // and waiting for iteration would delay every frame.
     TOXAV_ERR_SEND_FRAME cError;
 
     BOOL status = _toxav_audio_send_frame(self.toxAV, friendNumber,
@@ -220,6 +244,7 @@ bool (*_toxav_video_send_frame)(ToxAV *toxAV, uint32_t friend_number, uint16_t w
                         vPlane:(OCTToxAVPlaneData *)vPlane
                          error:(NSError **)error
 {
+    // See sendAudioFrame:sampleCount:channels:sampleRate:toFriend:error:.
     TOXAV_ERR_SEND_FRAME cError;
     BOOL status = _toxav_video_send_frame(self.toxAV, friendNumber, width, height, yPlane, uPlane, vPlane, &cError);
 
@@ -510,18 +535,6 @@ bool (*_toxav_video_send_frame)(ToxAV *toxAV, uint32_t friend_number, uint16_t w
     return [NSError errorWithDomain:kOCTToxAVErrorDomain code:code userInfo:userInfo];
 }
 
-- (void)updateTimerIntervalIfNeeded
-{
-    uint64_t nextIterate = _toxav_iteration_interval(self.toxAV) * (NSEC_PER_SEC / 1000);
-
-    if (self.previousIterate == nextIterate) {
-        return;
-    }
-
-    self.previousIterate = nextIterate;
-    dispatch_source_set_timer(self.timer, dispatch_walltime(NULL, nextIterate), nextIterate, nextIterate / 5);
-}
-
 @end
 
 #pragma mark - Callbacks
@@ -534,12 +547,12 @@ void callIncomingCallback(ToxAV *cToxAV,
 {
     OCTToxAV *toxAV = (__bridge OCTToxAV *)userData;
 
-    dispatch_async(dispatch_get_main_queue(), ^{
+    [toxAV.tox dispatchToDelegate:^{
         OCTLogCInfo(@"callIncomingCallback from friend %lu with audio:%d with video:%d", toxAV, (unsigned long)friendNumber, audioEnabled, videoEnabled);
         if ([toxAV.delegate respondsToSelector:@selector(toxAV:receiveCallAudioEnabled:videoEnabled:friendNumber:)]) {
             [toxAV.delegate toxAV:toxAV receiveCallAudioEnabled:audioEnabled videoEnabled:videoEnabled friendNumber:friendNumber];
         }
-    });
+    }];
 }
 
 void callStateCallback(ToxAV *cToxAV,
@@ -549,7 +562,7 @@ void callStateCallback(ToxAV *cToxAV,
 {
     OCTToxAV *toxAV = (__bridge OCTToxAV *)userData;
 
-    dispatch_async(dispatch_get_main_queue(), ^{
+    [toxAV.tox dispatchToDelegate:^{
 
         OCTLogCInfo(@"callStateCallback from friend %d with state: %d", toxAV, friendNumber, cState);
 
@@ -577,7 +590,7 @@ void callStateCallback(ToxAV *cToxAV,
         if ([toxAV.delegate respondsToSelector:@selector(toxAV:callStateChanged:friendNumber:)]) {
             [toxAV.delegate toxAV:toxAV callStateChanged:state friendNumber:friendNumber];
         }
-    });
+    }];
 }
 
 void audioBitRateStatusCallback(ToxAV *cToxAV,
@@ -587,12 +600,12 @@ void audioBitRateStatusCallback(ToxAV *cToxAV,
 {
     OCTToxAV *toxAV = (__bridge OCTToxAV *)userData;
 
-    dispatch_async(dispatch_get_main_queue(), ^{
+    [toxAV.tox dispatchToDelegate:^{
         OCTLogCInfo(@"audioBitRateStatusCallback from friend %d bitRate: %d", toxAV, friendNumber, bit_rate);
         if ([toxAV.delegate respondsToSelector:@selector(toxAV:audioBitRateStatus:forFriendNumber:)]) {
             [toxAV.delegate toxAV:toxAV audioBitRateStatus:bit_rate forFriendNumber:friendNumber];
         }
-    });
+    }];
 }
 
 void videoBitRateStatusCallback(ToxAV *cToxAV,
@@ -602,12 +615,12 @@ void videoBitRateStatusCallback(ToxAV *cToxAV,
 {
     OCTToxAV *toxAV = (__bridge OCTToxAV *)userData;
 
-    dispatch_async(dispatch_get_main_queue(), ^{
+    [toxAV.tox dispatchToDelegate:^{
         OCTLogCInfo(@"videoBitRateStatusCallback from friend %d bitRate: %d", toxAV, friendNumber, bit_rate);
         if ([toxAV.delegate respondsToSelector:@selector(toxAV:videoBitRateStatus:forFriendNumber:)]) {
             [toxAV.delegate toxAV:toxAV videoBitRateStatus:bit_rate forFriendNumber:friendNumber];
         }
-    });
+    }];
 }
 
 void receiveAudioFrameCallback(ToxAV *cToxAV,
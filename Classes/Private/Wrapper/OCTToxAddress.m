@@ -0,0 +1,121 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <toxcore/tox.h>
+
+#import "OCTToxAddress.h"
+#import "OCTPublicKey.h"
+#import "OCTHexCodec.h"
+
+const NSUInteger kOCTToxAddressSize = TOX_ADDRESS_SIZE;
+
+@implementation OCTToxAddress
+{
+    uint8_t _bytes[TOX_ADDRESS_SIZE];
+}
+
+#pragma mark -  Lifecycle
+
+- (instancetype)initWithBytes:(const uint8_t *)bytes
+{
+    NSParameterAssert(bytes);
+
+    self = [super init];
+
+    if (! self) {
+        return nil;
+    }
+
+    memcpy(_bytes, bytes, TOX_ADDRESS_SIZE);
+
+    return self;
+}
+
+- (instancetype)initWithHexString:(NSString *)hexString
+{
+    NSParameterAssert(hexString);
+
+    uint8_t bytes[TOX_ADDRESS_SIZE];
+
+    if (! OCTBytesFromHexString(hexString, bytes, TOX_ADDRESS_SIZE)) {
+        return nil;
+    }
+
+    return [self initWithBytes:bytes];
+}
+
+#pragma mark -  Properties
+
+- (const uint8_t *)bytes
+{
+    return _bytes;
+}
+
+- (OCTPublicKey *)publicKey
+{
+    return [[OCTPublicKey alloc] initWithBytes:_bytes];
+}
+
+- (OCTToxNoSpam)nospam
+{
+    // Nospam is stored in network byte order.
+    uint32_t nospam;
+    memcpy(&nospam, _bytes + TOX_PUBLIC_KEY_SIZE, sizeof(nospam));
+
+    return CFSwapInt32BigToHost(nospam);
+}
+
+- (NSString *)hexString
+{
+    return OCTHexStringFromBytes(_bytes, TOX_ADDRESS_SIZE);
+}
+
+#pragma mark -  Public
+
+- (BOOL)isEqualToAddress:(OCTToxAddress *)address
+{
+    if (! address) {
+        return NO;
+    }
+
+    return memcmp(_bytes, address->_bytes, TOX_ADDRESS_SIZE) == 0;
+}
+
+#pragma mark -  NSObject
+
+- (BOOL)isEqual:(id)object
+{
+    if (self == object) {
+        return YES;
+    }
+
+    if (! [object isKindOfClass:[OCTToxAddress class]]) {
+        return NO;
+    }
+
+    return [self isEqualToAddress:object];
+}
+
+- (NSUInteger)hash
+{
+    // Addresses start with public key, which is uniformly distributed.
+    NSUInteger hash;
+    memcpy(&hash, _bytes, sizeof(hash));
+
+    return hash;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"OCTToxAddress %@", self.hexString];
+}
+
+#pragma mark -  NSCopying
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    return self;
+}
+
+@end
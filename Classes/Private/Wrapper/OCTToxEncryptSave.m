@@ -3,15 +3,7 @@
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #import "OCTToxEncryptSave.h"
-#import <toxcore/toxencryptsave/toxencryptsave.h>
-#import "OCTToxEncryptSaveConstants.h"
-#import "OCTTox+Private.h"
-
-@interface OCTToxEncryptSave ()
-
-@property (assign, nonatomic) Tox_Pass_Key *passKey;
-
-@end
+#import "OCTToxPassKey+Private.h"
 
 @implementation OCTToxEncryptSave
 
@@ -21,45 +13,28 @@
                                     toxData:(nullable NSData *)toxData
                                       error:(NSError *__nullable *__nullable)error
 {
-    self = [super init];
+    OCTToxPassKey *passKey = [OCTToxPassKey passKeyWithPassphrase:passphrase forEncryptedData:toxData error:error];
 
-    if (! self) {
+    if (! passKey) {
         return nil;
     }
 
-    TOX_ERR_KEY_DERIVATION cError;
+    return [self initWithPassKey:passKey];
+}
 
-    uint8_t salt[TOX_PASS_SALT_LENGTH];
-    bool hasSalt = false;
+- (nonnull instancetype)initWithPassKey:(nonnull OCTToxPassKey *)passKey
+{
+    NSParameterAssert(passKey);
 
-    if (toxData) {
-        hasSalt = tox_get_salt(toxData.bytes, salt, NULL);
-    }
+    self = [super init];
 
-    if (hasSalt) {
-        _passKey = tox_pass_key_derive_with_salt(
-            (const uint8_t *)[passphrase cStringUsingEncoding:NSUTF8StringEncoding],
-            [passphrase lengthOfBytesUsingEncoding:NSUTF8StringEncoding],
-            salt,
-            &cError);
-    }
-    else {
-        _passKey = tox_pass_key_derive(
-            (const uint8_t *)[passphrase cStringUsingEncoding:NSUTF8StringEncoding],
-            [passphrase lengthOfBytesUsingEncoding:NSUTF8StringEncoding],
-            &cError);
+    if (! self) {
+        return nil;
     }
 
-    [OCTToxEncryptSave fillError:error withCErrorKeyDerivation:cError];
+    _passKey = passKey;
 
-    return (_passKey != NULL) ? self : nil;
-}
-
-- (void)dealloc
-{
-    if (_passKey) {
-        tox_pass_key_free(_passKey);
-    }
+    return self;
 }
 
 #pragma mark -  Public class methods
@@ -76,21 +51,14 @@
     NSParameterAssert(data);
     NSParameterAssert(passphrase);
 
-    return [OCTToxEncryptSave convertDataOfLength:data.length encrypt:YES withConvertBlock:^bool (uint8_t *out) {
-        TOX_ERR_ENCRYPTION cError;
-
-        bool result = tox_pass_encrypt(
-            data.bytes,
-            data.length,
-            (const uint8_t *)[passphrase cStringUsingEncoding:NSUTF8StringEncoding],
-            [passphrase lengthOfBytesUsingEncoding:NSUTF8StringEncoding],
-            out,
-            &cError);
+    OCTToxPassKey *passKey = [OCTToxPassKey passKeyWithPassphrase:passphrase salt:nil error:nil];
 
-        [OCTToxEncryptSave fillError:error withCErrorEncryption:cError];
+    if (! passKey) {
+        [OCTToxPassKey fillError:error withCErrorEncryption:TOX_ERR_ENCRYPTION_KEY_DERIVATION_FAILED];
+        return nil;
+    }
 
-        return result;
-    }];
+    return [passKey encryptData:data error:error];
 }
 
 + (nullable NSData *)decryptData:(nonnull NSData *)data
@@ -100,173 +68,34 @@
     NSParameterAssert(data);
     NSParameterAssert(passphrase);
 
-    return [OCTToxEncryptSave convertDataOfLength:data.length encrypt:NO withConvertBlock:^bool (uint8_t *out) {
-        TOX_ERR_DECRYPTION cError;
+    NSData *salt = [OCTToxPassKey saltOfEncryptedData:data];
 
-        bool result = tox_pass_decrypt(
-            data.bytes,
-            data.length,
-            (const uint8_t *)[passphrase cStringUsingEncoding:NSUTF8StringEncoding],
-            [passphrase lengthOfBytesUsingEncoding:NSUTF8StringEncoding],
-            out,
-            &cError);
+    if (! salt) {
+        // Not deriving key for data that cannot be decrypted anyway.
+        [OCTToxPassKey fillError:error withCErrorDecryption:data.length ? TOX_ERR_DECRYPTION_BAD_FORMAT : TOX_ERR_DECRYPTION_NULL];
+        return nil;
+    }
 
-        [OCTToxEncryptSave fillError:error withCErrorDecryption:cError];
+    OCTToxPassKey *passKey = [OCTToxPassKey passKeyWithPassphrase:passphrase salt:salt error:nil];
 
-        return result;
-    }];
+    if (! passKey) {
+        [OCTToxPassKey fillError:error withCErrorDecryption:TOX_ERR_DECRYPTION_KEY_DERIVATION_FAILED];
+        return nil;
+    }
+
+    return [passKey decryptData:data error:error];
 }
 
 #pragma mark -  Public instance method
 
 - (nullable NSData *)encryptData:(nonnull NSData *)data error:(NSError *__nullable *__nullable)error
 {
-    NSParameterAssert(data);
-
-    return [OCTToxEncryptSave convertDataOfLength:data.length encrypt:YES withConvertBlock:^bool (uint8_t *out) {
-        TOX_ERR_ENCRYPTION cError;
-
-        bool result = tox_pass_key_encrypt(
-            self.passKey,
-            data.bytes,
-            data.length,
-            out,
-            &cError);
-
-        [OCTToxEncryptSave fillError:error withCErrorEncryption:cError];
-
-        return result;
-    }];
+    return [self.passKey encryptData:data error:error];
 }
 
 - (nullable NSData *)decryptData:(nonnull NSData *)data error:(NSError *__nullable *__nullable)error
 {
-    NSParameterAssert(data);
-
-    return [OCTToxEncryptSave convertDataOfLength:data.length encrypt:NO withConvertBlock:^bool (uint8_t *out) {
-        TOX_ERR_DECRYPTION cError;
-
-        bool result = tox_pass_key_decrypt(
-            self.passKey,
-            data.bytes,
-            data.length,
-            out,
-            &cError);
-
-        [OCTToxEncryptSave fillError:error withCErrorDecryption:cError];
-
-        return result;
-    }];
-}
-
-#pragma mark -  Private
-
-+ (NSData *)convertDataOfLength:(NSUInteger)dataLength
-                        encrypt:(BOOL)encrypt
-               withConvertBlock:(bool (^)(uint8_t *out))convertBlock
-{
-    NSUInteger outLength = dataLength + (encrypt ? TOX_PASS_ENCRYPTION_EXTRA_LENGTH : -TOX_PASS_ENCRYPTION_EXTRA_LENGTH);
-    uint8_t *out = malloc(outLength);
-
-    bool result = convertBlock(out);
-    NSData *resultData = nil;
-
-    if (result) {
-        resultData = [NSData dataWithBytes:out length:outLength];
-    }
-
-    if (out) {
-        free(out);
-    }
-
-    return resultData;
-}
-
-+ (BOOL)fillError:(NSError **)error withCErrorKeyDerivation:(TOX_ERR_KEY_DERIVATION)cError
-{
-    if (! error || (cError == TOX_ERR_KEY_DERIVATION_OK)) {
-        return NO;
-    }
-
-    switch (cError) {
-        case TOX_ERR_KEY_DERIVATION_OK:
-            NSAssert(NO, @"We shouldn't be here");
-            return NO;
-        case TOX_ERR_KEY_DERIVATION_NULL:
-        case TOX_ERR_KEY_DERIVATION_FAILED:
-            *error = [OCTTox createErrorWithCode:OCTToxEncryptSaveKeyDerivationErrorFailed
-                                     description:@"Cannot create key from given passphrase"
-                                   failureReason:nil];
-            break;
-    }
-
-
-    return YES;
-}
-
-+ (BOOL)fillError:(NSError **)error withCErrorEncryption:(TOX_ERR_ENCRYPTION)cError
-{
-    if (! error || (cError == TOX_ERR_ENCRYPTION_OK)) {
-        return NO;
-    }
-
-    OCTToxEncryptSaveEncryptionError code;
-    NSString *description = @"Encryption failed";
-    NSString *failureReason = nil;
-
-    switch (cError) {
-        case TOX_ERR_ENCRYPTION_OK:
-            NSAssert(NO, @"We shouldn't be here");
-            return NO;
-        case TOX_ERR_ENCRYPTION_NULL:
-            code = OCTToxEncryptSaveEncryptionErrorNull;
-            failureReason = @"Some input data was empty.";
-            break;
-        case TOX_ERR_ENCRYPTION_KEY_DERIVATION_FAILED:
-        case TOX_ERR_ENCRYPTION_FAILED:
-            code = OCTToxEncryptSaveEncryptionErrorFailed;
-            failureReason = @"Encryption failed, please report";
-            break;
-    }
-
-    *error = [OCTTox createErrorWithCode:code description:description failureReason:failureReason];
-
-    return YES;
-}
-
-+ (BOOL)fillError:(NSError **)error withCErrorDecryption:(TOX_ERR_DECRYPTION)cError
-{
-    if (! error || (cError == TOX_ERR_DECRYPTION_OK)) {
-        return NO;
-    }
-
-    OCTToxEncryptSaveDecryptionError code;
-    NSString *description = @"Decryption failed";
-    NSString *failureReason = nil;
-
-    switch (cError) {
-        case TOX_ERR_DECRYPTION_OK:
-            NSAssert(NO, @"We shouldn't be here");
-            return NO;
-        case TOX_ERR_DECRYPTION_NULL:
-            code = OCTToxEncryptSaveDecryptionErrorNull;
-            failureReason = @"Some input data was empty.";
-            break;
-        case TOX_ERR_DECRYPTION_BAD_FORMAT:
-            code = OCTToxEncryptSaveDecryptionErrorBadFormat;
-            failureReason = @"The input data has bad format";
-            break;
-        case TOX_ERR_DECRYPTION_INVALID_LENGTH:
-        case TOX_ERR_DECRYPTION_KEY_DERIVATION_FAILED:
-        case TOX_ERR_DECRYPTION_FAILED:
-            code = OCTToxEncryptSaveDecryptionErrorFailed;
-            failureReason = @"Decryption failed, passphrase is incorrect or data is corrupt";
-            break;
-    }
-
-    *error = [OCTTox createErrorWithCode:code description:description failureReason:failureReason];
-
-    return YES;
+    return [self.passKey decryptData:data error:error];
 }
 
 @end
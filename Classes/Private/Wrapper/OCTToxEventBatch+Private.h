@@ -0,0 +1,58 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import "OCTToxEventBatch.h"
+#import "OCTToxDelegate.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * OCTToxDelegate methods implemented by delegate, see OCTToxDelegateCapabilitiesOfDelegate().
+ */
+typedef NS_OPTIONS(NSUInteger, OCTToxDelegateCapabilities) {
+    OCTToxDelegateCapabilityReceivedEventBatch = 1 << 0,
+    OCTToxDelegateCapabilityConnectionStatus = 1 << 1,
+    OCTToxDelegateCapabilityFriendRequest = 1 << 2,
+    OCTToxDelegateCapabilityFriendMessage = 1 << 3,
+    OCTToxDelegateCapabilityFriendName = 1 << 4,
+    OCTToxDelegateCapabilityFriendStatusMessage = 1 << 5,
+    OCTToxDelegateCapabilityFriendStatus = 1 << 6,
+    OCTToxDelegateCapabilityFriendIsTyping = 1 << 7,
+    OCTToxDelegateCapabilityMessageDelivered = 1 << 8,
+    OCTToxDelegateCapabilityFriendConnectionStatus = 1 << 9,
+    OCTToxDelegateCapabilityFileReceiveControl = 1 << 10,
+    OCTToxDelegateCapabilityFileChunkRequest = 1 << 11,
+    OCTToxDelegateCapabilityFileReceive = 1 << 12,
+    OCTToxDelegateCapabilityFileReceiveChunk = 1 << 13,
+};
+
+/**
+ * Checks which OCTToxDelegate methods are implemented by delegate. Result is meant to be cached,
+ * so events can be delivered without respondsToSelector: calls.
+ */
+OCTToxDelegateCapabilities OCTToxDelegateCapabilitiesOfDelegate(id<OCTToxDelegate> __nullable delegate);
+
+/**
+ * Single event, calls appropriate delegate method if it is present in capabilities.
+ */
+typedef void (^OCTToxEventBlock)(id<OCTToxDelegate> __nullable delegate, OCTToxDelegateCapabilities capabilities);
+
+@interface OCTToxEventBatch (Private)
+
+/**
+ * Batch of events which are not related to friends and don't call tox.
+ */
+- (instancetype)initWithEvents:(NSArray<OCTToxEventBlock> *)events;
+
+/**
+ * @param toxEventIndexes Indexes of events calling tox, see deliverToDelegate:callingTox:.
+ * @param friendNumbers Numbers of friends events are related to.
+ */
+- (instancetype)initWithEvents:(NSArray<OCTToxEventBlock> *)events
+               toxEventIndexes:(NSIndexSet *)toxEventIndexes
+                 friendNumbers:(NSIndexSet *)friendNumbers;
+
+@end
+
+NS_ASSUME_NONNULL_END
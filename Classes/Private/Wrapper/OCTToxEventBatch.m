@@ -0,0 +1,112 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import "OCTToxEventBatch+Private.h"
+
+OCTToxDelegateCapabilities OCTToxDelegateCapabilitiesOfDelegate(id<OCTToxDelegate> delegate)
+{
+    const struct {
+        SEL selector;
+        OCTToxDelegateCapabilities capability;
+    } table[] = {
+        { @selector(tox:receivedEventBatch:), OCTToxDelegateCapabilityReceivedEventBatch },
+        { @selector(tox:connectionStatus:), OCTToxDelegateCapabilityConnectionStatus },
+        { @selector(tox:friendRequestWithMessage:publicKey:), OCTToxDelegateCapabilityFriendRequest },
+        { @selector(tox:friendMessage:type:friendNumber:), OCTToxDelegateCapabilityFriendMessage },
+        { @selector(tox:friendNameUpdate:friendNumber:), OCTToxDelegateCapabilityFriendName },
+        { @selector(tox:friendStatusMessageUpdate:friendNumber:), OCTToxDelegateCapabilityFriendStatusMessage },
+        { @selector(tox:friendStatusUpdate:friendNumber:), OCTToxDelegateCapabilityFriendStatus },
+        { @selector(tox:friendIsTypingUpdate:friendNumber:), OCTToxDelegateCapabilityFriendIsTyping },
+        { @selector(tox:messageDelivered:friendNumber:), OCTToxDelegateCapabilityMessageDelivered },
+        { @selector(tox:friendConnectionStatusChanged:friendNumber:), OCTToxDelegateCapabilityFriendConnectionStatus },
+        { @selector(tox:fileReceiveControl:friendNumber:fileNumber:), OCTToxDelegateCapabilityFileReceiveControl },
+        { @selector(tox:fileChunkRequestForFileNumber:friendNumber:position:length:), OCTToxDelegateCapabilityFileChunkRequest },
+        { @selector(tox:fileReceiveForFileNumber:friendNumber:kind:fileSize:fileName:), OCTToxDelegateCapabilityFileReceive },
+        { @selector(tox:fileReceiveChunk:fileNumber:friendNumber:position:), OCTToxDelegateCapabilityFileReceiveChunk },
+    };
+
+    OCTToxDelegateCapabilities capabilities = 0;
+
+    for (NSUInteger i = 0; i < sizeof(table) / sizeof(table[0]); i++) {
+        if ([delegate respondsToSelector:table[i].selector]) {
+            capabilities |= table[i].capability;
+        }
+    }
+
+    return capabilities;
+}
+
+@interface OCTToxEventBatch ()
+
+@property (copy, nonatomic) NSArray<OCTToxEventBlock> *events;
+@property (copy, nonatomic) NSIndexSet *toxEventIndexes;
+@property (strong, nonatomic, readwrite) NSIndexSet *friendNumbers;
+
+@end
+
+@implementation OCTToxEventBatch
+
+#pragma mark -  Lifecycle
+
+- (instancetype)initWithEvents:(NSArray<OCTToxEventBlock> *)events
+{
+    return [self initWithEvents:events toxEventIndexes:[NSIndexSet indexSet] friendNumbers:[NSIndexSet indexSet]];
+}
+
+- (instancetype)initWithEvents:(NSArray<OCTToxEventBlock> *)events
+               toxEventIndexes:(NSIndexSet *)toxEventIndexes
+                 friendNumbers:(NSIndexSet *)friendNumbers
+{
+    NSParameterAssert(events);
+    NSParameterAssert(toxEventIndexes);
+    NSParameterAssert(friendNumbers);
+
+    self = [super init];
+
+    if (! self) {
+        return nil;
+    }
+
+    _events = [events copy];
+    _toxEventIndexes = [toxEventIndexes copy];
+    _friendNumbers = [friendNumbers copy];
+
+    return self;
+}
+
+#pragma mark -  Public
+
+- (NSUInteger)count
+{
+    return self.events.count;
+}
+
+- (void)deliverToDelegate:(id<OCTToxDelegate>)delegate
+{
+    OCTToxDelegateCapabilities capabilities = OCTToxDelegateCapabilitiesOfDelegate(delegate);
+
+    for (OCTToxEventBlock event in self.events) {
+        event(delegate, capabilities);
+    }
+}
+
+- (void)deliverToDelegate:(id<OCTToxDelegate>)delegate callingTox:(BOOL)callingTox
+{
+    OCTToxDelegateCapabilities capabilities = OCTToxDelegateCapabilitiesOfDelegate(delegate);
+
+    [self.events enumerateObjectsUsingBlock:^(OCTToxEventBlock event, NSUInteger index, BOOL *stop) {
+        if ([self.toxEventIndexes containsIndex:index] == callingTox) {
+            event(delegate, capabilities);
+        }
+    }];
+}
+
+#pragma mark -  Description
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"OCTToxEventBatch with %lu events", (unsigned long)self.events.count];
+}
+
+@end
@@ -0,0 +1,63 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Number of buckets in latency histogram. Bucket i counts commands that waited
+ * for [2^i, 2^(i+1)) microseconds, first one also includes everything below 1 microsecond,
+ * last one includes everything above.
+ */
+extern const NSUInteger kOCTToxExecutorLatencyBucketsCount;
+
+/**
+ * Serializes all access to toxcore, which is not thread-safe.
+ *
+ * Commands can be submitted from any thread. They are collected in lock-free multi-producer queue
+ * and executed in submission order on iterate queue, at the start of every iteration or right away
+ * if queue is idle.
+ */
+@interface OCTToxExecutor : NSObject
+
+/**
+ * @param queue Serial queue Tox is iterated on.
+ */
+- (instancetype)initWithQueue:(dispatch_queue_t)queue NS_DESIGNATED_INITIALIZER;
+
+/**
+ * Executes command and waits for it to finish. Called on iterate queue command is executed immediately.
+ */
+- (void)performSync:(dispatch_block_t)command;
+
+/**
+ * Submits command and returns right away.
+ */
+- (void)performAsync:(dispatch_block_t)command;
+
+/**
+ * Executes all commands submitted so far. Should be called on iterate queue.
+ */
+- (void)drain;
+
+/**
+ * @return YES if called on iterate queue.
+ */
+- (BOOL)isCurrentQueue;
+
+/**
+ * Copy of submit-to-execute latency histogram, see kOCTToxExecutorLatencyBucketsCount.
+ * Commands executed immediately on iterate queue are not counted.
+ */
+- (NSArray<NSNumber *> *)latencyHistogram;
+
+- (void)resetLatencyHistogram;
+
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
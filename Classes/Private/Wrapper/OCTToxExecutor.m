@@ -0,0 +1,197 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <mach/mach_time.h>
+#import <stdatomic.h>
+
+#import "OCTToxExecutor.h"
+
+enum {
+    OCTToxExecutorBucketsCount = 24,
+};
+
+const NSUInteger kOCTToxExecutorLatencyBucketsCount = OCTToxExecutorBucketsCount;
+
+static const void *kOCTToxExecutorQueueKey = &kOCTToxExecutorQueueKey;
+
+typedef struct OCTToxCommandNode {
+    struct OCTToxCommandNode *next;
+    // Retained dispatch_block_t.
+    void *command;
+    uint64_t submitTime;
+} OCTToxCommandNode;
+
+@interface OCTToxExecutor () {
+    // Commands are pushed on top of this list, so it is in reversed submission order.
+    _Atomic(OCTToxCommandNode *) _head;
+    atomic_uint_fast64_t _latencyBuckets[OCTToxExecutorBucketsCount];
+    mach_timebase_info_data_t _timebase;
+}
+
+@property (strong, nonatomic) dispatch_queue_t queue;
+
+@end
+
+@implementation OCTToxExecutor
+
+#pragma mark -  Lifecycle
+
+- (instancetype)initWithQueue:(dispatch_queue_t)queue
+{
+    NSParameterAssert(queue);
+
+    self = [super init];
+
+    if (! self) {
+        return nil;
+    }
+
+    _queue = queue;
+    atomic_init(&_head, NULL);
+
+    for (NSUInteger i = 0; i < OCTToxExecutorBucketsCount; i++) {
+        atomic_init(&_latencyBuckets[i], 0);
+    }
+
+    mach_timebase_info(&_timebase);
+    dispatch_queue_set_specific(queue, kOCTToxExecutorQueueKey, (__bridge void *)self, NULL);
+
+    return self;
+}
+
+- (void)dealloc
+{
+    OCTToxCommandNode *node = atomic_exchange(&_head, NULL);
+
+    while (node) {
+        OCTToxCommandNode *next = node->next;
+        CFRelease(node->command);
+        free(node);
+        node = next;
+    }
+}
+
+#pragma mark -  Public
+
+- (void)performSync:(dispatch_block_t)command
+{
+    NSParameterAssert(command);
+
+    if ([self isCurrentQueue]) {
+        command();
+        return;
+    }
+
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+
+    [self push:^{
+        command();
+        dispatch_semaphore_signal(semaphore);
+    }];
+
+    dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+}
+
+- (void)performAsync:(dispatch_block_t)command
+{
+    NSParameterAssert(command);
+
+    [self push:command];
+}
+
+- (void)drain
+{
+    OCTToxCommandNode *node = atomic_exchange(&_head, NULL);
+
+    if (! node) {
+        return;
+    }
+
+    // Restoring submission order.
+    OCTToxCommandNode *ordered = NULL;
+
+    while (node) {
+        OCTToxCommandNode *next = node->next;
+        node->next = ordered;
+        ordered = node;
+        node = next;
+    }
+
+    uint64_t now = mach_absolute_time();
+
+    while (ordered) {
+        OCTToxCommandNode *next = ordered->next;
+
+        [self recordLatency:now - ordered->submitTime];
+
+        @autoreleasepool {
+            dispatch_block_t command = (__bridge_transfer dispatch_block_t)ordered->command;
+            command();
+        }
+
+        free(ordered);
+        ordered = next;
+        now = mach_absolute_time();
+    }
+}
+
+- (BOOL)isCurrentQueue
+{
+    return dispatch_get_specific(kOCTToxExecutorQueueKey) == (__bridge void *)self;
+}
+
+- (NSArray<NSNumber *> *)latencyHistogram
+{
+    NSMutableArray *histogram = [NSMutableArray arrayWithCapacity:OCTToxExecutorBucketsCount];
+
+    for (NSUInteger i = 0; i < OCTToxExecutorBucketsCount; i++) {
+        [histogram addObject:@(atomic_load_explicit(&_latencyBuckets[i], memory_order_relaxed))];
+    }
+
+    return [histogram copy];
+}
+
+- (void)resetLatencyHistogram
+{
+    for (NSUInteger i = 0; i < OCTToxExecutorBucketsCount; i++) {
+        atomic_store_explicit(&_latencyBuckets[i], 0, memory_order_relaxed);
+    }
+}
+
+#pragma mark -  Private
+
+- (void)push:(dispatch_block_t)command
+{
+    OCTToxCommandNode *node = malloc(sizeof(OCTToxCommandNode));
+    node->command = (__bridge_retained void *)[command copy];
+    node->submitTime = mach_absolute_time();
+
+    OCTToxCommandNode *head = atomic_load_explicit(&_head, memory_order_relaxed);
+
+    do {
+        node->next = head;
+    } while (! atomic_compare_exchange_weak_explicit(&_head, &head, node, memory_order_release, memory_order_relaxed));
+
+    // Only first command after drain wakes up the queue, others are picked up by the same drain.
+    if (! head) {
+        dispatch_async(self.queue, ^{
+            [self drain];
+        });
+    }
+}
+
+// Called on iterate queue only.
+- (void)recordLatency:(uint64_t)machTime
+{
+    uint64_t microseconds = machTime * _timebase.numer / _timebase.denom / NSEC_PER_USEC;
+
+    NSUInteger bucket = 0;
+    while ((microseconds >>= 1) && (bucket < OCTToxExecutorBucketsCount - 1)) {
+        bucket++;
+    }
+
+    atomic_fetch_add_explicit(&_latencyBuckets[bucket], 1, memory_order_relaxed);
+}
+
+@end
@@ -50,7 +50,8 @@
             @"startPort %d\n"
             @"endPort %d\n"
             @"tcpPort %d\n"
-            @"holePunchingEnabled %d\n",
+            @"holePunchingEnabled %d\n"
+            @"delegateQueue %ld\n",
             self.ipv6Enabled,
             self.udpEnabled,
             self.localDiscoveryEnabled,
@@ -60,7 +61,8 @@
             self.startPort,
             self.endPort,
             self.tcpPort,
-            self.holePunchingEnabled];
+            self.holePunchingEnabled,
+            (long)self.delegateQueue];
 }
 
 #pragma mark - Properties
@@ -205,6 +207,7 @@
     options.endPort = self.endPort;
     options.tcpPort = self.tcpPort;
     options.holePunchingEnabled = self.holePunchingEnabled;
+    options.delegateQueue = self.delegateQueue;
 
     return options;
 }
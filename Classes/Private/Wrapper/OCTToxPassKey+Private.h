@@ -0,0 +1,24 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <toxcore/toxencryptsave/toxencryptsave.h>
+
+#import "OCTToxPassKey.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface OCTToxPassKey (Private)
+
+/**
+ * Number of key derivations performed by the process so far.
+ */
++ (NSUInteger)keyDerivationsCount;
+
++ (BOOL)fillError:(NSError **)error withCErrorKeyDerivation:(TOX_ERR_KEY_DERIVATION)cError;
++ (BOOL)fillError:(NSError **)error withCErrorEncryption:(TOX_ERR_ENCRYPTION)cError;
++ (BOOL)fillError:(NSError **)error withCErrorDecryption:(TOX_ERR_DECRYPTION)cError;
+
+@end
+
+NS_ASSUME_NONNULL_END
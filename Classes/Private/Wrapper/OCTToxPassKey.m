@@ -0,0 +1,371 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <CommonCrypto/CommonDigest.h>
+#import <Security/Security.h>
+#import <stdatomic.h>
+
+#import "OCTToxPassKey+Private.h"
+#import "OCTToxEncryptSaveConstants.h"
+#import "OCTTox+Private.h"
+
+static atomic_uint_fast64_t keyDerivationsCount;
+
+@interface OCTToxPassKey ()
+
+@property (assign, nonatomic) Tox_Pass_Key *passKey;
+
+/**
+ * Set once key successfully decrypted data with its salt.
+ */
+@property (assign, atomic) BOOL verified;
+
+@end
+
+@implementation OCTToxPassKey
+
+#pragma mark -  Lifecycle
+
+- (instancetype)initWithPassKey:(Tox_Pass_Key *)passKey salt:(NSData *)salt
+{
+    self = [super init];
+
+    if (! self) {
+        return nil;
+    }
+
+    _passKey = passKey;
+    _salt = [salt copy];
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_passKey) {
+        tox_pass_key_free(_passKey);
+    }
+}
+
+#pragma mark -  Public class methods
+
++ (nullable NSData *)saltOfEncryptedData:(NSData *)data
+{
+    if (data.length < TOX_PASS_ENCRYPTION_EXTRA_LENGTH || ! tox_is_data_encrypted(data.bytes)) {
+        return nil;
+    }
+
+    NSMutableData *salt = [NSMutableData dataWithLength:TOX_PASS_SALT_LENGTH];
+
+    if (! tox_get_salt(data.bytes, salt.mutableBytes, NULL)) {
+        return nil;
+    }
+
+    return [salt copy];
+}
+
++ (nullable instancetype)passKeyWithPassphrase:(NSString *)passphrase
+                                          salt:(nullable NSData *)salt
+                                         error:(NSError **)error
+{
+    NSParameterAssert(passphrase);
+    NSParameterAssert(! salt || salt.length == TOX_PASS_SALT_LENGTH);
+
+    if (! salt) {
+        return [self deriveWithPassphrase:passphrase salt:[self randomSalt] error:error];
+    }
+
+    NSData *cacheKey = [self cacheKeyForPassphrase:passphrase salt:salt];
+    OCTToxPassKey *passKey;
+
+    @synchronized(self) {
+        passKey = [[self cache] objectForKey:cacheKey];
+    }
+
+    if (passKey) {
+        return passKey;
+    }
+
+    passKey = [self deriveWithPassphrase:passphrase salt:salt error:error];
+
+    if (! passKey) {
+        return nil;
+    }
+
+    @synchronized(self) {
+        // Same key could be derived concurrently, keeping the first one to share its verified state.
+        OCTToxPassKey *existing = [[self cache] objectForKey:cacheKey];
+
+        if (existing) {
+            return existing;
+        }
+
+        [[self cache] setObject:passKey forKey:cacheKey];
+    }
+
+    return passKey;
+}
+
++ (nullable instancetype)passKeyWithPassphrase:(NSString *)passphrase
+                              forEncryptedData:(nullable NSData *)data
+                                         error:(NSError **)error
+{
+    NSData *salt = data ? [self saltOfEncryptedData:data] : nil;
+
+    return [self passKeyWithPassphrase:passphrase salt:salt error:error];
+}
+
++ (void)derivePassKeyWithPassphrase:(NSString *)passphrase
+                               salt:(nullable NSData *)salt
+                    completionBlock:(void (^)(OCTToxPassKey *__nullable passKey, NSError *__nullable error))completionBlock
+{
+    NSParameterAssert(completionBlock);
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^{
+        NSError *error;
+        OCTToxPassKey *passKey = [self passKeyWithPassphrase:passphrase salt:salt error:&error];
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completionBlock(passKey, passKey ? nil : error);
+        });
+    });
+}
+
+#pragma mark -  Public instance methods
+
+- (BOOL)verifyEncryptedData:(NSData *)data
+{
+    NSParameterAssert(data);
+
+    if (! [self.salt isEqualToData:[OCTToxPassKey saltOfEncryptedData:data]]) {
+        return NO;
+    }
+
+    if (self.verified) {
+        return YES;
+    }
+
+    return [self decryptData:data error:nil] != nil;
+}
+
+- (nullable NSData *)encryptData:(NSData *)data error:(NSError **)error
+{
+    NSParameterAssert(data);
+
+    return [OCTToxPassKey convertDataOfLength:data.length encrypt:YES withConvertBlock:^bool (uint8_t *out) {
+        TOX_ERR_ENCRYPTION cError;
+
+        bool result = tox_pass_key_encrypt(
+            self.passKey,
+            data.bytes,
+            data.length,
+            out,
+            &cError);
+
+        [OCTToxPassKey fillError:error withCErrorEncryption:cError];
+
+        return result;
+    }];
+}
+
+- (nullable NSData *)decryptData:(NSData *)data error:(NSError **)error
+{
+    NSParameterAssert(data);
+
+    NSData *result = [OCTToxPassKey convertDataOfLength:data.length encrypt:NO withConvertBlock:^bool (uint8_t *out) {
+        TOX_ERR_DECRYPTION cError;
+
+        bool result = tox_pass_key_decrypt(
+            self.passKey,
+            data.bytes,
+            data.length,
+            out,
+            &cError);
+
+        [OCTToxPassKey fillError:error withCErrorDecryption:cError];
+
+        return result;
+    }];
+
+    if (result && ! self.verified) {
+        self.verified = [self.salt isEqualToData:[OCTToxPassKey saltOfEncryptedData:data]];
+    }
+
+    return result;
+}
+
+#pragma mark -  Private
+
++ (NSUInteger)keyDerivationsCount
+{
+    return (NSUInteger)atomic_load(&keyDerivationsCount);
+}
+
+/**
+ * Cache key -> OCTToxPassKey, keys are held weakly. Should be accessed under @synchronized(self).
+ */
++ (NSMapTable<NSData *, OCTToxPassKey *> *)cache
+{
+    static NSMapTable *cache;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = [NSMapTable strongToWeakObjectsMapTable];
+    });
+
+    return cache;
+}
+
++ (NSData *)cacheKeyForPassphrase:(NSString *)passphrase salt:(NSData *)salt
+{
+    NSData *passphraseData = [passphrase dataUsingEncoding:NSUTF8StringEncoding];
+
+    CC_SHA256_CTX context;
+    CC_SHA256_Init(&context);
+    CC_SHA256_Update(&context, salt.bytes, (CC_LONG)salt.length);
+    CC_SHA256_Update(&context, passphraseData.bytes, (CC_LONG)passphraseData.length);
+
+    NSMutableData *digest = [NSMutableData dataWithLength:CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256_Final(digest.mutableBytes, &context);
+
+    return digest;
+}
+
++ (NSData *)randomSalt
+{
+    NSMutableData *salt = [NSMutableData dataWithLength:TOX_PASS_SALT_LENGTH];
+    SecRandomCopyBytes(kSecRandomDefault, salt.length, (uint8_t *)salt.mutableBytes);
+
+    return salt;
+}
+
++ (OCTToxPassKey *)deriveWithPassphrase:(NSString *)passphrase salt:(NSData *)salt error:(NSError **)error
+{
+    TOX_ERR_KEY_DERIVATION cError;
+
+    atomic_fetch_add(&keyDerivationsCount, 1);
+
+    Tox_Pass_Key *passKey = tox_pass_key_derive_with_salt(
+        (const uint8_t *)[passphrase cStringUsingEncoding:NSUTF8StringEncoding],
+        [passphrase lengthOfBytesUsingEncoding:NSUTF8StringEncoding],
+        salt.bytes,
+        &cError);
+
+    [self fillError:error withCErrorKeyDerivation:cError];
+
+    if (! passKey) {
+        return nil;
+    }
+
+    return [[OCTToxPassKey alloc] initWithPassKey:passKey salt:salt];
+}
+
++ (NSData *)convertDataOfLength:(NSUInteger)dataLength
+                        encrypt:(BOOL)encrypt
+               withConvertBlock:(bool (^)(uint8_t *out))convertBlock
+{
+    NSUInteger outLength = dataLength + (encrypt ? TOX_PASS_ENCRYPTION_EXTRA_LENGTH : -TOX_PASS_ENCRYPTION_EXTRA_LENGTH);
+    uint8_t *out = malloc(outLength);
+
+    bool result = convertBlock(out);
+    NSData *resultData = nil;
+
+    if (result) {
+        resultData = [NSData dataWithBytes:out length:outLength];
+    }
+
+    if (out) {
+        free(out);
+    }
+
+    return resultData;
+}
+
++ (BOOL)fillError:(NSError **)error withCErrorKeyDerivation:(TOX_ERR_KEY_DERIVATION)cError
+{
+    if (! error || (cError == TOX_ERR_KEY_DERIVATION_OK)) {
+        return NO;
+    }
+
+    switch (cError) {
+        case TOX_ERR_KEY_DERIVATION_OK:
+            NSAssert(NO, @"We shouldn't be here");
+            return NO;
+        case TOX_ERR_KEY_DERIVATION_NULL:
+        case TOX_ERR_KEY_DERIVATION_FAILED:
+            *error = [OCTTox createErrorWithCode:OCTToxEncryptSaveKeyDerivationErrorFailed
+                                     description:@"Cannot create key from given passphrase"
+                                   failureReason:nil];
+            break;
+    }
+
+
+    return YES;
+}
+
++ (BOOL)fillError:(NSError **)error withCErrorEncryption:(TOX_ERR_ENCRYPTION)cError
+{
+    if (! error || (cError == TOX_ERR_ENCRYPTION_OK)) {
+        return NO;
+    }
+
+    OCTToxEncryptSaveEncryptionError code;
+    NSString *description = @"Encryption failed";
+    NSString *failureReason = nil;
+
+    switch (cError) {
+        case TOX_ERR_ENCRYPTION_OK:
+            NSAssert(NO, @"We shouldn't be here");
+            return NO;
+        case TOX_ERR_ENCRYPTION_NULL:
+            code = OCTToxEncryptSaveEncryptionErrorNull;
+            failureReason = @"Some input data was empty.";
+            break;
+        case TOX_ERR_ENCRYPTION_KEY_DERIVATION_FAILED:
+        case TOX_ERR_ENCRYPTION_FAILED:
+            code = OCTToxEncryptSaveEncryptionErrorFailed;
+            failureReason = @"Encryption failed, please report";
+            break;
+    }
+
+    *error = [OCTTox createErrorWithCode:code description:description failureReason:failureReason];
+
+    return YES;
+}
+
++ (BOOL)fillError:(NSError **)error withCErrorDecryption:(TOX_ERR_DECRYPTION)cError
+{
+    if (! error || (cError == TOX_ERR_DECRYPTION_OK)) {
+        return NO;
+    }
+
+    OCTToxEncryptSaveDecryptionError code;
+    NSString *description = @"Decryption failed";
+    NSString *failureReason = nil;
+
+    switch (cError) {
+        case TOX_ERR_DECRYPTION_OK:
+            NSAssert(NO, @"We shouldn't be here");
+            return NO;
+        case TOX_ERR_DECRYPTION_NULL:
+            code = OCTToxEncryptSaveDecryptionErrorNull;
+            failureReason = @"Some input data was empty.";
+            break;
+        case TOX_ERR_DECRYPTION_BAD_FORMAT:
+            code = OCTToxEncryptSaveDecryptionErrorBadFormat;
+            failureReason = @"The input data has bad format";
+            break;
+        case TOX_ERR_DECRYPTION_INVALID_LENGTH:
+        case TOX_ERR_DECRYPTION_KEY_DERIVATION_FAILED:
+        case TOX_ERR_DECRYPTION_FAILED:
+            code = OCTToxEncryptSaveDecryptionErrorFailed;
+            failureReason = @"Decryption failed, passphrase is incorrect or data is corrupt";
+            break;
+    }
+
+    *error = [OCTTox createErrorWithCode:code description:description failureReason:failureReason];
+
+    return YES;
+}
+
+@end
@@ -0,0 +1,29 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import "OCTToxRunLoop.h"
+
+@class OCTTox;
+@class OCTToxAV;
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface OCTToxRunLoop (Private)
+
+/**
+ * @param queue Serial queue to iterate Tox and ToxAV on.
+ */
+- (instancetype)initWithQueue:(dispatch_queue_t)queue;
+
+/**
+ * Tox and ToxAV are held weakly. Timer is started when first of them is added and stopped when both are removed.
+ */
+- (void)startIteratingTox:(OCTTox *)tox;
+- (void)stopIteratingTox;
+- (void)startIteratingToxAV:(OCTToxAV *)toxAV;
+- (void)stopIteratingToxAV;
+
+@end
+
+NS_ASSUME_NONNULL_END
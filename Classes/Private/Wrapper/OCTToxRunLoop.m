@@ -0,0 +1,330 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <mach/mach_time.h>
+
+#import "OCTToxRunLoop+Private.h"
+#import "OCTTox+Private.h"
+#import "OCTToxAV+Private.h"
+#import "OCTLogging.h"
+
+static const uint64_t kLowPowerLeewayDivider = 2;
+
+static NSTimeInterval OCTToxRunLoopCurrentTime(void)
+{
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebase);
+    });
+
+    return (NSTimeInterval)mach_absolute_time() * timebase.numer / timebase.denom / NSEC_PER_SEC;
+}
+
+@interface OCTToxRunLoopStats ()
+
+@property (assign, nonatomic, readwrite) NSUInteger iterationsCount;
+@property (assign, nonatomic, readwrite) NSTimeInterval requestedInterval;
+@property (assign, nonatomic, readwrite) NSTimeInterval lastIterateDuration;
+@property (assign, nonatomic, readwrite) NSTimeInterval averageIterateDuration;
+@property (assign, nonatomic, readwrite) NSTimeInterval maxIterateDuration;
+@property (assign, nonatomic, readwrite) NSTimeInterval lastLateness;
+@property (assign, nonatomic, readwrite) NSTimeInterval averageLateness;
+@property (assign, nonatomic, readwrite) NSTimeInterval maxLateness;
+
+@end
+
+@implementation OCTToxRunLoopStats
+
+- (instancetype)initPrivate
+{
+    return [super init];
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"OCTToxRunLoopStats: iterations %lu, requested interval %.1fms, "
+            @"duration avg %.3fms max %.3fms, lateness avg %.3fms max %.3fms",
+            (unsigned long)self.iterationsCount,
+            self.requestedInterval * 1000,
+            self.averageIterateDuration * 1000,
+            self.maxIterateDuration * 1000,
+            self.averageLateness * 1000,
+            self.maxLateness * 1000];
+}
+
+@end
+
+@interface OCTToxRunLoop ()
+
+@property (strong, nonatomic) dispatch_queue_t queue;
+@property (strong, nonatomic) dispatch_source_t timer;
+
+@property (weak, atomic) OCTTox *tox;
+@property (weak, atomic) OCTToxAV *toxAV;
+
+// Time at which next iteration should start, in OCTToxRunLoopCurrentTime units. Written under @synchronized(self).
+@property (assign, nonatomic) NSTimeInterval expectedIterationTime;
+
+// Accessed under @synchronized(self.statsLock).
+@property (strong, nonatomic) NSObject *statsLock;
+@property (assign, nonatomic) NSUInteger iterationsCount;
+@property (assign, nonatomic) NSTimeInterval requestedInterval;
+@property (assign, nonatomic) NSTimeInterval lastIterateDuration;
+@property (assign, nonatomic) NSTimeInterval totalIterateDuration;
+@property (assign, nonatomic) NSTimeInterval maxIterateDuration;
+@property (assign, nonatomic) NSTimeInterval lastLateness;
+@property (assign, nonatomic) NSTimeInterval totalLateness;
+@property (assign, nonatomic) NSTimeInterval maxLateness;
+
+@end
+
+@implementation OCTToxRunLoop
+@synthesize profile = _profile;
+
+#pragma mark -  Lifecycle
+
+- (instancetype)initWithQueue:(dispatch_queue_t)queue
+{
+    NSParameterAssert(queue);
+
+    self = [super init];
+
+    if (! self) {
+        return nil;
+    }
+
+    _queue = queue;
+    _profile = OCTToxRunLoopProfileLowPower;
+    _statsLock = [NSObject new];
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_timer) {
+        dispatch_source_cancel(_timer);
+    }
+}
+
+#pragma mark -  Properties
+
+- (OCTToxRunLoopProfile)profile
+{
+    @synchronized(self) {
+        return _profile;
+    }
+}
+
+- (void)setProfile:(OCTToxRunLoopProfile)profile
+{
+    @synchronized(self) {
+        if (_profile == profile) {
+            return;
+        }
+
+        _profile = profile;
+
+        // Timer flags can be set only on creation.
+        if (self.timer) {
+            [self stopTimer];
+            [self startTimer];
+        }
+    }
+
+    OCTLogInfo(@"profile changed to %ld", (long)profile);
+}
+
+- (BOOL)isRunning
+{
+    @synchronized(self) {
+        return self.timer != nil;
+    }
+}
+
+#pragma mark -  Public
+
+- (OCTToxRunLoopStats *)stats
+{
+    OCTToxRunLoopStats *stats = [[OCTToxRunLoopStats alloc] initPrivate];
+
+    @synchronized(self.statsLock) {
+        NSUInteger count = self.iterationsCount;
+
+        stats.iterationsCount = count;
+        stats.requestedInterval = self.requestedInterval;
+        stats.lastIterateDuration = self.lastIterateDuration;
+        stats.averageIterateDuration = count ? self.totalIterateDuration / count : 0.0;
+        stats.maxIterateDuration = self.maxIterateDuration;
+        stats.lastLateness = self.lastLateness;
+        stats.averageLateness = count ? self.totalLateness / count : 0.0;
+        stats.maxLateness = self.maxLateness;
+    }
+
+    return stats;
+}
+
+- (void)resetStats
+{
+    @synchronized(self.statsLock) {
+        self.iterationsCount = 0;
+        self.lastIterateDuration = 0.0;
+        self.totalIterateDuration = 0.0;
+        self.maxIterateDuration = 0.0;
+        self.lastLateness = 0.0;
+        self.totalLateness = 0.0;
+        self.maxLateness = 0.0;
+    }
+}
+
+#pragma mark -  Private
+
+- (void)startIteratingTox:(OCTTox *)tox
+{
+    NSParameterAssert(tox);
+
+    @synchronized(self) {
+        self.tox = tox;
+        [self startTimer];
+    }
+}
+
+- (void)stopIteratingTox
+{
+    @synchronized(self) {
+        self.tox = nil;
+        [self stopTimerIfIdle];
+    }
+}
+
+- (void)startIteratingToxAV:(OCTToxAV *)toxAV
+{
+    NSParameterAssert(toxAV);
+
+    @synchronized(self) {
+        self.toxAV = toxAV;
+        [self startTimer];
+    }
+}
+
+- (void)stopIteratingToxAV
+{
+    @synchronized(self) {
+        self.toxAV = nil;
+        [self stopTimerIfIdle];
+    }
+}
+
+#pragma mark -  Timer
+
+// Should be called under @synchronized(self).
+- (void)startTimer
+{
+    if (self.timer) {
+        return;
+    }
+
+    unsigned long flags = (_profile == OCTToxRunLoopProfileLowLatency) ? DISPATCH_TIMER_STRICT : 0;
+    self.timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, flags, self.queue);
+
+    __weak OCTToxRunLoop *weakSelf = self;
+    dispatch_source_set_event_handler(self.timer, ^{
+        [weakSelf iterate];
+    });
+
+    // First iteration is performed right away, interval is known only after it.
+    self.expectedIterationTime = OCTToxRunLoopCurrentTime();
+    dispatch_source_set_timer(self.timer, DISPATCH_TIME_NOW, DISPATCH_TIME_FOREVER, 0);
+    dispatch_resume(self.timer);
+}
+
+// Should be called under @synchronized(self).
+- (void)stopTimer
+{
+    if (! self.timer) {
+        return;
+    }
+
+    dispatch_source_cancel(self.timer);
+    self.timer = nil;
+}
+
+// Should be called under @synchronized(self).
+- (void)stopTimerIfIdle
+{
+    if (self.tox || self.toxAV) {
+        return;
+    }
+
+    [self stopTimer];
+}
+
+- (void)iterate
+{
+    @autoreleasepool {
+        OCTTox *tox = self.tox;
+        OCTToxAV *toxAV = self.toxAV;
+
+        if (! tox && ! toxAV) {
+            return;
+        }
+
+        NSTimeInterval start = OCTToxRunLoopCurrentTime();
+        NSTimeInterval lateness = MAX(start - self.expectedIterationTime, 0.0);
+
+        [tox iterate];
+        [toxAV iterate];
+
+        NSTimeInterval duration = OCTToxRunLoopCurrentTime() - start;
+
+        uint32_t intervalMs = UINT32_MAX;
+        if (tox) {
+            intervalMs = MIN(intervalMs, [tox iterationInterval]);
+        }
+        if (toxAV) {
+            intervalMs = MIN(intervalMs, [toxAV iterationInterval]);
+        }
+
+        [self recordIterationWithDuration:duration lateness:lateness interval:intervalMs / 1000.0];
+        [self scheduleNextIterationAfterMs:intervalMs];
+    }
+}
+
+- (void)scheduleNextIterationAfterMs:(uint32_t)intervalMs
+{
+    uint64_t interval = intervalMs * NSEC_PER_MSEC;
+
+    @synchronized(self) {
+        if (! self.timer) {
+            return;
+        }
+
+        uint64_t leeway = (_profile == OCTToxRunLoopProfileLowLatency) ? 0 : interval / kLowPowerLeewayDivider;
+
+        // Interval returned by toxcore is counted from the end of iteration, so timer is rearmed every time.
+        self.expectedIterationTime = OCTToxRunLoopCurrentTime() + intervalMs / 1000.0;
+        dispatch_source_set_timer(self.timer, dispatch_time(DISPATCH_TIME_NOW, interval), DISPATCH_TIME_FOREVER, leeway);
+    }
+}
+
+- (void)recordIterationWithDuration:(NSTimeInterval)duration
+                           lateness:(NSTimeInterval)lateness
+                           interval:(NSTimeInterval)interval
+{
+    @synchronized(self.statsLock) {
+        self.iterationsCount++;
+        self.requestedInterval = interval;
+
+        self.lastIterateDuration = duration;
+        self.totalIterateDuration += duration;
+        self.maxIterateDuration = MAX(self.maxIterateDuration, duration);
+
+        self.lastLateness = lateness;
+        self.totalLateness += lateness;
+        self.maxLateness = MAX(self.maxLateness, lateness);
+    }
+}
+
+@end
@@ -48,6 +48,15 @@
  */
 @property (assign, nonatomic) BOOL useFauxOfflineMessaging;
 
+/**
+ * Maximum time in seconds between tox state change and writing it to tox save file.
+ * Changes made within this interval are written at once on background queue.
+ * Pending changes are always written when application goes to background.
+ *
+ * Default value: 2.0.
+ */
+@property (assign, nonatomic) NSTimeInterval toxSaveMaxLatency;
+
 /**
  * This is default configuration for manager.
  * Each property of OCTManagerConfiguration has "Default value" field. This method returns configuration
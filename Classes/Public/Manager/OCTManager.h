@@ -9,6 +9,7 @@
 
 NS_ASSUME_NONNULL_BEGIN
 @class OCTManagerConfiguration;
+@class OCTPresenceStore;
 
 @protocol OCTSubmanagerBootstrap;
 @protocol OCTSubmanagerCalls;
@@ -55,6 +56,11 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (strong, nonatomic, readonly) id<OCTSubmanagerUser> user;
 
+/**
+ * Connection and typing state of friends.
+ */
+@property (strong, nonatomic, readonly) OCTPresenceStore *presence;
+
 /**
  * Configuration used by OCTManager.
  *
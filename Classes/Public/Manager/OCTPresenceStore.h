@@ -0,0 +1,55 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Foundation/Foundation.h>
+
+#import "OCTToxConstants.h"
+
+@class OCTFriend;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Presence of single friend. All properties are KVO-compliant, they are changed on main thread.
+ */
+@interface OCTFriendPresence : NSObject
+
+@property (assign, nonatomic, readonly) OCTToxConnectionStatus connectionStatus;
+
+/**
+ * Whether connectionStatus is other than OCTToxConnectionStatusNone.
+ */
+@property (assign, nonatomic, readonly) BOOL isConnected;
+
+/**
+ * Whether friend is typing now in current chat.
+ */
+@property (assign, nonatomic, readonly) BOOL isTyping;
+
+@end
+
+/**
+ * Connection and typing state of friends. It is meaningful only while tox is running, so it is kept
+ * in memory instead of database. Every friend is offline and not typing after launch.
+ *
+ * Methods returning state can be called from any thread, they reflect latest callbacks of tox.
+ */
+@interface OCTPresenceStore : NSObject
+
+- (OCTToxConnectionStatus)connectionStatusOfFriend:(OCTFriend *)friend;
+
+- (BOOL)isFriendConnected:(OCTFriend *)friend;
+
+- (BOOL)isFriendTyping:(OCTFriend *)friend;
+
+/**
+ * Object to observe presence of friend with KVO. Should be called on main thread.
+ *
+ * @return The same object for friend during lifetime of manager.
+ */
+- (OCTFriendPresence *)presenceOfFriend:(OCTFriend *)friend;
+
+@end
+
+NS_ASSUME_NONNULL_END
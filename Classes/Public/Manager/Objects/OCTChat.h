@@ -20,9 +20,26 @@
 
 /**
  * The latest message that was send or received.
+ *
+ * Updated in the same write transaction as messages are added or removed.
  */
 @property (nullable) OCTMessageAbstract *lastMessage;
 
+/**
+ * Number of messages in chat.
+ *
+ * Updated in the same write transaction as messages are added or removed.
+ */
+@property NSInteger messageCount;
+
+/**
+ * Number of incoming messages that have date later than lastReadDateInterval.
+ *
+ * Updated in the same write transaction as messages are added or removed, and when lastReadDateInterval
+ * is changed with OCTSubmanagerObjects method.
+ */
+@property NSInteger unreadCount;
+
 /**
  * This property can be used for storing entered text that wasn't send yet.
  *
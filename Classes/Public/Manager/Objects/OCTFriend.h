@@ -55,28 +55,14 @@
  */
 @property OCTToxUserStatus status;
 
-/**
- * Property specifies if friend is connected. For type of connection you can check
- * connectionStatus property.
- */
-@property BOOL isConnected;
-
-/**
- * Connection status message of a friend.
- */
-@property OCTToxConnectionStatus connectionStatus;
-
 /**
  * The date interval when friend was last seen online.
- * Contains actual information in case if friend has connectionStatus offline.
+ * Contains actual information in case if friend is offline.
+ *
+ * Connection and typing state of friend are not stored in database, see OCTPresenceStore.
  */
 @property NSTimeInterval lastSeenOnlineInterval;
 
-/**
- * Whether friend is typing now in current chat.
- */
-@property BOOL isTyping;
-
 /**
  * Data representation of friend's avatar.
  */
@@ -84,7 +70,7 @@
 
 /**
  * The date when friend was last seen online.
- * Contains actual information in case if friend has connectionStatus offline.
+ * Contains actual information in case if friend is offline.
  */
 - (nullable NSDate *)lastSeenOnline;
 
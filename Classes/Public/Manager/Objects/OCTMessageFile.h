@@ -56,6 +56,17 @@
 @property (nullable) NSString *internalFilePath;
 - (void)internalSetFilePath:(nullable NSString *)path;
 
+/**
+ * File id of transfer, it stays the same when transfer is resent, so receiver can resume it.
+ */
+@property (nullable) NSData *internalFileId;
+
+/**
+ * Name of partially downloaded file in downloads temp directory, kept to resume download
+ * interrupted by relaunch. Bytes already in file are not requested again.
+ */
+@property (nullable) NSString *internalTempFileName;
+
 @end
 
 RLM_ARRAY_TYPE(OCTMessageFile)
@@ -0,0 +1,61 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Foundation/Foundation.h>
+
+@class OCTMessageAbstract;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Pages through message history of a chat. Messages are ordered by dateInterval and uniqueIdentifier,
+ * each page continues from the last message returned instead of skipping offset, so cost of a page doesn't
+ * depend on how far it is in history.
+ *
+ * Cursor is positioned at the moment it was created: olderMessages walks history back from it,
+ * newerMessages returns messages added since. After each call adjacent page in the same direction is
+ * prefetched on background queue.
+ *
+ * Pages contain unmanaged copies of messages. They don't change and can be passed to any thread.
+ * To modify message fetch it by uniqueIdentifier with OCTSubmanagerObjects.
+ *
+ * Cursor is thread safe.
+ */
+@interface OCTMessageCursor : NSObject
+
+/**
+ * Chat cursor pages through.
+ */
+@property (copy, nonatomic, readonly) NSString *chatUniqueIdentifier;
+
+/**
+ * Maximum number of messages in page.
+ */
+@property (assign, nonatomic, readonly) NSUInteger pageSize;
+
+/**
+ * NO once olderMessages returned less than pageSize messages, i.e. the beginning of history was reached.
+ */
+@property (assign, atomic, readonly) BOOL hasOlderMessages;
+
+/**
+ * Returns messages preceding the oldest message returned so far.
+ *
+ * @return Up to pageSize messages sorted by date ascending. Empty array if there are no more messages.
+ */
+- (NSArray<OCTMessageAbstract *> *)olderMessages;
+
+/**
+ * Returns messages following the newest message returned so far.
+ *
+ * @return Up to pageSize messages sorted by date ascending. Empty array if there are no new messages.
+ */
+- (NSArray<OCTMessageAbstract *> *)newerMessages;
+
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
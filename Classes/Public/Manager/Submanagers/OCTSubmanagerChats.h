@@ -9,9 +9,29 @@
 @class OCTChat;
 @class OCTFriend;
 @class OCTMessageAbstract;
+@class OCTMessageCursor;
+@class RLMResults;
+
+@protocol OCTSubmanagerChats;
+@protocol OCTSubmanagerChatsDelegate <NSObject>
+
+/**
+ * Called on main thread when toxcore refused queued message for reason other than full send queue
+ * or friend not being connected, e.g. message is too long. Message stays undelivered.
+ *
+ * @param messageUniqueIdentifier Unique identifier of OCTMessageAbstract that was not sent.
+ * @param error Error with OCTToxErrorFriendSendMessage code.
+ */
+- (void)submanagerChats:(id<OCTSubmanagerChats>)submanager
+    failedToSendMessageWithUniqueIdentifier:(NSString *)messageUniqueIdentifier
+                                      error:(NSError *)error;
+
+@end
 
 @protocol OCTSubmanagerChats <NSObject>
 
+@property (weak, nonatomic) id<OCTSubmanagerChatsDelegate> delegate;
+
 /**
  * Searches for a chat with specific friend. If chat is not found creates one and returns it.
  *
@@ -41,15 +61,40 @@
 - (void)removeAllMessagesInChat:(OCTChat *)chat removeChat:(BOOL)removeChat;
 
 /**
- * Send text message to specific chat
+ * Creates cursor paging through message history of chat, starting from the latest messages.
+ * Use it instead of sorting all messages of chat to show history.
+ *
+ * @param chat Chat to page through.
+ * @param pageSize Maximum number of messages in page, should be greater than 0.
+ *
+ * @return Cursor positioned at current moment.
+ */
+- (OCTMessageCursor *)messageCursorForChat:(OCTChat *)chat pageSize:(NSUInteger)pageSize;
+
+/**
+ * Searches text messages. Search is case and diacritic insensitive, each word of query matches
+ * words starting with it.
+ *
+ * @param query Text to search.
+ * @param chat Chat to search in, nil to search in all chats.
+ *
+ * @return RLMResults with OCTMessageAbstract objects containing all words of query, sorted by date descending.
+ * Results are updated automatically as matching messages are added or removed.
+ */
+- (RLMResults *)searchMessagesWithQuery:(NSString *)query inChat:(OCTChat *)chat;
+
+/**
+ * Send text message to specific chat. Message is stored and queued, it is sent after next iteration of tox.
+ * If toxcore send queue is full message is retried later, messages to offline friend are sent once friend
+ * is connected.
  *
  * @param chat Chat send message to.
  * @param text Text to send.
  * @param type Type of message to send.
- * @param successBlock Block called when message was successfully send.
- *     @param message Message that was send.
- * @param failureBlock Block called when submanager failed to send message.
- *     @param error Error that occurred. See OCTToxErrorFriendSendMessage for all error codes.
+ * @param successBlock Block called synchronously when message was stored and queued.
+ *     @param message Message that was queued.
+ * @param failureBlock Block called synchronously when friend is not connected and faux offline messaging is disabled.
+ *     @param error Error with OCTToxErrorFriendSendMessageFriendNotConnected code.
  */
 - (void)sendMessageToChat:(OCTChat *)chat
                      text:(NSString *)text
@@ -57,6 +102,11 @@
              successBlock:(void (^)(OCTMessageAbstract *message))userSuccessBlock
              failureBlock:(void (^)(NSError *error))userFailureBlock;
 
+/**
+ * Number of messages to friend waiting to be passed to toxcore, including undelivered messages being resent.
+ */
+- (NSUInteger)numberOfQueuedMessagesForFriend:(OCTFriend *)friend;
+
 /**
  * Set our typing status for a chat. You are responsible for turning it on or off.
  *
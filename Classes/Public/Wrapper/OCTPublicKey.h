@@ -0,0 +1,48 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Size of binary public key in bytes.
+ */
+extern const NSUInteger kOCTPublicKeySize;
+
+/**
+ * Immutable binary Tox public key. Cheap to hash and compare, can be used as dictionary key.
+ */
+@interface OCTPublicKey : NSObject <NSCopying>
+
+/**
+ * Pointer to kOCTPublicKeySize bytes of key. Valid as long as the object is alive.
+ */
+@property (assign, nonatomic, readonly) const uint8_t *bytes NS_RETURNS_INNER_POINTER;
+
+/**
+ * Key as uppercase hex string of kOCTToxPublicKeyLength characters.
+ */
+@property (strong, nonatomic, readonly) NSString *hexString;
+
+/**
+ * @param bytes kOCTPublicKeySize bytes of key, are copied.
+ */
+- (instancetype)initWithBytes:(const uint8_t *)bytes NS_DESIGNATED_INITIALIZER;
+
+/**
+ * @param hexString Hex string of kOCTToxPublicKeyLength characters, upper or lower case.
+ *
+ * @return Key or nil if string isn't valid public key.
+ */
+- (nullable instancetype)initWithHexString:(NSString *)hexString;
+
+- (BOOL)isEqualToPublicKey:(nullable OCTPublicKey *)publicKey;
+
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -6,11 +6,35 @@
 
 #import "OCTToxDelegate.h"
 #import "OCTToxConstants.h"
+#import "OCTToxRunLoop.h"
+#import "OCTPublicKey.h"
+#import "OCTToxAddress.h"
 
 @class OCTToxOptions;
 
+/**
+ * Block receiving file chunks directly from toxcore, see setFileReceiveChunkSink:forFileNumber:friendNumber:.
+ *
+ * @param bytes Chunk bytes. Pointer is borrowed from toxcore and valid only during the call. NULL when length is 0.
+ * @param length Length of chunk. 0 means that transfer is finished.
+ * @param position The file position of the first byte in bytes.
+ */
+typedef void (^OCTToxFileReceiveChunkSink)(const uint8_t *bytes, size_t length, OCTToxFileSize position);
+
+/**
+ * Block called after every tox iteration, see addIterationObserver:.
+ */
+typedef void (^OCTToxIterationObserver)(void);
+
+/**
+ * Methods can be called from any thread. Calls to toxcore are executed on iterate queue, between iterations.
+ */
 @interface OCTTox : NSObject
 
+/**
+ * Methods implemented by delegate are checked on assignment. If delegate starts or stops
+ * responding to some of OCTToxDelegate methods later, it should be set again.
+ */
 @property (weak, nonatomic) id<OCTToxDelegate> delegate;
 
 /**
@@ -26,11 +50,21 @@
  */
 @property (strong, nonatomic, readonly) NSString *userAddress;
 
+/**
+ * Our address in binary form.
+ */
+@property (strong, nonatomic, readonly) OCTToxAddress *userAddressValue;
+
 /**
  * Our Tox Public Key (long term public key) of kOCTToxPublicKeyLength.
  */
 @property (strong, nonatomic, readonly) NSString *publicKey;
 
+/**
+ * Our Tox Public Key in binary form.
+ */
+@property (strong, nonatomic, readonly) OCTPublicKey *publicKeyValue;
+
 /**
  * Our secret key of kOCTToxSecretKeyLength.
  */
@@ -46,6 +80,11 @@
  */
 @property (assign, nonatomic) OCTToxUserStatus userStatus;
 
+/**
+ * Scheduler iterating this Tox and OCTToxAV created with it. Use it to switch profile and to inspect timing stats.
+ */
+@property (strong, nonatomic, readonly) OCTToxRunLoop *runLoop;
+
 #pragma mark -  Class methods
 
 /**
@@ -98,7 +137,7 @@
 - (NSData *)save;
 
 /**
- * Starts the main loop of the Tox on it's own unique queue.
+ * Starts the main loop of the Tox on it's own unique queue. Tox is iterated by runLoop.
  *
  * @warning Tox won't do anything without calling this method.
  */
@@ -133,6 +172,11 @@
  */
 - (BOOL)bootstrapFromHost:(NSString *)host port:(OCTToxPort)port publicKey:(NSString *)publicKey error:(NSError **)error;
 
+/**
+ * Same as bootstrapFromHost:port:publicKey:error:, but takes binary public key.
+ */
+- (BOOL)bootstrapFromHost:(NSString *)host port:(OCTToxPort)port publicKeyValue:(OCTPublicKey *)publicKey error:(NSError **)error;
+
 /**
  * Adds additional host:port pair as TCP relay.
  *
@@ -150,6 +194,11 @@
  */
 - (BOOL)addTCPRelayWithHost:(NSString *)host port:(OCTToxPort)port publicKey:(NSString *)publicKey error:(NSError **)error;
 
+/**
+ * Same as addTCPRelayWithHost:port:publicKey:error:, but takes binary public key.
+ */
+- (BOOL)addTCPRelayWithHost:(NSString *)host port:(OCTToxPort)port publicKeyValue:(OCTPublicKey *)publicKey error:(NSError **)error;
+
 /**
  * Add a friend.
  *
@@ -165,6 +214,11 @@
  */
 - (OCTToxFriendNumber)addFriendWithAddress:(NSString *)address message:(NSString *)message error:(NSError **)error;
 
+/**
+ * Same as addFriendWithAddress:message:error:, but takes binary address.
+ */
+- (OCTToxFriendNumber)addFriendWithAddressValue:(OCTToxAddress *)address message:(NSString *)message error:(NSError **)error;
+
 /**
  * Add a friend without sending friend request.
  *
@@ -185,6 +239,11 @@
  */
 - (OCTToxFriendNumber)addFriendWithNoRequestWithPublicKey:(NSString *)publicKey error:(NSError **)error;
 
+/**
+ * Same as addFriendWithNoRequestWithPublicKey:error:, but takes binary public key.
+ */
+- (OCTToxFriendNumber)addFriendWithNoRequestWithPublicKeyValue:(OCTPublicKey *)publicKey error:(NSError **)error;
+
 /**
  * Remove a friend from the friend list.
  *
@@ -202,6 +261,8 @@
 
 /**
  * Return the friend number associated with that Public Key.
+ * Friends are cached inside OCTTox (cache is filled on init and updated on friend add/delete), so for existing
+ * friends this method is O(1) and doesn't call toxcore.
  *
  * @param publicKey Public key of a friend. Public key is hex string, must be exactry kOCTToxPublicKeyLength length.
  * @param error If an error occurs, this pointer is set to an actual error object containing the error information.
@@ -212,7 +273,12 @@
 - (OCTToxFriendNumber)friendNumberWithPublicKey:(NSString *)publicKey error:(NSError **)error;
 
 /**
- * Get public key from associated friend number.
+ * Same as friendNumberWithPublicKey:error:, but takes binary public key.
+ */
+- (OCTToxFriendNumber)friendNumberWithPublicKeyValue:(OCTPublicKey *)publicKey error:(NSError **)error;
+
+/**
+ * Get public key from associated friend number. For existing friends returns cached value in O(1).
  *
  * @param friendNumber Associated friend number
  * @param error If an error occurs, this pointer is set to an actual error object containing the error information.
@@ -222,6 +288,25 @@
  */
 - (NSString *)publicKeyFromFriendNumber:(OCTToxFriendNumber)friendNumber error:(NSError **)error;
 
+/**
+ * Same as publicKeyFromFriendNumber:error:, but returns binary public key.
+ */
+- (OCTPublicKey *)publicKeyValueFromFriendNumber:(OCTToxFriendNumber)friendNumber error:(NSError **)error;
+
+/**
+ * Attaches arbitrary identifier to friend, e.g. OCTManager stores uniqueIdentifier of OCTFriend here.
+ * Identifier is stored in the friends cache and is dropped when friend is deleted.
+ *
+ * @param identifier Identifier to store, nil to remove it.
+ * @param friendNumber Number of existing friend. Does nothing if there is no such friend.
+ */
+- (void)setClientIdentifier:(NSString *)identifier forFriendNumber:(OCTToxFriendNumber)friendNumber;
+
+/**
+ * @return Identifier set with setClientIdentifier:forFriendNumber:, O(1).
+ */
+- (NSString *)clientIdentifierForFriendNumber:(OCTToxFriendNumber)friendNumber;
+
 /**
  * Checks if there exists a friend with given friendNumber.
  *
@@ -536,4 +621,51 @@
                               data:(NSData *)data
                              error:(NSError **)error;
 
+/**
+ * Same as fileSendChunkForFileNumber:friendNumber:position:data:error:, but reports error code without
+ * creating NSError. Suited for calls repeated on OCTToxErrorFileSendChunkSendq.
+ *
+ * @param errorCode Set to error code on failure. May be NULL.
+ *
+ * @return YES on success, NO on failure.
+ */
+- (BOOL)fileSendChunkForFileNumber:(OCTToxFileNumber)fileNumber
+                      friendNumber:(OCTToxFriendNumber)friendNumber
+                          position:(OCTToxFileSize)position
+                              data:(NSData *)data
+                         errorCode:(OCTToxErrorFileSendChunk *)errorCode;
+
+/**
+ * Register sink for incoming file transfer. Chunks of this transfer are passed to sink synchronously on
+ * the queue iterating Tox, without copying and without calling tox:fileReceiveChunk:... delegate method.
+ *
+ * The final (zero length) chunk completes transfer, so it is delivered on delegate queue in order with other
+ * events of the same iteration (see OCTToxOptions.delegateQueue). Sink is removed when final chunk is received.
+ * Removing sink waits for sink call in progress (if any) to finish.
+ *
+ * @param sink Sink to register. Pass nil to remove registered sink.
+ * @param fileNumber The friend-specific file number the data received is associated with.
+ * @param friendNumber The friend number of the friend who is sending the file.
+ */
+- (void)setFileReceiveChunkSink:(OCTToxFileReceiveChunkSink)sink
+                  forFileNumber:(OCTToxFileNumber)fileNumber
+                   friendNumber:(OCTToxFriendNumber)friendNumber;
+
+/**
+ * Register observer called synchronously on the queue iterating Tox after every iteration. OCTTox methods
+ * called from observer are executed right away, so it can be used to pace outgoing data with iterations.
+ *
+ * @param observer Observer to register.
+ *
+ * @return Token to pass to removeIterationObserver:.
+ */
+- (id)addIterationObserver:(OCTToxIterationObserver)observer;
+
+/**
+ * Removes observer. Removing waits for observer call in progress (if any) to finish.
+ *
+ * @param token Token returned by addIterationObserver:.
+ */
+- (void)removeIterationObserver:(id)token;
+
 @end
@@ -24,7 +24,8 @@
 - (instancetype)initWithTox:(OCTTox *)tox error:(NSError **)error;
 
 /**
- * Starts the main loop of the ToxAV on it's own unique queue.
+ * Starts the main loop of the ToxAV. ToxAV is iterated by runLoop of OCTTox it was created with,
+ * on the same queue as Tox.
  *
  * @warning ToxAV won't do anything without calling this method.
  */
@@ -10,7 +10,8 @@
 @class OCTToxAV;
 
 /**
- * All delegate methods will be called on main thread.
+ * Delegate methods are called on queue specified by OCTToxOptions.delegateQueue of OCTTox (main queue by default).
+ * Audio and video frames are always delivered synchronously on ToxAV iterate queue.
  */
 @protocol OCTToxAVDelegate <NSObject>
 
@@ -0,0 +1,63 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Foundation/Foundation.h>
+
+#import "OCTToxConstants.h"
+
+@class OCTPublicKey;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Size of binary Tox address in bytes.
+ */
+extern const NSUInteger kOCTToxAddressSize;
+
+/**
+ * Immutable binary Tox address, has following format:
+ * [publicKey (32 bytes)][nospam number (4 bytes)][checksum (2 bytes)]
+ */
+@interface OCTToxAddress : NSObject <NSCopying>
+
+/**
+ * Pointer to kOCTToxAddressSize bytes of address. Valid as long as the object is alive.
+ */
+@property (assign, nonatomic, readonly) const uint8_t *bytes NS_RETURNS_INNER_POINTER;
+
+/**
+ * Public key part of address.
+ */
+@property (strong, nonatomic, readonly) OCTPublicKey *publicKey;
+
+/**
+ * Nospam part of address.
+ */
+@property (assign, nonatomic, readonly) OCTToxNoSpam nospam;
+
+/**
+ * Address as uppercase hex string of kOCTToxAddressLength characters.
+ */
+@property (strong, nonatomic, readonly) NSString *hexString;
+
+/**
+ * @param bytes kOCTToxAddressSize bytes of address, are copied.
+ */
+- (instancetype)initWithBytes:(const uint8_t *)bytes NS_DESIGNATED_INITIALIZER;
+
+/**
+ * @param hexString Hex string of kOCTToxAddressLength characters, upper or lower case.
+ *
+ * @return Address or nil if string isn't valid hex of proper length. Checksum isn't verified.
+ */
+- (nullable instancetype)initWithHexString:(NSString *)hexString;
+
+- (BOOL)isEqualToAddress:(nullable OCTToxAddress *)address;
+
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
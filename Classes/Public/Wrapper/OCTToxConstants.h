@@ -48,6 +48,38 @@ typedef NS_ENUM(NSInteger, OCTToxProxyType) {
     OCTToxProxyTypeHTTP,
 };
 
+typedef NS_ENUM(NSInteger, OCTToxDelegateQueue) {
+    /**
+     * Delegate methods are called on the main queue.
+     */
+    OCTToxDelegateQueueMain,
+
+    /**
+     * Delegate methods are called synchronously on the queue that iterates Tox, right from toxcore callback.
+     * Delegate should not block, otherwise network processing will be stalled.
+     */
+    OCTToxDelegateQueueIterate,
+
+    /**
+     * Delegate methods are called on dedicated serial queue, separate from both main and iterate queues.
+     */
+    OCTToxDelegateQueueDedicated,
+};
+
+typedef NS_ENUM(NSInteger, OCTToxRunLoopProfile) {
+    /**
+     * Wakeups are allowed to be delayed by up to half of iteration interval, so system can coalesce them
+     * with other timers. Suitable when there is no active call.
+     */
+    OCTToxRunLoopProfileLowPower,
+
+    /**
+     * Strict timer with zero leeway. Tox and ToxAV are iterated exactly at the interval they request.
+     * Suitable during audio/video calls.
+     */
+    OCTToxRunLoopProfileLowLatency,
+};
+
 typedef NS_ENUM(NSInteger, OCTToxConnectionStatus) {
     /**
      * There is no connection. This instance, or the friend the state change is about, is now offline.
@@ -366,6 +398,12 @@ typedef NS_ENUM(NSInteger, OCTToxErrorFriendSendMessage) {
      */
     OCTToxErrorFriendSendMessageAlloc,
 
+    /**
+     * Send queue of friend is full, message can be sent again later. Toxcore reports it together with
+     * allocation error, so it is the same code as OCTToxErrorFriendSendMessageAlloc.
+     */
+    OCTToxErrorFriendSendMessageSendq = OCTToxErrorFriendSendMessageAlloc,
+
     /**
      * Message length exceeded kOCTToxMaxMessageLength.
      */
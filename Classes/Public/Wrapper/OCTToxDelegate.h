@@ -7,14 +7,26 @@
 #import "OCTToxConstants.h"
 
 @class OCTTox;
+@class OCTToxEventBatch;
 
 /**
- * All delegate methods will be called on main thread.
+ * Delegate methods are called on queue specified by OCTToxOptions.delegateQueue (main queue by default).
  */
 @protocol OCTToxDelegate <NSObject>
 
 @optional
 
+/**
+ * If delegate implements this method, all events fired during single tox iteration are collected
+ * and delivered with this method at once instead of separate delegate methods.
+ * This allows to handle a burst of events in one go (e.g. in single database transaction).
+ *
+ * Use OCTToxEventBatch deliverToDelegate: to get separate delegate methods called.
+ *
+ * @param batch Events fired during tox iteration, in order they were received.
+ */
+- (void)tox:(OCTTox *)tox receivedEventBatch:(OCTToxEventBatch *)batch;
+
 /**
  * User connection status changed.
  *
@@ -4,15 +4,23 @@
 
 #import <Foundation/Foundation.h>
 
+@class OCTToxPassKey;
+
 /**
  * This class is used for encryption/decryption of save data.
  *
  * You can use class methods or create instance and use it's methods.
  * Note that instance encryption/decryption methods are much faster because
- * instance stores generated encryption key.
+ * instance stores generated encryption key. Class methods reuse keys that are still alive
+ * for the same passphrase and salt, see OCTToxPassKey.
  */
 @interface OCTToxEncryptSave : NSObject
 
+/**
+ * Key used for encryption/decryption.
+ */
+@property (strong, nonatomic, readonly, nonnull) OCTToxPassKey *passKey;
+
 /**
  * Determines whether or not the given data is encrypted (by checking the magic number).
  *
@@ -68,6 +76,15 @@
                                     toxData:(nullable NSData *)toxData
                                       error:(NSError *__nullable *__nullable)error;
 
+/**
+ * Creates new instance with already derived key.
+ *
+ * @param passKey Key used to encrypt/decrypt the data.
+ *
+ * @return Created instance.
+ */
+- (nonnull instancetype)initWithPassKey:(nonnull OCTToxPassKey *)passKey;
+
 /**
  * Encrypts the given data.
  *
@@ -0,0 +1,51 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Foundation/Foundation.h>
+
+@protocol OCTToxDelegate;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Events fired by toxcore during single iteration, in order they were received.
+ * See OCTToxDelegate tox:receivedEventBatch: method.
+ */
+@interface OCTToxEventBatch : NSObject
+
+/**
+ * Number of events in batch.
+ */
+@property (assign, nonatomic, readonly) NSUInteger count;
+
+/**
+ * Numbers of friends events are related to. Delegate may resolve them before events are delivered.
+ */
+@property (strong, nonatomic, readonly) NSIndexSet *friendNumbers;
+
+/**
+ * Calls appropriate OCTToxDelegate method for every event in batch, synchronously on current thread.
+ *
+ * @param delegate Delegate to deliver events to.
+ */
+- (void)deliverToDelegate:(id<OCTToxDelegate>)delegate;
+
+/**
+ * Same as deliverToDelegate:, but delivers only events which handlers are expected to call tox back
+ * (file transfer events and friend connection changes), or only the rest of them. Order within each group is kept.
+ *
+ * Tox calls made from other threads wait for tox iteration, events calling tox shouldn't be delivered while
+ * something tox thread may wait for (e.g. database write lock) is held.
+ *
+ * @param delegate Delegate to deliver events to.
+ * @param callingTox YES to deliver events calling tox, NO to deliver the rest.
+ */
+- (void)deliverToDelegate:(id<OCTToxDelegate>)delegate callingTox:(BOOL)callingTox;
+
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -98,6 +98,14 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (nonatomic, assign) BOOL holePunchingEnabled;
 
+/**
+ * Queue on which OCTToxDelegate and OCTToxAVDelegate methods (except audio/video frames) are called.
+ * This option is objcTox specific and isn't passed to toxcore.
+ *
+ * Default value: OCTToxDelegateQueueMain.
+ */
+@property (nonatomic, assign) OCTToxDelegateQueue delegateQueue;
+
 @end
 
 NS_ASSUME_NONNULL_END
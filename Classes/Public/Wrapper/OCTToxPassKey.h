@@ -0,0 +1,110 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Symmetric key derived from passphrase and salt.
+ *
+ * Key derivation is intentionally very expensive. Keys are cached, deriving key for the same passphrase
+ * and salt again returns existing instance as long as it is alive. Data encrypted with key stores key salt,
+ * so it can be decrypted with key derived for salt extracted from data.
+ */
+@interface OCTToxPassKey : NSObject
+
+/**
+ * Salt key was derived with.
+ */
+@property (copy, nonatomic, readonly) NSData *salt;
+
+/**
+ * Extracts salt from encrypted data.
+ *
+ * @param data Encrypted data.
+ *
+ * @return Salt or nil if data isn't encrypted.
+ */
++ (nullable NSData *)saltOfEncryptedData:(NSData *)data;
+
+/**
+ * Derives key or returns cached one.
+ *
+ * @param passphrase Passphrase to derive key from.
+ * @param salt Salt to use. If nil, random salt will be generated and key won't be taken from cache.
+ * @param error If an error occurs, this pointer is set to an actual error object containing the error information.
+ * See OCTToxEncryptSaveKeyDerivationError for all error codes.
+ *
+ * @return Key or nil in case of error.
+ */
++ (nullable instancetype)passKeyWithPassphrase:(NSString *)passphrase
+                                          salt:(nullable NSData *)salt
+                                         error:(NSError **)error;
+
+/**
+ * Derives key that can decrypt given data or returns cached one.
+ *
+ * @param passphrase Passphrase to derive key from.
+ * @param data Encrypted data, salt is extracted from it. If data isn't encrypted random salt will be used.
+ * @param error If an error occurs, this pointer is set to an actual error object containing the error information.
+ * See OCTToxEncryptSaveKeyDerivationError for all error codes.
+ *
+ * @return Key or nil in case of error.
+ */
++ (nullable instancetype)passKeyWithPassphrase:(NSString *)passphrase
+                              forEncryptedData:(nullable NSData *)data
+                                         error:(NSError **)error;
+
+/**
+ * Derives key on background queue.
+ *
+ * @param passphrase Passphrase to derive key from.
+ * @param salt Salt to use. If nil, random salt will be generated.
+ * @param completionBlock Block called on main queue with key or error.
+ */
++ (void)derivePassKeyWithPassphrase:(NSString *)passphrase
+                               salt:(nullable NSData *)salt
+                    completionBlock:(void (^)(OCTToxPassKey *__nullable passKey, NSError *__nullable error))completionBlock;
+
+/**
+ * Checks whether data was encrypted with this key.
+ *
+ * Data with different salt is rejected right away. Once key has decrypted any data, it is known to be
+ * correct for its salt and data with the same salt is accepted without decryption.
+ *
+ * @param data Encrypted data.
+ *
+ * @return YES if data can be decrypted with this key.
+ */
+- (BOOL)verifyEncryptedData:(NSData *)data;
+
+/**
+ * Encrypts the given data.
+ *
+ * @param data Data to encrypt.
+ * @param error If an error occurs, this pointer is set to an actual error object containing the error information.
+ * See OCTToxEncryptSaveEncryptionError for all error codes.
+ *
+ * @return Encrypted data on success, nil on failure.
+ */
+- (nullable NSData *)encryptData:(NSData *)data error:(NSError **)error;
+
+/**
+ * Decrypts the given data.
+ *
+ * @param data Data to decrypt.
+ * @param error If an error occurs, this pointer is set to an actual error object containing the error information.
+ * See OCTToxEncryptSaveDecryptionError for all error codes.
+ *
+ * @return Decrypted data on success, nil on failure.
+ */
+- (nullable NSData *)decryptData:(NSData *)data error:(NSError **)error;
+
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,77 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Foundation/Foundation.h>
+#import "OCTToxConstants.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Snapshot of OCTToxRunLoop timing statistics. All time values are in seconds.
+ */
+@interface OCTToxRunLoopStats : NSObject
+
+/**
+ * Number of iterations since run loop creation or last resetStats call.
+ */
+@property (assign, nonatomic, readonly) NSUInteger iterationsCount;
+
+/**
+ * Interval requested by tox/toxav after last iteration.
+ */
+@property (assign, nonatomic, readonly) NSTimeInterval requestedInterval;
+
+/**
+ * Time spent in tox_iterate and toxav_iterate (including delegate calls made synchronously from them).
+ */
+@property (assign, nonatomic, readonly) NSTimeInterval lastIterateDuration;
+@property (assign, nonatomic, readonly) NSTimeInterval averageIterateDuration;
+@property (assign, nonatomic, readonly) NSTimeInterval maxIterateDuration;
+
+/**
+ * How late iteration has started compared to the time requested by previous iteration.
+ */
+@property (assign, nonatomic, readonly) NSTimeInterval lastLateness;
+@property (assign, nonatomic, readonly) NSTimeInterval averageLateness;
+@property (assign, nonatomic, readonly) NSTimeInterval maxLateness;
+
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+/**
+ * Single timer on Tox queue which iterates both Tox and ToxAV (if it was started).
+ * Interval is the smallest one requested by tox_iteration_interval and toxav_iteration_interval.
+ */
+@interface OCTToxRunLoop : NSObject
+
+/**
+ * Scheduling profile, can be changed at any time.
+ *
+ * Default value: OCTToxRunLoopProfileLowPower.
+ */
+@property (assign, atomic) OCTToxRunLoopProfile profile;
+
+/**
+ * YES if timer is scheduled, i.e. Tox or ToxAV is started.
+ */
+@property (assign, atomic, readonly, getter=isRunning) BOOL running;
+
+/**
+ * @return Snapshot of timing statistics.
+ */
+- (OCTToxRunLoopStats *)stats;
+
+/**
+ * Drops all statistics collected so far.
+ */
+- (void)resetStats;
+
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
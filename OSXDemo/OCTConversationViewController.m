@@ -11,6 +11,7 @@
 #import "OCTSubmanagerUser.h"
 #import "OCTSubmanagerCalls.h"
 #import "OCTSubmanagerFiles.h"
+#import "OCTPresenceStore.h"
 #import "OCTMessageText.h"
 #import "RLMCollectionChange+IndexSet.h"
 
@@ -175,7 +176,7 @@ static NSString *const kCellIdent = @"cellIdent";
         OCTChat *chat = self.allChats[row];
         OCTFriend *friend = [chat.friends firstObject];
 
-        field.stringValue = (friend.isConnected) ? ([NSString stringWithFormat:@"%@ : Online", friend.nickname]) : friend.nickname;
+        field.stringValue = [self.manager.presence isFriendConnected:friend] ? ([NSString stringWithFormat:@"%@ : Online", friend.nickname]) : friend.nickname;
 
     }
     else {
@@ -8,6 +8,7 @@
 #import "OCTSubmanagerObjects.h"
 #import "OCTSubmanagerFriends.h"
 #import "OCTSubmanagerChats.h"
+#import "OCTPresenceStore.h"
 #import "RLMCollectionChange+IndexSet.h"
 
 static NSString *const kNibName = @"OCTFriendsViewController";
@@ -106,7 +107,7 @@ static NSString *const kCellIdent = @"cellIdent";
 
     if (tableView == self.friendsTableView) {
         OCTFriend *friend = self.friends[row];
-        field.stringValue = (friend.isConnected) ? ([NSString stringWithFormat:@"%@ : Online", friend.nickname]) : friend.nickname;
+        field.stringValue = [self.manager.presence isFriendConnected:friend] ? ([NSString stringWithFormat:@"%@ : Online", friend.nickname]) : friend.nickname;
 
     }
     else if (tableView == self.requestsTableView) {
@@ -140,10 +141,10 @@ static NSString *const kCellIdent = @"cellIdent";
                                            friend.nickname,
                                            friend.statusMessage,
                                            [self stringFromUserStatus:friend.status],
-                                           friend.isConnected,
-                                           [self stringFromConnectionStatus:friend.connectionStatus],
+                                           [self.manager.presence isFriendConnected:friend],
+                                           [self stringFromConnectionStatus:[self.manager.presence connectionStatusOfFriend:friend]],
                                            friend.lastSeenOnline,
-                                           friend.isTyping];
+                                           [self.manager.presence isFriendTyping:friend]];
 
     }
 }
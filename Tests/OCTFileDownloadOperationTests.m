@@ -0,0 +1,424 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <XCTest/XCTest.h>
+#import <OCMock/OCMock.h>
+#import <sys/xattr.h>
+
+#import "OCTTestCase.h"
+#import "OCTTox+Private.h"
+#import "OCTToxOptions.h"
+#import "OCTFileDownloadOperation.h"
+#import "OCTFileDataOutput.h"
+#import "OCTFilePathOutput.h"
+
+static const OCTToxFriendNumber kFriendNumber = 5;
+static const OCTToxFileNumber kFileNumber = 7;
+
+// Size of chunk toxcore delivers with default MTU.
+static const size_t kChunkSize = 1371;
+static const OCTToxFileSize kBenchmarkFileSize = 32 * 1024 * 1024;
+
+/**
+ * Mimics OCTSubmanagerFilesImpl: passes chunks received by delegate to operation.
+ */
+@interface OCTFileDownloadOperationTestsDelegate : NSObject <OCTToxDelegate>
+
+@property (weak, nonatomic) OCTFileDownloadOperation *operation;
+
+@end
+
+@implementation OCTFileDownloadOperationTestsDelegate
+
+- (void)     tox:(OCTTox *)tox fileReceiveChunk:(NSData *)chunk
+      fileNumber:(OCTToxFileNumber)fileNumber
+    friendNumber:(OCTToxFriendNumber)friendNumber
+        position:(OCTToxFileSize)position
+{
+    [self.operation receiveChunk:chunk position:position];
+}
+
+@end
+
+@interface OCTFileDownloadOperationTests : OCTTestCase
+
+@property (strong, nonatomic) OCTTox *tox;
+@property (strong, nonatomic) id mockedTox;
+@property (strong, nonatomic) NSString *directory;
+@property (assign, atomic) NSUInteger resumeControlsCount;
+@property (assign, atomic) NSUInteger pauseControlsCount;
+
+// Mimics friend: no chunks are sent while transfer is paused.
+@property (assign, atomic) BOOL paused;
+
+@end
+
+@implementation OCTFileDownloadOperationTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    OCTToxOptions *options = [OCTToxOptions new];
+    options.delegateQueue = OCTToxDelegateQueueIterate;
+
+    self.tox = [[OCTTox alloc] initWithOptions:options savedData:nil error:nil];
+
+    self.mockedTox = OCMPartialMock(self.tox);
+    OCMStub([self.mockedTox fileSendControlForFileNumber:kFileNumber
+                                            friendNumber:kFriendNumber
+                                                 control:OCTToxFileControlResume
+                                                   error:[OCMArg anyObjectRef]]).andDo(^(NSInvocation *invocation) {
+        self.resumeControlsCount++;
+        self.paused = NO;
+
+        BOOL result = YES;
+        [invocation setReturnValue:&result];
+    });
+    OCMStub([self.mockedTox fileSendControlForFileNumber:kFileNumber
+                                            friendNumber:kFriendNumber
+                                                 control:OCTToxFileControlPause
+                                                   error:[OCMArg anyObjectRef]]).andDo(^(NSInvocation *invocation) {
+        self.pauseControlsCount++;
+        self.paused = YES;
+
+        BOOL result = YES;
+        [invocation setReturnValue:&result];
+    });
+
+    self.directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    [[NSFileManager defaultManager] createDirectoryAtPath:self.directory withIntermediateDirectories:YES attributes:nil error:nil];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:self.directory error:nil];
+
+    [self.mockedTox stopMocking];
+    self.mockedTox = nil;
+    self.tox = nil;
+
+    [super tearDown];
+}
+
+- (void)testSinkReceivesBorrowedBytes
+{
+    id delegate = OCMProtocolMock(@protocol(OCTToxDelegate));
+    [[delegate reject] tox:[OCMArg any] fileReceiveChunk:[OCMArg any] fileNumber:kFileNumber friendNumber:kFriendNumber position:0];
+    self.tox.delegate = delegate;
+
+    uint8_t bytes[] = {1, 2, 3, 4};
+    __block const uint8_t *receivedBytes = NULL;
+    __block size_t receivedLength = 0;
+    __block NSUInteger callsCount = 0;
+
+    [self.tox setFileReceiveChunkSink:^(const uint8_t *sinkBytes, size_t length, OCTToxFileSize position) {
+        receivedBytes = sinkBytes;
+        receivedLength = length;
+        callsCount++;
+    } forFileNumber:kFileNumber friendNumber:kFriendNumber];
+
+    fileReceiveChunkCallback(NULL, kFriendNumber, kFileNumber, 0, bytes, sizeof(bytes), (__bridge void *)self.tox);
+
+    XCTAssertEqual(receivedBytes, bytes);
+    XCTAssertEqual(receivedLength, sizeof(bytes));
+
+    fileReceiveChunkCallback(NULL, kFriendNumber, kFileNumber, sizeof(bytes), NULL, 0, (__bridge void *)self.tox);
+
+    XCTAssertEqual(callsCount, 2);
+    XCTAssertEqual(receivedLength, 0);
+
+    // Sink is removed after final chunk.
+    XCTAssertFalse([self.tox passChunkToSinkWithFileNumber:kFileNumber friendNumber:kFriendNumber bytes:NULL length:0 position:0]);
+
+    OCMVerifyAll(delegate);
+}
+
+- (void)testSinkForOtherTransferIsNotUsed
+{
+    id delegate = OCMProtocolMock(@protocol(OCTToxDelegate));
+    OCMExpect([delegate tox:self.tox fileReceiveChunk:[OCMArg isNotNil] fileNumber:kFileNumber friendNumber:kFriendNumber position:0]);
+    self.tox.delegate = delegate;
+
+    [self.tox setFileReceiveChunkSink:^(const uint8_t *bytes, size_t length, OCTToxFileSize position) {
+        XCTFail(@"Sink shouldn't be called");
+    } forFileNumber:kFileNumber friendNumber:kFriendNumber + 1];
+
+    uint8_t bytes[] = {1, 2, 3, 4};
+    fileReceiveChunkCallback(NULL, kFriendNumber, kFileNumber, 0, bytes, sizeof(bytes), (__bridge void *)self.tox);
+
+    OCMVerifyAll(delegate);
+}
+
+- (void)testOperationReceivesChunksFromSink
+{
+    id delegate = OCMProtocolMock(@protocol(OCTToxDelegate));
+    [[delegate reject] tox:[OCMArg any] fileReceiveChunk:[OCMArg any] fileNumber:kFileNumber friendNumber:kFriendNumber position:0];
+    self.tox.delegate = delegate;
+
+    uint8_t bytes[] = {1, 2, 3, 4, 5, 6};
+    OCTFileDataOutput *output = [OCTFileDataOutput new];
+
+    OCTFileDownloadOperation *operation = [self createOperationWithOutput:output fileSize:sizeof(bytes)];
+    [operation start];
+
+    fileReceiveChunkCallback(NULL, kFriendNumber, kFileNumber, 0, bytes, 4, (__bridge void *)self.tox);
+    fileReceiveChunkCallback(NULL, kFriendNumber, kFileNumber, 4, bytes + 4, 2, (__bridge void *)self.tox);
+    fileReceiveChunkCallback(NULL, kFriendNumber, kFileNumber, 6, NULL, 0, (__bridge void *)self.tox);
+
+    [self waitForOperationToFinish:operation];
+    XCTAssertEqualObjects(output.resultData, [NSData dataWithBytes:bytes length:sizeof(bytes)]);
+
+    OCMVerifyAll(delegate);
+}
+
+- (void)testOperationRemovesSinkOnCancel
+{
+    OCTFileDownloadOperation *operation = [self createOperationWithOutput:[OCTFileDataOutput new] fileSize:10];
+    [operation start];
+
+    XCTAssertTrue([self.tox passChunkToSinkWithFileNumber:kFileNumber friendNumber:kFriendNumber bytes:NULL length:0 position:10]);
+
+    operation = [self createOperationWithOutput:[OCTFileDataOutput new] fileSize:10];
+    [operation start];
+    [operation cancel];
+
+    XCTAssertFalse([self.tox passChunkToSinkWithFileNumber:kFileNumber friendNumber:kFriendNumber bytes:NULL length:0 position:10]);
+}
+
+- (void)testOperationSeeksToResumePosition
+{
+    NSString *tempFilePath = [self.directory stringByAppendingPathComponent:@"temp"];
+    NSString *resultFilePath = [self.directory stringByAppendingPathComponent:@"result"];
+    uint8_t bytes[] = {1, 2, 3, 4, 5, 6};
+
+    // Last two bytes may not have reached the disk, they are downloaded again.
+    [[NSData dataWithBytes:bytes length:sizeof(bytes)] writeToFile:tempFilePath atomically:NO];
+    uint64_t synchronizedLength = 4;
+    setxattr(tempFilePath.fileSystemRepresentation, "me.dvor.objcTox.syncedLength",
+             &synchronizedLength, sizeof(synchronizedLength), 0, 0);
+
+    OCMExpect([self.mockedTox fileSeekForFileNumber:kFileNumber
+                                       friendNumber:kFriendNumber
+                                           position:4
+                                              error:[OCMArg anyObjectRef]]).andReturn(YES);
+
+    OCTFilePathOutput *output = [[OCTFilePathOutput alloc] initWithTempFilePath:tempFilePath resultFilePath:resultFilePath];
+    OCTFileDownloadOperation *operation = [self createOperationWithOutput:output fileSize:sizeof(bytes)];
+    [operation start];
+
+    OCMVerifyAll(self.mockedTox);
+    XCTAssertEqual(operation.bytesDone, 4);
+
+    fileReceiveChunkCallback(NULL, kFriendNumber, kFileNumber, 4, bytes + 4, 2, (__bridge void *)self.tox);
+    fileReceiveChunkCallback(NULL, kFriendNumber, kFileNumber, 6, NULL, 0, (__bridge void *)self.tox);
+
+    [self waitForOperationToFinish:operation];
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:resultFilePath], [NSData dataWithBytes:bytes length:sizeof(bytes)]);
+}
+
+- (void)testOperationStartedPausedDoesNotResumeTransfer
+{
+    OCTFileDownloadOperation *operation = [self createOperationWithOutput:[OCTFileDataOutput new] fileSize:10];
+    operation.startsPaused = YES;
+    [operation start];
+
+    XCTAssertEqual(self.resumeControlsCount, 0);
+    XCTAssertFalse(operation.isFinished);
+    XCTAssertTrue([self.tox passChunkToSinkWithFileNumber:kFileNumber friendNumber:kFriendNumber bytes:NULL length:0 position:10]);
+
+    [self waitForOperationToFinish:operation];
+}
+
+- (void)testWriteFailureCancelsTransferAndDropsOutput
+{
+    id output = OCMProtocolMock(@protocol(OCTFileOutputProtocol));
+    OCMStub([output prepareToWrite]).andReturn(YES);
+    OCMStub([output writeBytes:[OCMArg anyPointer] length:4]).andReturn(NO);
+    OCMExpect([output cancel]);
+
+    OCMExpect([self.mockedTox fileSendControlForFileNumber:kFileNumber
+                                              friendNumber:kFriendNumber
+                                                   control:OCTToxFileControlCancel
+                                                     error:[OCMArg anyObjectRef]]).andReturn(YES);
+
+    uint8_t bytes[] = {1, 2, 3, 4};
+    OCTFileDownloadOperation *operation = [self createOperationWithOutput:output fileSize:10];
+    [operation start];
+
+    fileReceiveChunkCallback(NULL, kFriendNumber, kFileNumber, 0, bytes, sizeof(bytes), (__bridge void *)self.tox);
+
+    [self waitForOperationToFinish:operation];
+    OCMVerifyAll(output);
+    OCMVerifyAll(self.mockedTox);
+}
+
+- (void)testThrottledOutputPausesTransfer
+{
+    OCTFileDownloadOperation *operation = [self createOperationWithOutput:nil fileSize:10];
+    void (^throttleBlock)(BOOL) = [self startOperationCapturingThrottleBlock:operation];
+
+    XCTAssertEqual(self.resumeControlsCount, 1);
+
+    throttleBlock(YES);
+    [self waitForControlsCount:1 ofPause:YES];
+
+    throttleBlock(NO);
+    [self waitForControlsCount:2 ofPause:NO];
+    XCTAssertFalse(operation.isFinished);
+}
+
+- (void)testTransferPausedByUserStaysPausedAfterThrottling
+{
+    OCTFileDownloadOperation *operation = [self createOperationWithOutput:nil fileSize:10];
+    void (^throttleBlock)(BOOL) = [self startOperationCapturingThrottleBlock:operation];
+
+    throttleBlock(YES);
+    [self waitForControlsCount:1 ofPause:YES];
+
+    // Transfer is paused already.
+    [operation pauseByUser:YES];
+
+    throttleBlock(NO);
+    [operation pauseByUser:YES];
+    XCTAssertEqual(self.resumeControlsCount, 1);
+
+    // Still throttled, resumed once output caught up.
+    throttleBlock(YES);
+    [operation pauseByUser:NO];
+    XCTAssertEqual(self.resumeControlsCount, 1);
+
+    throttleBlock(NO);
+    [self waitForControlsCount:2 ofPause:NO];
+    XCTAssertEqual(self.pauseControlsCount, 1);
+}
+
+#pragma mark -  Throughput benchmark
+
+/**
+ * Old path: every chunk is copied to NSData and goes through delegate.
+ */
+- (void)testThroughputWithDelegatePerformance
+{
+    [self measureThroughputUsingSink:NO];
+}
+
+/**
+ * New path: chunks are written to buffered file output directly from sink.
+ */
+- (void)testThroughputWithSinkPerformance
+{
+    [self measureThroughputUsingSink:YES];
+}
+
+/**
+ * Receives kBenchmarkFileSize bytes in kChunkSize chunks to file, MB/s = kBenchmarkFileSize / measured time.
+ */
+- (void)measureThroughputUsingSink:(BOOL)useSink
+{
+    uint8_t *chunk = malloc(kChunkSize);
+    memset(chunk, 0xAB, kChunkSize);
+
+    OCTFileDownloadOperationTestsDelegate *delegate = [OCTFileDownloadOperationTestsDelegate new];
+    self.tox.delegate = delegate;
+
+    [self measureBlock:^{
+        OCTFilePathOutput *output = [[OCTFilePathOutput alloc] initWithTempFolder:self.directory
+                                                                     resultFolder:self.directory
+                                                                         fileName:@"benchmark"];
+
+        OCTFileDownloadOperation *operation = [self createOperationWithOutput:output fileSize:kBenchmarkFileSize];
+        delegate.operation = operation;
+        [operation start];
+
+        if (! useSink) {
+            [self.tox setFileReceiveChunkSink:nil forFileNumber:kFileNumber friendNumber:kFriendNumber];
+        }
+
+        OCTToxFileSize position = 0;
+
+        while (position < kBenchmarkFileSize) {
+            if (self.paused) {
+                usleep(100);
+                continue;
+            }
+
+            size_t length = (size_t)MIN(kChunkSize, kBenchmarkFileSize - position);
+            fileReceiveChunkCallback(NULL, kFriendNumber, kFileNumber, position, chunk, length, (__bridge void *)self.tox);
+            position += length;
+        }
+        fileReceiveChunkCallback(NULL, kFriendNumber, kFileNumber, position, NULL, 0, (__bridge void *)self.tox);
+
+        [self waitForOperationToFinish:operation];
+        XCTAssertEqual(operation.bytesDone, kBenchmarkFileSize);
+
+        [[NSFileManager defaultManager] removeItemAtPath:output.resultFilePath error:nil];
+    }];
+
+    free(chunk);
+}
+
+#pragma mark -  Private
+
+/**
+ * Output is finished on background queue after final chunk.
+ */
+- (void)waitForOperationToFinish:(OCTFileDownloadOperation *)operation
+{
+    NSPredicate *finished = [NSPredicate predicateWithFormat:@"isFinished == YES"];
+    [self expectationForPredicate:finished evaluatedWithObject:operation handler:nil];
+
+    [self waitForExpectationsWithTimeout:5.0 handler:nil];
+}
+
+/**
+ * Starts operation with mocked output, throttle block operation has set on it is returned.
+ */
+- (void (^)(BOOL))startOperationCapturingThrottleBlock:(OCTFileDownloadOperation *)operation
+{
+    __block void (^throttleBlock)(BOOL);
+
+    id output = operation.output;
+    OCMStub([output prepareToWrite]).andReturn(YES);
+    OCMStub([output setWriteThrottleBlock:[OCMArg any]]).andDo(^(NSInvocation *invocation) {
+        __unsafe_unretained void (^block)(BOOL);
+        [invocation getArgument:&block atIndex:2];
+        throttleBlock = block;
+    });
+
+    [operation start];
+    XCTAssertNotNil(throttleBlock);
+
+    return throttleBlock;
+}
+
+/**
+ * Controls are sent on background queue.
+ */
+- (void)waitForControlsCount:(NSUInteger)count ofPause:(BOOL)pause
+{
+    NSString *format = pause ? @"pauseControlsCount == %lu" : @"resumeControlsCount == %lu";
+    NSPredicate *sent = [NSPredicate predicateWithFormat:format, (unsigned long)count];
+    [self expectationForPredicate:sent evaluatedWithObject:self handler:nil];
+
+    [self waitForExpectationsWithTimeout:1.0 handler:nil];
+}
+
+- (OCTFileDownloadOperation *)createOperationWithOutput:(id<OCTFileOutputProtocol>)output fileSize:(OCTToxFileSize)fileSize
+{
+    output = output ?: OCMProtocolMock(@protocol(OCTFileOutputProtocol));
+
+    return [[OCTFileDownloadOperation alloc] initWithTox:self.tox
+                                              fileOutput:output
+                                            friendNumber:kFriendNumber
+                                              fileNumber:kFileNumber
+                                                fileSize:fileSize
+                                                userInfo:nil
+                                           progressBlock:nil
+                                          etaUpdateBlock:nil
+                                            successBlock:nil
+                                            failureBlock:nil];
+}
+
+@end
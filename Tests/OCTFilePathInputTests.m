@@ -0,0 +1,214 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <XCTest/XCTest.h>
+#import <unistd.h>
+
+#import "OCTTestCase.h"
+#import "OCTFilePathInput.h"
+
+// Size of chunk toxcore requests with default MTU.
+static const size_t kChunkSize = 1371;
+static const OCTToxFileSize kBenchmarkFileSize = 64 * 1024 * 1024;
+
+@interface OCTFilePathInputTests : OCTTestCase
+
+@property (strong, nonatomic) NSString *directory;
+
+@end
+
+@implementation OCTFilePathInputTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    [[NSFileManager defaultManager] createDirectoryAtPath:self.directory withIntermediateDirectories:YES attributes:nil error:nil];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:self.directory error:nil];
+    self.directory = nil;
+
+    [super tearDown];
+}
+
+- (void)testReadWholeMapping
+{
+    NSData *contents = [self patternDataWithLength:100000];
+    OCTFilePathInput *input = [[OCTFilePathInput alloc] initWithFilePath:[self writeFileWithData:contents]];
+
+    XCTAssertTrue([input prepareToRead]);
+    [self verifyInput:input contents:contents];
+}
+
+- (void)testReadSlidingWindow
+{
+    NSData *contents = [self patternDataWithLength:100000];
+    OCTFilePathInput *input = [[OCTFilePathInput alloc] initWithFilePath:[self writeFileWithData:contents]];
+    input.maxMappingSize = 1000;
+    input.windowSize = 10000;
+
+    XCTAssertTrue([input prepareToRead]);
+    [self verifyInput:input contents:contents];
+
+    // Going back and crossing window end.
+    XCTAssertEqualObjects([input bytesWithPosition:9990 length:kChunkSize],
+                          [contents subdataWithRange:NSMakeRange(9990, kChunkSize)]);
+    XCTAssertEqualObjects([input bytesWithPosition:5 length:10], [contents subdataWithRange:NSMakeRange(5, 10)]);
+}
+
+- (void)testReadPastEnd
+{
+    NSData *contents = [self patternDataWithLength:100];
+    OCTFilePathInput *input = [[OCTFilePathInput alloc] initWithFilePath:[self writeFileWithData:contents]];
+
+    XCTAssertTrue([input prepareToRead]);
+    XCTAssertEqualObjects([input bytesWithPosition:90 length:kChunkSize], [contents subdataWithRange:NSMakeRange(90, 10)]);
+    XCTAssertEqual([input bytesWithPosition:100 length:kChunkSize].length, 0);
+    XCTAssertNil([input bytesWithPosition:101 length:kChunkSize]);
+}
+
+- (void)testNoFile
+{
+    OCTFilePathInput *input = [[OCTFilePathInput alloc] initWithFilePath:[self.directory stringByAppendingPathComponent:@"none"]];
+    XCTAssertFalse([input prepareToRead]);
+}
+
+- (void)testDataOutlivesFinishReading
+{
+    NSData *contents = [self patternDataWithLength:100000];
+    OCTFilePathInput *input = [[OCTFilePathInput alloc] initWithFilePath:[self writeFileWithData:contents]];
+    input.maxMappingSize = 0;
+    input.windowSize = 4096;
+
+    XCTAssertTrue([input prepareToRead]);
+    NSData *data = [input bytesWithPosition:50000 length:kChunkSize];
+
+    [input finishReading];
+
+    XCTAssertNil([input bytesWithPosition:0 length:kChunkSize]);
+    XCTAssertEqualObjects(data, [contents subdataWithRange:NSMakeRange(50000, kChunkSize)]);
+}
+
+- (void)testPrepareToReadTwice
+{
+    NSData *contents = [self patternDataWithLength:100000];
+    OCTFilePathInput *input = [[OCTFilePathInput alloc] initWithFilePath:[self writeFileWithData:contents]];
+
+    XCTAssertTrue([input prepareToRead]);
+    XCTAssertTrue([input prepareToRead]);
+    [self verifyInput:input contents:contents];
+}
+
+- (void)testTruncatedFileIsNotReadThroughMapping
+{
+    // File size is checked after each 1MB read.
+    NSUInteger megabyte = 1024 * 1024;
+    NSData *contents = [self patternDataWithLength:3 * megabyte];
+    NSString *path = [self writeFileWithData:contents];
+    OCTFilePathInput *input = [[OCTFilePathInput alloc] initWithFilePath:path];
+
+    XCTAssertTrue([input prepareToRead]);
+    XCTAssertEqualObjects([input bytesWithPosition:1000 length:kChunkSize],
+                          [contents subdataWithRange:NSMakeRange(1000, kChunkSize)]);
+
+    XCTAssertEqual(truncate(path.fileSystemRepresentation, 3 * megabyte / 2), 0);
+
+    XCTAssertEqualObjects([input bytesWithPosition:megabyte length:kChunkSize],
+                          [contents subdataWithRange:NSMakeRange(megabyte, kChunkSize)]);
+    XCTAssertNil([input bytesWithPosition:2 * megabyte length:kChunkSize]);
+}
+
+#pragma mark -  Throughput benchmark
+
+/**
+ * Old path: seek and readDataOfLength: of NSFileHandle, every chunk is copied to new buffer.
+ */
+- (void)testThroughputWithFileHandlePerformance
+{
+    NSString *path = [self writeFileWithData:[self patternDataWithLength:kBenchmarkFileSize]];
+
+    [self measureBlock:^{
+        NSFileHandle *handle = [NSFileHandle fileHandleForReadingAtPath:path];
+
+        for (OCTToxFileSize position = 0; position < kBenchmarkFileSize; position += kChunkSize) {
+            @autoreleasepool {
+                [handle seekToFileOffset:position];
+                [handle readDataOfLength:kChunkSize];
+            }
+        }
+    }];
+}
+
+/**
+ * New path: chunks point into mapping.
+ */
+- (void)testThroughputWithMappingPerformance
+{
+    [self measureMappedThroughputWithMaxMappingSize:kOCTFilePathInputDefaultMaxMappingSize];
+}
+
+- (void)testThroughputWithSlidingWindowPerformance
+{
+    [self measureMappedThroughputWithMaxMappingSize:0];
+}
+
+/**
+ * Reads kBenchmarkFileSize bytes in kChunkSize chunks, MB/s = kBenchmarkFileSize / measured time.
+ */
+- (void)measureMappedThroughputWithMaxMappingSize:(OCTToxFileSize)maxMappingSize
+{
+    NSString *path = [self writeFileWithData:[self patternDataWithLength:kBenchmarkFileSize]];
+
+    [self measureBlock:^{
+        OCTFilePathInput *input = [[OCTFilePathInput alloc] initWithFilePath:path];
+        input.maxMappingSize = maxMappingSize;
+        [input prepareToRead];
+
+        for (OCTToxFileSize position = 0; position < kBenchmarkFileSize; position += kChunkSize) {
+            @autoreleasepool {
+                [input bytesWithPosition:position length:kChunkSize];
+            }
+        }
+
+        [input finishReading];
+    }];
+}
+
+#pragma mark -  Private
+
+- (void)verifyInput:(OCTFilePathInput *)input contents:(NSData *)contents
+{
+    for (NSUInteger position = 0; position < contents.length; position += kChunkSize) {
+        NSUInteger length = MIN(kChunkSize, contents.length - position);
+
+        NSData *data = [input bytesWithPosition:position length:kChunkSize];
+        XCTAssertEqualObjects(data, [contents subdataWithRange:NSMakeRange(position, length)]);
+    }
+}
+
+- (NSData *)patternDataWithLength:(NSUInteger)length
+{
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    uint8_t *bytes = data.mutableBytes;
+
+    for (NSUInteger i = 0; i < length; i++) {
+        bytes[i] = (uint8_t)(i % 251);
+    }
+
+    return data;
+}
+
+- (NSString *)writeFileWithData:(NSData *)data
+{
+    NSString *path = [self.directory stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    [data writeToFile:path atomically:NO];
+
+    return path;
+}
+
+@end
@@ -0,0 +1,325 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <XCTest/XCTest.h>
+
+#import "OCTTestCase.h"
+#import "OCTFilePathOutput.h"
+
+// Size of chunk toxcore delivers with default MTU.
+static const size_t kChunkSize = 1371;
+static const NSUInteger kBenchmarkFileSize = 32 * 1024 * 1024;
+static const NSUInteger kBufferSize = 512 * 1024;
+
+@interface OCTFilePathOutputTests : OCTTestCase
+
+@property (strong, nonatomic) NSString *directory;
+
+// Set by throttle block of outputs made by createOutput, no chunks are written meanwhile.
+@property (assign, atomic) BOOL throttled;
+
+@end
+
+@implementation OCTFilePathOutputTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    [[NSFileManager defaultManager] createDirectoryAtPath:self.directory withIntermediateDirectories:YES attributes:nil error:nil];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:self.directory error:nil];
+    self.directory = nil;
+
+    [super tearDown];
+}
+
+- (void)testWriteSeveralBuffers
+{
+    // More than reused write buffers together, so extra ones are allocated while I/O queue is behind.
+    NSMutableData *contents = [NSMutableData dataWithLength:5 * 1024 * 1024 + 123];
+    uint8_t *bytes = contents.mutableBytes;
+
+    for (NSUInteger i = 0; i < contents.length; i++) {
+        bytes[i] = (uint8_t)(i % 251);
+    }
+
+    OCTFilePathOutput *output = [self createOutput];
+    XCTAssertTrue([output prepareToWrite]);
+
+    for (NSUInteger position = 0; position < contents.length; position += kChunkSize) {
+        XCTAssertTrue([self writeBytes:bytes + position length:MIN(kChunkSize, contents.length - position) toOutput:output]);
+    }
+
+    XCTAssertTrue([output finishWriting]);
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:output.resultFilePath], contents);
+}
+
+- (void)testThrottlesWhileDiskIsBehind
+{
+    OCTFilePathOutput *output = [self createOutput];
+    XCTAssertTrue([output prepareToWrite]);
+
+    dispatch_semaphore_t stall = [self stallDiskOfOutput:output];
+
+    // All but two buffers are in flight.
+    XCTAssertTrue([output writeData:[NSMutableData dataWithLength:5 * kBufferSize]]);
+    XCTAssertFalse(self.throttled);
+    XCTAssertTrue([output writeData:[NSMutableData dataWithLength:kBufferSize]]);
+    XCTAssertTrue(self.throttled);
+
+    // Chunks sent before pause reached friend still fit.
+    XCTAssertTrue([output writeData:[NSMutableData dataWithLength:kBufferSize]]);
+
+    dispatch_semaphore_signal(stall);
+
+    NSPredicate *resumed = [NSPredicate predicateWithFormat:@"throttled == NO"];
+    [self expectationForPredicate:resumed evaluatedWithObject:self handler:nil];
+    [self waitForExpectationsWithTimeout:1.0 handler:nil];
+
+    XCTAssertTrue([output finishWriting]);
+}
+
+- (void)testExhaustedBuffersFailWriting
+{
+    OCTFilePathOutput *output = [self createOutput];
+
+    __block NSUInteger failuresCount = 0;
+    XCTestExpectation *expectation = [self expectationWithDescription:@"failure"];
+    output.writeFailureBlock = ^{
+        failuresCount++;
+        [expectation fulfill];
+    };
+
+    XCTAssertTrue([output prepareToWrite]);
+
+    dispatch_semaphore_t stall = [self stallDiskOfOutput:output];
+
+    XCTAssertTrue([output writeData:[NSMutableData dataWithLength:8 * kBufferSize]]);
+    XCTAssertFalse([output writeData:[NSMutableData dataWithLength:1]]);
+    XCTAssertFalse([output writeData:[NSMutableData dataWithLength:1]]);
+
+    [self waitForExpectationsWithTimeout:1.0 handler:nil];
+    dispatch_semaphore_signal(stall);
+
+    XCTAssertFalse([output finishWriting]);
+    XCTAssertEqual(failuresCount, 1);
+}
+
+- (void)testWriteAfterFinish
+{
+    OCTFilePathOutput *output = [self createOutput];
+    XCTAssertTrue([output prepareToWrite]);
+    XCTAssertTrue([output writeData:[@"data" dataUsingEncoding:NSUTF8StringEncoding]]);
+    XCTAssertTrue([output finishWriting]);
+
+    XCTAssertFalse([output writeData:[@"data" dataUsingEncoding:NSUTF8StringEncoding]]);
+    XCTAssertEqualObjects([NSString stringWithContentsOfFile:output.resultFilePath encoding:NSUTF8StringEncoding error:nil], @"data");
+}
+
+- (void)testCancel
+{
+    OCTFilePathOutput *output = [self createOutput];
+    XCTAssertTrue([output prepareToWrite]);
+
+    NSMutableData *data = [NSMutableData dataWithLength:3 * 1024 * 1024];
+    XCTAssertTrue([output writeData:data]);
+
+    [output cancel];
+    XCTAssertFalse([output writeData:data]);
+
+    // Temp file is removed on I/O queue after pending writes.
+    NSString *tempFolder = [self.directory stringByAppendingPathComponent:@"temp"];
+    NSPredicate *empty = [NSPredicate predicateWithBlock:^BOOL (NSString *folder, NSDictionary *bindings) {
+        return [[NSFileManager defaultManager] contentsOfDirectoryAtPath:folder error:nil].count == 0;
+    }];
+    [self expectationForPredicate:empty evaluatedWithObject:tempFolder handler:nil];
+
+    [self waitForExpectationsWithTimeout:1.0 handler:nil];
+}
+
+- (void)testResumeContinuesFromSynchronizedPosition
+{
+    NSMutableData *contents = [NSMutableData dataWithLength:2 * 1024 * 1024];
+    uint8_t *bytes = contents.mutableBytes;
+
+    for (NSUInteger i = 0; i < contents.length; i++) {
+        bytes[i] = (uint8_t)(i % 251);
+    }
+
+    NSUInteger bufferSize = 2 * kBufferSize;
+
+    NSString *tempFilePath;
+    NSString *resultFilePath;
+    __weak OCTFilePathOutput *weakOutput;
+
+    // Emulating relaunch: full buffers are synchronized, output is dropped without finishing.
+    @autoreleasepool {
+        OCTFilePathOutput *output = [self createOutput];
+        output.syncInterval = 1;
+        XCTAssertTrue([output prepareToWrite]);
+        XCTAssertEqual(output.resumePosition, 0);
+        XCTAssertTrue([output writeBytes:bytes length:bufferSize + 10]);
+
+        tempFilePath = output.tempFilePath;
+        resultFilePath = output.resultFilePath;
+        weakOutput = output;
+    }
+
+    NSPredicate *released = [NSPredicate predicateWithBlock:^BOOL (id object, NSDictionary *bindings) {
+        return weakOutput == nil;
+    }];
+    [self expectationForPredicate:released evaluatedWithObject:self handler:nil];
+    [self waitForExpectationsWithTimeout:1.0 handler:nil];
+
+    // Tail that may not have reached the disk is not trusted.
+    NSFileHandle *handle = [NSFileHandle fileHandleForWritingAtPath:tempFilePath];
+    [handle seekToEndOfFile];
+    [handle writeData:[NSMutableData dataWithLength:100]];
+    [handle closeFile];
+
+    OCTFilePathOutput *output = [[OCTFilePathOutput alloc] initWithTempFilePath:tempFilePath resultFilePath:resultFilePath];
+    XCTAssertTrue([output prepareToWrite]);
+    XCTAssertEqual(output.resumePosition, bufferSize);
+    XCTAssertTrue([output writeBytes:bytes + bufferSize length:contents.length - bufferSize]);
+    XCTAssertTrue([output finishWriting]);
+
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:resultFilePath], contents);
+}
+
+- (void)testResumeWithoutSynchronizedDataStartsFromScratch
+{
+    OCTFilePathOutput *output = [self createOutput];
+    XCTAssertTrue([output prepareToWrite]);
+    XCTAssertTrue([output writeData:[@"first " dataUsingEncoding:NSUTF8StringEncoding]]);
+
+    // Finished file has no synchronized length, as well as file left by older version.
+    [output finishWriting];
+    NSString *tempFilePath = [self.directory stringByAppendingPathComponent:@"partial"];
+    [[NSFileManager defaultManager] moveItemAtPath:output.resultFilePath toPath:tempFilePath error:nil];
+
+    output = [[OCTFilePathOutput alloc] initWithTempFilePath:tempFilePath
+                                              resultFilePath:[self.directory stringByAppendingPathComponent:@"result"]];
+    XCTAssertTrue([output prepareToWrite]);
+    XCTAssertEqual(output.resumePosition, 0);
+    XCTAssertTrue([output writeData:[@"second" dataUsingEncoding:NSUTF8StringEncoding]]);
+    XCTAssertTrue([output finishWriting]);
+
+    XCTAssertEqualObjects([NSString stringWithContentsOfFile:output.resultFilePath encoding:NSUTF8StringEncoding error:nil],
+                          @"second");
+}
+
+- (void)testWriteSubmittedAfterCancelDoesNotReachFile
+{
+    OCTFilePathOutput *output = [self createOutput];
+    XCTAssertTrue([output prepareToWrite]);
+    XCTAssertTrue([output writeData:[NSMutableData dataWithLength:kBufferSize - 1]]);
+
+    [output cancel];
+
+    // Buffer is full now, but output is closed.
+    XCTAssertFalse([output writeData:[NSMutableData dataWithLength:1]]);
+    XCTAssertFalse([output finishWriting]);
+}
+
+#pragma mark -  Performance
+
+/**
+ * Time taken from tox queue: writes kBenchmarkFileSize bytes in kChunkSize chunks, without waiting
+ * for data to reach the disk.
+ */
+- (void)testWriteBehindPerformance
+{
+    [self measureWritingAndFinishing:NO];
+}
+
+/**
+ * Total time of writing kBenchmarkFileSize bytes in kChunkSize chunks, MB/s = kBenchmarkFileSize / measured time.
+ */
+- (void)testWriteThroughputPerformance
+{
+    [self measureWritingAndFinishing:YES];
+}
+
+#pragma mark -  Private
+
+- (void)measureWritingAndFinishing:(BOOL)measureFinishing
+{
+    uint8_t *chunk = malloc(kChunkSize);
+    memset(chunk, 0xAB, kChunkSize);
+
+    [self measureMetrics:[[self class] defaultPerformanceMetrics] automaticallyStartMeasuring:NO forBlock:^{
+        OCTFilePathOutput *output = [self createOutput];
+        XCTAssertTrue([output prepareToWrite]);
+
+        [self startMeasuring];
+
+        for (NSUInteger position = 0; position < kBenchmarkFileSize; position += kChunkSize) {
+            [self writeBytes:chunk length:MIN(kChunkSize, kBenchmarkFileSize - position) toOutput:output];
+        }
+
+        if (! measureFinishing) {
+            [self stopMeasuring];
+        }
+
+        XCTAssertTrue([output finishWriting]);
+
+        if (measureFinishing) {
+            [self stopMeasuring];
+        }
+
+        [[NSFileManager defaultManager] removeItemAtPath:output.resultFilePath error:nil];
+    }];
+
+    free(chunk);
+}
+
+/**
+ * Mimics paused transfer: no chunks come while output is throttled.
+ */
+- (BOOL)writeBytes:(const uint8_t *)bytes length:(NSUInteger)length toOutput:(OCTFilePathOutput *)output
+{
+    while (self.throttled) {
+        usleep(100);
+    }
+
+    return [output writeBytes:bytes length:length];
+}
+
+/**
+ * Blocks I/O queue of output until returned semaphore is signalled.
+ */
+- (dispatch_semaphore_t)stallDiskOfOutput:(OCTFilePathOutput *)output
+{
+    dispatch_semaphore_t stall = dispatch_semaphore_create(0);
+
+    dispatch_async([output valueForKey:@"ioQueue"], ^{
+        dispatch_semaphore_wait(stall, DISPATCH_TIME_FOREVER);
+    });
+
+    return stall;
+}
+
+- (OCTFilePathOutput *)createOutput
+{
+    NSString *tempFolder = [self.directory stringByAppendingPathComponent:@"temp"];
+    [[NSFileManager defaultManager] createDirectoryAtPath:tempFolder withIntermediateDirectories:YES attributes:nil error:nil];
+
+    OCTFilePathOutput *output = [[OCTFilePathOutput alloc] initWithTempFolder:tempFolder resultFolder:self.directory fileName:@"file"];
+
+    self.throttled = NO;
+
+    __weak OCTFilePathOutputTests *weakSelf = self;
+    output.writeThrottleBlock = ^(BOOL throttled) {
+        weakSelf.throttled = throttled;
+    };
+
+    return output;
+}
+
+@end
@@ -0,0 +1,120 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <XCTest/XCTest.h>
+#import <OCMock/OCMock.h>
+
+#import "OCTTestCase.h"
+#import "OCTTox.h"
+#import "OCTFileTransferRegistry.h"
+#import "OCTFileBaseOperation.h"
+
+static const NSUInteger kLookupBenchmarkTransfers = 64;
+static const NSUInteger kLookupBenchmarkRepeats = 100000;
+
+@interface OCTFileTransferRegistryTests : OCTTestCase
+
+@property (strong, nonatomic) id tox;
+@property (strong, nonatomic) OCTFileTransferRegistry *registry;
+
+@end
+
+@implementation OCTFileTransferRegistryTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.tox = OCMClassMock([OCTTox class]);
+    self.registry = [OCTFileTransferRegistry new];
+}
+
+- (void)tearDown
+{
+    self.tox = nil;
+    self.registry = nil;
+
+    [super tearDown];
+}
+
+- (void)testLookup
+{
+    OCTFileBaseOperation *operation1 = [self operationWithFriendNumber:1 fileNumber:2];
+    OCTFileBaseOperation *operation2 = [self operationWithFriendNumber:2 fileNumber:1];
+
+    [self.registry registerOperation:operation1];
+    [self.registry registerOperation:operation2];
+
+    XCTAssertEqual([self.registry operationWithFileNumber:2 friendNumber:1], operation1);
+    XCTAssertEqual([self.registry operationWithFileNumber:1 friendNumber:2], operation2);
+    XCTAssertNil([self.registry operationWithFileNumber:1 friendNumber:1]);
+
+    // High bits of file number are used by toxcore for incoming transfers.
+    OCTFileBaseOperation *incoming = [self operationWithFriendNumber:1 fileNumber:(1 << 16)];
+    [self.registry registerOperation:incoming];
+
+    XCTAssertEqual([self.registry operationWithFileNumber:(1 << 16) friendNumber:1], incoming);
+    XCTAssertEqual([self.registry operationWithFileNumber:2 friendNumber:1], operation1);
+}
+
+- (void)testUnregisterOnCancel
+{
+    OCTFileBaseOperation *operation = [self operationWithFriendNumber:1 fileNumber:2];
+    [self.registry registerOperation:operation];
+
+    [self expectationForPredicate:[NSPredicate predicateWithFormat:@"count == 0"] evaluatedWithObject:self.registry handler:nil];
+
+    [operation cancel];
+
+    [self waitForExpectationsWithTimeout:1.0 handler:nil];
+    XCTAssertNil([self.registry operationWithFileNumber:2 friendNumber:1]);
+}
+
+- (void)testReusedFileNumberIsNotUnregistered
+{
+    OCTFileBaseOperation *old = [self operationWithFriendNumber:1 fileNumber:2];
+    OCTFileBaseOperation *new = [self operationWithFriendNumber:1 fileNumber:2];
+
+    [self.registry registerOperation:old];
+    [self.registry registerOperation:new];
+
+    [old cancel];
+
+    // Letting completion block of old operation run.
+    [NSThread sleepForTimeInterval:0.1];
+
+    XCTAssertEqual([self.registry operationWithFileNumber:2 friendNumber:1], new);
+    XCTAssertEqual(self.registry.count, 1);
+}
+
+- (void)testLookupPerformance
+{
+    for (OCTToxFriendNumber friendNumber = 0; friendNumber < kLookupBenchmarkTransfers; friendNumber++) {
+        [self.registry registerOperation:[self operationWithFriendNumber:friendNumber fileNumber:0]];
+    }
+
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < kLookupBenchmarkRepeats; i++) {
+            OCTToxFriendNumber friendNumber = (OCTToxFriendNumber)(i % kLookupBenchmarkTransfers);
+            XCTAssertNotNil([self.registry operationWithFileNumber:0 friendNumber:friendNumber]);
+        }
+    }];
+}
+
+#pragma mark -  Private
+
+- (OCTFileBaseOperation *)operationWithFriendNumber:(OCTToxFriendNumber)friendNumber fileNumber:(OCTToxFileNumber)fileNumber
+{
+    return [[OCTFileBaseOperation alloc] initWithTox:self.tox
+                                        friendNumber:friendNumber
+                                          fileNumber:fileNumber
+                                            fileSize:1
+                                            userInfo:nil
+                                       progressBlock:nil
+                                      etaUpdateBlock:nil
+                                        successBlock:nil
+                                        failureBlock:nil];
+}
+
+@end
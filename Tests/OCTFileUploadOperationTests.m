@@ -0,0 +1,218 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <XCTest/XCTest.h>
+#import <OCMock/OCMock.h>
+
+#import "OCTTox.h"
+#import "OCTFileUploadOperation.h"
+#import "OCTFileDataInput.h"
+
+static const OCTToxFriendNumber kFriendNumber = 5;
+static const OCTToxFileNumber kFileNumber = 7;
+static const size_t kChunkSize = 10;
+
+@interface OCTFileUploadOperationTests : XCTestCase
+
+@property (strong, nonatomic) id tox;
+@property (copy, nonatomic) OCTToxIterationObserver iterationObserver;
+
+/**
+ * Positions of chunks accepted by tox.
+ */
+@property (strong, nonatomic) NSMutableArray<NSNumber *> *sentPositions;
+@property (assign, nonatomic) BOOL sendQueueFull;
+
+@end
+
+@implementation OCTFileUploadOperationTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.sentPositions = [NSMutableArray new];
+
+    self.tox = OCMClassMock([OCTTox class]);
+
+    OCMStub([self.tox addIterationObserver:[OCMArg any]]).andDo(^(NSInvocation *invocation) {
+        __unsafe_unretained OCTToxIterationObserver observer;
+        [invocation getArgument:&observer atIndex:2];
+        self.iterationObserver = observer;
+
+        __unsafe_unretained id token = self.iterationObserver;
+        [invocation setReturnValue:&token];
+    });
+
+    OCMStub([self.tox removeIterationObserver:[OCMArg any]]).andDo(^(NSInvocation *invocation) {
+        self.iterationObserver = nil;
+    });
+
+    OCMStub([self.tox fileSendChunkForFileNumber:kFileNumber
+                                    friendNumber:kFriendNumber
+                                        position:0
+                                            data:[OCMArg any]
+                                       errorCode:[OCMArg anyPointer]])
+    .ignoringNonObjectArgs()
+    .andDo(^(NSInvocation *invocation) {
+        OCTToxFileSize position;
+        OCTToxErrorFileSendChunk *errorCode;
+
+        [invocation getArgument:&position atIndex:4];
+        [invocation getArgument:&errorCode atIndex:6];
+
+        BOOL result = ! self.sendQueueFull;
+
+        if (result) {
+            [self.sentPositions addObject:@(position)];
+        }
+        else {
+            *errorCode = OCTToxErrorFileSendChunkSendq;
+        }
+
+        [invocation setReturnValue:&result];
+    });
+}
+
+- (void)tearDown
+{
+    self.tox = nil;
+    self.iterationObserver = nil;
+
+    [super tearDown];
+}
+
+- (void)testSendChunks
+{
+    OCTFileUploadOperation *operation = [self createOperationWithFileSize:3 * kChunkSize];
+    [operation start];
+
+    for (OCTToxFileSize position = 0; position < 3 * kChunkSize; position += kChunkSize) {
+        [operation chunkRequestWithPosition:position length:kChunkSize];
+    }
+
+    XCTAssertEqualObjects(self.sentPositions, (@[@0, @10, @20]));
+    XCTAssertEqual(operation.parkedChunksCount, 0);
+
+    [operation chunkRequestWithPosition:3 * kChunkSize length:0];
+
+    XCTAssertNil(self.iterationObserver);
+    [self waitForOperationToFinish:operation];
+    XCTAssertEqual(operation.bytesDone, 3 * kChunkSize);
+}
+
+- (void)testParkedChunksAreRetriedInOrderAfterIteration
+{
+    OCTFileUploadOperation *operation = [self createOperationWithFileSize:3 * kChunkSize];
+    [operation start];
+
+    [operation chunkRequestWithPosition:0 length:kChunkSize];
+
+    self.sendQueueFull = YES;
+    [operation chunkRequestWithPosition:10 length:kChunkSize];
+    [operation chunkRequestWithPosition:20 length:kChunkSize];
+    [operation chunkRequestWithPosition:30 length:0];
+
+    XCTAssertEqualObjects(self.sentPositions, (@[@0]));
+    XCTAssertFalse(operation.isFinished);
+
+    // Queue is still full.
+    self.iterationObserver();
+    XCTAssertEqualObjects(self.sentPositions, (@[@0]));
+    XCTAssertEqual(operation.parkedChunksCount, 1);
+
+    self.sendQueueFull = NO;
+    self.iterationObserver();
+
+    XCTAssertEqualObjects(self.sentPositions, (@[@0, @10, @20]));
+    XCTAssertEqual(operation.parkedChunksCount, 1);
+    XCTAssertNil(self.iterationObserver);
+    [self waitForOperationToFinish:operation];
+}
+
+- (void)testProgressAndFinishAreNotReportedOnIterationThread
+{
+    NSThread *iterationThread = [NSThread currentThread];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"success"];
+
+    OCTFileDataInput *input = [[OCTFileDataInput alloc] initWithData:[NSMutableData dataWithLength:kChunkSize]];
+    OCTFileUploadOperation *operation = [[OCTFileUploadOperation alloc] initWithTox:self.tox
+                                                                          fileInput:input
+                                                                       friendNumber:kFriendNumber
+                                                                         fileNumber:kFileNumber
+                                                                           fileSize:kChunkSize
+                                                                           userInfo:nil
+                                                                      progressBlock:nil
+                                                                     etaUpdateBlock:nil
+                                                                       successBlock:^(OCTFileBaseOperation *theOperation) {
+        [expectation fulfill];
+    }
+                                                                       failureBlock:nil];
+    [operation start];
+
+    __block NSThread *finishThread;
+    [self keyValueObservingExpectationForObject:operation keyPath:@"isFinished" handler:^BOOL (id object, NSDictionary *change) {
+        finishThread = [NSThread currentThread];
+        return operation.isFinished;
+    }];
+
+    self.sendQueueFull = YES;
+    [operation chunkRequestWithPosition:0 length:kChunkSize];
+    [operation chunkRequestWithPosition:kChunkSize length:0];
+
+    self.sendQueueFull = NO;
+    self.iterationObserver();
+
+    [self waitForExpectationsWithTimeout:5.0 handler:nil];
+
+    XCTAssertNotEqual(finishThread, iterationThread);
+    XCTAssertEqual(operation.bytesDone, kChunkSize);
+}
+
+- (void)testCancelDropsParkedChunks
+{
+    OCTFileUploadOperation *operation = [self createOperationWithFileSize:3 * kChunkSize];
+    [operation start];
+
+    self.sendQueueFull = YES;
+    [operation chunkRequestWithPosition:0 length:kChunkSize];
+
+    OCTToxIterationObserver observer = self.iterationObserver;
+    [operation cancel];
+
+    XCTAssertNil(self.iterationObserver);
+
+    self.sendQueueFull = NO;
+    observer();
+
+    XCTAssertEqual(self.sentPositions.count, 0);
+}
+
+#pragma mark -  Private
+
+- (void)waitForOperationToFinish:(OCTFileUploadOperation *)operation
+{
+    NSPredicate *finished = [NSPredicate predicateWithFormat:@"isFinished == YES"];
+    [self expectationForPredicate:finished evaluatedWithObject:operation handler:nil];
+
+    [self waitForExpectationsWithTimeout:5.0 handler:nil];
+}
+
+- (OCTFileUploadOperation *)createOperationWithFileSize:(OCTToxFileSize)fileSize
+{
+    OCTFileDataInput *input = [[OCTFileDataInput alloc] initWithData:[NSMutableData dataWithLength:(NSUInteger)fileSize]];
+
+    return [[OCTFileUploadOperation alloc] initWithTox:self.tox
+                                             fileInput:input
+                                          friendNumber:kFriendNumber
+                                            fileNumber:kFileNumber
+                                              fileSize:fileSize
+                                              userInfo:nil
+                                         progressBlock:nil
+                                        etaUpdateBlock:nil
+                                          successBlock:nil
+                                          failureBlock:nil];
+}
+
+@end
@@ -32,6 +32,7 @@
     XCTAssertNotNil(configuration.fileStorage);
     XCTAssertNotNil(configuration.options);
     XCTAssertTrue(configuration.useFauxOfflineMessaging);
+    XCTAssertEqual(configuration.toxSaveMaxLatency, 2.0);
 }
 
 - (void)testCopy
@@ -49,6 +50,7 @@
     configuration.options.holePunchingEnabled = YES;
     configuration.importToxSaveFromPath = @"save.tox";
     configuration.useFauxOfflineMessaging = NO;
+    configuration.toxSaveMaxLatency = 5.0;
 
     OCTManagerConfiguration *c2 = [configuration copy];
 
@@ -64,6 +66,7 @@
     configuration.options.holePunchingEnabled = NO;
     configuration.importToxSaveFromPath = @"another.tox";
     configuration.useFauxOfflineMessaging = YES;
+    configuration.toxSaveMaxLatency = 1.0;
 
     XCTAssertEqualObjects(configuration.fileStorage, c2.fileStorage);
 
@@ -79,6 +82,7 @@
     XCTAssertTrue(c2.options.holePunchingEnabled);
     XCTAssertEqualObjects(c2.importToxSaveFromPath, @"save.tox");
     XCTAssertFalse(c2.useFauxOfflineMessaging);
+    XCTAssertEqual(c2.toxSaveMaxLatency, 5.0);
 }
 
 @end
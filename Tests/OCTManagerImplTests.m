@@ -5,6 +5,7 @@
 #import <OCMock/OCMock.h>
 #import <XCTest/XCTest.h>
 
+#import "OCTTestCase.h"
 #import "OCTManagerImpl.h"
 #import "OCTManagerFactory.h"
 #import "OCTManagerConstants.h"
@@ -25,6 +26,9 @@
 #import "OCTMessageAbstract.h"
 #import "OCTMessageText.h"
 #import "OCTMessageFile.h"
+#import "OCTToxPassKey+Private.h"
+#import "OCTToxEventBatch+Private.h"
+#import "OCTFriend.h"
 
 static NSString *const kTestDirectory = @"me.dvor.objcToxTests";
 
@@ -49,15 +53,20 @@ static NSString *const kTestDirectory = @"me.dvor.objcToxTests";
 @end
 
 
+static const NSUInteger kForwardedCallbacksCount = 1000000;
+
 @interface FakeSubmanager : NSObject <OCTToxDelegate>
 @property (weak, nonatomic) id dataSource;
+@property (assign, nonatomic) NSUInteger connectionStatusCount;
 @end
 @implementation FakeSubmanager
 - (void)tox:(OCTTox *)tox connectionStatus:(OCTToxConnectionStatus)status
-{}
+{
+    self.connectionStatusCount++;
+}
 @end
 
-@interface OCTManagerImplTests : XCTestCase
+@interface OCTManagerImplTests : OCTTestCase
 
 @property (strong, nonatomic) OCTManagerImpl *manager;
 @property (nonatomic, assign) id mockedCallManager;
@@ -270,6 +279,52 @@ static NSString *const kTestDirectory = @"me.dvor.objcToxTests";
     [self waitForExpectationsWithTimeout:2.0 handler:nil];
 }
 
+- (void)testKeyDerivationsCount
+{
+    [self.tox stopMocking];
+    self.tox = nil;
+
+    OCTManagerConfiguration *configuration = [OCTManagerConfiguration defaultConfiguration];
+    configuration.fileStorage = [self temporaryFileStorage];
+
+    NSUInteger (^launch)(NSString *) = ^NSUInteger (NSString *password) {
+        NSUInteger count = [OCTToxPassKey keyDerivationsCount];
+        XCTestExpectation *expectation = [self expectationWithDescription:@"launch"];
+
+        [OCTManagerFactory managerWithConfiguration:configuration encryptPassword:password successBlock:^(id < OCTManager > manager) {
+            XCTAssertTrue([manager isManagerEncryptedWithPassword:password]);
+            [expectation fulfill];
+        } failureBlock:nil];
+
+        [self waitForExpectationsWithTimeout:10.0 handler:nil];
+
+        return [OCTToxPassKey keyDerivationsCount] - count;
+    };
+
+    // Keys of previous manager may be still alive, so launch can take no derivations at all.
+    NSUInteger firstLaunch = launch(@"password123");
+    NSUInteger secondLaunch = launch(@"password123");
+
+    XCTAssertLessThanOrEqual(firstLaunch, 1);
+    XCTAssertLessThanOrEqual(secondLaunch, 1);
+
+    __block NSUInteger passwordChange;
+    XCTestExpectation *expectation = [self expectationWithDescription:@"change"];
+
+    [OCTManagerFactory managerWithConfiguration:configuration encryptPassword:@"password123" successBlock:^(id < OCTManager > manager) {
+        NSUInteger count = [OCTToxPassKey keyDerivationsCount];
+        XCTAssertTrue([manager changeEncryptPassword:@"new password" oldPassword:@"password123"]);
+        passwordChange = [OCTToxPassKey keyDerivationsCount] - count;
+
+        [expectation fulfill];
+    } failureBlock:nil];
+
+    [self waitForExpectationsWithTimeout:10.0 handler:nil];
+
+    XCTAssertEqual(passwordChange, 1);
+    XCTAssertLessThanOrEqual(launch(@"new password"), 1);
+}
+
 - (void)testDatabaseMigration
 {
     NSMutableArray *friendsArray = [NSMutableArray new];
@@ -476,6 +531,127 @@ static NSString *const kTestDirectory = @"me.dvor.objcToxTests";
     XCTAssertEqual([self.manager forwardingTargetForSelector:@selector(tox:connectionStatus:)], submanager);
 }
 
+- (void)testForwardingIsMulticasted
+{
+    [self createManager];
+
+    FakeSubmanager *first = [FakeSubmanager new];
+    FakeSubmanager *second = [FakeSubmanager new];
+    id dummy = [NSObject new];
+
+    self.manager.bootstrap = first;
+    self.manager.chats = dummy;
+    self.manager.files = second;
+    self.manager.friends = dummy;
+    self.manager.objects = dummy;
+    self.manager.user = first;
+
+    XCTAssertTrue([self.manager respondsToSelector:@selector(tox:connectionStatus:)]);
+    XCTAssertFalse([self.manager respondsToSelector:@selector(tox:friendNameUpdate:friendNumber:)]);
+    XCTAssertTrue([self.manager respondsToSelector:@selector(tox:receivedEventBatch:)]);
+
+    // Selector with several targets is not forwarded to single one.
+    XCTAssertNil([self.manager forwardingTargetForSelector:@selector(tox:connectionStatus:)]);
+
+    [(id<OCTToxDelegate>)self.manager tox:self.tox connectionStatus:OCTToxConnectionStatusUDP];
+
+    // Same submanager set for several properties receives callback once.
+    XCTAssertEqual(first.connectionStatusCount, 1);
+    XCTAssertEqual(second.connectionStatusCount, 1);
+}
+
+- (void)testForwardedCallbacksPerformance
+{
+    [self createManager];
+
+    FakeSubmanager *submanager = [FakeSubmanager new];
+    self.manager.user = submanager;
+
+    id<OCTToxDelegate> delegate = (id<OCTToxDelegate>)self.manager;
+    OCTTox *tox = self.tox;
+
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < kForwardedCallbacksCount; i++) {
+            if ([delegate respondsToSelector:@selector(tox:connectionStatus:)]) {
+                [delegate tox:tox connectionStatus:OCTToxConnectionStatusUDP];
+            }
+        }
+    }];
+
+    XCTAssertEqual(submanager.connectionStatusCount % kForwardedCallbacksCount, 0);
+}
+
+- (void)testEventBatchCallsToxOutsideOfTransaction
+{
+    [self createManager];
+
+    OCTRealmManager *realmManager = self.manager.realmManager;
+
+    OCTFriend *friend = [OCTFriend new];
+    friend.nickname = @"";
+    friend.publicKey = [[NSUUID UUID] UUIDString];
+    friend.friendNumber = 5;
+    [realmManager addObject:friend];
+
+    NSString *publicKey = friend.publicKey;
+    NSMutableDictionary *clientIdentifiers = [NSMutableDictionary new];
+    __block NSUInteger callsInsideOfTransaction = 0;
+
+    void (^checkTransaction)(void) = ^{
+        if ([realmManager currentRealm].inWriteTransaction) {
+            callsInsideOfTransaction++;
+        }
+    };
+
+    // Friend isn't in friends cache of tox yet, so it is looked up by public key.
+    OCMStub([self.tox clientIdentifierForFriendNumber:5]).andDo(^(NSInvocation *invocation) {
+        __unsafe_unretained NSString *identifier = clientIdentifiers[@5];
+        [invocation setReturnValue:&identifier];
+    });
+    OCMStub([self.tox setClientIdentifier:[OCMArg any] forFriendNumber:5]).andDo(^(NSInvocation *invocation) {
+        __unsafe_unretained NSString *identifier;
+        [invocation getArgument:&identifier atIndex:2];
+        clientIdentifiers[@5] = identifier;
+    });
+    OCMStub([self.tox publicKeyFromFriendNumber:5 error:nil]).andDo(^(NSInvocation *invocation) {
+        checkTransaction();
+
+        __unsafe_unretained NSString *key = publicKey;
+        [invocation setReturnValue:&key];
+    });
+    OCMStub([self.tox fileGetFileIdForFileNumber:1 friendNumber:5 error:nil]).andDo(^(NSInvocation *invocation) {
+        checkTransaction();
+
+        __unsafe_unretained NSData *fileId = nil;
+        [invocation setReturnValue:&fileId];
+    });
+
+    OCTTox *tox = self.tox;
+    OCTToxEventBatch *batch = [[OCTToxEventBatch alloc] initWithEvents:@[
+                                   ^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
+                                       [delegate tox:tox friendMessage:@"message" type:OCTToxMessageTypeNormal friendNumber:5];
+                                   },
+                                   ^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
+                                       [delegate tox:tox fileReceiveForFileNumber:1
+                                            friendNumber:5
+                                                    kind:OCTToxFileKindData
+                                                fileSize:100
+                                                fileName:@"file.txt"];
+                                   },
+                               ]
+                                                       toxEventIndexes:[NSIndexSet indexSetWithIndex:1]
+                                                         friendNumbers:[NSIndexSet indexSetWithIndex:5]];
+
+    [(id<OCTToxDelegate>)self.manager tox:tox receivedEventBatch:batch];
+
+    OCMVerify([self.tox publicKeyFromFriendNumber:5 error:nil]);
+    OCMVerify([self.tox fileGetFileIdForFileNumber:1 friendNumber:5 error:nil]);
+    XCTAssertEqual(callsInsideOfTransaction, 0);
+
+    RLMResults *messages = [realmManager objectsWithClass:[OCTMessageAbstract class] predicate:nil];
+    XCTAssertEqual(messages.count, 2);
+}
+
 - (void)testExportToxSaveFile
 {
     [self createManager];
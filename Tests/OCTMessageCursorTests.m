@@ -0,0 +1,296 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <XCTest/XCTest.h>
+#import <Realm/Realm.h>
+
+#import "OCTTestCase.h"
+#import "OCTMessageCursor+Private.h"
+#import "OCTRealmManager.h"
+#import "OCTChat.h"
+#import "OCTMessageAbstract.h"
+#import "OCTMessageText.h"
+
+static const NSUInteger kLargeChatMessagesCount = 100000;
+
+@interface OCTMessageCursorTests : OCTTestCase
+
+@property (strong, nonatomic) NSString *directory;
+@property (strong, nonatomic) OCTRealmManager *realmManager;
+@property (strong, nonatomic) OCTChat *chat;
+
+@end
+
+@implementation OCTMessageCursorTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    // Cursor reads on background queue, so real database file is used instead of mocked in-memory realm.
+    self.directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    [[NSFileManager defaultManager] createDirectoryAtPath:self.directory withIntermediateDirectories:YES attributes:nil error:nil];
+
+    NSURL *fileURL = [NSURL fileURLWithPath:[self.directory stringByAppendingPathComponent:@"database"]];
+    self.realmManager = [[OCTRealmManager alloc] initWithDatabaseFileURL:fileURL encryptionKey:nil];
+
+    self.chat = [OCTChat new];
+    [self.realmManager addObject:self.chat];
+}
+
+- (void)tearDown
+{
+    self.chat = nil;
+    self.realmManager = nil;
+
+    [[NSFileManager defaultManager] removeItemAtPath:self.directory error:nil];
+
+    [super tearDown];
+}
+
+- (void)testOlderMessages
+{
+    NSArray *identifiers = [self addMessagesWithDateIntervals:[self dateIntervalsFrom:1000 count:25 step:1]];
+
+    OCTMessageCursor *cursor = [self cursorWithPageSize:10];
+
+    NSArray *page = [cursor olderMessages];
+    XCTAssertEqualObjects([page valueForKey:@"uniqueIdentifier"], [identifiers subarrayWithRange:NSMakeRange(15, 10)]);
+    XCTAssertTrue(cursor.hasOlderMessages);
+
+    page = [cursor olderMessages];
+    XCTAssertEqualObjects([page valueForKey:@"uniqueIdentifier"], [identifiers subarrayWithRange:NSMakeRange(5, 10)]);
+    XCTAssertTrue(cursor.hasOlderMessages);
+
+    page = [cursor olderMessages];
+    XCTAssertEqualObjects([page valueForKey:@"uniqueIdentifier"], [identifiers subarrayWithRange:NSMakeRange(0, 5)]);
+    XCTAssertFalse(cursor.hasOlderMessages);
+
+    XCTAssertEqual([cursor olderMessages].count, 0);
+}
+
+- (void)testMessagesOfOtherChatsAreSkipped
+{
+    OCTChat *other = [OCTChat new];
+    [self.realmManager addObject:other];
+
+    OCTMessageAbstract *message = [self messageWithDateInterval:1000];
+    message.chatUniqueIdentifier = other.uniqueIdentifier;
+    [self.realmManager addObject:message];
+
+    NSArray *identifiers = [self addMessagesWithDateIntervals:@[@(1001)]];
+
+    XCTAssertEqualObjects([[[self cursorWithPageSize:10] olderMessages] valueForKey:@"uniqueIdentifier"], identifiers);
+}
+
+- (void)testMessagesWithSameDate
+{
+    NSArray *dateIntervals = [self dateIntervalsFrom:1000 count:10 step:0];
+    [self addMessagesWithDateIntervals:dateIntervals];
+
+    OCTMessageCursor *cursor = [self cursorWithPageSize:3];
+    NSMutableArray *identifiers = [NSMutableArray new];
+
+    while (cursor.hasOlderMessages) {
+        NSArray *page = [cursor olderMessages];
+        [identifiers insertObjects:[page valueForKey:@"uniqueIdentifier"]
+                         atIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, page.count)]];
+    }
+
+    NSArray *expected = [[self allIdentifiers] sortedArrayUsingComparator:^NSComparisonResult (NSString *first, NSString *second) {
+        return [first compare:second options:NSLiteralSearch];
+    }];
+    XCTAssertEqualObjects(identifiers, expected);
+}
+
+- (void)testSparseHistory
+{
+    // Years between messages, window has to grow several times.
+    NSArray *identifiers = [self addMessagesWithDateIntervals:[self dateIntervalsFrom:1000 count:5 step:365 * 24 * 60 * 60]];
+
+    NSArray *page = [[self cursorWithPageSize:10] olderMessages];
+
+    XCTAssertEqualObjects([page valueForKey:@"uniqueIdentifier"], identifiers);
+}
+
+- (void)testNewerMessages
+{
+    [self addMessagesWithDateIntervals:[self dateIntervalsFrom:1000 count:5 step:1]];
+
+    OCTMessageCursor *cursor = [self cursorWithPageSize:3];
+
+    XCTAssertEqual([cursor olderMessages].count, 3);
+    XCTAssertEqual([cursor newerMessages].count, 0);
+
+    NSTimeInterval now = [[NSDate date] timeIntervalSince1970];
+    NSArray *identifiers = [self addMessagesWithDateIntervals:[self dateIntervalsFrom:now + 1 count:4 step:1]];
+
+    NSArray *page = [cursor newerMessages];
+    XCTAssertEqualObjects([page valueForKey:@"uniqueIdentifier"], [identifiers subarrayWithRange:NSMakeRange(0, 3)]);
+
+    page = [cursor newerMessages];
+    XCTAssertEqualObjects([page valueForKey:@"uniqueIdentifier"], [identifiers subarrayWithRange:NSMakeRange(3, 1)]);
+
+    XCTAssertEqual([cursor newerMessages].count, 0);
+
+    // Older direction is not affected.
+    XCTAssertEqual([cursor olderMessages].count, 2);
+}
+
+- (void)testPrefetchedPageIsUsed
+{
+    NSArray *identifiers = [self addMessagesWithDateIntervals:[self dateIntervalsFrom:1000 count:20 step:1]];
+
+    OCTMessageCursor *cursor = [self cursorWithPageSize:10];
+    [cursor olderMessages];
+
+    // Waiting for prefetch, then removing messages. Prefetched snapshot is returned.
+    dispatch_sync([cursor valueForKey:@"queue"], ^{});
+
+    [self.realmManager.realm beginWriteTransaction];
+    [self.realmManager.realm deleteObjects:[OCTMessageAbstract allObjectsInRealm:self.realmManager.realm]];
+    [self.realmManager.realm commitWriteTransaction];
+
+    NSArray *page = [cursor olderMessages];
+    XCTAssertEqualObjects([page valueForKey:@"uniqueIdentifier"], [identifiers subarrayWithRange:NSMakeRange(0, 10)]);
+}
+
+- (void)testSnapshots
+{
+    [self addMessagesWithDateIntervals:@[@(1000)]];
+
+    OCTMessageAbstract *message = [[[self cursorWithPageSize:10] olderMessages] firstObject];
+
+    XCTAssertNil(message.realm);
+    XCTAssertNil(message.messageText.realm);
+    XCTAssertEqualObjects(message.messageText.text, @"message");
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"other thread"];
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        XCTAssertEqualObjects(message.messageText.text, @"message");
+        [expectation fulfill];
+    });
+
+    [self waitForExpectationsWithTimeout:1.0 handler:nil];
+}
+
+#pragma mark -  Performance
+
+/**
+ * Previous behaviour: sorting all messages of chat to show the latest ones.
+ */
+- (void)testSortLargeChatPerformance
+{
+    [self addLargeChat];
+
+    [self measureBlock:^{
+        RLMResults *all = [OCTMessageAbstract objectsInRealm:self.realmManager.realm
+                                                       where:@"chatUniqueIdentifier == %@", self.chat.uniqueIdentifier];
+        all = [all sortedResultsUsingKeyPath:@"dateInterval" ascending:YES];
+        XCTAssertNotNil(all.lastObject);
+    }];
+}
+
+/**
+ * Opening chat with cursor, second page is prefetched.
+ */
+- (void)testOpenLargeChatWithCursorPerformance
+{
+    [self addLargeChat];
+
+    [self measureBlock:^{
+        OCTMessageCursor *cursor = [self cursorWithPageSize:50];
+
+        XCTAssertEqual([cursor olderMessages].count, 50);
+        XCTAssertEqual([cursor olderMessages].count, 50);
+    }];
+}
+
+#pragma mark -  Private
+
+/**
+ * Adds kLargeChatMessagesCount messages to chat, message per minute.
+ */
+- (void)addLargeChat
+{
+    const NSUInteger batchSize = 10000;
+    NSTimeInterval now = [[NSDate date] timeIntervalSince1970];
+
+    for (NSUInteger batch = 0; batch < kLargeChatMessagesCount / batchSize; batch++) {
+        @autoreleasepool {
+            [self.realmManager.realm beginWriteTransaction];
+
+            for (NSUInteger i = batch * batchSize; i < (batch + 1) * batchSize; i++) {
+                OCTMessageAbstract *message = [self messageWithDateInterval:now - (kLargeChatMessagesCount - i) * 60];
+                [self.realmManager.realm addObject:message];
+            }
+
+            [self.realmManager.realm commitWriteTransaction];
+        }
+    }
+}
+
+- (OCTMessageCursor *)cursorWithPageSize:(NSUInteger)pageSize
+{
+    return [[OCTMessageCursor alloc] initWithRealmManager:self.realmManager
+                                     chatUniqueIdentifier:self.chat.uniqueIdentifier
+                                                 pageSize:pageSize];
+}
+
+- (NSArray<NSNumber *> *)dateIntervalsFrom:(NSTimeInterval)from count:(NSUInteger)count step:(NSTimeInterval)step
+{
+    NSMutableArray *dateIntervals = [NSMutableArray new];
+
+    for (NSUInteger i = 0; i < count; i++) {
+        [dateIntervals addObject:@(from + i * step)];
+    }
+
+    return dateIntervals;
+}
+
+/**
+ * @return Unique identifiers of added messages.
+ */
+- (NSArray<NSString *> *)addMessagesWithDateIntervals:(NSArray<NSNumber *> *)dateIntervals
+{
+    NSMutableArray *messages = [NSMutableArray new];
+
+    for (NSNumber *dateInterval in dateIntervals) {
+        [messages addObject:[self messageWithDateInterval:dateInterval.doubleValue]];
+    }
+
+    [self.realmManager.realm beginWriteTransaction];
+    [self.realmManager.realm addObjects:messages];
+    [self.realmManager.realm commitWriteTransaction];
+
+    return [messages valueForKey:@"uniqueIdentifier"];
+}
+
+- (NSArray<NSString *> *)allIdentifiers
+{
+    RLMResults *messages = [OCTMessageAbstract allObjectsInRealm:self.realmManager.realm];
+    NSMutableArray *identifiers = [NSMutableArray new];
+
+    for (OCTMessageAbstract *message in messages) {
+        [identifiers addObject:message.uniqueIdentifier];
+    }
+
+    return identifiers;
+}
+
+- (OCTMessageAbstract *)messageWithDateInterval:(NSTimeInterval)dateInterval
+{
+    OCTMessageText *messageText = [OCTMessageText new];
+    messageText.text = @"message";
+
+    OCTMessageAbstract *message = [OCTMessageAbstract new];
+    message.dateInterval = dateInterval;
+    message.chatUniqueIdentifier = self.chat.uniqueIdentifier;
+    message.messageText = messageText;
+
+    return message;
+}
+
+@end
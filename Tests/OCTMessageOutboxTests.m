@@ -0,0 +1,286 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <OCMock/OCMock.h>
+
+#import "OCTRealmTests.h"
+
+#import "OCTMessageOutbox.h"
+#import "OCTMessageOutboxEntry.h"
+#import "OCTTox.h"
+#import "OCTMessageAbstract.h"
+#import "OCTMessageText.h"
+
+@interface OCTMessageOutboxTests : OCTRealmTests
+
+@property (strong, nonatomic) id tox;
+@property (strong, nonatomic) OCTMessageOutbox *outbox;
+
+/**
+ * "friendNumber:text" of messages passed to tox.
+ */
+@property (strong, nonatomic) NSMutableArray<NSString *> *sentMessages;
+
+/**
+ * friendNumber to error code returned by tox, friends without code send successfully.
+ */
+@property (strong, nonatomic) NSMutableDictionary<NSNumber *, NSNumber *> *sendErrorCodes;
+
+@end
+
+@implementation OCTMessageOutboxTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.sentMessages = [NSMutableArray new];
+    self.sendErrorCodes = [NSMutableDictionary new];
+
+    self.tox = OCMClassMock([OCTTox class]);
+    OCMStub([self.tox sendMessageWithFriendNumber:0 type:0 message:[OCMArg any] error:[OCMArg anyObjectRef]])
+    .ignoringNonObjectArgs()
+    .andDo(^(NSInvocation *invocation) {
+        OCTToxFriendNumber friendNumber;
+        __unsafe_unretained NSString *text;
+        NSError *__autoreleasing *error;
+
+        [invocation getArgument:&friendNumber atIndex:2];
+        [invocation getArgument:&text atIndex:4];
+        [invocation getArgument:&error atIndex:5];
+
+        [self.sentMessages addObject:[NSString stringWithFormat:@"%u:%@", friendNumber, text]];
+
+        OCTToxMessageId messageId = (OCTToxMessageId)self.sentMessages.count;
+        NSNumber *code = self.sendErrorCodes[@(friendNumber)];
+
+        if (code) {
+            messageId = 0;
+
+            if (error) {
+                *error = [NSError errorWithDomain:kOCTToxErrorDomain code:code.integerValue userInfo:nil];
+            }
+        }
+
+        [invocation setReturnValue:&messageId];
+    });
+
+    self.outbox = [[OCTMessageOutbox alloc] initWithTox:self.tox realmManager:self.realmManager];
+}
+
+- (void)tearDown
+{
+    self.outbox = nil;
+    self.tox = nil;
+
+    [super tearDown];
+}
+
+- (void)testSendq
+{
+    OCTChat *chat = [self addChatWithFriendNumber:1];
+    [self.outbox addMessageWithText:@"a" type:OCTToxMessageTypeNormal chat:chat friend:chat.friends.firstObject];
+
+    self.sendErrorCodes[@1] = @(OCTToxErrorFriendSendMessageSendq);
+    [self.outbox drain];
+
+    XCTAssertEqualObjects(self.sentMessages, (@[@"1:a"]));
+    XCTAssertEqual([self.outbox queuedMessagesCountForFriendNumber:1], 1);
+
+    // Backing off, friend is skipped.
+    [self.outbox drain];
+    XCTAssertEqual(self.sentMessages.count, 1);
+
+    [self.sendErrorCodes removeAllObjects];
+    [NSThread sleepForTimeInterval:0.1];
+    [self.outbox drain];
+
+    XCTAssertEqualObjects(self.sentMessages, (@[@"1:a", @"1:a"]));
+    XCTAssertEqual([self.outbox queuedMessagesCountForFriendNumber:1], 0);
+}
+
+- (void)testFriendNotConnected
+{
+    OCTChat *chat = [self addChatWithFriendNumber:1];
+    [self.outbox addMessageWithText:@"a" type:OCTToxMessageTypeNormal chat:chat friend:chat.friends.firstObject];
+    [self.outbox addMessageWithText:@"b" type:OCTToxMessageTypeNormal chat:chat friend:chat.friends.firstObject];
+
+    self.sendErrorCodes[@1] = @(OCTToxErrorFriendSendMessageFriendNotConnected);
+    [self.outbox drain];
+    [self.outbox drain];
+
+    XCTAssertEqualObjects(self.sentMessages, (@[@"1:a"]));
+    XCTAssertEqual([self.outbox queuedMessagesCountForFriendNumber:1], 2);
+
+    [self.sendErrorCodes removeAllObjects];
+    [self.outbox resumeFriendNumber:1];
+    [self.outbox drain];
+
+    XCTAssertEqualObjects(self.sentMessages, (@[@"1:a", @"1:a", @"1:b"]));
+}
+
+- (void)testOtherErrorDropsMessage
+{
+    OCTChat *chat = [self addChatWithFriendNumber:1];
+    OCTMessageAbstract *message = [self.outbox addMessageWithText:@"a"
+                                                             type:OCTToxMessageTypeNormal
+                                                             chat:chat
+                                                           friend:chat.friends.firstObject];
+
+    __block NSString *failedIdentifier;
+    __block NSError *failedError;
+    self.outbox.failedBlock = ^(NSString *messageUniqueIdentifier, OCTToxFriendNumber friendNumber, NSError *error) {
+        failedIdentifier = messageUniqueIdentifier;
+        failedError = error;
+    };
+
+    self.sendErrorCodes[@1] = @(OCTToxErrorFriendSendMessageTooLong);
+    [self.outbox drain];
+    [self.realmManager flushAsyncWrites];
+
+    XCTAssertEqualObjects(failedIdentifier, message.uniqueIdentifier);
+    XCTAssertEqual(failedError.code, OCTToxErrorFriendSendMessageTooLong);
+    XCTAssertEqual([self.outbox queuedMessagesCountForFriendNumber:1], 0);
+    XCTAssertEqual([OCTMessageOutboxEntry allObjectsInRealm:self.realmManager.realm].count, 0);
+    XCTAssertEqual(message.messageText.messageId, 0);
+}
+
+- (void)testFreshMessagesBeforeBacklog
+{
+    OCTChat *chat = [self addChatWithFriendNumber:1];
+    OCTMessageAbstract *old = [self.realmManager addMessageWithText:@"old"
+                                                               type:OCTToxMessageTypeNormal
+                                                               chat:chat
+                                                             sender:nil
+                                                          messageId:0];
+
+    [self.outbox enqueueBacklogMessages:@[old] friendNumber:1];
+    [self.outbox addMessageWithText:@"new" type:OCTToxMessageTypeNormal chat:chat friend:chat.friends.firstObject];
+
+    // Already queued.
+    [self.outbox enqueueBacklogMessages:@[old] friendNumber:1];
+    XCTAssertEqual([self.outbox queuedMessagesCountForFriendNumber:1], 2);
+
+    [self.outbox drain];
+
+    XCTAssertEqualObjects(self.sentMessages, (@[@"1:new", @"1:old"]));
+}
+
+- (void)testSendBudgetAndRoundRobin
+{
+    OCTChat *chat1 = [self addChatWithFriendNumber:1];
+    OCTChat *chat2 = [self addChatWithFriendNumber:2];
+
+    for (NSUInteger i = 0; i < 3; i++) {
+        NSString *text = [NSString stringWithFormat:@"%lu", (unsigned long)i];
+        [self.outbox addMessageWithText:text type:OCTToxMessageTypeNormal chat:chat1 friend:chat1.friends.firstObject];
+    }
+    [self.outbox addMessageWithText:@"0" type:OCTToxMessageTypeNormal chat:chat2 friend:chat2.friends.firstObject];
+
+    self.outbox.sendBudget = 3;
+    [self.outbox drain];
+
+    NSArray *firstIteration = [self.sentMessages sortedArrayUsingSelector:@selector(compare:)];
+    XCTAssertEqualObjects(firstIteration, (@[@"1:0", @"1:1", @"2:0"]));
+    XCTAssertEqual([self.outbox queuedMessagesCountForFriendNumber:1], 1);
+    XCTAssertEqual([self.outbox queuedMessagesCountForFriendNumber:2], 0);
+
+    [self.outbox drain];
+
+    XCTAssertEqualObjects(self.sentMessages.lastObject, @"1:2");
+    XCTAssertEqual([self.outbox queuedMessagesCountForFriendNumber:1], 0);
+}
+
+- (void)testRoundRobinContinuesAfterLastServedFriend
+{
+    for (OCTToxFriendNumber friendNumber = 1; friendNumber <= 3; friendNumber++) {
+        OCTChat *chat = [self addChatWithFriendNumber:friendNumber];
+
+        for (NSUInteger i = 0; i < 2; i++) {
+            NSString *text = [NSString stringWithFormat:@"%lu", (unsigned long)i];
+            [self.outbox addMessageWithText:text type:OCTToxMessageTypeNormal chat:chat friend:chat.friends.firstObject];
+        }
+    }
+
+    self.outbox.sendBudget = 2;
+    [self.outbox drain];
+    [self.outbox drain];
+
+    // Second drain starts with friend skipped by the first one.
+    XCTAssertEqualObjects(self.sentMessages, (@[@"1:0", @"2:0", @"3:0", @"1:1"]));
+
+    [self.outbox drain];
+
+    XCTAssertEqualObjects(self.sentMessages, (@[@"1:0", @"2:0", @"3:0", @"1:1", @"2:1", @"3:1"]));
+}
+
+- (void)testSentMessageIsUpdated
+{
+    OCTChat *chat = [self addChatWithFriendNumber:1];
+    OCTMessageAbstract *message = [self.outbox addMessageWithText:@"a"
+                                                             type:OCTToxMessageTypeNormal
+                                                             chat:chat
+                                                           friend:chat.friends.firstObject];
+
+    __block NSString *sentIdentifier;
+    __block OCTToxMessageId sentMessageId;
+    self.outbox.sentBlock = ^(NSString *messageUniqueIdentifier, OCTToxFriendNumber friendNumber, OCTToxMessageId messageId) {
+        sentIdentifier = messageUniqueIdentifier;
+        sentMessageId = messageId;
+    };
+
+    XCTAssertEqual([OCTMessageOutboxEntry allObjectsInRealm:self.realmManager.realm].count, 1);
+
+    [self.outbox drain];
+    [self.realmManager flushAsyncWrites];
+
+    XCTAssertEqualObjects(sentIdentifier, message.uniqueIdentifier);
+    XCTAssertEqual(sentMessageId, 1);
+    XCTAssertEqual(message.messageText.messageId, 1);
+    XCTAssertEqual([OCTMessageOutboxEntry allObjectsInRealm:self.realmManager.realm].count, 0);
+}
+
+- (void)testRestore
+{
+    OCTChat *chat = [self addChatWithFriendNumber:1];
+    OCTFriend *friend = chat.friends.firstObject;
+
+    [self.outbox addMessageWithText:@"a" type:OCTToxMessageTypeNormal chat:chat friend:friend];
+    [self.outbox addMessageWithText:@"b" type:OCTToxMessageTypeNormal chat:chat friend:friend];
+    OCTMessageAbstract *delivered = [self.outbox addMessageWithText:@"c"
+                                                               type:OCTToxMessageTypeNormal
+                                                               chat:chat
+                                                             friend:friend];
+
+    [self.realmManager.realm beginWriteTransaction];
+    delivered.messageText.isDelivered = YES;
+    [self.realmManager.realm commitWriteTransaction];
+
+    // Relaunch before anything was sent.
+    self.outbox = [[OCTMessageOutbox alloc] initWithTox:self.tox realmManager:self.realmManager];
+    [self.outbox restore];
+
+    XCTAssertEqual([self.outbox queuedMessagesCountForFriendNumber:1], 2);
+    XCTAssertEqual([OCTMessageOutboxEntry allObjectsInRealm:self.realmManager.realm].count, 2);
+
+    [self.outbox drain];
+
+    XCTAssertEqualObjects(self.sentMessages, (@[@"1:a", @"1:b"]));
+}
+
+#pragma mark -  Private
+
+- (OCTChat *)addChatWithFriendNumber:(OCTToxFriendNumber)friendNumber
+{
+    OCTChat *chat = [OCTChat new];
+    [chat.friends addObject:[self createFriendWithFriendNumber:friendNumber]];
+
+    [self.realmManager.realm beginWriteTransaction];
+    [self.realmManager.realm addObject:chat];
+    [self.realmManager.realm commitWriteTransaction];
+
+    return chat;
+}
+
+@end
@@ -0,0 +1,378 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <XCTest/XCTest.h>
+#import <Realm/Realm.h>
+
+#import "OCTTestCase.h"
+#import "OCTMessageSearchIndex.h"
+#import "OCTMessageSearchEntry.h"
+#import "OCTRealmManager.h"
+#import "OCTSettingsStorageObject.h"
+#import "OCTChat.h"
+#import "OCTMessageAbstract.h"
+#import "OCTMessageText.h"
+
+static const NSUInteger kSearchMessagesCount = 100000;
+static const NSUInteger kSearchWordsCount = 20000;
+static const NSUInteger kSearchQueriesCount = 20;
+static const NSUInteger kLargeSearchMessagesCount = 1000000;
+static const NSUInteger kLargeSearchPageSize = 50;
+static NSString *const kFrequentWord = @"hello";
+
+@interface OCTMessageSearchIndexTests : OCTTestCase
+
+@property (strong, nonatomic) NSString *directory;
+@property (strong, nonatomic) OCTRealmManager *realmManager;
+@property (strong, nonatomic) OCTChat *chat;
+
+@end
+
+@implementation OCTMessageSearchIndexTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    // Index is rebuilt on background queue, so real database file is used instead of mocked in-memory realm.
+    self.directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    [[NSFileManager defaultManager] createDirectoryAtPath:self.directory withIntermediateDirectories:YES attributes:nil error:nil];
+
+    NSURL *fileURL = [NSURL fileURLWithPath:[self.directory stringByAppendingPathComponent:@"database"]];
+    self.realmManager = [[OCTRealmManager alloc] initWithDatabaseFileURL:fileURL encryptionKey:nil];
+
+    self.chat = [OCTChat new];
+    [self.realmManager addObject:self.chat];
+}
+
+- (void)tearDown
+{
+    self.chat = nil;
+    self.realmManager = nil;
+
+    [[NSFileManager defaultManager] removeItemAtPath:self.directory error:nil];
+
+    [super tearDown];
+}
+
+- (void)testTokens
+{
+    NSArray *tokens = [OCTMessageSearchIndex tokensFromString:@"Hello, WORLD! Café ｆｕｌｌ width, hello again :)"];
+    NSArray *expected = @[@"hello", @"world", @"cafe", @"full", @"width", @"again"];
+
+    XCTAssertEqualObjects(tokens, expected);
+
+    XCTAssertEqualObjects([OCTMessageSearchIndex tokensFromString:@""], @[]);
+    XCTAssertEqualObjects([OCTMessageSearchIndex tokensFromString:@"... !!! ?"], @[]);
+
+    // No spaces between words.
+    XCTAssertGreaterThan([OCTMessageSearchIndex tokensFromString:@"東京タワーに行きました"].count, 1);
+}
+
+- (void)testSearch
+{
+    OCTMessageAbstract *first = [self addMessageWithText:@"Meet me at the café tomorrow"];
+    OCTMessageAbstract *second = [self addMessageWithText:@"Tomorrow is fine"];
+
+    XCTAssertEqualObjects([self searchResults:@"tomorrow" chat:nil], (@[second, first]));
+    XCTAssertEqualObjects([self searchResults:@"TOMOR" chat:nil], (@[second, first]));
+    XCTAssertEqualObjects([self searchResults:@"cafe tom" chat:nil], (@[first]));
+    XCTAssertEqualObjects([self searchResults:@"fine café" chat:nil], (@[]));
+    XCTAssertEqualObjects([self searchResults:@"nothing" chat:nil], (@[]));
+    XCTAssertEqualObjects([self searchResults:@"  " chat:nil], (@[]));
+}
+
+- (void)testSearchInChat
+{
+    OCTChat *other = [OCTChat new];
+    [self.realmManager addObject:other];
+
+    OCTMessageAbstract *message = [self addMessageWithText:@"hello"];
+    [self.realmManager addMessageWithText:@"hello" type:OCTToxMessageTypeNormal chat:other sender:nil messageId:0];
+
+    XCTAssertEqual([self searchResults:@"hello" chat:nil].count, 2);
+    XCTAssertEqualObjects([self searchResults:@"hello" chat:self.chat], (@[message]));
+}
+
+- (void)testResultsAreUpdated
+{
+    OCTMessageAbstract *first = [self addMessageWithText:@"hello"];
+    RLMResults *results = [self.realmManager searchMessagesWithQuery:@"hel" chatUniqueIdentifier:nil];
+
+    XCTAssertEqual(results.count, 1);
+
+    OCTMessageAbstract *second = [self addMessageWithText:@"hello again"];
+
+    XCTAssertEqual(results.count, 2);
+    XCTAssertEqualObjects(results.firstObject, second);
+
+    [self.realmManager removeMessages:@[second]];
+
+    XCTAssertEqual(results.count, 1);
+    XCTAssertEqualObjects(results.firstObject, first);
+}
+
+- (void)testRemoveMessages
+{
+    OCTMessageAbstract *message = [self addMessageWithText:@"hello world"];
+    [self addMessageWithText:@"hello"];
+
+    [self.realmManager removeMessages:@[message]];
+
+    XCTAssertEqual([self searchResults:@"hello" chat:nil].count, 1);
+    XCTAssertEqual([self searchResults:@"world" chat:nil].count, 0);
+    XCTAssertEqual([OCTMessageSearchEntry allObjectsInRealm:self.realmManager.realm].count, 1);
+
+    [self.realmManager removeAllMessagesInChat:self.chat removeChat:NO];
+
+    XCTAssertEqual([OCTMessageSearchEntry allObjectsInRealm:self.realmManager.realm].count, 0);
+}
+
+- (void)testRebuild
+{
+    OCTMessageAbstract *indexed = [self addMessageWithText:@"hello indexed"];
+
+    // Messages from database created before search index.
+    RLMRealm *realm = self.realmManager.realm;
+    [realm beginWriteTransaction];
+    for (NSUInteger i = 0; i < 2500; i++) {
+        [realm addObject:[self messageWithText:@"hello old" dateInterval:i]];
+    }
+    self.realmManager.settingsStorage.messageSearchIndexBuilt = NO;
+    [realm commitWriteTransaction];
+
+    XCTAssertEqual([self searchResults:@"old" chat:nil].count, 0);
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"rebuild"];
+    [self.realmManager rebuildSearchIndexIfNeededWithCompletionBlock:^{
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10.0 handler:nil];
+
+    [realm refresh];
+
+    XCTAssertEqual([self searchResults:@"old" chat:nil].count, 2500);
+    XCTAssertEqual([self searchResults:@"indexed" chat:nil].count, 1);
+    XCTAssertEqual([OCTMessageSearchEntry objectsInRealm:realm where:@"message == %@", indexed].count, 2);
+    XCTAssertTrue(self.realmManager.settingsStorage.messageSearchIndexBuilt);
+
+    // Second call doesn't do anything.
+    NSUInteger transactionsBefore = self.realmManager.writeTransactionsCount;
+
+    expectation = [self expectationWithDescription:@"rebuild again"];
+    [self.realmManager rebuildSearchIndexIfNeededWithCompletionBlock:^{
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10.0 handler:nil];
+
+    XCTAssertEqual(self.realmManager.writeTransactionsCount, transactionsBefore);
+}
+
+#pragma mark -  Performance
+
+/**
+ * Adding messages together with their search entries.
+ */
+- (void)testAddMessagesWithIndexPerformance
+{
+    NSArray<NSString *> *words = [self searchWords];
+    __block NSUInteger dateInterval = 0;
+
+    [self measureBlock:^{
+        @autoreleasepool {
+            NSMutableArray *messages = [NSMutableArray new];
+
+            for (NSUInteger i = 0; i < 10000; i++, dateInterval++) {
+                [messages addObject:[self messageWithText:[self textWithWords:words number:dateInterval] dateInterval:dateInterval]];
+            }
+
+            [self.realmManager addMessages:messages];
+        }
+    }];
+}
+
+/**
+ * Previous behaviour: scanning text of every message.
+ */
+- (void)testSearchWithScanPerformance
+{
+    NSArray<NSString *> *words = [self addSearchMessages];
+    RLMRealm *realm = self.realmManager.realm;
+
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < kSearchQueriesCount; i++) {
+            RLMResults *results = [OCTMessageAbstract objectsInRealm:realm where:@"messageText.text CONTAINS[c] %@", words[i * 97]];
+            XCTAssertGreaterThan(results.count, 0);
+        }
+    }];
+}
+
+- (void)testSearchWordWithIndexPerformance
+{
+    NSArray<NSString *> *words = [self addSearchMessages];
+
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < kSearchQueriesCount; i++) {
+            XCTAssertGreaterThan([self.realmManager searchMessagesWithQuery:words[i * 97] chatUniqueIdentifier:nil].count, 0);
+        }
+    }];
+}
+
+- (void)testSearchPrefixWithIndexPerformance
+{
+    NSArray<NSString *> *words = [self addSearchMessages];
+
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < kSearchQueriesCount; i++) {
+            NSString *prefix = [words[i * 97] substringToIndex:3];
+            XCTAssertGreaterThan([self.realmManager searchMessagesWithQuery:prefix chatUniqueIdentifier:nil].count, 0);
+        }
+    }];
+}
+
+/**
+ * Word contained in every message of large history, first page of results is read like chat UI does.
+ */
+- (void)testSearchFrequentWordInLargeHistoryPerformance
+{
+    [self addSearchMessagesWithCount:kLargeSearchMessagesCount frequentWord:kFrequentWord];
+
+    [self measureBlock:^{
+        RLMResults *results = [self.realmManager searchMessagesWithQuery:kFrequentWord chatUniqueIdentifier:nil];
+        XCTAssertEqual(results.count, kLargeSearchMessagesCount);
+
+        for (NSUInteger i = 0; i < kLargeSearchPageSize; i++) {
+            XCTAssertNotNil(results[i]);
+        }
+    }];
+}
+
+/**
+ * Frequent word together with rare one, only few messages out of large history match.
+ */
+- (void)testSearchFrequentAndRareWordsInLargeHistoryPerformance
+{
+    NSArray<NSString *> *words = [self addSearchMessagesWithCount:kLargeSearchMessagesCount frequentWord:kFrequentWord];
+
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < kSearchQueriesCount; i++) {
+            NSString *query = [NSString stringWithFormat:@"%@ %@", kFrequentWord, words[i * 97]];
+            XCTAssertGreaterThan([self.realmManager searchMessagesWithQuery:query chatUniqueIdentifier:nil].count, 0);
+        }
+    }];
+}
+
+#pragma mark -  Private
+
+/**
+ * Adds kSearchMessagesCount messages, each of them has 4 of kSearchWordsCount words.
+ *
+ * @return Words used in messages.
+ */
+- (NSArray<NSString *> *)addSearchMessages
+{
+    return [self addSearchMessagesWithCount:kSearchMessagesCount frequentWord:nil];
+}
+
+/**
+ * Adds messages, each of them has 4 of kSearchWordsCount words and frequentWord if it is not nil.
+ *
+ * @return Words used in messages.
+ */
+- (NSArray<NSString *> *)addSearchMessagesWithCount:(NSUInteger)count frequentWord:(NSString *)frequentWord
+{
+    NSArray<NSString *> *words = [self searchWords];
+    const NSUInteger batchSize = 10000;
+
+    for (NSUInteger batch = 0; batch < count / batchSize; batch++) {
+        @autoreleasepool {
+            NSMutableArray *messages = [NSMutableArray new];
+
+            for (NSUInteger i = batch * batchSize; i < (batch + 1) * batchSize; i++) {
+                NSString *text = [self textWithWords:words number:i];
+
+                if (frequentWord) {
+                    text = [NSString stringWithFormat:@"%@ %@", frequentWord, text];
+                }
+
+                [messages addObject:[self messageWithText:text dateInterval:i]];
+            }
+
+            [self.realmManager addMessages:messages];
+        }
+    }
+
+    return words;
+}
+
+- (NSArray<NSString *> *)searchWords
+{
+    NSMutableArray<NSString *> *words = [NSMutableArray new];
+
+    for (NSUInteger i = 0; i < kSearchWordsCount; i++) {
+        [words addObject:[self wordWithNumber:i]];
+    }
+
+    return words;
+}
+
+- (NSString *)textWithWords:(NSArray<NSString *> *)words number:(NSUInteger)number
+{
+    return [NSString stringWithFormat:@"%@ %@ %@ %@",
+            words[(number * 7) % kSearchWordsCount],
+            words[(number * 13) % kSearchWordsCount],
+            words[(number * 31) % kSearchWordsCount],
+            words[number % kSearchWordsCount]];
+}
+
+- (NSArray *)searchResults:(NSString *)query chat:(OCTChat *)chat
+{
+    RLMResults *results = [self.realmManager searchMessagesWithQuery:query chatUniqueIdentifier:chat.uniqueIdentifier];
+    NSMutableArray *array = [NSMutableArray new];
+
+    for (OCTMessageAbstract *message in results) {
+        [array addObject:message];
+    }
+
+    return array;
+}
+
+- (OCTMessageAbstract *)addMessageWithText:(NSString *)text
+{
+    return [self.realmManager addMessageWithText:text type:OCTToxMessageTypeNormal chat:self.chat sender:nil messageId:0];
+}
+
+- (OCTMessageAbstract *)messageWithText:(NSString *)text dateInterval:(NSTimeInterval)dateInterval
+{
+    OCTMessageText *messageText = [OCTMessageText new];
+    messageText.text = text;
+
+    OCTMessageAbstract *message = [OCTMessageAbstract new];
+    message.dateInterval = dateInterval;
+    message.chatUniqueIdentifier = self.chat.uniqueIdentifier;
+    message.messageText = messageText;
+
+    return message;
+}
+
+/**
+ * Pronounceable pseudo word, different numbers give different words.
+ */
+- (NSString *)wordWithNumber:(NSUInteger)number
+{
+    NSString *consonants = @"bcdfghklmnprstvz";
+    NSString *vowels = @"aeiou";
+    NSMutableString *word = [NSMutableString new];
+
+    do {
+        [word appendFormat:@"%C", [consonants characterAtIndex:number % consonants.length]];
+        number /= consonants.length;
+        [word appendFormat:@"%C", [vowels characterAtIndex:number % vowels.length]];
+        number /= vowels.length;
+    } while (number > 0 || word.length < 6);
+
+    return word;
+}
+
+@end
@@ -0,0 +1,100 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <XCTest/XCTest.h>
+
+#import "OCTPresenceStore+Private.h"
+#import "OCTFriend.h"
+
+@interface OCTPresenceStoreTests : XCTestCase
+
+@property (strong, nonatomic) OCTPresenceStore *store;
+@property (strong, nonatomic) OCTFriend *friend;
+
+@end
+
+@implementation OCTPresenceStoreTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.store = [OCTPresenceStore new];
+
+    self.friend = [OCTFriend new];
+    self.friend.friendNumber = 7;
+}
+
+- (void)tearDown
+{
+    self.store = nil;
+    self.friend = nil;
+
+    [super tearDown];
+}
+
+- (void)testDefaults
+{
+    XCTAssertEqual([self.store connectionStatusOfFriend:self.friend], OCTToxConnectionStatusNone);
+    XCTAssertFalse([self.store isFriendConnected:self.friend]);
+    XCTAssertFalse([self.store isFriendTyping:self.friend]);
+    XCTAssertEqual([self.store connectedFriendNumbers].count, 0);
+}
+
+- (void)testGoingOfflineStopsTyping
+{
+    [self.store setConnectionStatus:OCTToxConnectionStatusTCP forFriendNumber:7];
+    [self.store setIsTyping:YES forFriendNumber:7];
+
+    XCTAssertTrue([self.store isFriendConnected:self.friend]);
+    XCTAssertTrue([self.store isFriendTyping:self.friend]);
+    XCTAssertEqualObjects([self.store connectedFriendNumbers], @[@7]);
+
+    [self.store setConnectionStatus:OCTToxConnectionStatusNone forFriendNumber:7];
+
+    XCTAssertFalse([self.store isFriendConnected:self.friend]);
+    XCTAssertFalse([self.store isFriendTyping:self.friend]);
+    XCTAssertEqual([self.store connectedFriendNumbers].count, 0);
+}
+
+- (void)testPresenceObject
+{
+    [self.store setConnectionStatus:OCTToxConnectionStatusUDP forFriendNumber:7];
+
+    OCTFriendPresence *presence = [self.store presenceOfFriend:self.friend];
+    XCTAssertEqual([self.store presenceOfFriend:self.friend], presence);
+    XCTAssertEqual(presence.connectionStatus, OCTToxConnectionStatusUDP);
+    XCTAssertTrue(presence.isConnected);
+
+    [self keyValueObservingExpectationForObject:presence keyPath:@"isConnected" expectedValue:@NO];
+    [self keyValueObservingExpectationForObject:presence keyPath:@"isTyping" expectedValue:@YES];
+
+    [self.store setIsTyping:YES forFriendNumber:7];
+    [self.store removeFriendNumber:7];
+
+    [self waitForExpectationsWithTimeout:0.0 handler:nil];
+
+    XCTAssertFalse(presence.isTyping);
+
+    // Friend number may be reused by new friend.
+    XCTAssertNotEqual([self.store presenceOfFriend:self.friend], presence);
+}
+
+- (void)testPresenceIsUpdatedFromBackgroundThread
+{
+    OCTFriendPresence *presence = [self.store presenceOfFriend:self.friend];
+
+    [self keyValueObservingExpectationForObject:presence keyPath:@"connectionStatus" handler:^BOOL (id object, NSDictionary *change) {
+        XCTAssertTrue([NSThread isMainThread]);
+        return presence.connectionStatus == OCTToxConnectionStatusTCP;
+    }];
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [self.store setConnectionStatus:OCTToxConnectionStatusTCP forFriendNumber:7];
+    });
+
+    [self waitForExpectationsWithTimeout:1.0 handler:nil];
+}
+
+@end
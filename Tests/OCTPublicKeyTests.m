@@ -0,0 +1,240 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <XCTest/XCTest.h>
+
+#import "OCTTestCase.h"
+#import "OCTPublicKey.h"
+#import "OCTToxAddress.h"
+#import "OCTHexCodec.h"
+#import "OCTTox+Private.h"
+#import "OCTToxOptions.h"
+
+static NSString *const kPublicKey = @"951C88B7E75C867418ACDB5D273821372BB5BD652740BCDF623A4FA293E75D2F";
+static NSString *const kAddress = @"951C88B7E75C867418ACDB5D273821372BB5BD652740BCDF623A4FA293E75D2F0102030405F0";
+
+static const NSUInteger kBenchmarkIterations = 100000;
+
+// Implementation used before OCTHexCodec, kept for comparison in benchmarks.
+static NSString *legacyBinToHexString(uint8_t *bin, NSUInteger length)
+{
+    NSMutableString *string = [NSMutableString stringWithCapacity:length];
+
+    for (NSUInteger idx = 0; idx < length; ++idx) {
+        [string appendFormat:@"%02X", bin[idx]];
+    }
+
+    return [string copy];
+}
+
+static uint8_t *legacyHexStringToBin(NSString *string)
+{
+    char *hex_string = (char *)string.UTF8String;
+    size_t i, len = strlen(hex_string) / 2;
+    uint8_t *ret = malloc(len);
+    char *pos = hex_string;
+
+    for (i = 0; i < len; ++i, pos += 2) {
+        sscanf(pos, "%2hhx", &ret[i]);
+    }
+
+    return ret;
+}
+
+@interface OCTPublicKeyTests : OCTTestCase
+
+@end
+
+@implementation OCTPublicKeyTests
+
+#pragma mark -  OCTHexCodec
+
+- (void)testHexRoundTrip
+{
+    uint8_t bytes[256];
+    for (NSUInteger i = 0; i < 256; i++) {
+        bytes[i] = (uint8_t)i;
+    }
+
+    NSString *string = OCTHexStringFromBytes(bytes, 256);
+    XCTAssertEqualObjects(string, legacyBinToHexString(bytes, 256));
+
+    uint8_t decoded[256];
+    XCTAssertTrue(OCTBytesFromHexString(string, decoded, 256));
+    XCTAssertEqual(memcmp(bytes, decoded, 256), 0);
+
+    XCTAssertTrue(OCTBytesFromHexString(string.lowercaseString, decoded, 256));
+    XCTAssertEqual(memcmp(bytes, decoded, 256), 0);
+}
+
+- (void)testHexLongBuffer
+{
+    NSMutableData *data = [NSMutableData dataWithLength:4096];
+    arc4random_buf(data.mutableBytes, data.length);
+
+    NSString *string = OCTHexStringFromBytes(data.bytes, data.length);
+    XCTAssertEqual(string.length, 2 * data.length);
+
+    NSMutableData *decoded = [NSMutableData dataWithLength:data.length];
+    XCTAssertTrue(OCTBytesFromHexString(string, decoded.mutableBytes, decoded.length));
+    XCTAssertEqualObjects(data, decoded);
+}
+
+- (void)testHexInvalidInput
+{
+    uint8_t bytes[2];
+
+    XCTAssertFalse(OCTBytesFromHexString(@"0102", bytes, 1));
+    XCTAssertFalse(OCTBytesFromHexString(@"01", bytes, 2));
+    XCTAssertFalse(OCTBytesFromHexString(@"0G02", bytes, 2));
+    XCTAssertFalse(OCTBytesFromHexString(@"01 2", bytes, 2));
+    XCTAssertFalse(OCTBytesFromHexString(@"01А2", bytes, 2));
+    XCTAssertTrue(OCTBytesFromHexString(@"aBcD", bytes, 2));
+    XCTAssertEqual(bytes[0], 0xAB);
+    XCTAssertEqual(bytes[1], 0xCD);
+}
+
+#pragma mark -  OCTPublicKey
+
+- (void)testPublicKey
+{
+    OCTPublicKey *key = [[OCTPublicKey alloc] initWithHexString:kPublicKey];
+
+    XCTAssertNotNil(key);
+    XCTAssertEqualObjects(key.hexString, kPublicKey);
+    XCTAssertEqual(key.bytes[0], 0x95);
+    XCTAssertEqual(key.bytes[kOCTPublicKeySize - 1], 0x2F);
+
+    OCTPublicKey *lowercase = [[OCTPublicKey alloc] initWithHexString:kPublicKey.lowercaseString];
+    XCTAssertEqualObjects(key, lowercase);
+    XCTAssertEqual(key.hash, lowercase.hash);
+
+    OCTPublicKey *fromBytes = [[OCTPublicKey alloc] initWithBytes:key.bytes];
+    XCTAssertEqualObjects(key, fromBytes);
+    XCTAssertTrue([key isEqualToPublicKey:fromBytes]);
+    XCTAssertEqual(key, [key copy]);
+
+    XCTAssertNil([[OCTPublicKey alloc] initWithHexString:@"951C"]);
+    XCTAssertNil([[OCTPublicKey alloc] initWithHexString:[kPublicKey stringByReplacingOccurrencesOfString:@"9" withString:@"X"]]);
+}
+
+- (void)testPublicKeyInequality
+{
+    OCTPublicKey *key = [[OCTPublicKey alloc] initWithHexString:kPublicKey];
+    OCTPublicKey *other = [[OCTPublicKey alloc] initWithHexString:
+                           [kPublicKey stringByReplacingOccurrencesOfString:@"2F" withString:@"30"]];
+
+    XCTAssertNotEqualObjects(key, other);
+    XCTAssertFalse([key isEqualToPublicKey:nil]);
+    XCTAssertFalse([key isEqual:kPublicKey]);
+}
+
+- (void)testPublicKeyAsDictionaryKey
+{
+    OCTPublicKey *key = [[OCTPublicKey alloc] initWithHexString:kPublicKey];
+    NSDictionary *dictionary = @{ key : @1 };
+
+    XCTAssertEqualObjects(dictionary[[[OCTPublicKey alloc] initWithHexString:kPublicKey.lowercaseString]], @1);
+}
+
+#pragma mark -  OCTToxAddress
+
+- (void)testAddress
+{
+    OCTToxAddress *address = [[OCTToxAddress alloc] initWithHexString:kAddress];
+
+    XCTAssertNotNil(address);
+    XCTAssertEqualObjects(address.hexString, kAddress);
+    XCTAssertEqualObjects(address.publicKey, [[OCTPublicKey alloc] initWithHexString:kPublicKey]);
+    XCTAssertEqual(address.nospam, 0x01020304);
+    XCTAssertEqualObjects(address, [[OCTToxAddress alloc] initWithBytes:address.bytes]);
+
+    XCTAssertNil([[OCTToxAddress alloc] initWithHexString:kPublicKey]);
+}
+
+- (void)testAddressFromTox
+{
+    OCTTox *tox = [[OCTTox alloc] initWithOptions:[OCTToxOptions new] savedData:nil error:nil];
+    tox.nospam = 0xDEADBEEF;
+
+    OCTToxAddress *address = tox.userAddressValue;
+
+    XCTAssertEqualObjects(address.hexString, tox.userAddress);
+    XCTAssertEqualObjects(address.publicKey, tox.publicKeyValue);
+    XCTAssertEqualObjects(tox.publicKeyValue.hexString, tox.publicKey);
+    XCTAssertEqual(address.nospam, 0xDEADBEEF);
+}
+
+#pragma mark -  Benchmarks
+
+- (void)testLegacyEncodePerformance
+{
+    OCTPublicKey *key = [[OCTPublicKey alloc] initWithHexString:kPublicKey];
+
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < kBenchmarkIterations; i++) {
+            @autoreleasepool {
+                legacyBinToHexString((uint8_t *)key.bytes, kOCTPublicKeySize);
+            }
+        }
+    }];
+}
+
+- (void)testEncodePerformance
+{
+    OCTPublicKey *key = [[OCTPublicKey alloc] initWithHexString:kPublicKey];
+
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < kBenchmarkIterations; i++) {
+            @autoreleasepool {
+                OCTHexStringFromBytes(key.bytes, kOCTPublicKeySize);
+            }
+        }
+    }];
+}
+
+- (void)testLegacyDecodePerformance
+{
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < kBenchmarkIterations; i++) {
+            @autoreleasepool {
+                free(legacyHexStringToBin(kPublicKey));
+            }
+        }
+    }];
+}
+
+- (void)testDecodePerformance
+{
+    [self measureBlock:^{
+        uint8_t bytes[32];
+
+        for (NSUInteger i = 0; i < kBenchmarkIterations; i++) {
+            OCTBytesFromHexString(kPublicKey, bytes, kOCTPublicKeySize);
+        }
+    }];
+}
+
+- (void)testPublicKeyDictionaryLookupPerformance
+{
+    NSMutableArray<OCTPublicKey *> *keys = [NSMutableArray new];
+    NSMutableDictionary<OCTPublicKey *, NSNumber *> *dictionary = [NSMutableDictionary new];
+
+    for (NSUInteger i = 0; i < 1000; i++) {
+        uint8_t bytes[32];
+        arc4random_buf(bytes, sizeof(bytes));
+
+        OCTPublicKey *key = [[OCTPublicKey alloc] initWithBytes:bytes];
+        [keys addObject:key];
+        dictionary[key] = @(i);
+    }
+
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < kBenchmarkIterations; i++) {
+            XCTAssertNotNil(dictionary[keys[i % keys.count]]);
+        }
+    }];
+}
+
+@end
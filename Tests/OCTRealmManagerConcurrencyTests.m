@@ -0,0 +1,254 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <XCTest/XCTest.h>
+#import <Realm/Realm.h>
+
+#import "OCTTestCase.h"
+#import "OCTRealmManager.h"
+#import "OCTFriend.h"
+#import "OCTChat.h"
+#import "OCTMessageAbstract.h"
+#import "OCTMessageText.h"
+
+static const NSUInteger kReadersCount = 8;
+static const NSUInteger kReadsPerReader = 2000;
+static const NSUInteger kFriendsCount = 1000;
+static const NSUInteger kWriterBatchSize = 100;
+
+@interface OCTRealmManagerConcurrencyTests : OCTTestCase
+
+@property (strong, nonatomic) NSString *directory;
+@property (strong, nonatomic) OCTRealmManager *realmManager;
+@property (strong, nonatomic) OCTChat *chat;
+@property (strong, nonatomic) NSArray<NSString *> *friendIdentifiers;
+
+@end
+
+@implementation OCTRealmManagerConcurrencyTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    // Realm instances of several threads are used, so real database file is used instead of mocked in-memory realm.
+    self.directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    [[NSFileManager defaultManager] createDirectoryAtPath:self.directory withIntermediateDirectories:YES attributes:nil error:nil];
+
+    NSURL *fileURL = [NSURL fileURLWithPath:[self.directory stringByAppendingPathComponent:@"database"]];
+    self.realmManager = [[OCTRealmManager alloc] initWithDatabaseFileURL:fileURL encryptionKey:nil];
+
+    self.chat = [OCTChat new];
+    [self.realmManager addObject:self.chat];
+
+    NSMutableArray *identifiers = [NSMutableArray new];
+
+    [self.realmManager performBatchUpdates:^{
+        for (NSUInteger i = 0; i < kFriendsCount; i++) {
+            OCTFriend *friend = [OCTFriend new];
+            friend.nickname = @"";
+            friend.publicKey = [[NSUUID UUID] UUIDString];
+            friend.friendNumber = (OCTToxFriendNumber)i;
+
+            [self.realmManager addObject:friend];
+            [identifiers addObject:friend.uniqueIdentifier];
+        }
+    }];
+
+    self.friendIdentifiers = identifiers;
+}
+
+- (void)tearDown
+{
+    self.chat = nil;
+    self.realmManager = nil;
+
+    [[NSFileManager defaultManager] removeItemAtPath:self.directory error:nil];
+
+    [super tearDown];
+}
+
+- (void)testReadOnOtherThreadUsesOwnRealm
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"read"];
+    NSString *identifier = self.friendIdentifiers.firstObject;
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        OCTFriend *friend = [self.realmManager objectWithUniqueIdentifier:identifier class:[OCTFriend class]];
+
+        XCTAssertNotNil(friend);
+        XCTAssertEqual(friend.realm, [self.realmManager currentRealm]);
+        XCTAssertEqualObjects([self.realmManager friendWithPublicKey:friend.publicKey], friend);
+
+        [expectation fulfill];
+    });
+
+    [self waitForExpectationsWithTimeout:1.0 handler:nil];
+}
+
+- (void)testReadOnOtherThreadSeesLatestCommit
+{
+    OCTMessageAbstract *message = [self messageWithIndex:0];
+    [self.realmManager addMessages:@[message]];
+    NSString *identifier = message.uniqueIdentifier;
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"read"];
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        XCTAssertNotNil([self.realmManager objectWithUniqueIdentifier:identifier class:[OCTMessageAbstract class]]);
+        [expectation fulfill];
+    });
+
+    [self waitForExpectationsWithTimeout:1.0 handler:nil];
+}
+
+- (void)testBatchUpdatesOnOtherThreadWithMainThreadWrites
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"batches"];
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        for (NSUInteger i = 0; i < 100; i++) {
+            @autoreleasepool {
+                [self.realmManager performBatchUpdates:^{
+                    [self.realmManager addMessages:@[[self messageWithIndex:i]]];
+                }];
+            }
+        }
+
+        [expectation fulfill];
+    });
+
+    // Main thread writes while other thread is inside of batches, each of them holds queue and write lock together.
+    for (NSUInteger i = 0; i < 100; i++) {
+        [self.realmManager addObject:[OCTChat new]];
+    }
+
+    [self waitForExpectationsWithTimeout:10.0 handler:nil];
+}
+
+/**
+ * Async writes are grouped by writer queue, not by the thread manager was created on.
+ */
+- (void)testAsyncWritesOfManagerCreatedOnOtherThread
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"completion"];
+    NSURL *fileURL = [NSURL fileURLWithPath:[self.directory stringByAppendingPathComponent:@"other"]];
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        OCTRealmManager *realmManager = [[OCTRealmManager alloc] initWithDatabaseFileURL:fileURL encryptionKey:nil];
+        realmManager.asyncWritesInterval = 0.1;
+
+        NSUInteger transactionsBefore = realmManager.writeTransactionsCount;
+        __block NSUInteger completed = 0;
+
+        for (NSUInteger i = 0; i < 10; i++) {
+            [realmManager performAsyncWrite:^{
+                [realmManager addObject:[OCTChat new]];
+            } completion:^{
+                // Enqueueing thread isn't waited for.
+                if (++completed == 10) {
+                    XCTAssertEqual(realmManager.writeTransactionsCount - transactionsBefore, 1);
+                    XCTAssertEqual([OCTChat allObjectsInRealm:[realmManager currentRealm]].count, 10);
+                    [expectation fulfill];
+                }
+            }];
+        }
+    });
+
+    [self waitForExpectationsWithTimeout:2.0 handler:nil];
+}
+
+#pragma mark -  Performance
+
+/**
+ * Previous behaviour: every read queued on manager queue shared with writes.
+ */
+- (void)testSerializedReadersWithWriterPerformance
+{
+    dispatch_queue_t queue = [(id)self.realmManager valueForKey:@"queue"];
+
+    [self measureBlock:^{
+        [self runReadersWithWriterUsingQueue:queue];
+    }];
+}
+
+- (void)testPerThreadReadersWithWriterPerformance
+{
+    [self measureBlock:^{
+        [self runReadersWithWriterUsingQueue:nil];
+    }];
+}
+
+#pragma mark -  Private
+
+/**
+ * Runs kReadersCount readers while writer keeps adding messages, returns when readers are done.
+ *
+ * @param queue If non-nil, each read is performed with dispatch_sync on it.
+ */
+- (void)runReadersWithWriterUsingQueue:(dispatch_queue_t)queue
+{
+    __block volatile BOOL readersFinished = NO;
+
+    dispatch_group_t writerGroup = dispatch_group_create();
+    dispatch_group_t readersGroup = dispatch_group_create();
+
+    dispatch_group_async(writerGroup, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        NSUInteger index = 0;
+
+        while (! readersFinished) {
+            @autoreleasepool {
+                NSMutableArray *messages = [NSMutableArray new];
+
+                for (NSUInteger i = 0; i < kWriterBatchSize; i++) {
+                    [messages addObject:[self messageWithIndex:index++]];
+                }
+
+                [self.realmManager addMessages:messages];
+            }
+        }
+    });
+
+    for (NSUInteger reader = 0; reader < kReadersCount; reader++) {
+        dispatch_group_async(readersGroup, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            for (NSUInteger i = 0; i < kReadsPerReader; i++) {
+                @autoreleasepool {
+                    NSString *identifier = self.friendIdentifiers[(reader * kReadsPerReader + i) % kFriendsCount];
+
+                    dispatch_block_t read = ^{
+                        OCTFriend *friend = [self.realmManager objectWithUniqueIdentifier:identifier class:[OCTFriend class]];
+                        XCTAssertNotNil(friend);
+                    };
+
+                    if (queue) {
+                        dispatch_sync(queue, read);
+                    }
+                    else {
+                        read();
+                    }
+                }
+            }
+        });
+    }
+
+    dispatch_group_wait(readersGroup, DISPATCH_TIME_FOREVER);
+
+    readersFinished = YES;
+    dispatch_group_wait(writerGroup, DISPATCH_TIME_FOREVER);
+}
+
+- (OCTMessageAbstract *)messageWithIndex:(NSUInteger)index
+{
+    OCTMessageText *messageText = [OCTMessageText new];
+    messageText.text = [NSString stringWithFormat:@"message %lu", (unsigned long)index];
+
+    OCTMessageAbstract *message = [OCTMessageAbstract new];
+    message.dateInterval = [[NSDate date] timeIntervalSince1970];
+    message.chatUniqueIdentifier = self.chat.uniqueIdentifier;
+    message.messageText = messageText;
+
+    return message;
+}
+
+@end
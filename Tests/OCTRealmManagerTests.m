@@ -0,0 +1,578 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import "OCTRealmTests.h"
+#import "OCTMessageAbstract.h"
+#import "OCTMessageText.h"
+#import "OCTMessageFile.h"
+
+static const NSUInteger kIncomingMessagesCount = 1000;
+
+static const NSUInteger kIndexedQueriesMessagesCount = 200000;
+static const NSUInteger kIndexedQueriesChatsCount = 1000;
+static const NSUInteger kIndexedQueriesFriendsCount = 10000;
+static const NSUInteger kIndexedQueriesRepeats = 10;
+
+static const NSUInteger kLargeChatMessagesCount = 20000;
+static const NSUInteger kLargeChatRemovalsCount = 100;
+
+@interface OCTRealmManagerTests : OCTRealmTests
+
+@end
+
+@implementation OCTRealmManagerTests
+
+- (void)testAsyncWritesAreCommittedTogether
+{
+    self.realmManager.asyncWritesInterval = 0.1;
+
+    NSUInteger transactionsBefore = self.realmManager.writeTransactionsCount;
+    XCTestExpectation *expectation = [self expectationWithDescription:@"completion"];
+    __block NSUInteger completed = 0;
+
+    for (NSUInteger i = 0; i < 10; i++) {
+        [self.realmManager performAsyncWrite:^{
+            [self.realmManager addObject:[self createFriendWithFriendNumber:(OCTToxFriendNumber)i]];
+        } completion:^{
+            // Completions are called one by one on writer queue.
+            if (++completed == 10) {
+                [expectation fulfill];
+            }
+        }];
+    }
+
+    XCTAssertEqual([OCTFriend allObjectsInRealm:self.realmManager.realm].count, 0);
+
+    [self waitForExpectationsWithTimeout:1.0 handler:nil];
+    [self.realmManager.realm refresh];
+
+    XCTAssertEqual([OCTFriend allObjectsInRealm:self.realmManager.realm].count, 10);
+    XCTAssertEqual(self.realmManager.writeTransactionsCount - transactionsBefore, 1);
+}
+
+- (void)testSyncWriteFlushesPendingAsyncWrites
+{
+    self.realmManager.asyncWritesInterval = 0.1;
+
+    NSUInteger transactionsBefore = self.realmManager.writeTransactionsCount;
+    __block BOOL completed = NO;
+
+    [self.realmManager performAsyncWrite:^{
+        [self.realmManager addObject:[self createFriendWithFriendNumber:0]];
+    } completion:^{
+        completed = YES;
+    }];
+
+    OCTFriend *friend = [self createFriendWithFriendNumber:1];
+    [self.realmManager addObject:friend];
+
+    XCTAssertTrue(completed);
+    XCTAssertEqual([OCTFriend allObjectsInRealm:self.realmManager.realm].count, 2);
+    XCTAssertEqual(self.realmManager.writeTransactionsCount - transactionsBefore, 1);
+
+    // Scheduled flush has nothing to do.
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.2]];
+    XCTAssertEqual(self.realmManager.writeTransactionsCount - transactionsBefore, 1);
+}
+
+- (void)testAsyncWriteFromOtherThread
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"completion"];
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [self.realmManager performAsyncWrite:^{
+            XCTAssertFalse([NSThread isMainThread]);
+            [self.realmManager addObject:[self createFriendWithFriendNumber:0]];
+        } completion:^{
+            [expectation fulfill];
+        }];
+    });
+
+    [self waitForExpectationsWithTimeout:1.0 handler:nil];
+    [self.realmManager.realm refresh];
+
+    XCTAssertEqual([OCTFriend allObjectsInRealm:self.realmManager.realm].count, 1);
+}
+
+- (void)testAsyncWritesInterval
+{
+    self.realmManager.asyncWritesInterval = 0.2;
+
+    [self.realmManager performAsyncWrite:^{
+        [self.realmManager addObject:[self createFriendWithFriendNumber:0]];
+    } completion:nil];
+
+    [NSThread sleepForTimeInterval:0.05];
+    [self.realmManager.realm refresh];
+    XCTAssertEqual([OCTFriend allObjectsInRealm:self.realmManager.realm].count, 0);
+
+    [NSThread sleepForTimeInterval:0.3];
+    [self.realmManager.realm refresh];
+    XCTAssertEqual([OCTFriend allObjectsInRealm:self.realmManager.realm].count, 1);
+}
+
+- (void)testFlushAsyncWrites
+{
+    [self.realmManager performAsyncWrite:^{
+        [self.realmManager addObject:[self createFriendWithFriendNumber:0]];
+    } completion:nil];
+
+    [self.realmManager flushAsyncWrites];
+
+    XCTAssertEqual([OCTFriend allObjectsInRealm:self.realmManager.realm].count, 1);
+}
+
+- (void)testFlushSkipsAlreadyScheduledFlush
+{
+    self.realmManager.asyncWritesInterval = 0.2;
+
+    [self.realmManager performAsyncWrite:^{
+        [self.realmManager addObject:[self createFriendWithFriendNumber:0]];
+    } completion:nil];
+    [self.realmManager flushAsyncWrites];
+
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+
+    [self.realmManager performAsyncWrite:^{
+        [self.realmManager addObject:[self createFriendWithFriendNumber:1]];
+    } completion:nil];
+
+    // First scheduled flush fires here, second write should wait for its own interval.
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.15]];
+    [self.realmManager.realm refresh];
+    XCTAssertEqual([OCTFriend allObjectsInRealm:self.realmManager.realm].count, 1);
+
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.2]];
+    [self.realmManager.realm refresh];
+    XCTAssertEqual([OCTFriend allObjectsInRealm:self.realmManager.realm].count, 2);
+}
+
+- (void)testBatchUpdatesCancelTransactionOnException
+{
+    XCTAssertThrows([self.realmManager performBatchUpdates:^{
+        [self.realmManager addObject:[self createFriendWithFriendNumber:0]];
+        [NSException raise:NSInternalInconsistencyException format:@"failure"];
+    }]);
+
+    XCTAssertFalse(self.realmManager.realm.inWriteTransaction);
+    XCTAssertEqual([OCTFriend allObjectsInRealm:self.realmManager.realm].count, 0);
+
+    [self.realmManager addObject:[self createFriendWithFriendNumber:1]];
+    XCTAssertEqual([OCTFriend allObjectsInRealm:self.realmManager.realm].count, 1);
+}
+
+- (void)testAddMessageIsSingleTransaction
+{
+    OCTChat *chat = [OCTChat new];
+    [self.realmManager addObject:chat];
+
+    NSUInteger transactionsBefore = self.realmManager.writeTransactionsCount;
+
+    OCTMessageAbstract *message = [self.realmManager addMessageWithText:@"text" type:OCTToxMessageTypeNormal chat:chat sender:nil messageId:1];
+
+    XCTAssertEqual(self.realmManager.writeTransactionsCount - transactionsBefore, 1);
+    XCTAssertEqualObjects(chat.lastMessage, message);
+    XCTAssertEqual(chat.lastActivityDateInterval, message.dateInterval);
+}
+
+- (void)testAddMessages
+{
+    OCTChat *first = [OCTChat new];
+    OCTChat *second = [OCTChat new];
+    [self.realmManager addObject:first];
+    [self.realmManager addObject:second];
+
+    NSMutableArray *messages = [NSMutableArray new];
+
+    for (NSUInteger i = 0; i < 100; i++) {
+        OCTMessageAbstract *message = [self messageInChat:(i % 2) ? first : second];
+        message.dateInterval = i;
+        [messages addObject:message];
+    }
+
+    NSUInteger transactionsBefore = self.realmManager.writeTransactionsCount;
+
+    [self.realmManager addMessages:messages];
+
+    XCTAssertEqual(self.realmManager.writeTransactionsCount - transactionsBefore, 1);
+    XCTAssertEqual([OCTMessageAbstract allObjectsInRealm:self.realmManager.realm].count, 100);
+
+    XCTAssertEqualObjects(first.lastMessage, messages[99]);
+    XCTAssertEqual(first.lastActivityDateInterval, 99);
+    XCTAssertEqualObjects(second.lastMessage, messages[98]);
+    XCTAssertEqual(second.lastActivityDateInterval, 98);
+}
+
+- (void)testChatAggregatesOnAddMessages
+{
+    OCTChat *chat = [OCTChat new];
+    chat.lastReadDateInterval = 50;
+    [self.realmManager addObject:chat];
+
+    NSArray *messages = [self messagesInChat:chat count:100];
+    [self.realmManager addMessages:messages];
+
+    XCTAssertEqual(chat.messageCount, 100);
+    // Incoming messages 52, 54, ..., 98.
+    XCTAssertEqual(chat.unreadCount, 24);
+    XCTAssertEqualObjects(chat.lastMessage, messages[99]);
+
+    // Older message doesn't replace lastMessage.
+    OCTMessageAbstract *old = [self messageInChat:chat];
+    old.dateInterval = 10;
+    old.senderUniqueIdentifier = @"sender";
+    [self.realmManager addMessages:@[old]];
+
+    XCTAssertEqual(chat.messageCount, 101);
+    XCTAssertEqual(chat.unreadCount, 24);
+    XCTAssertEqualObjects(chat.lastMessage, messages[99]);
+    XCTAssertEqual(chat.lastActivityDateInterval, 99);
+}
+
+- (void)testChatAggregatesOnRemoveMessages
+{
+    OCTChat *chat = [OCTChat new];
+    chat.lastReadDateInterval = 50;
+    [self.realmManager addObject:chat];
+
+    NSArray *messages = [self messagesInChat:chat count:100];
+    [self.realmManager addMessages:messages];
+
+    // Last message, unread incoming, read incoming and outgoing.
+    [self.realmManager removeMessages:@[messages[99], messages[98], messages[10], messages[11]]];
+
+    XCTAssertEqual(chat.messageCount, 96);
+    XCTAssertEqual(chat.unreadCount, 23);
+    XCTAssertEqualObjects(chat.lastMessage, messages[97]);
+
+    [self.realmManager removeAllMessagesInChat:chat removeChat:NO];
+
+    XCTAssertEqual(chat.messageCount, 0);
+    XCTAssertEqual(chat.unreadCount, 0);
+    XCTAssertNil(chat.lastMessage);
+}
+
+- (void)testUnreadCountInChat
+{
+    OCTChat *chat = [OCTChat new];
+    [self.realmManager addObject:chat];
+    [self.realmManager addMessages:[self messagesInChat:chat count:100]];
+
+    XCTAssertEqual([self.realmManager unreadCountInChat:chat lastReadDateInterval:-1], 50);
+    XCTAssertEqual([self.realmManager unreadCountInChat:chat lastReadDateInterval:89], 5);
+    XCTAssertEqual([self.realmManager unreadCountInChat:chat lastReadDateInterval:99], 0);
+}
+
+- (void)testRecomputeChatAggregates
+{
+    OCTChat *chat = [OCTChat new];
+    chat.lastReadDateInterval = 50;
+    [self.realmManager addObject:chat];
+
+    // Messages written directly, as they were before aggregates were introduced.
+    NSArray *messages = [self messagesInChat:chat count:100];
+
+    [self.realmManager.realm beginWriteTransaction];
+    [self.realmManager.realm addObjects:messages];
+    [self.realmManager.realm commitWriteTransaction];
+
+    XCTAssertEqual(chat.messageCount, 0);
+
+    [self.realmManager recomputeChatAggregates];
+
+    XCTAssertEqual(chat.messageCount, 100);
+    XCTAssertEqual(chat.unreadCount, 24);
+    XCTAssertEqualObjects(chat.lastMessage, messages[99]);
+}
+
+- (void)testIndexedProperties
+{
+    RLMSchema *schema = self.realmManager.realm.schema;
+
+    XCTAssertTrue(schema[OCTFriend.className][@"publicKey"].indexed);
+    XCTAssertTrue(schema[OCTMessageAbstract.className][@"chatUniqueIdentifier"].indexed);
+    XCTAssertTrue(schema[OCTMessageFile.className][@"internalFilePath"].indexed);
+}
+
+#pragma mark -  Performance
+
+/**
+ * Previous behaviour: transaction per incoming message.
+ */
+- (void)testIncomingMessagesSyncWritesPerformance
+{
+    OCTChat *chat = [OCTChat new];
+    [self.realmManager addObject:chat];
+
+    [self measureBlock:^{
+        NSUInteger transactionsBefore = self.realmManager.writeTransactionsCount;
+
+        for (NSUInteger i = 0; i < kIncomingMessagesCount; i++) {
+            [self.realmManager addObject:[self messageInChat:chat]];
+        }
+
+        XCTAssertEqual(self.realmManager.writeTransactionsCount - transactionsBefore, kIncomingMessagesCount);
+    }];
+}
+
+/**
+ * Main thread only enqueues messages, they are committed together.
+ */
+- (void)testIncomingMessagesAsyncWritesPerformance
+{
+    OCTChat *chat = [OCTChat new];
+    [self.realmManager addObject:chat];
+
+    // Writer queue runs concurrently with enqueueing, interval keeps writes grouped.
+    self.realmManager.asyncWritesInterval = 0.05;
+
+    [self measureBlock:^{
+        NSUInteger transactionsBefore = self.realmManager.writeTransactionsCount;
+        __block NSUInteger completed = 0;
+
+        for (NSUInteger i = 0; i < kIncomingMessagesCount; i++) {
+            OCTMessageAbstract *message = [self messageInChat:chat];
+
+            [self.realmManager performAsyncWrite:^{
+                [self.realmManager addObject:message];
+            } completion:^{
+                completed++;
+            }];
+        }
+
+        [self runRunLoopUntil:^BOOL {
+            return completed == kIncomingMessagesCount;
+        }];
+
+        XCTAssertLessThan(self.realmManager.writeTransactionsCount - transactionsBefore, 10);
+    }];
+}
+
+/**
+ * Case insensitive comparison can't use index, it gives the same result on this data
+ * and is used as "before" measurement.
+ */
+- (void)testQueriesWithoutIndexPerformance
+{
+    [self measureQueriesWithFormats:@[
+         @"publicKey ==[c] %@",
+         @"chatUniqueIdentifier ==[c] %@",
+         @"internalFilePath ==[c] %@",
+     ]];
+}
+
+- (void)testIndexedQueriesPerformance
+{
+    [self measureQueriesWithFormats:@[
+         @"publicKey == %@",
+         @"chatUniqueIdentifier == %@",
+         @"internalFilePath == %@",
+     ]];
+}
+
+/**
+ * Previous behaviour: sorting all remaining messages of chat after each removal.
+ */
+- (void)testSortLargeChatForLastMessagePerformance
+{
+    OCTChat *chat = [self addLargeChatWithRemovedMessages:nil];
+
+    RLMResults *all = [OCTMessageAbstract objectsInRealm:self.realmManager.realm
+                                                   where:@"chatUniqueIdentifier == %@", chat.uniqueIdentifier];
+
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < kLargeChatRemovalsCount; i++) {
+            XCTAssertNotNil([[all sortedResultsUsingKeyPath:@"dateInterval" ascending:YES] lastObject]);
+        }
+    }];
+}
+
+- (void)testRemoveMessagesInLargeChatPerformance
+{
+    [self measureMetrics:[[self class] defaultPerformanceMetrics] automaticallyStartMeasuring:NO forBlock:^{
+        NSMutableArray<OCTMessageAbstract *> *removed = [NSMutableArray new];
+        OCTChat *chat = [self addLargeChatWithRemovedMessages:removed];
+
+        [self startMeasuring];
+
+        for (OCTMessageAbstract *message in removed) {
+            [self.realmManager removeMessages:@[message]];
+        }
+
+        [self stopMeasuring];
+
+        XCTAssertEqual(chat.messageCount, kLargeChatMessagesCount - kLargeChatRemovalsCount);
+    }];
+}
+
+/**
+ * Removing last message, new one is searched in window before it.
+ */
+- (void)testRemoveLastMessageInLargeChatPerformance
+{
+    [self measureMetrics:[[self class] defaultPerformanceMetrics] automaticallyStartMeasuring:NO forBlock:^{
+        OCTChat *chat = [self addLargeChatWithRemovedMessages:nil];
+
+        [self startMeasuring];
+
+        for (NSUInteger i = 0; i < kLargeChatRemovalsCount; i++) {
+            [self.realmManager removeMessages:@[chat.lastMessage]];
+        }
+
+        [self stopMeasuring];
+
+        XCTAssertEqual(chat.messageCount, kLargeChatMessagesCount - kLargeChatRemovalsCount);
+    }];
+}
+
+#pragma mark -  Private
+
+/**
+ * Messages with dateInterval 0, 1, ..., count - 1. Messages with even dateInterval are incoming.
+ */
+- (NSArray<OCTMessageAbstract *> *)messagesInChat:(OCTChat *)chat count:(NSUInteger)count
+{
+    NSMutableArray *messages = [NSMutableArray new];
+
+    for (NSUInteger i = 0; i < count; i++) {
+        OCTMessageAbstract *message = [self messageInChat:chat];
+        message.dateInterval = i;
+        message.senderUniqueIdentifier = (i % 2) ? nil : @"sender";
+        [messages addObject:message];
+    }
+
+    return messages;
+}
+
+/**
+ * Runs kIndexedQueriesRepeats queries for friend public key, message chat and file path with given formats.
+ */
+- (void)measureQueriesWithFormats:(NSArray<NSString *> *)formats
+{
+    RLMRealm *realm = self.realmManager.realm;
+
+    NSMutableArray<NSString *> *publicKeys = [NSMutableArray new];
+    NSMutableArray<NSString *> *chatIdentifiers = [NSMutableArray new];
+    NSMutableArray<NSString *> *filePaths = [NSMutableArray new];
+
+    [realm beginWriteTransaction];
+
+    for (NSUInteger i = 0; i < kIndexedQueriesFriendsCount; i++) {
+        OCTFriend *friend = [self createFriendWithFriendNumber:(OCTToxFriendNumber)i];
+        [realm addObject:friend];
+        [publicKeys addObject:friend.publicKey];
+    }
+
+    for (NSUInteger i = 0; i < kIndexedQueriesChatsCount; i++) {
+        OCTChat *chat = [OCTChat new];
+        [realm addObject:chat];
+        [chatIdentifiers addObject:chat.uniqueIdentifier];
+    }
+
+    [realm commitWriteTransaction];
+
+    const NSUInteger batchSize = 10000;
+
+    for (NSUInteger batch = 0; batch < kIndexedQueriesMessagesCount / batchSize; batch++) {
+        @autoreleasepool {
+            [realm beginWriteTransaction];
+
+            for (NSUInteger i = batch * batchSize; i < (batch + 1) * batchSize; i++) {
+                OCTMessageAbstract *message = [OCTMessageAbstract new];
+                message.dateInterval = i;
+                message.chatUniqueIdentifier = chatIdentifiers[i % kIndexedQueriesChatsCount];
+
+                if (i % 10) {
+                    message.messageText = [OCTMessageText new];
+                    message.messageText.text = @"message";
+                }
+                else {
+                    message.messageFile = [OCTMessageFile new];
+                    message.messageFile.internalFilePath = [NSString stringWithFormat:@"~/Library/Files/%lu", (unsigned long)i];
+
+                    if (filePaths.count < kIndexedQueriesRepeats) {
+                        [filePaths addObject:message.messageFile.internalFilePath];
+                    }
+                }
+
+                [realm addObject:message];
+            }
+
+            [realm commitWriteTransaction];
+        }
+    }
+
+    NSArray<Class> *classes = @[[OCTFriend class], [OCTMessageAbstract class], [OCTMessageFile class]];
+    NSArray<NSArray *> *values = @[publicKeys, chatIdentifiers, filePaths];
+
+    [self measureBlock:^{
+        for (NSUInteger query = 0; query < formats.count; query++) {
+            for (NSUInteger i = 0; i < kIndexedQueriesRepeats; i++) {
+                id value = values[query][i % values[query].count];
+                NSPredicate *predicate = [NSPredicate predicateWithFormat:formats[query], value];
+
+                XCTAssertGreaterThan([classes[query] objectsInRealm:realm withPredicate:predicate].count, 0);
+            }
+        }
+    }];
+}
+
+/**
+ * Adds chat with kLargeChatMessagesCount messages, message per minute.
+ *
+ * @param removed If non-nil, kLargeChatRemovalsCount messages evenly spread over chat are added to it.
+ */
+- (OCTChat *)addLargeChatWithRemovedMessages:(NSMutableArray<OCTMessageAbstract *> *)removed
+{
+    OCTChat *chat = [OCTChat new];
+    [self.realmManager addObject:chat];
+
+    const NSUInteger batchSize = 10000;
+
+    for (NSUInteger batch = 0; batch < kLargeChatMessagesCount / batchSize; batch++) {
+        @autoreleasepool {
+            NSMutableArray *messages = [NSMutableArray new];
+
+            for (NSUInteger i = batch * batchSize; i < (batch + 1) * batchSize; i++) {
+                OCTMessageAbstract *message = [self messageInChat:chat];
+                message.dateInterval = i * 60;
+                [messages addObject:message];
+
+                if (i % (kLargeChatMessagesCount / kLargeChatRemovalsCount) == 0) {
+                    [removed addObject:message];
+                }
+            }
+
+            [self.realmManager addMessages:messages];
+        }
+    }
+
+    return chat;
+}
+
+- (OCTMessageAbstract *)messageInChat:(OCTChat *)chat
+{
+    OCTMessageText *messageText = [OCTMessageText new];
+    messageText.text = @"incoming message";
+
+    OCTMessageAbstract *message = [OCTMessageAbstract new];
+    message.dateInterval = [[NSDate date] timeIntervalSince1970];
+    message.chatUniqueIdentifier = chat.uniqueIdentifier;
+    message.messageText = messageText;
+
+    return message;
+}
+
+- (void)runRunLoopUntil:(BOOL (^)(void))condition
+{
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:10.0];
+
+    while (! condition() && ([deadline timeIntervalSinceNow] > 0)) {
+        [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+
+    XCTAssertTrue(condition());
+}
+
+@end
@@ -5,6 +5,7 @@
 #import <XCTest/XCTest.h>
 #import <Realm/Realm.h>
 
+#import "OCTTestCase.h"
 #import "OCTRealmManager.h"
 #import "OCTFriend.h"
 #import "OCTChat.h"
@@ -16,7 +17,7 @@
 
 @end
 
-@interface OCTRealmTests : XCTestCase
+@interface OCTRealmTests : OCTTestCase
 
 /**
  * Partially mocked realm manager with in memory realm, which is reset after each test.
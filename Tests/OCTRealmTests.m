@@ -24,8 +24,13 @@
 
     RLMRealm *realRealm = [RLMRealm realmWithConfiguration:configuration error:nil];
 
+    // Manager gets in-memory realm instead of file one. Instances for other threads (e.g. writer queue of manager)
+    // are opened with configuration of in-memory realm and go to Realm itself.
     self.realmMock = OCMClassMock([RLMRealm class]);
-    OCMStub([self.realmMock realmWithConfiguration:[OCMArg any] error:[OCMArg anyObjectRef]]).andReturn(realRealm);
+    OCMStub([self.realmMock realmWithConfiguration:[OCMArg checkWithBlock:^BOOL (RLMRealmConfiguration *theConfiguration) {
+        return (theConfiguration.inMemoryIdentifier == nil);
+    }] error:[OCMArg anyObjectRef]]).andReturn(realRealm);
+    OCMStub([self.realmMock realmWithConfiguration:[OCMArg any] error:[OCMArg anyObjectRef]]).andForwardToRealObject();
 
     NSURL *fileURL = [NSURL fileURLWithPath:@"/some/realm/path"];
     self.realmManager = [[OCTRealmManager alloc] initWithDatabaseFileURL:fileURL encryptionKey:nil];
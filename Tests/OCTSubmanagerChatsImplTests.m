@@ -12,6 +12,21 @@
 #import "OCTTox.h"
 #import "OCTMessageAbstract.h"
 #import "OCTMessageText.h"
+#import "OCTMessageCursor.h"
+#import "OCTMessageOutbox.h"
+#import "OCTMessageOutboxEntry.h"
+#import "OCTPresenceStore+Private.h"
+
+static const NSUInteger kReceiptStormCount = 10000;
+static const NSUInteger kReceiptStormQueriedCount = 1000;
+
+@interface OCTSubmanagerChatsImpl (Tests)
+
+- (void)addPendingReceiptForMessage:(NSString *)messageIdentifier
+                       friendNumber:(OCTToxFriendNumber)friendNumber
+                          messageId:(OCTToxMessageId)messageId;
+
+@end
 
 @interface OCTSubmanagerChatsImplTests : OCTRealmTests
 
@@ -19,6 +34,7 @@
 @property (strong, nonatomic) NSNotificationCenter *notificationCenter;
 @property (strong, nonatomic) id dataSource;
 @property (strong, nonatomic) id tox;
+@property (strong, nonatomic) OCTPresenceStore *presence;
 
 @end
 
@@ -37,6 +53,9 @@
     self.tox = OCMClassMock([OCTTox class]);
     OCMStub([self.dataSource managerGetTox]).andReturn(self.tox);
 
+    self.presence = [OCTPresenceStore new];
+    OCMStub([self.dataSource managerGetPresenceStore]).andReturn(self.presence);
+
     self.submanager = [OCTSubmanagerChatsImpl new];
     self.submanager.dataSource = self.dataSource;
     [self.submanager configure];
@@ -46,6 +65,7 @@
 {
     self.dataSource = nil;
     self.tox = nil;
+    self.presence = nil;
     self.submanager = nil;
     // Put teardown code here. This method is called after the invocation of each test method in the class.
     [super tearDown];
@@ -101,141 +121,122 @@
 
 - (void)testSendMessageToChatSuccess
 {
-    id message = OCMClassMock([OCTMessageAbstract class]);
-
-    id friend = OCMClassMock([OCTFriend class]);
-    OCMStub([friend friendNumber]).andReturn(5);
-    NSArray *friends = @[friend];
-
-    id chat = OCMClassMock([OCTChat class]);
-    OCMStub([chat friends]).andReturn(friends);
+    OCTChat *chat = [self addChatWithConnectedFriend:YES];
 
     OCMStub([self.tox sendMessageWithFriendNumber:5
                                              type:OCTToxMessageTypeAction
                                           message:@"text"
                                             error:[OCMArg anyObjectRef]]).andReturn(7);
-    OCMExpect([self.realmManager addMessageWithText:@"text"
-                                               type:OCTToxMessageTypeAction
-                                               chat:chat
-                                             sender:nil
-                                          messageId:7]).andReturn(message);
 
-    XCTestExpectation *expectation = [self expectationWithDescription:@""];
+    __block OCTMessageAbstract *message;
 
     [self.submanager sendMessageToChat:chat text:@"text" type:OCTToxMessageTypeAction successBlock:^(OCTMessageAbstract *theMessage) {
-        OCMVerifyAll((id)self.realmManager);
-        XCTAssertEqualObjects(message, theMessage);
-        [expectation fulfill];
+        message = theMessage;
 
     } failureBlock:^(NSError *error) {
         XCTAssertTrue(false, @"This block shouldn't be called");
     }];
 
-    [self waitForExpectationsWithTimeout:0.2 handler:nil];
+    XCTAssertNotNil(message);
+    XCTAssertEqualObjects(message.messageText.text, @"text");
+    XCTAssertEqual(message.messageText.type, OCTToxMessageTypeAction);
+    XCTAssertEqual([OCTMessageOutboxEntry allObjectsInRealm:self.realmManager.realm].count, 1);
+    XCTAssertEqual([self.submanager numberOfQueuedMessagesForFriend:chat.friends.firstObject], 1);
+
+    [self drainOutbox];
+
+    XCTAssertEqual(message.messageText.messageId, 7);
+    XCTAssertEqual([OCTMessageOutboxEntry allObjectsInRealm:self.realmManager.realm].count, 0);
+    XCTAssertEqual([self.submanager numberOfQueuedMessagesForFriend:chat.friends.firstObject], 0);
 }
 
 - (void)testSendMessageToChatFailure
 {
-    id friend = OCMClassMock([OCTFriend class]);
-    OCMStub([friend friendNumber]).andReturn(5);
-    NSArray *friends = @[friend];
-
-    id chat = OCMClassMock([OCTChat class]);
-    OCMStub([chat friends]).andReturn(friends);
+    OCTChat *chat = [self addChatWithConnectedFriend:YES];
 
-    NSError *error2 = OCMClassMock([NSError class]);
+    NSError *error2 = [NSError errorWithDomain:kOCTToxErrorDomain code:OCTToxErrorFriendSendMessageTooLong userInfo:nil];
 
     OCMStub([self.tox sendMessageWithFriendNumber:5
                                              type:OCTToxMessageTypeAction
                                           message:@"text"
                                             error:[OCMArg setTo:error2]]).andReturn(0);
 
-
-    XCTestExpectation *expectation = [self expectationWithDescription:@""];
+    __block OCTMessageAbstract *message;
 
     [self.submanager sendMessageToChat:chat text:@"text" type:OCTToxMessageTypeAction successBlock:^(OCTMessageAbstract *theMessage) {
-        XCTAssertTrue(false, @"This block shouldn't be called");
+        message = theMessage;
 
     } failureBlock:^(NSError *error) {
-        OCMVerifyAll((id)self.realmManager);
-        XCTAssertEqualObjects(error, error2);
-        [expectation fulfill];
+        XCTAssertTrue(false, @"This block shouldn't be called");
     }];
 
-    [self waitForExpectationsWithTimeout:0.2 handler:nil];
+    [self drainOutbox];
+
+    // Message toxcore refused is dropped from outbox and stays undelivered.
+    XCTAssertEqual(message.messageText.messageId, 0);
+    XCTAssertFalse(message.messageText.isDelivered);
+    XCTAssertEqual([OCTMessageOutboxEntry allObjectsInRealm:self.realmManager.realm].count, 0);
+    XCTAssertEqual([self.submanager numberOfQueuedMessagesForFriend:chat.friends.firstObject], 0);
 }
 
 - (void)testSendMessageToChatFauxEnabled
 {
     OCMStub([self.dataSource managerUseFauxOfflineMessaging]).andReturn(YES);
 
-    id message = OCMClassMock([OCTMessageAbstract class]);
+    OCTChat *chat = [self addChatWithConnectedFriend:NO];
 
-    id friend = OCMClassMock([OCTFriend class]);
-    OCMStub([friend friendNumber]).andReturn(5);
-    NSArray *friends = @[friend];
-
-    id chat = OCMClassMock([OCTChat class]);
-    OCMStub([chat friends]).andReturn(friends);
-
-    NSError *error2 = OCMClassMock([NSError class]);
-    OCMStub(error2.code).andReturn(OCTToxErrorFriendSendMessageFriendNotConnected);
+    NSError *error2 = [NSError errorWithDomain:kOCTToxErrorDomain
+                                          code:OCTToxErrorFriendSendMessageFriendNotConnected
+                                      userInfo:nil];
 
     OCMStub([self.tox sendMessageWithFriendNumber:5
                                              type:OCTToxMessageTypeAction
                                           message:@"text"
                                             error:[OCMArg setTo:error2]]).andReturn(0);
-    OCMExpect([self.realmManager addMessageWithText:@"text"
-                                               type:OCTToxMessageTypeAction
-                                               chat:chat
-                                             sender:nil
-                                          messageId:-1]).andReturn(message);
 
-    XCTestExpectation *expectation = [self expectationWithDescription:@""];
+    __block OCTMessageAbstract *message;
 
     [self.submanager sendMessageToChat:chat text:@"text" type:OCTToxMessageTypeAction successBlock:^(OCTMessageAbstract *theMessage) {
-        OCMVerifyAll((id)self.realmManager);
-        XCTAssertEqualObjects(message, theMessage);
-        [expectation fulfill];
+        message = theMessage;
 
     } failureBlock:^(NSError *error) {
         XCTAssertTrue(false, @"This block shouldn't be called");
     }];
 
-    [self waitForExpectationsWithTimeout:0.2 handler:nil];
+    XCTAssertNotNil(message);
+
+    [self drainOutbox];
+
+    // Message waits for friend to connect.
+    XCTAssertEqual([OCTMessageOutboxEntry allObjectsInRealm:self.realmManager.realm].count, 1);
+    XCTAssertEqual([self.submanager numberOfQueuedMessagesForFriend:chat.friends.firstObject], 1);
 }
 
 - (void)testSendMessageToChatFauxDisabled
 {
     OCMStub([self.dataSource managerUseFauxOfflineMessaging]).andReturn(NO);
 
-    id friend = OCMClassMock([OCTFriend class]);
-    OCMStub([friend friendNumber]).andReturn(5);
-    NSArray *friends = @[friend];
-
-    id chat = OCMClassMock([OCTChat class]);
-    OCMStub([chat friends]).andReturn(friends);
-
-    NSError *error2 = OCMClassMock([NSError class]);
-    OCMStub(error2.code).andReturn(OCTToxErrorFriendSendMessageFriendNotConnected);
+    OCTChat *chat = [self addChatWithConnectedFriend:NO];
 
-    OCMStub([self.tox sendMessageWithFriendNumber:5
-                                             type:OCTToxMessageTypeAction
-                                          message:@"text"
-                                            error:[OCMArg setTo:error2]]).andReturn(0);
+    OCMReject([self.tox sendMessageWithFriendNumber:5
+                                               type:OCTToxMessageTypeAction
+                                            message:[OCMArg any]
+                                              error:[OCMArg anyObjectRef]]);
 
-    XCTestExpectation *expectation = [self expectationWithDescription:@""];
+    __block NSError *error2;
 
     [self.submanager sendMessageToChat:chat text:@"text" type:OCTToxMessageTypeAction successBlock:^(OCTMessageAbstract *theMessage) {
         XCTAssertTrue(false, @"This block shouldn't be called");
 
     } failureBlock:^(NSError *error) {
-        OCMVerifyAll((id)self.realmManager);
-        XCTAssertEqualObjects(error, error2);
-        [expectation fulfill];
+        error2 = error;
     }];
 
-    [self waitForExpectationsWithTimeout:0.2 handler:nil];
+    [self drainOutbox];
+
+    XCTAssertEqualObjects(error2.domain, kOCTToxErrorDomain);
+    XCTAssertEqual(error2.code, OCTToxErrorFriendSendMessageFriendNotConnected);
+    XCTAssertEqual([OCTMessageAbstract allObjectsInRealm:self.realmManager.realm].count, 0);
 }
 
 - (void)testSetIsTyping
@@ -302,10 +303,7 @@
     OCMStub([self.tox sendMessageWithFriendNumber:1 type:OCTToxMessageTypeNormal message:@"7" error:[OCMArg anyObjectRef]]).andReturn(107);
     OCMStub([self.tox sendMessageWithFriendNumber:1 type:OCTToxMessageTypeNormal message:@"9" error:[OCMArg anyObjectRef]]).andReturn(109);
 
-    [self.realmManager.realm beginWriteTransaction];
-    friend1.connectionStatus = OCTToxConnectionStatusUDP;
-    friend1.isConnected = YES;
-    [self.realmManager.realm commitWriteTransaction];
+    [self.presence setConnectionStatus:OCTToxConnectionStatusUDP forFriendNumber:friend1.friendNumber];
 
     [self.notificationCenter postNotificationName:kOCTFriendConnectionStatusChangeNotification object:friend1];
 
@@ -317,9 +315,9 @@
         XCTAssertEqual(message.messageText.isDelivered, __delivered); \
     }
 
-    XCTestExpectation *expectation = [self expectationWithDescription:@""];
+    [self drainOutbox];
 
-    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, 0.1 * NSEC_PER_SEC), dispatch_get_main_queue(), ^{
+    {
         VERIFY_MESSAGE(messages1, 0, 0, NO);
         VERIFY_MESSAGE(messages1, 1, 101, NO);
         VERIFY_MESSAGE(messages1, 2, 2, NO);
@@ -333,11 +331,7 @@
 
         VERIFY_MESSAGE(messages2, 0, 0, NO);
         VERIFY_MESSAGE(messages2, 1, 1, NO);
-
-        [expectation fulfill];
-    });
-
-    [self waitForExpectationsWithTimeout:0.3 handler:nil];
+    }
 
 
     // Deliver some messages, then resend all left again.
@@ -364,9 +358,9 @@
 
     [self.notificationCenter postNotificationName:kOCTFriendConnectionStatusChangeNotification object:friend1];
 
-    XCTestExpectation *expectation2 = [self expectationWithDescription:@""];
+    [self drainOutbox];
 
-    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, 0.1 * NSEC_PER_SEC), dispatch_get_main_queue(), ^{
+    {
         VERIFY_MESSAGE(messages1, 0, 0, NO);
         VERIFY_MESSAGE(messages1, 1, 101, YES);
         VERIFY_MESSAGE(messages1, 2, 2, NO);
@@ -380,11 +374,7 @@
 
         VERIFY_MESSAGE(messages2, 0, 0, NO);
         VERIFY_MESSAGE(messages2, 1, 1, NO);
-
-        [expectation2 fulfill];
-    });
-
-    [self waitForExpectationsWithTimeout:0.3 handler:nil];
+    }
 }
 
 #pragma mark -  OCTToxDelegate
@@ -415,6 +405,110 @@
     XCTAssertEqual(message.messageText.type, OCTToxMessageTypeAction);
 }
 
+- (void)testMessageCursorForChat
+{
+    OCTChat *chat = [OCTChat new];
+
+    OCTMessageCursor *cursor = [self.submanager messageCursorForChat:chat pageSize:20];
+
+    XCTAssertEqualObjects(cursor.chatUniqueIdentifier, chat.uniqueIdentifier);
+    XCTAssertEqual(cursor.pageSize, 20);
+    XCTAssertTrue(cursor.hasOlderMessages);
+}
+
+- (void)testSearchMessages
+{
+    OCTChat *chat = [OCTChat new];
+    [self.realmManager addObject:chat];
+
+    OCTMessageAbstract *message = [self.realmManager addMessageWithText:@"Hello there"
+                                                                   type:OCTToxMessageTypeNormal
+                                                                   chat:chat
+                                                                 sender:nil
+                                                              messageId:0];
+
+    RLMResults *results = [self.submanager searchMessagesWithQuery:@"hel" inChat:chat];
+
+    XCTAssertEqual(results.count, 1);
+    XCTAssertEqualObjects(results.firstObject, message);
+    XCTAssertEqual([self.submanager searchMessagesWithQuery:@"hel" inChat:[OCTChat new]].count, 0);
+}
+
+- (void)testFriendMessageIsSingleTransaction
+{
+    OCTFriend *friend = [self createFriendWithFriendNumber:5];
+    NSString *publicKey = friend.publicKey;
+    OCMStub([self.tox publicKeyFromFriendNumber:friend.friendNumber error:nil]).andReturn(publicKey);
+
+    [self.realmManager.realm beginWriteTransaction];
+    [self.realmManager.realm addObject:friend];
+    [self.realmManager.realm commitWriteTransaction];
+
+    // First message creates chat.
+    for (NSUInteger i = 0; i < 2; i++) {
+        NSUInteger transactionsBefore = self.realmManager.writeTransactionsCount;
+
+        [self.submanager tox:nil friendMessage:@"message" type:OCTToxMessageTypeNormal friendNumber:5];
+
+        XCTAssertEqual(self.realmManager.writeTransactionsCount - transactionsBefore, 1);
+    }
+
+    OCTChat *chat = [[OCTChat allObjectsInRealm:self.realmManager.realm] firstObject];
+    RLMResults *messages = [OCTMessageAbstract allObjectsInRealm:self.realmManager.realm];
+
+    XCTAssertEqual(messages.count, 2);
+    XCTAssertNotNil(chat.lastMessage);
+    XCTAssertEqual(chat.lastActivityDateInterval, chat.lastMessage.dateInterval);
+}
+
+- (void)testFriendMessageInsideOfBatch
+{
+    OCTFriend *friend = [self createFriendWithFriendNumber:5];
+    NSString *publicKey = friend.publicKey;
+
+    [self.realmManager.realm beginWriteTransaction];
+    [self.realmManager.realm addObject:friend];
+    [self.realmManager.realm commitWriteTransaction];
+
+    NSMutableDictionary *clientIdentifiers = [NSMutableDictionary new];
+    __block NSUInteger lookupsInsideOfTransaction = 0;
+
+    OCMStub([self.tox clientIdentifierForFriendNumber:5]).andDo(^(NSInvocation *invocation) {
+        __unsafe_unretained NSString *identifier = clientIdentifiers[@5];
+        [invocation setReturnValue:&identifier];
+    });
+    OCMStub([self.tox setClientIdentifier:[OCMArg any] forFriendNumber:5]).andDo(^(NSInvocation *invocation) {
+        __unsafe_unretained NSString *identifier;
+        [invocation getArgument:&identifier atIndex:2];
+        clientIdentifiers[@5] = identifier;
+    });
+    OCMStub([self.tox publicKeyFromFriendNumber:5 error:nil]).andDo(^(NSInvocation *invocation) {
+        if (self.realmManager.realm.inWriteTransaction) {
+            lookupsInsideOfTransaction++;
+        }
+
+        __unsafe_unretained NSString *key = publicKey;
+        [invocation setReturnValue:&key];
+    });
+
+    // Same as OCTManagerImpl does with event batch.
+    [self.realmManager friendWithFriendNumber:5 tox:self.tox];
+
+    NSUInteger transactionsBefore = self.realmManager.writeTransactionsCount;
+
+    [self.realmManager performBatchUpdates:^{
+        [self.submanager tox:self.tox friendMessage:@"first" type:OCTToxMessageTypeNormal friendNumber:5];
+        [self.submanager tox:self.tox friendMessage:@"second" type:OCTToxMessageTypeNormal friendNumber:5];
+    }];
+
+    XCTAssertEqual(self.realmManager.writeTransactionsCount - transactionsBefore, 1);
+    XCTAssertEqual(lookupsInsideOfTransaction, 0);
+
+    RLMResults *messages = [OCTMessageAbstract allObjectsInRealm:self.realmManager.realm];
+    XCTAssertEqual(messages.count, 2);
+    XCTAssertEqual([OCTChat allObjectsInRealm:self.realmManager.realm].count, 1);
+}
+
 - (void)testMessageDelivered
 {
     OCTFriend *friend = [self createFriendWithFriendNumber:5];
@@ -459,6 +553,197 @@
     XCTAssertTrue(anotherMessageSameId.messageText.isDelivered);
 }
 
+- (void)testMessageDeliveredUsesPendingReceipt
+{
+    OCTFriend *friend = [self createFriendWithFriendNumber:5];
+    OCTChat *chat = [self createChatWithFriend:friend];
+
+    OCTMessageAbstract *sent = [self createTextMessageInChat:chat outgoing:YES messageId:10];
+    OCTMessageAbstract *newerSameId = [self createTextMessageInChat:chat outgoing:YES messageId:10];
+    sent.dateInterval = 1;
+    newerSameId.dateInterval = 2;
+
+    [self.realmManager.realm beginWriteTransaction];
+    [self.realmManager.realm addObject:friend];
+    [self.realmManager.realm addObject:chat];
+    [self.realmManager.realm addObject:sent];
+    [self.realmManager.realm addObject:newerSameId];
+    [self.realmManager.realm commitWriteTransaction];
+
+    [self.submanager addPendingReceiptForMessage:sent.uniqueIdentifier friendNumber:5 messageId:10];
+
+    // Friend and chat are not resolved.
+    [[self.tox reject] publicKeyFromFriendNumber:5 error:[OCMArg anyObjectRef]];
+
+    [self.submanager tox:self.tox messageDelivered:10 friendNumber:5];
+
+    XCTAssertTrue(sent.messageText.isDelivered);
+    XCTAssertFalse(newerSameId.messageText.isDelivered);
+}
+
+- (void)testPendingReceiptsAreRemovedWithFriend
+{
+    OCTFriend *removedFriend = [self createFriendWithFriendNumber:5];
+    OCTChat *removedChat = [self createChatWithFriend:removedFriend];
+    OCTMessageAbstract *sent = [self createTextMessageInChat:removedChat outgoing:YES messageId:10];
+
+    // Friend number is reused by newly added friend.
+    OCTFriend *addedFriend = [self createFriendWithFriendNumber:5];
+    OCTChat *addedChat = [self createChatWithFriend:addedFriend];
+    OCTMessageAbstract *sentToAdded = [self createTextMessageInChat:addedChat outgoing:YES messageId:10];
+
+    NSString *publicKey = addedFriend.publicKey;
+    OCMStub([self.tox publicKeyFromFriendNumber:5 error:[OCMArg anyObjectRef]]).andReturn(publicKey);
+
+    [self.realmManager.realm beginWriteTransaction];
+    [self.realmManager.realm addObject:removedChat];
+    [self.realmManager.realm addObject:addedChat];
+    [self.realmManager.realm addObject:sent];
+    [self.realmManager.realm addObject:sentToAdded];
+    [self.realmManager.realm commitWriteTransaction];
+
+    [self.submanager addPendingReceiptForMessage:sent.uniqueIdentifier friendNumber:5 messageId:10];
+
+    [self.notificationCenter postNotificationName:kOCTFriendWasRemovedNotification object:@5];
+
+    [self.submanager tox:self.tox messageDelivered:10 friendNumber:5];
+
+    XCTAssertFalse(sent.messageText.isDelivered);
+    XCTAssertTrue(sentToAdded.messageText.isDelivered);
+}
+
+#pragma mark -  Performance
+
+/**
+ * Previous behaviour: messages without pending receipt are looked up with query.
+ */
+- (void)testQueriedReceiptsPerformance
+{
+    OCTChat *chat = [self addChatForReceipts];
+    __block NSTimeInterval dateInterval = 0;
+
+    [self measureMetrics:[[self class] defaultPerformanceMetrics] automaticallyStartMeasuring:NO forBlock:^{
+        NSArray<OCTMessageAbstract *> *messages = [self addOutgoingMessagesInChat:chat
+                                                                            count:kReceiptStormQueriedCount
+                                                                firstDateInterval:dateInterval];
+        dateInterval += messages.count;
+
+        [self startMeasuring];
+
+        [self.realmManager performBatchUpdates:^{
+            for (OCTToxMessageId messageId = 0; messageId < messages.count; messageId++) {
+                [self.submanager tox:self.tox messageDelivered:messageId friendNumber:5];
+            }
+        }];
+
+        [self stopMeasuring];
+
+        XCTAssertTrue(messages.lastObject.messageText.isDelivered);
+    }];
+}
+
+/**
+ * Receipts of tox iteration are delivered inside of batch, see OCTManager tox:receivedEventBatch:.
+ */
+- (void)testPendingReceiptsPerformance
+{
+    OCTChat *chat = [self addChatForReceipts];
+    __block NSTimeInterval dateInterval = 0;
+
+    [self measureMetrics:[[self class] defaultPerformanceMetrics] automaticallyStartMeasuring:NO forBlock:^{
+        NSArray<OCTMessageAbstract *> *messages = [self addOutgoingMessagesInChat:chat
+                                                                            count:kReceiptStormCount
+                                                                firstDateInterval:dateInterval];
+        dateInterval += messages.count;
+
+        for (OCTMessageAbstract *message in messages) {
+            [self.submanager addPendingReceiptForMessage:message.uniqueIdentifier
+                                            friendNumber:5
+                                               messageId:message.messageText.messageId];
+        }
+
+        NSUInteger transactionsBefore = self.realmManager.writeTransactionsCount;
+
+        [self startMeasuring];
+
+        [self.realmManager performBatchUpdates:^{
+            for (OCTToxMessageId messageId = 0; messageId < messages.count; messageId++) {
+                [self.submanager tox:self.tox messageDelivered:messageId friendNumber:5];
+            }
+        }];
+
+        [self stopMeasuring];
+
+        XCTAssertEqual(self.realmManager.writeTransactionsCount - transactionsBefore, 1);
+        XCTAssertEqual([self.realmManager objectsWithClass:[OCTMessageAbstract class]
+                                                 predicate:[NSPredicate predicateWithFormat:@"messageText.isDelivered == NO"]].count, 0);
+    }];
+}
+
+#pragma mark -  Private
+
+/**
+ * Adds friend 5 and chat with it.
+ */
+- (OCTChat *)addChatForReceipts
+{
+    OCTFriend *friend = [self createFriendWithFriendNumber:5];
+    NSString *publicKey = friend.publicKey;
+    OCMStub([self.tox publicKeyFromFriendNumber:friend.friendNumber error:[OCMArg anyObjectRef]]).andReturn(publicKey);
+
+    OCTChat *chat = [self createChatWithFriend:friend];
+
+    [self.realmManager.realm beginWriteTransaction];
+    [self.realmManager.realm addObject:friend];
+    [self.realmManager.realm addObject:chat];
+    [self.realmManager.realm commitWriteTransaction];
+
+    return chat;
+}
+
+/**
+ * Adds outgoing messages with messageId 0, 1, ..., count - 1.
+ */
+- (NSArray<OCTMessageAbstract *> *)addOutgoingMessagesInChat:(OCTChat *)chat
+                                                       count:(NSUInteger)count
+                                           firstDateInterval:(NSTimeInterval)firstDateInterval
+{
+    NSMutableArray<OCTMessageAbstract *> *messages = [NSMutableArray new];
+
+    for (OCTToxMessageId messageId = 0; messageId < count; messageId++) {
+        OCTMessageAbstract *message = [self createTextMessageInChat:chat outgoing:YES messageId:messageId];
+        message.dateInterval = firstDateInterval + messageId;
+        [messages addObject:message];
+    }
+
+    [self.realmManager addMessages:messages];
+
+    return messages;
+}
+
+- (OCTChat *)addChatWithConnectedFriend:(BOOL)isConnected
+{
+    OCTFriend *friend = [self createFriendWithFriendNumber:5];
+    [self.presence setConnectionStatus:(isConnected ? OCTToxConnectionStatusUDP : OCTToxConnectionStatusNone)
+                       forFriendNumber:5];
+    OCTChat *chat = [self createChatWithFriend:friend];
+
+    [self.realmManager.realm beginWriteTransaction];
+    [self.realmManager.realm addObject:chat];
+    [self.realmManager.realm commitWriteTransaction];
+
+    return chat;
+}
+
+/**
+ * Sends queued messages the way it happens after tox iteration and commits resulting writes.
+ */
+- (void)drainOutbox
+{
+    [[self.submanager valueForKey:@"outbox"] drain];
+    [self.realmManager flushAsyncWrites];
+}
+
 - (OCTChat *)createChatWithFriend:(OCTFriend *)friend
 {
     OCTChat *chat = [OCTChat new];
@@ -10,6 +10,7 @@
 #import "OCTSubmanagerDataSource.h"
 #import "OCTTox.h"
 #import "OCTFriendRequest.h"
+#import "OCTPresenceStore+Private.h"
 
 static const OCTToxFriendNumber kFriendNumber = 5;
 static NSString *const kPublicKey = @"kPublicKey";
@@ -26,6 +27,7 @@ static NSString *const kMessage = @"kMessage";
 @property (strong, nonatomic) OCTSubmanagerFriendsImpl *submanager;
 @property (strong, nonatomic) id dataSource;
 @property (strong, nonatomic) id tox;
+@property (strong, nonatomic) OCTPresenceStore *presence;
 
 @end
 
@@ -44,6 +46,9 @@ static NSString *const kMessage = @"kMessage";
     self.tox = OCMClassMock([OCTTox class]);
     OCMStub([self.dataSource managerGetTox]).andReturn(self.tox);
 
+    self.presence = [OCTPresenceStore new];
+    OCMStub([self.dataSource managerGetPresenceStore]).andReturn(self.presence);
+
     self.submanager = [OCTSubmanagerFriendsImpl new];
     self.submanager.dataSource = self.dataSource;
 }
@@ -52,6 +57,7 @@ static NSString *const kMessage = @"kMessage";
 {
     self.dataSource = nil;
     self.tox = nil;
+    self.presence = nil;
     self.submanager = nil;
 
     [super tearDown];
@@ -61,9 +67,6 @@ static NSString *const kMessage = @"kMessage";
 {
     OCTFriend *friend = [self createFriendWithFriendNumber:5];
     friend.status = OCTToxUserStatusBusy;
-    friend.isConnected = YES;
-    friend.connectionStatus = OCTToxConnectionStatusUDP;
-    friend.isTyping = YES;
 
     NSString *publicKey = friend.publicKey;
     OCMStub([self.tox publicKeyFromFriendNumber:5 error:[OCMArg anyObjectRef]]).andReturn(publicKey);
@@ -75,12 +78,27 @@ static NSString *const kMessage = @"kMessage";
     [self.realmManager.realm addObject:friend];
     [self.realmManager.realm commitWriteTransaction];
 
+    NSUInteger transactionsBefore = self.realmManager.writeTransactionsCount;
+
     [self.submanager configure];
 
+    XCTAssertEqual(self.realmManager.writeTransactionsCount - transactionsBefore, 1);
     XCTAssertEqual(friend.status, OCTToxUserStatusNone);
-    XCTAssertFalse(friend.isConnected);
-    XCTAssertEqual(friend.connectionStatus, OCTToxConnectionStatusNone);
-    XCTAssertFalse(friend.isTyping);
+    XCTAssertFalse([self.presence isFriendNumberConnected:5]);
+    XCTAssertFalse([self.presence isFriendNumberTyping:5]);
+}
+
+- (void)testConfigureWithBrokenToxSaveDoesNotOpenTransaction
+{
+    NSArray *array = @[@(5)];
+    OCMStub([self.tox friendsArray]).andReturn(array);
+
+    NSUInteger transactionsBefore = self.realmManager.writeTransactionsCount;
+
+    XCTAssertThrows([self.submanager configure]);
+
+    XCTAssertEqual(self.realmManager.writeTransactionsCount, transactionsBefore);
+    XCTAssertFalse(self.realmManager.realm.inWriteTransaction);
 }
 
 - (void)testConfigure2
@@ -236,10 +254,19 @@ static NSString *const kMessage = @"kMessage";
 
     OCMExpect([self.tox deleteFriendWithFriendNumber:kFriendNumber error:nil]).andReturn(YES);
 
+    NSNotificationCenter *center = [[NSNotificationCenter alloc] init];
+    OCMStub([self.dataSource managerGetNotificationCenter]).andReturn(center);
+
+    __block NSNumber *removedFriendNumber;
+    [center addObserverForName:kOCTFriendWasRemovedNotification object:nil queue:nil usingBlock:^(NSNotification *note) {
+        removedFriendNumber = note.object;
+    }];
+
     BOOL result = [self.submanager removeFriend:friend error:nil];
 
     XCTAssertTrue(result);
     OCMVerify([self.dataSource managerSaveTox]);
+    XCTAssertEqualObjects(removedFriendNumber, @(kFriendNumber));
 
     RLMResults *objects = [OCTFriend allObjectsInRealm:self.realmManager.realm];
     XCTAssertEqual(objects.count, 0);
@@ -306,9 +333,6 @@ static NSString *const kMessage = @"kMessage";
     OCTFriend *friend = [self createFriendWithFriendNumber:kFriendNumber];
     friend.publicKey = kPublicKey;
     friend.status = OCTToxUserStatusBusy;
-    friend.isConnected = YES;
-    friend.connectionStatus = OCTToxConnectionStatusUDP;
-    friend.isTyping = YES;
 
     NSString *publicKey = friend.publicKey;
     OCMStub([self.tox publicKeyFromFriendNumber:kFriendNumber error:[OCMArg anyObjectRef]]).andReturn(publicKey);
@@ -345,6 +369,39 @@ static NSString *const kMessage = @"kMessage";
     XCTAssertEqualObjects(friend.nickname, kName);
 }
 
+- (void)testFriendIsResolvedByClientIdentifier
+{
+    OCTFriend *friend = [self createFriendWithFriendNumber:kFriendNumber];
+
+    [self.realmManager.realm beginWriteTransaction];
+    [self.realmManager.realm addObject:friend];
+    [self.realmManager.realm commitWriteTransaction];
+
+    OCMStub([self.tox clientIdentifierForFriendNumber:kFriendNumber]).andReturn(friend.uniqueIdentifier);
+    OCMReject([self.tox publicKeyFromFriendNumber:kFriendNumber error:[OCMArg anyObjectRef]]);
+
+    [self.submanager tox:self.tox friendStatusMessageUpdate:kStatusMessage friendNumber:kFriendNumber];
+
+    XCTAssertEqualObjects(friend.statusMessage, kStatusMessage);
+}
+
+- (void)testClientIdentifierIsStoredAfterLookup
+{
+    OCTFriend *friend = [self createFriendWithFriendNumber:kFriendNumber];
+
+    [self.realmManager.realm beginWriteTransaction];
+    [self.realmManager.realm addObject:friend];
+    [self.realmManager.realm commitWriteTransaction];
+
+    OCMStub([self.tox publicKeyFromFriendNumber:kFriendNumber error:[OCMArg anyObjectRef]]).andReturn(friend.publicKey);
+    OCMExpect([self.tox setClientIdentifier:friend.uniqueIdentifier forFriendNumber:kFriendNumber]);
+
+    [self.submanager tox:self.tox friendStatusMessageUpdate:kStatusMessage friendNumber:kFriendNumber];
+
+    OCMVerifyAll(self.tox);
+    XCTAssertEqualObjects(friend.statusMessage, kStatusMessage);
+}
+
 - (void)testStatusMessageUpdate
 {
     OCTFriend *friend = [self createFriendWithFriendNumber:kFriendNumber];
@@ -410,8 +467,13 @@ static NSString *const kMessage = @"kMessage";
     [self.realmManager.realm addObject:friend];
     [self.realmManager.realm commitWriteTransaction];
 
+    NSUInteger transactionsBefore = self.realmManager.writeTransactionsCount;
+
     [self.submanager tox:self.tox friendIsTypingUpdate:kIsTyping friendNumber:kFriendNumber];
-    XCTAssertEqual(friend.isTyping, kIsTyping);
+    XCTAssertEqual([self.presence isFriendTyping:friend], kIsTyping);
+
+    // Typing isn't stored in database.
+    XCTAssertEqual(self.realmManager.writeTransactionsCount, transactionsBefore);
 }
 
 - (void)testFriendConnectionStatusChanged
@@ -426,16 +488,16 @@ static NSString *const kMessage = @"kMessage";
     [self.realmManager.realm commitWriteTransaction];
 
     [self.submanager tox:self.tox friendConnectionStatusChanged:OCTToxConnectionStatusUDP friendNumber:kFriendNumber];
-    XCTAssertEqual(friend.connectionStatus, OCTToxConnectionStatusUDP);
-    XCTAssertTrue(friend.isConnected);
+    XCTAssertEqual([self.presence connectionStatusOfFriend:friend], OCTToxConnectionStatusUDP);
+    XCTAssertTrue([self.presence isFriendConnected:friend]);
 
     [self.submanager tox:self.tox friendConnectionStatusChanged:OCTToxConnectionStatusNone friendNumber:kFriendNumber];
-    XCTAssertEqual(friend.connectionStatus, OCTToxConnectionStatusNone);
-    XCTAssertFalse(friend.isConnected);
+    XCTAssertEqual([self.presence connectionStatusOfFriend:friend], OCTToxConnectionStatusNone);
+    XCTAssertFalse([self.presence isFriendConnected:friend]);
 
     [self.submanager tox:self.tox friendConnectionStatusChanged:OCTToxConnectionStatusTCP friendNumber:kFriendNumber];
-    XCTAssertEqual(friend.connectionStatus, OCTToxConnectionStatusTCP);
-    XCTAssertTrue(friend.isConnected);
+    XCTAssertEqual([self.presence connectionStatusOfFriend:friend], OCTToxConnectionStatusTCP);
+    XCTAssertTrue([self.presence isFriendConnected:friend]);
 
     NSNotificationCenter *center = [[NSNotificationCenter alloc] init];
     OCMStub([self.dataSource managerGetNotificationCenter]).andReturn(center);
@@ -472,10 +534,10 @@ static NSString *const kMessage = @"kMessage";
     XCTAssertEqualObjects(friend.name, kName);
     XCTAssertEqualObjects(friend.statusMessage, kStatusMessage);
     XCTAssertEqual(friend.status, kStatus);
-    XCTAssertEqual(friend.isConnected, YES);
-    XCTAssertEqual(friend.connectionStatus, kConnectionStatus);
+    XCTAssertEqual([self.presence isFriendConnected:friend], YES);
+    XCTAssertEqual([self.presence connectionStatusOfFriend:friend], kConnectionStatus);
     XCTAssertEqual(friend.lastSeenOnlineInterval, [sLastSeenOnline timeIntervalSince1970]);
-    XCTAssertEqual(friend.isTyping, kIsTyping);
+    XCTAssertEqual([self.presence isFriendTyping:friend], kIsTyping);
 }
 
 @end
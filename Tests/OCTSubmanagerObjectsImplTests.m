@@ -186,10 +186,12 @@
         block(chat);
         return YES;
     }]]);
+    OCMStub([self.realmManager unreadCountInChat:chat lastReadDateInterval:17]).andReturn(3);
 
     [self.submanager changeChat:chat lastReadDateInterval:17];
 
     XCTAssertEqual(chat.lastReadDateInterval, 17);
+    XCTAssertEqual(chat.unreadCount, 3);
 }
 
 @end
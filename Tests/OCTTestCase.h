@@ -0,0 +1,16 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <XCTest/XCTest.h>
+
+/**
+ * Base class for tests with performance tests.
+ *
+ * Test methods with names ending with "Performance" use measureBlock: and take long, they are run
+ * only if OCT_PERFORMANCE_TESTS environment variable is set (see iOSDemoPerformance and OSXDemoPerformance
+ * schemes). Other schemes run remaining tests only.
+ */
+@interface OCTTestCase : XCTestCase
+
+@end
@@ -0,0 +1,34 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import "OCTTestCase.h"
+
+static NSString *const kPerformanceTestsEnvironmentKey = @"OCT_PERFORMANCE_TESTS";
+static NSString *const kPerformanceTestSuffix = @"Performance";
+
+@implementation OCTTestCase
+
++ (XCTestSuite *)defaultTestSuite
+{
+    XCTestSuite *suite = [super defaultTestSuite];
+
+    if ([NSProcessInfo processInfo].environment[kPerformanceTestsEnvironmentKey]) {
+        return suite;
+    }
+
+    XCTestSuite *filtered = [XCTestSuite testSuiteWithName:suite.name];
+
+    for (XCTest *test in suite.tests) {
+        if ([test isKindOfClass:[XCTestCase class]] &&
+            [NSStringFromSelector(((XCTestCase *)test).invocation.selector) hasSuffix:kPerformanceTestSuffix]) {
+            continue;
+        }
+
+        [filtered addTest:test];
+    }
+
+    return filtered;
+}
+
+@end
@@ -0,0 +1,315 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <Foundation/Foundation.h>
+#import <OCMock/OCMock.h>
+
+#import "OCTRealmTests.h"
+
+#import "OCTTox+Private.h"
+#import "OCTToxOptions.h"
+#import "OCTToxEventBatch+Private.h"
+#import "OCTSubmanagerChatsImpl.h"
+#import "OCTMessageAbstract.h"
+
+static const NSUInteger kLoopbackMessagesCount = 1000;
+
+/**
+ * Mimics OCTManagerImpl: forwards batch to submanager inside of single database transaction,
+ * events calling tox are forwarded after it.
+ */
+@interface OCTToxEventBatchTestsManager : NSObject <OCTToxDelegate>
+
+@property (strong, nonatomic) OCTRealmManager *realmManager;
+@property (strong, nonatomic) id<OCTToxDelegate> submanager;
+
+@end
+
+@implementation OCTToxEventBatchTestsManager
+
+- (void)tox:(OCTTox *)tox receivedEventBatch:(OCTToxEventBatch *)batch
+{
+    [self.realmManager performBatchUpdates:^{
+        [batch deliverToDelegate:self.submanager callingTox:NO];
+    }];
+
+    [batch deliverToDelegate:self.submanager callingTox:YES];
+}
+
+@end
+
+/**
+ * Implements single delegate method, used to check capabilities.
+ */
+@interface OCTToxEventBatchTestsTypingDelegate : NSObject <OCTToxDelegate>
+
+@property (assign, nonatomic) NSUInteger typingUpdatesCount;
+
+@end
+
+@implementation OCTToxEventBatchTestsTypingDelegate
+
+- (void)tox:(OCTTox *)tox friendIsTypingUpdate:(BOOL)isTyping friendNumber:(OCTToxFriendNumber)friendNumber
+{
+    self.typingUpdatesCount++;
+}
+
+@end
+
+@interface OCTToxEventBatchTests : OCTRealmTests
+
+@property (strong, nonatomic) OCTTox *tox;
+
+@end
+
+@implementation OCTToxEventBatchTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    OCTToxOptions *options = [OCTToxOptions new];
+    options.delegateQueue = OCTToxDelegateQueueIterate;
+
+    self.tox = [[OCTTox alloc] initWithOptions:options savedData:nil error:nil];
+}
+
+- (void)tearDown
+{
+    self.tox = nil;
+
+    [super tearDown];
+}
+
+- (void)testDeliverToDelegate
+{
+    NSMutableArray *order = [NSMutableArray new];
+
+    OCTToxEventBatch *batch = [[OCTToxEventBatch alloc] initWithEvents:@[
+                                   ^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
+                                       [order addObject:@1];
+                                   },
+                                   ^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
+                                       [order addObject:@2];
+                                   },
+                               ]];
+
+    XCTAssertEqual(batch.count, 2);
+
+    [batch deliverToDelegate:OCMProtocolMock(@protocol(OCTToxDelegate))];
+
+    XCTAssertEqualObjects(order, (@[@1, @2]));
+}
+
+- (void)testDeliverToDelegateCallingTox
+{
+    NSMutableArray *order = [NSMutableArray new];
+
+    OCTToxEventBatch *batch = [[OCTToxEventBatch alloc] initWithEvents:@[
+                                   ^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
+                                       [order addObject:@1];
+                                   },
+                                   ^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
+                                       [order addObject:@2];
+                                   },
+                                   ^(id<OCTToxDelegate> delegate, OCTToxDelegateCapabilities capabilities) {
+                                       [order addObject:@3];
+                                   },
+                               ]
+                                                       toxEventIndexes:[NSIndexSet indexSetWithIndex:1]
+                                                         friendNumbers:[NSIndexSet indexSetWithIndex:5]];
+
+    id delegate = OCMProtocolMock(@protocol(OCTToxDelegate));
+
+    [batch deliverToDelegate:delegate callingTox:NO];
+    XCTAssertEqualObjects(order, (@[@1, @3]));
+
+    [batch deliverToDelegate:delegate callingTox:YES];
+    XCTAssertEqualObjects(order, (@[@1, @3, @2]));
+
+    XCTAssertEqualObjects(batch.friendNumbers, [NSIndexSet indexSetWithIndex:5]);
+}
+
+- (void)testFileEventsCallTox
+{
+    id delegate = OCMProtocolMock(@protocol(OCTToxDelegate));
+    self.tox.delegate = delegate;
+
+    __block OCTToxEventBatch *receivedBatch;
+    OCMStub([delegate tox:self.tox receivedEventBatch:[OCMArg checkWithBlock:^BOOL (id obj) {
+        receivedBatch = obj;
+        return YES;
+    }]]);
+
+    const char *text = "message";
+
+    [self.tox beginEventBatch];
+    friendMessageCallback(NULL, 5, TOX_MESSAGE_TYPE_NORMAL, (const uint8_t *)text, strlen(text), (__bridge void *)self.tox);
+    fileReceiveControlCallback(NULL, 7, 1, TOX_FILE_CONTROL_CANCEL, (__bridge void *)self.tox);
+    friendConnectionStatusCallback(NULL, 8, TOX_CONNECTION_NONE, (__bridge void *)self.tox);
+    [self.tox endEventBatch];
+
+    NSMutableIndexSet *friendNumbers = [NSMutableIndexSet new];
+    [friendNumbers addIndex:5];
+    [friendNumbers addIndex:7];
+    [friendNumbers addIndex:8];
+    XCTAssertEqualObjects(receivedBatch.friendNumbers, friendNumbers);
+
+    id toxDelegate = OCMStrictProtocolMock(@protocol(OCTToxDelegate));
+    OCMExpect([toxDelegate tox:self.tox fileReceiveControl:OCTToxFileControlCancel friendNumber:7 fileNumber:1]);
+    OCMExpect([toxDelegate tox:self.tox friendConnectionStatusChanged:OCTToxConnectionStatusNone friendNumber:8]);
+
+    [receivedBatch deliverToDelegate:toxDelegate callingTox:YES];
+
+    OCMVerifyAll(toxDelegate);
+}
+
+- (void)testEventsAreBatchedDuringIteration
+{
+    id delegate = OCMProtocolMock(@protocol(OCTToxDelegate));
+    self.tox.delegate = delegate;
+
+    __block OCTToxEventBatch *receivedBatch;
+    OCMExpect([delegate tox:self.tox receivedEventBatch:[OCMArg checkWithBlock:^BOOL (id obj) {
+        receivedBatch = obj;
+        return YES;
+    }]]);
+
+    [[delegate reject] tox:[OCMArg any] friendIsTypingUpdate:YES friendNumber:5];
+
+    [self.tox beginEventBatch];
+    friendTypingCallback(NULL, 5, true, (__bridge void *)self.tox);
+    friendReadReceiptCallback(NULL, 5, 7, (__bridge void *)self.tox);
+    [self.tox endEventBatch];
+
+    OCMVerifyAll(delegate);
+    XCTAssertEqual(receivedBatch.count, 2);
+
+    id secondDelegate = OCMProtocolMock(@protocol(OCTToxDelegate));
+    OCMExpect([secondDelegate tox:self.tox friendIsTypingUpdate:YES friendNumber:5]);
+    OCMExpect([secondDelegate tox:self.tox messageDelivered:7 friendNumber:5]);
+    [secondDelegate setExpectationOrderMatters:YES];
+
+    [receivedBatch deliverToDelegate:secondDelegate];
+
+    OCMVerifyAll(secondDelegate);
+}
+
+- (void)testNoBatchingWithoutBatchDelegateMethod
+{
+    id delegate = OCMStrictProtocolMock(@protocol(OCTToxDelegate));
+    OCMStub([delegate respondsToSelector:@selector(tox:receivedEventBatch:)]).andReturn(NO);
+    OCMStub([delegate respondsToSelector:@selector(tox:friendIsTypingUpdate:friendNumber:)]).andReturn(YES);
+    OCMExpect([delegate tox:self.tox friendIsTypingUpdate:YES friendNumber:5]);
+    self.tox.delegate = delegate;
+
+    [self.tox beginEventBatch];
+    friendTypingCallback(NULL, 5, true, (__bridge void *)self.tox);
+
+    // Delivered right away, not waiting for the end of iteration.
+    OCMVerifyAll(delegate);
+
+    [self.tox endEventBatch];
+}
+
+- (void)testDelegateCapabilities
+{
+    XCTAssertEqual(OCTToxDelegateCapabilitiesOfDelegate(nil), 0);
+    XCTAssertEqual(OCTToxDelegateCapabilitiesOfDelegate([OCTToxEventBatchTestsTypingDelegate new]),
+                   OCTToxDelegateCapabilityFriendIsTyping);
+    XCTAssertEqual(OCTToxDelegateCapabilitiesOfDelegate([OCTToxEventBatchTestsManager new]),
+                   OCTToxDelegateCapabilityReceivedEventBatch);
+}
+
+- (void)testBatchUsesCapabilitiesOfReceivingDelegate
+{
+    OCTToxEventBatchTestsManager *manager = [OCTToxEventBatchTestsManager new];
+    OCTToxEventBatchTestsTypingDelegate *submanager = [OCTToxEventBatchTestsTypingDelegate new];
+    manager.realmManager = self.realmManager;
+    manager.submanager = submanager;
+    self.tox.delegate = manager;
+
+    [self.tox beginEventBatch];
+    friendTypingCallback(NULL, 5, true, (__bridge void *)self.tox);
+    friendReadReceiptCallback(NULL, 5, 7, (__bridge void *)self.tox);
+    friendTypingCallback(NULL, 5, false, (__bridge void *)self.tox);
+    [self.tox endEventBatch];
+
+    XCTAssertEqual(submanager.typingUpdatesCount, 2);
+}
+
+- (void)testEmptyIterationDoesNotDeliverBatch
+{
+    id delegate = OCMProtocolMock(@protocol(OCTToxDelegate));
+    [[delegate reject] tox:[OCMArg any] receivedEventBatch:[OCMArg any]];
+    self.tox.delegate = delegate;
+
+    [self.tox beginEventBatch];
+    [self.tox endEventBatch];
+
+    OCMVerifyAll(delegate);
+}
+
+#pragma mark -  Loopback benchmark
+
+- (void)testLoopbackMessagesWithoutBatchPerformance
+{
+    [self measureLoopbackMessagesWithBatching:NO expectedTransactions:2 * kLoopbackMessagesCount];
+}
+
+- (void)testLoopbackMessagesWithBatchPerformance
+{
+    [self measureLoopbackMessagesWithBatching:YES expectedTransactions:1];
+}
+
+/**
+ * Delivers kLoopbackMessagesCount friend messages fired during single iteration to chats submanager.
+ */
+- (void)measureLoopbackMessagesWithBatching:(BOOL)batching expectedTransactions:(NSUInteger)expectedTransactions
+{
+    OCTFriend *friend = [self createFriendWithFriendNumber:5];
+    OCTChat *chat = [OCTChat new];
+    [chat.friends addObject:friend];
+
+    [self.realmManager.realm beginWriteTransaction];
+    [self.realmManager.realm addObject:chat];
+    [self.realmManager.realm commitWriteTransaction];
+
+    id tox = OCMPartialMock(self.tox);
+    OCMStub([tox publicKeyFromFriendNumber:5 error:nil]).andReturn(friend.publicKey);
+
+    id dataSource = OCMProtocolMock(@protocol(OCTSubmanagerDataSource));
+    OCMStub([dataSource managerGetRealmManager]).andReturn(self.realmManager);
+    OCMStub([dataSource managerGetTox]).andReturn(tox);
+    OCMStub([dataSource managerGetNotificationCenter]).andReturn([NSNotificationCenter new]);
+
+    OCTSubmanagerChatsImpl *submanager = [OCTSubmanagerChatsImpl new];
+    submanager.dataSource = dataSource;
+
+    OCTToxEventBatchTestsManager *manager = [OCTToxEventBatchTestsManager new];
+    manager.realmManager = self.realmManager;
+    manager.submanager = submanager;
+
+    self.tox.delegate = batching ? manager : submanager;
+
+    const char *text = "loopback message";
+
+    [self measureBlock:^{
+        NSUInteger transactionsBefore = self.realmManager.writeTransactionsCount;
+
+        [self.tox beginEventBatch];
+        for (NSUInteger i = 0; i < kLoopbackMessagesCount; i++) {
+            friendMessageCallback(NULL, 5, TOX_MESSAGE_TYPE_NORMAL, (const uint8_t *)text, strlen(text), (__bridge void *)self.tox);
+        }
+        [self.tox endEventBatch];
+
+        XCTAssertEqual(self.realmManager.writeTransactionsCount - transactionsBefore, expectedTransactions);
+    }];
+
+    XCTAssertEqual([OCTMessageAbstract allObjectsInRealm:self.realmManager.realm].count % kLoopbackMessagesCount, 0);
+
+    [tox stopMocking];
+}
+
+@end
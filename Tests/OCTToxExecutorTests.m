@@ -0,0 +1,182 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <XCTest/XCTest.h>
+#import <libkern/OSAtomic.h>
+
+#import "OCTToxExecutor.h"
+#import "OCTTox+Private.h"
+#import "OCTToxOptions.h"
+
+static const NSUInteger kStressThreadsCount = 16;
+static const NSUInteger kStressCommandsPerThread = 2000;
+
+@interface OCTToxExecutorTests : XCTestCase
+
+@property (strong, nonatomic) dispatch_queue_t queue;
+@property (strong, nonatomic) OCTToxExecutor *executor;
+
+@end
+
+@implementation OCTToxExecutorTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.queue = dispatch_queue_create("me.dvor.objcToxTests.executor", NULL);
+    self.executor = [[OCTToxExecutor alloc] initWithQueue:self.queue];
+}
+
+- (void)tearDown
+{
+    self.executor = nil;
+    self.queue = nil;
+
+    [super tearDown];
+}
+
+- (void)testPerformSync
+{
+    __block BOOL onQueue = NO;
+
+    [self.executor performSync:^{
+        onQueue = [self.executor isCurrentQueue];
+    }];
+
+    XCTAssertTrue(onQueue);
+    XCTAssertFalse([self.executor isCurrentQueue]);
+}
+
+- (void)testPerformSyncOnQueueIsImmediate
+{
+    NSMutableArray *order = [NSMutableArray new];
+
+    [self.executor performSync:^{
+        [self.executor performSync:^{
+            [order addObject:@1];
+        }];
+        [order addObject:@2];
+    }];
+
+    XCTAssertEqualObjects(order, (@[@1, @2]));
+}
+
+- (void)testPerformAsyncKeepsOrder
+{
+    NSMutableArray *order = [NSMutableArray new];
+
+    for (NSUInteger i = 0; i < 1000; i++) {
+        [self.executor performAsync:^{
+            [order addObject:@(i)];
+        }];
+    }
+
+    // Sync command is queued after all async ones.
+    [self.executor performSync:^{}];
+
+    XCTAssertEqual(order.count, 1000);
+
+    for (NSUInteger i = 0; i < order.count; i++) {
+        XCTAssertEqualObjects(order[i], @(i));
+    }
+}
+
+- (void)testDrain
+{
+    __block NSUInteger count = 0;
+
+    dispatch_sync(self.queue, ^{
+        // Queue is busy, so commands wait for explicit drain.
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            [self.executor performAsync:^{
+                count++;
+            }];
+        });
+
+        [NSThread sleepForTimeInterval:0.1];
+        [self.executor drain];
+
+        XCTAssertEqual(count, 1);
+    });
+}
+
+- (void)testLatencyHistogram
+{
+    XCTAssertEqual([self.executor latencyHistogram].count, kOCTToxExecutorLatencyBucketsCount);
+
+    for (NSUInteger i = 0; i < 10; i++) {
+        [self.executor performSync:^{}];
+    }
+
+    // Executed right away, not counted.
+    dispatch_sync(self.queue, ^{
+        [self.executor performSync:^{}];
+    });
+
+    XCTAssertEqual([self sumOfHistogram:[self.executor latencyHistogram]], 10);
+
+    [self.executor resetLatencyHistogram];
+    XCTAssertEqual([self sumOfHistogram:[self.executor latencyHistogram]], 0);
+}
+
+#pragma mark -  Stress
+
+- (void)testStressSendsFromManyThreads
+{
+    OCTTox *friendTox = [[OCTTox alloc] initWithOptions:[OCTToxOptions new] savedData:nil error:nil];
+    OCTTox *tox = [[OCTTox alloc] initWithOptions:[OCTToxOptions new] savedData:nil error:nil];
+
+    OCTToxFriendNumber friendNumber = [tox addFriendWithNoRequestWithPublicKey:friendTox.publicKey error:nil];
+    XCTAssertNotEqual(friendNumber, kOCTToxFriendNumberFailure);
+
+    [tox start];
+    [tox.executor resetLatencyHistogram];
+
+    dispatch_group_t group = dispatch_group_create();
+    dispatch_queue_t queue = dispatch_queue_create("me.dvor.objcToxTests.stress", DISPATCH_QUEUE_CONCURRENT);
+
+    __block int32_t notConnectedCount = 0;
+
+    for (NSUInteger thread = 0; thread < kStressThreadsCount; thread++) {
+        dispatch_group_async(group, queue, ^{
+            int32_t localCount = 0;
+
+            for (NSUInteger i = 0; i < kStressCommandsPerThread; i++) {
+                NSError *error;
+                [tox sendMessageWithFriendNumber:friendNumber type:OCTToxMessageTypeNormal message:@"stress" error:&error];
+
+                if (error.code == OCTToxErrorFriendSendMessageFriendNotConnected) {
+                    localCount++;
+                }
+            }
+
+            OSAtomicAdd32(localCount, &notConnectedCount);
+        });
+    }
+
+    XCTAssertEqual(dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, 60 * NSEC_PER_SEC)), 0);
+
+    [tox stop];
+
+    XCTAssertEqual((NSUInteger)notConnectedCount, kStressThreadsCount * kStressCommandsPerThread);
+
+    NSArray<NSNumber *> *histogram = [tox.executor latencyHistogram];
+    XCTAssertEqual([self sumOfHistogram:histogram], kStressThreadsCount * kStressCommandsPerThread);
+}
+
+#pragma mark -  Private
+
+- (NSUInteger)sumOfHistogram:(NSArray<NSNumber *> *)histogram
+{
+    NSUInteger sum = 0;
+
+    for (NSNumber *count in histogram) {
+        sum += count.unsignedIntegerValue;
+    }
+
+    return sum;
+}
+
+@end
@@ -0,0 +1,109 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <XCTest/XCTest.h>
+
+#import "OCTToxPassKey+Private.h"
+#import "OCTToxEncryptSave.h"
+#import "OCTToxEncryptSaveConstants.h"
+
+@interface OCTToxPassKeyTests : XCTestCase
+
+@end
+
+@implementation OCTToxPassKeyTests
+
+- (void)testEncryptDecrypt
+{
+    OCTToxPassKey *passKey = [OCTToxPassKey passKeyWithPassphrase:@"p@s$" salt:nil error:nil];
+    XCTAssertNotNil(passKey);
+    XCTAssertEqual(passKey.salt.length, TOX_PASS_SALT_LENGTH);
+
+    NSData *data = [@"data" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *encrypted = [passKey encryptData:data error:nil];
+
+    XCTAssertTrue([OCTToxEncryptSave isDataEncrypted:encrypted]);
+    XCTAssertEqualObjects([OCTToxPassKey saltOfEncryptedData:encrypted], passKey.salt);
+    XCTAssertEqualObjects([passKey decryptData:encrypted error:nil], data);
+
+    // Compatible with class methods.
+    XCTAssertEqualObjects([OCTToxEncryptSave decryptData:encrypted withPassphrase:@"p@s$" error:nil], data);
+}
+
+- (void)testSaltOfEncryptedData
+{
+    XCTAssertNil([OCTToxPassKey saltOfEncryptedData:[NSData new]]);
+    XCTAssertNil([OCTToxPassKey saltOfEncryptedData:[@"data" dataUsingEncoding:NSUTF8StringEncoding]]);
+}
+
+- (void)testKeyIsDerivedOncePerPassphraseAndSalt
+{
+    OCTToxPassKey *passKey = [OCTToxPassKey passKeyWithPassphrase:@"password" salt:nil error:nil];
+    NSUInteger count = [OCTToxPassKey keyDerivationsCount];
+
+    OCTToxPassKey *same = [OCTToxPassKey passKeyWithPassphrase:@"password" salt:passKey.salt error:nil];
+
+    XCTAssertEqual(passKey, same);
+    XCTAssertEqual([OCTToxPassKey keyDerivationsCount], count);
+
+    OCTToxPassKey *another = [OCTToxPassKey passKeyWithPassphrase:@"another" salt:passKey.salt error:nil];
+
+    XCTAssertNotEqual(passKey, another);
+    XCTAssertEqual([OCTToxPassKey keyDerivationsCount], count + 1);
+
+    // Class methods reuse alive keys too.
+    NSData *encrypted = [passKey encryptData:[NSData dataWithBytes:"1" length:1] error:nil];
+    XCTAssertNotNil([OCTToxEncryptSave decryptData:encrypted withPassphrase:@"password" error:nil]);
+    XCTAssertEqual([OCTToxPassKey keyDerivationsCount], count + 1);
+}
+
+- (void)testRandomSaltIsNotReused
+{
+    OCTToxPassKey *first = [OCTToxPassKey passKeyWithPassphrase:@"password" salt:nil error:nil];
+    OCTToxPassKey *second = [OCTToxPassKey passKeyWithPassphrase:@"password" salt:nil error:nil];
+
+    XCTAssertNotEqualObjects(first.salt, second.salt);
+}
+
+- (void)testVerifyEncryptedData
+{
+    OCTToxPassKey *passKey = [OCTToxPassKey passKeyWithPassphrase:@"password" salt:nil error:nil];
+    OCTToxPassKey *wrong = [OCTToxPassKey passKeyWithPassphrase:@"wrong" salt:passKey.salt error:nil];
+    OCTToxPassKey *otherSalt = [OCTToxPassKey passKeyWithPassphrase:@"password" salt:nil error:nil];
+
+    NSData *encrypted = [passKey encryptData:[NSData dataWithBytes:"1" length:1] error:nil];
+
+    XCTAssertFalse([wrong verifyEncryptedData:encrypted]);
+    XCTAssertFalse([otherSalt verifyEncryptedData:encrypted]);
+    XCTAssertTrue([passKey verifyEncryptedData:encrypted]);
+    XCTAssertTrue([passKey verifyEncryptedData:encrypted]);
+}
+
+- (void)testDecryptErrors
+{
+    NSError *error;
+    NSUInteger count = [OCTToxPassKey keyDerivationsCount];
+
+    XCTAssertNil([OCTToxEncryptSave decryptData:[@"data" dataUsingEncoding:NSUTF8StringEncoding] withPassphrase:@"password" error:&error]);
+    XCTAssertEqual(error.code, OCTToxEncryptSaveDecryptionErrorBadFormat);
+
+    // Unencrypted data doesn't cost derivation.
+    XCTAssertEqual([OCTToxPassKey keyDerivationsCount], count);
+}
+
+- (void)testDeriveAsync
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"derived"];
+
+    [OCTToxPassKey derivePassKeyWithPassphrase:@"password" salt:nil completionBlock:^(OCTToxPassKey *passKey, NSError *error) {
+        XCTAssertTrue([NSThread isMainThread]);
+        XCTAssertNotNil(passKey);
+        XCTAssertNil(error);
+        [expectation fulfill];
+    }];
+
+    [self waitForExpectationsWithTimeout:10.0 handler:nil];
+}
+
+@end
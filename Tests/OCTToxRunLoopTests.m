@@ -0,0 +1,186 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <XCTest/XCTest.h>
+#import <libkern/OSAtomic.h>
+
+#import "OCTTestCase.h"
+#import "OCTToxRunLoop+Private.h"
+#import "OCTTox+Private.h"
+#import "OCTToxAV+Private.h"
+#import "OCTToxOptions.h"
+
+static const uint32_t kToxAVInterval = 5;
+static volatile int32_t toxAVIterationsCount;
+
+static void mocked_toxav_iterate(ToxAV *toxAV)
+{
+    OSAtomicIncrement32(&toxAVIterationsCount);
+}
+
+static uint32_t mocked_toxav_iteration_interval(const ToxAV *toxAV)
+{
+    return kToxAVInterval;
+}
+
+@interface OCTToxRunLoopTests : OCTTestCase
+
+@property (strong, nonatomic) OCTTox *tox;
+@property (strong, nonatomic) OCTToxAV *toxAV;
+
+@end
+
+@implementation OCTToxRunLoopTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.tox = [[OCTTox alloc] initWithOptions:[OCTToxOptions new] savedData:nil error:nil];
+    self.toxAV = [[OCTToxAV alloc] initWithTox:self.tox error:nil];
+
+    _toxav_iterate = mocked_toxav_iterate;
+    _toxav_iteration_interval = mocked_toxav_iteration_interval;
+    toxAVIterationsCount = 0;
+}
+
+- (void)tearDown
+{
+    [self.toxAV stop];
+    [self.tox stop];
+
+    self.toxAV = nil;
+    self.tox = nil;
+
+    [super tearDown];
+}
+
+- (void)testRunningWithTox
+{
+    XCTAssertNotNil(self.tox.runLoop);
+    XCTAssertFalse(self.tox.runLoop.isRunning);
+
+    [self.tox start];
+    XCTAssertTrue(self.tox.runLoop.isRunning);
+
+    [self.tox stop];
+    XCTAssertFalse(self.tox.runLoop.isRunning);
+}
+
+- (void)testRunningWithToxAndToxAV
+{
+    [self.tox start];
+    [self.toxAV start];
+
+    [self.tox stop];
+    XCTAssertTrue(self.tox.runLoop.isRunning);
+
+    [self.toxAV stop];
+    XCTAssertFalse(self.tox.runLoop.isRunning);
+}
+
+- (void)testIteratesTox
+{
+    [self.tox start];
+
+    [self waitForIterationsCount:3];
+
+    OCTToxRunLoopStats *stats = [self.tox.runLoop stats];
+    XCTAssertGreaterThanOrEqual(stats.iterationsCount, 3);
+    XCTAssertGreaterThan(stats.requestedInterval, 0.0);
+    XCTAssertGreaterThan(stats.maxIterateDuration, 0.0);
+    XCTAssertLessThanOrEqual(stats.averageIterateDuration, stats.maxIterateDuration);
+    XCTAssertLessThanOrEqual(stats.averageLateness, stats.maxLateness);
+    XCTAssertEqual(toxAVIterationsCount, 0);
+}
+
+- (void)testIteratesToxAVOnSameRunLoop
+{
+    [self.toxAV start];
+
+    [self waitForIterationsCount:3];
+
+    XCTAssertGreaterThanOrEqual(toxAVIterationsCount, 3);
+    XCTAssertEqualWithAccuracy([self.tox.runLoop stats].requestedInterval, kToxAVInterval / 1000.0, 0.0001);
+}
+
+- (void)testUsesSmallestInterval
+{
+    [self.tox start];
+    [self.toxAV start];
+
+    [self waitForIterationsCount:3];
+
+    XCTAssertEqualWithAccuracy([self.tox.runLoop stats].requestedInterval, kToxAVInterval / 1000.0, 0.0001);
+}
+
+- (void)testProfileChangeWhileRunning
+{
+    XCTAssertEqual(self.tox.runLoop.profile, OCTToxRunLoopProfileLowPower);
+
+    [self.toxAV start];
+    [self waitForIterationsCount:2];
+
+    self.tox.runLoop.profile = OCTToxRunLoopProfileLowLatency;
+    XCTAssertEqual(self.tox.runLoop.profile, OCTToxRunLoopProfileLowLatency);
+    XCTAssertTrue(self.tox.runLoop.isRunning);
+
+    NSUInteger count = [self.tox.runLoop stats].iterationsCount;
+    [self waitForIterationsCount:count + 2];
+}
+
+- (void)testResetStats
+{
+    [self.toxAV start];
+    [self waitForIterationsCount:2];
+    [self.toxAV stop];
+
+    [self.tox.runLoop resetStats];
+
+    OCTToxRunLoopStats *stats = [self.tox.runLoop stats];
+    XCTAssertEqual(stats.iterationsCount, 0);
+    XCTAssertEqual(stats.averageIterateDuration, 0.0);
+    XCTAssertEqual(stats.maxIterateDuration, 0.0);
+    XCTAssertEqual(stats.averageLateness, 0.0);
+    XCTAssertEqual(stats.maxLateness, 0.0);
+}
+
+/**
+ * Low power profile gives timer leeway, so iterations are expected to start later than with low latency one.
+ */
+- (void)testLowLatencyLatenessPerformance
+{
+    self.tox.runLoop.profile = OCTToxRunLoopProfileLowPower;
+    [self.toxAV start];
+    [self waitForIterationsCount:100];
+    [self.toxAV stop];
+
+    OCTToxRunLoopStats *lowPower = [self.tox.runLoop stats];
+
+    [self.tox.runLoop resetStats];
+    self.tox.runLoop.profile = OCTToxRunLoopProfileLowLatency;
+    [self.toxAV start];
+    [self waitForIterationsCount:100];
+    [self.toxAV stop];
+
+    OCTToxRunLoopStats *lowLatency = [self.tox.runLoop stats];
+
+    XCTAssertLessThanOrEqual(lowLatency.averageLateness, lowPower.averageLateness);
+}
+
+#pragma mark -  Private
+
+- (void)waitForIterationsCount:(NSUInteger)count
+{
+    OCTToxRunLoop *runLoop = self.tox.runLoop;
+
+    NSPredicate *predicate = [NSPredicate predicateWithBlock:^BOOL (id object, NSDictionary *bindings) {
+        return [runLoop stats].iterationsCount >= count;
+    }];
+
+    [self expectationForPredicate:predicate evaluatedWithObject:runLoop handler:nil];
+    [self waitForExpectationsWithTimeout:5.0 handler:nil];
+}
+
+@end
@@ -0,0 +1,215 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#import <OCMock/OCMock.h>
+#import <XCTest/XCTest.h>
+
+#if TARGET_OS_IPHONE
+#import <UIKit/UIKit.h>
+#else
+#import <AppKit/AppKit.h>
+#endif
+
+#import "OCTToxSaveScheduler.h"
+#import "OCTTox.h"
+#import "OCTToxEncryptSave.h"
+
+static const NSTimeInterval kMaxLatency = 0.2;
+
+@interface OCTToxSaveSchedulerTests : XCTestCase
+
+@property (strong, nonatomic) id tox;
+@property (strong, nonatomic) id encryptSave;
+@property (strong, nonatomic) NSString *path;
+@property (strong, atomic) NSData *toxData;
+@property (strong, nonatomic) OCTToxSaveScheduler *scheduler;
+
+@end
+
+@implementation OCTToxSaveSchedulerTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    self.toxData = [@"state 1" dataUsingEncoding:NSUTF8StringEncoding];
+
+    __weak OCTToxSaveSchedulerTests *weakSelf = self;
+
+    self.tox = OCMClassMock([OCTTox class]);
+    OCMStub([self.tox save]).andDo(^(NSInvocation *invocation) {
+        NSData *data = weakSelf.toxData;
+        [invocation setReturnValue:&data];
+    });
+
+    self.encryptSave = [self mockedEncryptSave];
+
+    self.scheduler = [[OCTToxSaveScheduler alloc] initWithTox:self.tox
+                                                  encryptSave:self.encryptSave
+                                                         path:self.path
+                                                   maxLatency:kMaxLatency];
+}
+
+- (void)tearDown
+{
+    self.scheduler = nil;
+    self.tox = nil;
+    self.encryptSave = nil;
+
+    [[NSFileManager defaultManager] removeItemAtPath:self.path error:nil];
+
+    [super tearDown];
+}
+
+- (void)testFlush
+{
+    XCTAssertTrue([self.scheduler flushAndReturnError:nil]);
+
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:self.path], self.toxData);
+    XCTAssertEqual(self.scheduler.savesRequestedCount, 1);
+    XCTAssertEqual(self.scheduler.savesPerformedCount, 1);
+}
+
+- (void)testFlushSkipsUnchangedData
+{
+    XCTAssertTrue([self.scheduler flushAndReturnError:nil]);
+    XCTAssertTrue([self.scheduler flushAndReturnError:nil]);
+
+    XCTAssertEqual(self.scheduler.savesPerformedCount, 1);
+    XCTAssertEqual(self.scheduler.savesSkippedCount, 1);
+
+    self.toxData = [@"state 2" dataUsingEncoding:NSUTF8StringEncoding];
+    XCTAssertTrue([self.scheduler flushAndReturnError:nil]);
+
+    XCTAssertEqual(self.scheduler.savesPerformedCount, 2);
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:self.path], self.toxData);
+}
+
+- (void)testNewEncryptSaveForcesWrite
+{
+    XCTAssertTrue([self.scheduler flushAndReturnError:nil]);
+
+    self.scheduler.encryptSave = [self mockedEncryptSave];
+    XCTAssertTrue([self.scheduler flushAndReturnError:nil]);
+
+    XCTAssertEqual(self.scheduler.savesPerformedCount, 2);
+}
+
+- (void)testFlushFailure
+{
+    id encryptSave = OCMClassMock([OCTToxEncryptSave class]);
+    OCMStub([encryptSave encryptData:[OCMArg any] error:[OCMArg anyObjectRef]]).andReturn(nil);
+
+    self.scheduler.encryptSave = encryptSave;
+
+    XCTAssertFalse([self.scheduler flushAndReturnError:nil]);
+    XCTAssertEqual(self.scheduler.savesPerformedCount, 0);
+}
+
+- (void)testSetNeedsSaveIsCoalesced
+{
+    for (NSUInteger i = 0; i < 500; i++) {
+        self.toxData = [[NSString stringWithFormat:@"state %lu", (unsigned long)i] dataUsingEncoding:NSUTF8StringEncoding];
+        [self.scheduler setNeedsSave];
+    }
+
+    XCTAssertEqual(self.scheduler.savesRequestedCount, 500);
+    XCTAssertEqual(self.scheduler.savesPerformedCount, 0);
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:self.path]);
+
+    [self waitForSavesPerformedCount:1];
+
+    XCTAssertEqual(self.scheduler.savesPerformedCount, 1);
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:self.path], self.toxData);
+}
+
+- (void)testSetNeedsSaveAfterWriteSchedulesNewOne
+{
+    [self.scheduler setNeedsSave];
+    [self waitForSavesPerformedCount:1];
+
+    self.toxData = [@"state 2" dataUsingEncoding:NSUTF8StringEncoding];
+    [self.scheduler setNeedsSave];
+    [self waitForSavesPerformedCount:2];
+
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:self.path], self.toxData);
+}
+
+- (void)testFlushWritesPendingSave
+{
+    [self.scheduler setNeedsSave];
+    XCTAssertTrue([self.scheduler flushAndReturnError:nil]);
+
+    XCTAssertEqual(self.scheduler.savesPerformedCount, 1);
+
+    // Scheduled save has nothing to do.
+    [NSThread sleepForTimeInterval:kMaxLatency * 2];
+
+    XCTAssertEqual(self.scheduler.savesPerformedCount, 1);
+    XCTAssertEqual(self.scheduler.savesSkippedCount, 0);
+}
+
+- (void)testDeallocWritesPendingSave
+{
+    [self.scheduler setNeedsSave];
+    self.scheduler = nil;
+
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:self.path], self.toxData);
+}
+
+- (void)testAccessSaveFile
+{
+    [self.scheduler flushAndReturnError:nil];
+
+    __block NSString *path;
+    [self.scheduler accessSaveFile:^(NSString *savePath) {
+        path = savePath;
+    }];
+
+    XCTAssertEqualObjects(path, self.path);
+}
+
+- (void)testApplicationNotificationFlushesPendingSave
+{
+    [self.scheduler setNeedsSave];
+
+#if TARGET_OS_IPHONE
+    NSString *name = UIApplicationDidEnterBackgroundNotification;
+#else
+    NSString *name = NSApplicationWillTerminateNotification;
+#endif
+
+    [[NSNotificationCenter defaultCenter] postNotificationName:name object:nil];
+
+    XCTAssertEqual(self.scheduler.savesPerformedCount, 1);
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:self.path], self.toxData);
+}
+
+#pragma mark -  Private
+
+- (id)mockedEncryptSave
+{
+    id encryptSave = OCMClassMock([OCTToxEncryptSave class]);
+    OCMStub([encryptSave encryptData:[OCMArg any] error:[OCMArg anyObjectRef]]).andDo(^(NSInvocation *invocation) {
+        __unsafe_unretained NSData *data;
+        [invocation getArgument:&data atIndex:2];
+        [invocation setReturnValue:&data];
+    });
+
+    return encryptSave;
+}
+
+- (void)waitForSavesPerformedCount:(NSUInteger)count
+{
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:kMaxLatency * 10];
+
+    while ((self.scheduler.savesPerformedCount < count) && ([deadline timeIntervalSinceNow] > 0)) {
+        [NSThread sleepForTimeInterval:0.01];
+    }
+
+    XCTAssertEqual(self.scheduler.savesPerformedCount, count);
+}
+
+@end
@@ -5,6 +5,7 @@
 #import <Foundation/Foundation.h>
 #import <OCMock/OCMock.h>
 
+#import "OCTTestCase.h"
 #import "OCTTox+Private.h"
 #import "OCTToxOptions.h"
 #import "OCTCAsserts.h"
@@ -12,8 +13,37 @@
 static void *refToSelf;
 
 void mocked_tox_self_get_public_key(const Tox *tox, uint8_t *public_key);
+bool mocked_tox_file_get_file_id(const Tox *tox, uint32_t friend_number, uint32_t file_number, uint8_t *file_id,
+                                 TOX_ERR_FILE_GET *error);
 
-@interface OCTToxTests : XCTestCase
+static NSUInteger fileGetFileIdCallsCount;
+
+static const NSUInteger kDelegateQueueBenchmarkEvents = 10000;
+
+@interface OCTToxTestsCountingDelegate : NSObject <OCTToxDelegate>
+
+@property (assign, nonatomic) NSUInteger expectedCount;
+@property (assign, nonatomic) NSUInteger count;
+@property (assign, nonatomic) BOOL calledOnMainThread;
+@property (strong, nonatomic) dispatch_semaphore_t semaphore;
+
+@end
+
+@implementation OCTToxTestsCountingDelegate
+
+- (void)tox:(OCTTox *)tox friendIsTypingUpdate:(BOOL)isTyping friendNumber:(OCTToxFriendNumber)friendNumber
+{
+    self.count++;
+    self.calledOnMainThread = self.calledOnMainThread || [NSThread isMainThread];
+
+    if (self.count == self.expectedCount) {
+        dispatch_semaphore_signal(self.semaphore);
+    }
+}
+
+@end
+
+@interface OCTToxTests : OCTTestCase
 
 @property (strong, nonatomic) OCTTox *tox;
 
@@ -68,6 +98,94 @@ void mocked_tox_self_get_public_key(const Tox *tox, uint8_t *public_key);
     XCTAssertEqualObjects(publicKey, @"000102030405060708090A0B0C0D0E0F" @"000102030405060708090A0B0C0D0E0F");
 }
 
+- (void)testFriendsCache
+{
+    OCTTox *other = [[OCTTox alloc] initWithOptions:[OCTToxOptions new] savedData:nil error:nil];
+    OCTPublicKey *publicKey = other.publicKeyValue;
+
+    OCTToxFriendNumber friendNumber = [self.tox addFriendWithNoRequestWithPublicKeyValue:publicKey error:nil];
+    XCTAssertNotEqual(friendNumber, kOCTToxFriendNumberFailure);
+
+    XCTAssertEqualObjects([self.tox publicKeyValueFromFriendNumber:friendNumber error:nil], publicKey);
+    XCTAssertEqualObjects([self.tox publicKeyFromFriendNumber:friendNumber error:nil], other.publicKey);
+    XCTAssertEqual([self.tox friendNumberWithPublicKeyValue:publicKey error:nil], friendNumber);
+    XCTAssertEqual([self.tox friendNumberWithPublicKey:other.publicKey.lowercaseString error:nil], friendNumber);
+
+    XCTAssertNil([self.tox clientIdentifierForFriendNumber:friendNumber]);
+    [self.tox setClientIdentifier:@"identifier" forFriendNumber:friendNumber];
+    XCTAssertEqualObjects([self.tox clientIdentifierForFriendNumber:friendNumber], @"identifier");
+
+    XCTAssertTrue([self.tox deleteFriendWithFriendNumber:friendNumber error:nil]);
+
+    NSError *error;
+    XCTAssertNil([self.tox publicKeyFromFriendNumber:friendNumber error:&error]);
+    XCTAssertEqual(error.code, OCTToxErrorFriendGetPublicKeyFriendNotFound);
+    XCTAssertNil([self.tox clientIdentifierForFriendNumber:friendNumber]);
+    XCTAssertEqual([self.tox friendNumberWithPublicKeyValue:publicKey error:nil], kOCTToxFriendNumberFailure);
+}
+
+- (void)testFriendsCacheIsFilledOnLoad
+{
+    OCTTox *other = [[OCTTox alloc] initWithOptions:[OCTToxOptions new] savedData:nil error:nil];
+    OCTToxFriendNumber friendNumber = [self.tox addFriendWithNoRequestWithPublicKey:other.publicKey error:nil];
+    [self.tox setClientIdentifier:@"identifier" forFriendNumber:friendNumber];
+
+    OCTTox *loaded = [[OCTTox alloc] initWithOptions:[OCTToxOptions new] savedData:[self.tox save] error:nil];
+
+    XCTAssertEqualObjects([loaded publicKeyFromFriendNumber:friendNumber error:nil], other.publicKey);
+    XCTAssertNil([loaded clientIdentifierForFriendNumber:friendNumber]);
+}
+
+- (void)testFriendsCachePerformance
+{
+    const NSUInteger count = 2000;
+
+    for (NSUInteger i = 0; i < count; i++) {
+        uint8_t bytes[32];
+        arc4random_buf(bytes, sizeof(bytes));
+
+        [self.tox addFriendWithNoRequestWithPublicKeyValue:[[OCTPublicKey alloc] initWithBytes:bytes] error:nil];
+    }
+
+    [self measureBlock:^{
+        for (NSUInteger iteration = 0; iteration < 50; iteration++) {
+            for (OCTToxFriendNumber friendNumber = 0; friendNumber < count; friendNumber++) {
+                [self.tox publicKeyFromFriendNumber:friendNumber error:nil];
+            }
+        }
+    }];
+}
+
+- (void)testIterationObservers
+{
+    __block NSUInteger calls = 0;
+    __block id removingToken;
+
+    id token = [self.tox addIterationObserver:^{
+        calls++;
+    }];
+
+    // Removing itself while being called.
+    removingToken = [self.tox addIterationObserver:^{
+        [self.tox removeIterationObserver:removingToken];
+        removingToken = nil;
+    }];
+
+    dispatch_queue_t queue = [self.tox valueForKey:@"iterateQueue"];
+
+    dispatch_sync(queue, ^{
+        [self.tox iterate];
+    });
+    XCTAssertEqual(calls, 1);
+
+    [self.tox removeIterationObserver:token];
+
+    dispatch_sync(queue, ^{
+        [self.tox iterate];
+    });
+    XCTAssertEqual(calls, 1);
+}
+
 #pragma mark -  Private methods
 
 - (void)testUserStatusFromCUserStatus
@@ -731,6 +849,25 @@ void mocked_tox_self_get_public_key(const Tox *tox, uint8_t *public_key);
     }];
 }
 
+- (void)testFileIdOfReceivedFileIsCapturedInCallback
+{
+    _tox_file_get_file_id = mocked_tox_file_get_file_id;
+    fileGetFileIdCallsCount = 0;
+
+    fileReceiveCallback(NULL, 5, 4, TOX_FILE_KIND_DATA, 500, (const uint8_t *)"filename", 8, (__bridge void *)self.tox);
+    XCTAssertEqual(fileGetFileIdCallsCount, 1);
+
+    NSData *fileId = [self.tox fileGetFileIdForFileNumber:4 friendNumber:5 error:nil];
+    XCTAssertEqual(fileId.length, kOCTToxFileIdLength);
+    XCTAssertEqual(((const uint8_t *)fileId.bytes)[0], 4);
+    XCTAssertEqual(fileGetFileIdCallsCount, 1);
+
+    fileReceiveControlCallback(NULL, 5, 4, TOX_FILE_CONTROL_CANCEL, (__bridge void *)self.tox);
+
+    [self.tox fileGetFileIdForFileNumber:4 friendNumber:5 error:nil];
+    XCTAssertEqual(fileGetFileIdCallsCount, 2);
+}
+
 - (void)testFileReceiveChunkCallback
 {
     [self makeTestCallbackWithCallBlock:^{
@@ -747,6 +884,84 @@ void mocked_tox_self_get_public_key(const Tox *tox, uint8_t *public_key);
     }];
 }
 
+#pragma mark -  Delegate queue
+
+- (void)testDelegateQueueIterate
+{
+    OCTToxOptions *options = [OCTToxOptions new];
+    options.delegateQueue = OCTToxDelegateQueueIterate;
+    self.tox = [[OCTTox alloc] initWithOptions:options savedData:nil error:nil];
+
+    self.tox.delegate = OCMProtocolMock(@protocol(OCTToxDelegate));
+    OCMExpect([self.tox.delegate tox:self.tox friendIsTypingUpdate:YES friendNumber:5]);
+
+    friendTypingCallback(NULL, 5, true, (__bridge void *)self.tox);
+
+    // Delivered synchronously, no need to wait.
+    OCMVerifyAll((id)self.tox.delegate);
+}
+
+- (void)testDelegateQueueDedicatedWithBusyMainThread
+{
+    OCTToxOptions *options = [OCTToxOptions new];
+    options.delegateQueue = OCTToxDelegateQueueDedicated;
+    self.tox = [[OCTTox alloc] initWithOptions:options savedData:nil error:nil];
+
+    OCTToxTestsCountingDelegate *delegate = [OCTToxTestsCountingDelegate new];
+    delegate.expectedCount = 1;
+    delegate.semaphore = dispatch_semaphore_create(0);
+    self.tox.delegate = delegate;
+
+    friendTypingCallback(NULL, 5, true, (__bridge void *)self.tox);
+
+    // Main thread is blocked here, delegate should be called anyway.
+    long result = dispatch_semaphore_wait(delegate.semaphore, dispatch_time(DISPATCH_TIME_NOW, 1.0 * NSEC_PER_SEC));
+
+    XCTAssertEqual(result, 0);
+    XCTAssertEqual(delegate.count, 1);
+    XCTAssertFalse(delegate.calledOnMainThread);
+}
+
+- (void)testDelegateQueueDedicatedPerformance
+{
+    [self measureDelegateQueueWithType:OCTToxDelegateQueueDedicated];
+}
+
+- (void)testDelegateQueueIteratePerformance
+{
+    [self measureDelegateQueueWithType:OCTToxDelegateQueueIterate];
+}
+
+/**
+ * Delivers kDelegateQueueBenchmarkEvents events from iterate queue while main thread is busy.
+ */
+- (void)measureDelegateQueueWithType:(OCTToxDelegateQueue)type
+{
+    OCTToxOptions *options = [OCTToxOptions new];
+    options.delegateQueue = type;
+    OCTTox *tox = [[OCTTox alloc] initWithOptions:options savedData:nil error:nil];
+
+    dispatch_queue_t iterateQueue = dispatch_queue_create("OCTToxTests iterate queue", NULL);
+
+    [self measureBlock:^{
+        OCTToxTestsCountingDelegate *delegate = [OCTToxTestsCountingDelegate new];
+        delegate.expectedCount = kDelegateQueueBenchmarkEvents;
+        delegate.semaphore = dispatch_semaphore_create(0);
+        tox.delegate = delegate;
+
+        dispatch_async(iterateQueue, ^{
+            for (NSUInteger i = 0; i < kDelegateQueueBenchmarkEvents; i++) {
+                friendTypingCallback(NULL, (uint32_t)i, true, (__bridge void *)tox);
+            }
+        });
+
+        long result = dispatch_semaphore_wait(delegate.semaphore, dispatch_time(DISPATCH_TIME_NOW, 10.0 * NSEC_PER_SEC));
+
+        XCTAssertEqual(result, 0);
+        XCTAssertFalse(delegate.calledOnMainThread);
+    }];
+}
+
 - (void)makeTestCallbackWithCallBlock:(void (^)())callBlock expectBlock:(void (^)(id<OCTToxDelegate> delegate))expectBlock
 {
     NSParameterAssert(callBlock);
@@ -781,4 +996,21 @@ void mocked_tox_self_get_public_key(const Tox *cTox, uint8_t *public_key)
     memcpy(public_key, bin, TOX_PUBLIC_KEY_SIZE);
 }
 
+bool mocked_tox_file_get_file_id(const Tox *cTox, uint32_t friend_number, uint32_t file_number, uint8_t *file_id,
+                                 TOX_ERR_FILE_GET *error)
+{
+    OCTTox *tox = [(__bridge OCTToxTests *)refToSelf tox];
+
+    CCCAssertTrue(cTox == tox.tox);
+
+    fileGetFileIdCallsCount++;
+    memset(file_id, file_number, TOX_FILE_ID_LENGTH);
+
+    if (error) {
+        *error = TOX_ERR_FILE_GET_OK;
+    }
+
+    return true;
+}
+
 @end
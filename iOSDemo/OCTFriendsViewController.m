@@ -12,6 +12,7 @@
 #import "OCTSubmanagerObjects.h"
 #import "OCTSubmanagerChats.h"
 #import "OCTSubmanagerFriends.h"
+#import "OCTPresenceStore.h"
 
 typedef NS_ENUM(NSUInteger, SectionType) {
     SectionTypeFriends = 0,
@@ -168,10 +169,10 @@ typedef NS_ENUM(NSUInteger, SectionType) {
                            friend.nickname,
                            friend.statusMessage,
                            [self stringFromUserStatus:friend.status],
-                           friend.isConnected,
-                           [self stringFromConnectionStatus:friend.connectionStatus],
+                           [self.manager.presence isFriendConnected:friend],
+                           [self stringFromConnectionStatus:[self.manager.presence connectionStatusOfFriend:friend]],
                            friend.lastSeenOnline,
-                           friend.isTyping];
+                           [self.manager.presence isFriendTyping:friend]];
 
     return cell;
 }